@@ -0,0 +1,576 @@
+#include <stdio.h>
+#include <nvdec/annexb.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#  define ANNEXB_HAVE_X86 1
+#  include <immintrin.h>
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  endif
+#  if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define ANNEXB_HAVE_SSE2 1
+#  endif
+#  if defined(_MSC_VER) || defined(__GNUC__) || defined(__clang__)
+#    define ANNEXB_HAVE_AVX2 1
+#  endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  define ANNEXB_HAVE_NEON 1
+#  include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER)
+#  define ANNEXB_TARGET_AVX2
+#else
+#  define ANNEXB_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  typedef const uint8_t* (*find_start_code_func)(const uint8_t* data, const uint8_t* end);
+
+  static find_start_code_func select_find_start_code();
+  static bool cpu_has_avx2();
+  static int count_trailing_zeros(uint64_t v);
+  static const uint8_t* find_start_code_scalar(const uint8_t* data, const uint8_t* end);
+
+#if defined(ANNEXB_HAVE_SSE2)
+  static const uint8_t* find_start_code_sse2(const uint8_t* data, const uint8_t* end);
+#endif
+
+#if defined(ANNEXB_HAVE_AVX2)
+  ANNEXB_TARGET_AVX2 static const uint8_t* find_start_code_avx2(const uint8_t* data, const uint8_t* end);
+#endif
+
+#if defined(ANNEXB_HAVE_NEON)
+  static const uint8_t* find_start_code_neon(const uint8_t* data, const uint8_t* end);
+#endif
+
+  /* ------------------------------------------------ */
+
+  AnnexbSplitter::AnnexbSplitter() {
+    reset();
+  }
+
+  void AnnexbSplitter::reset() {
+    scan_offset = 0;
+    has_vcl = false;
+    flags = 0;
+    num_nals = 0;
+  }
+
+  int AnnexbSplitter::next(const uint8_t* data, size_t nbytes, bool is_eos, AccessUnit& result) {
+
+    if (nullptr == data || 0 == nbytes) {
+      return (is_eos) ? ANNEXB_END_OF_STREAM : ANNEXB_NEED_MORE_DATA;
+    }
+
+    const uint8_t* end = data + nbytes;
+
+    while (true) {
+
+      const uint8_t* sc = annexb_find_start_code(data + scan_offset, end);
+      const uint8_t* hdr = sc + 3;
+
+      /* We need the NAL header and the first byte of the slice header to decide if this NAL starts a new access unit. */
+      if (end == sc || (end - hdr) < 2) {
+
+        if (false == is_eos) {
+          /* Keep the last two bytes so a start code that straddles two reads is found. */
+          if (end == sc) {
+            scan_offset = (nbytes > 2) ? nbytes - 2 : 0;
+          }
+          else {
+            scan_offset = sc - data;
+          }
+          return ANNEXB_NEED_MORE_DATA;
+        }
+
+        if (end != sc && hdr < end) {
+          add_nal(hdr[0]);
+        }
+
+        /* End of stream: everything that's left belongs to the last access unit. */
+        result.data = data;
+        result.size = nbytes;
+        result.flags = flags;
+        result.num_nals = num_nals;
+        result.pts = ANNEXB_NO_TIMESTAMP;
+        result.dts = ANNEXB_NO_TIMESTAMP;
+        reset();
+
+        return ANNEXB_OK;
+      }
+
+      uint8_t nal_type = hdr[0] & 0x1F;
+      bool is_vcl = (nal_type >= 1 && nal_type <= 5);
+      bool is_first_mb = (0 != (hdr[1] & 0x80)); /* first_mb_in_slice is ue(v); a leading 1-bit means 0. */
+      bool starts_au = false;
+
+      if (true == has_vcl) {
+        starts_au = (6 == nal_type)
+          || (7 == nal_type)
+          || (8 == nal_type)
+          || (9 == nal_type)
+          || (nal_type >= 14 && nal_type <= 18)
+          || (true == is_vcl && true == is_first_mb);
+      }
+
+      if (false == starts_au) {
+        add_nal(hdr[0]);
+        scan_offset = hdr - data;
+        continue;
+      }
+
+      /* The zero_byte in front of a 4-byte start code belongs to the next access unit. */
+      size_t cut = sc - data;
+      while (cut > 0 && 0x00 == data[cut - 1]) {
+        cut--;
+      }
+
+      result.data = data;
+      result.size = cut;
+      result.flags = flags;
+      result.num_nals = num_nals;
+      result.pts = ANNEXB_NO_TIMESTAMP;
+      result.dts = ANNEXB_NO_TIMESTAMP;
+
+      /* The NAL we just found is the first one of the next access unit; offsets are now relative to `data + cut`. */
+      reset();
+      add_nal(hdr[0]);
+      scan_offset = (hdr - data) - cut;
+
+      return ANNEXB_OK;
+    }
+
+    return ANNEXB_NEED_MORE_DATA;
+  }
+
+  void AnnexbSplitter::add_nal(uint8_t nal_header) {
+
+    uint8_t nal_type = nal_header & 0x1F;
+    uint8_t ref_idc = (nal_header >> 5) & 0x03;
+
+    switch (nal_type) {
+      case 1: {
+        break;
+      }
+      case 5: {
+        flags |= ANNEXB_AU_FLAG_IDR;
+        break;
+      }
+      case 6: {
+        flags |= ANNEXB_AU_FLAG_SEI;
+        break;
+      }
+      case 7: {
+        flags |= ANNEXB_AU_FLAG_SPS;
+        break;
+      }
+      case 8: {
+        flags |= ANNEXB_AU_FLAG_PPS;
+        break;
+      }
+    }
+
+    if (nal_type >= 1 && nal_type <= 5) {
+      has_vcl = true;
+      if (0 != ref_idc) {
+        flags |= ANNEXB_AU_FLAG_REFERENCE;
+      }
+    }
+
+    num_nals++;
+  }
+
+  /* ------------------------------------------------ */
+
+  AnnexbTimestamper::AnnexbTimestamper() {
+    reset();
+  }
+
+  void AnnexbTimestamper::reset() {
+    parameter_sets.reset();
+    picture_order.reset();
+    rate_num = 0;
+    rate_den = 0;
+    origin_fields = 0;
+    origin_ticks = 0;
+    num_fields = 0;
+    period_fields = 0;
+    max_fields = 0;
+    has_period = false;
+  }
+
+  /* The pictures before the random access point are gone, so the next picture starts a period. */
+  void AnnexbTimestamper::seek(uint64_t frame) {
+    picture_order.reset();
+    num_fields = 2 * (int64_t)frame;
+    max_fields = num_fields;
+    has_period = false;
+  }
+
+  int AnnexbTimestamper::add_parameter_sets(const uint8_t* data, size_t nbytes) {
+
+    if (nullptr == data || 0 == nbytes) {
+      return -1;
+    }
+
+    const uint8_t* end = data + nbytes;
+    const uint8_t* sc = annexb_find_start_code(data, end);
+    int result = 0;
+
+    while (sc < end) {
+
+      const uint8_t* nal = sc + 3;
+      const uint8_t* next = annexb_find_start_code(nal, end);
+      const uint8_t* nal_end = next;
+
+      while (nal_end > nal && 0x00 == nal_end[-1]) {
+        nal_end--;
+      }
+
+      if (nal_end > nal && 0 != parameter_sets.parse(nal, nal_end - nal)) {
+        result = -2;
+      }
+
+      sc = next;
+    }
+
+    return result;
+  }
+
+  /*
+    We scan the access unit up to its first slice; the parameter
+    sets in front of it are the ones it may use.
+  */
+  int AnnexbTimestamper::stamp(AccessUnit& au) {
+
+    au.pts = ANNEXB_NO_TIMESTAMP;
+    au.dts = ANNEXB_NO_TIMESTAMP;
+
+    if (nullptr == au.data || 0 == au.size) {
+      return -1;
+    }
+
+    const uint8_t* end = au.data + au.size;
+    const uint8_t* sc = annexb_find_start_code(au.data, end);
+    const uint8_t* slice = nullptr;
+    const uint8_t* slice_end = nullptr;
+
+    while (sc < end && nullptr == slice) {
+
+      const uint8_t* nal = sc + 3;
+      const uint8_t* next = annexb_find_start_code(nal, end);
+      const uint8_t* nal_end = next;
+
+      while (nal_end > nal && 0x00 == nal_end[-1]) {
+        nal_end--;
+      }
+
+      if (nal_end > nal) {
+        int nal_type = nal[0] & 0x1F;
+        if (H264_NAL_SPS == nal_type || H264_NAL_PPS == nal_type) {
+          parameter_sets.parse(nal, nal_end - nal);
+        }
+        else if (H264_NAL_SLICE == nal_type || H264_NAL_IDR == nal_type) {
+          slice = nal;
+          slice_end = nal_end;
+        }
+      }
+
+      sc = next;
+    }
+
+    /* E.g. the end of stream or parameter sets on their own. */
+    if (nullptr == slice) {
+      return 0;
+    }
+
+    H264SliceHeader sh;
+    if (0 != parameter_sets.parse_slice_header(slice, slice_end - slice, sh)) {
+      return -2;
+    }
+
+    const H264Sps* sps = parameter_sets.get_sps_for_pps(sh.pps_id);
+    if (nullptr == sps) {
+      return -3;
+    }
+
+    int64_t num = ANNEXB_DEFAULT_FRAME_RATE;
+    int64_t den = 1;
+
+    if (1 == sps->timing_info_present_flag && 0 != sps->num_units_in_tick && 0 != sps->time_scale) {
+      num = sps->time_scale;
+      den = 2 * (int64_t)sps->num_units_in_tick;
+    }
+
+    /* The time we reached stays; we count at the new rate from here. */
+    if (num != rate_num || den != rate_den) {
+      if (0 != rate_num) {
+        origin_ticks = get_ticks(num_fields);
+        origin_fields = num_fields;
+      }
+      rate_num = num;
+      rate_den = den;
+    }
+
+    int poc = picture_order.compute(*sps, sh);
+
+    /* Leave room for the pictures that are decoded after, but displayed before, POC 0. */
+    if (H264_NAL_IDR == sh.nal_type || false == has_period) {
+      period_fields = num_fields + 2 * h264_get_num_reorder_frames(*sps) - poc;
+      if (true == has_period && period_fields <= max_fields) {
+        period_fields = max_fields + 2;
+      }
+      has_period = true;
+    }
+
+    int64_t display_fields = period_fields + poc;
+    if (display_fields > max_fields) {
+      max_fields = display_fields;
+    }
+
+    au.dts = get_ticks(num_fields);
+    au.pts = get_ticks(display_fields);
+
+    num_fields += (1 == sh.field_pic_flag) ? 1 : 2;
+
+    return 0;
+  }
+
+  /* We compute every timestamp from the origin so the rounding doesn't add up. */
+  int64_t AnnexbTimestamper::get_ticks(int64_t fields) {
+    return origin_ticks + ((fields - origin_fields) * ANNEXB_CLOCK_RATE * rate_den) / (2 * rate_num);
+  }
+
+  /* ------------------------------------------------ */
+
+  const uint8_t* annexb_find_start_code(const uint8_t* data, const uint8_t* end) {
+    static const find_start_code_func func = select_find_start_code();
+    return func(data, end);
+  }
+
+  const uint8_t* annexb_find_start_code_with_isa(int isa, const uint8_t* data, const uint8_t* end) {
+
+    if (false == annexb_is_isa_supported(isa)) {
+      printf("Error: the requested ISA (%s) is not supported, using scalar version.\n", annexb_isa_to_string(isa));
+      return find_start_code_scalar(data, end);
+    }
+
+    switch (isa) {
+#if defined(ANNEXB_HAVE_SSE2)
+      case ANNEXB_ISA_SSE2: {
+        return find_start_code_sse2(data, end);
+      }
+#endif
+#if defined(ANNEXB_HAVE_AVX2)
+      case ANNEXB_ISA_AVX2: {
+        return find_start_code_avx2(data, end);
+      }
+#endif
+#if defined(ANNEXB_HAVE_NEON)
+      case ANNEXB_ISA_NEON: {
+        return find_start_code_neon(data, end);
+      }
+#endif
+      default: {
+        return find_start_code_scalar(data, end);
+      }
+    }
+  }
+
+  bool annexb_is_isa_supported(int isa) {
+
+    switch (isa) {
+      case ANNEXB_ISA_SCALAR: {
+        return true;
+      }
+#if defined(ANNEXB_HAVE_SSE2)
+      case ANNEXB_ISA_SSE2: {
+        return true;
+      }
+#endif
+#if defined(ANNEXB_HAVE_AVX2)
+      case ANNEXB_ISA_AVX2: {
+        return cpu_has_avx2();
+      }
+#endif
+#if defined(ANNEXB_HAVE_NEON)
+      case ANNEXB_ISA_NEON: {
+        return true;
+      }
+#endif
+      default: {
+        return false;
+      }
+    }
+  }
+
+  const char* annexb_isa_to_string(int isa) {
+
+    switch (isa) {
+      case ANNEXB_ISA_SCALAR: { return "scalar"; }
+      case ANNEXB_ISA_SSE2:   { return "sse2";   }
+      case ANNEXB_ISA_AVX2:   { return "avx2";   }
+      case ANNEXB_ISA_NEON:   { return "neon";   }
+      default:                { return "unknown"; }
+    }
+  }
+
+  /* ------------------------------------------------ */
+
+  static find_start_code_func select_find_start_code() {
+
+#if defined(ANNEXB_HAVE_AVX2)
+    if (true == cpu_has_avx2()) {
+      return find_start_code_avx2;
+    }
+#endif
+
+#if defined(ANNEXB_HAVE_SSE2)
+    return find_start_code_sse2;
+#elif defined(ANNEXB_HAVE_NEON)
+    return find_start_code_neon;
+#else
+    return find_start_code_scalar;
+#endif
+  }
+
+  static bool cpu_has_avx2() {
+
+#if defined(ANNEXB_HAVE_AVX2) && defined(_MSC_VER)
+    int regs[4] = { 0 };
+    __cpuid(regs, 1);
+    if (0 == (regs[2] & (1 << 27))) {
+      return false; /* No OSXSAVE. */
+    }
+    if (6 != (_xgetbv(0) & 6)) {
+      return false; /* The OS doesn't save the YMM registers. */
+    }
+    __cpuidex(regs, 7, 0);
+    return (0 != (regs[1] & (1 << 5)));
+#elif defined(ANNEXB_HAVE_AVX2)
+    return (0 != __builtin_cpu_supports("avx2"));
+#else
+    return false;
+#endif
+  }
+
+  static int count_trailing_zeros(uint64_t v) {
+
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long dx = 0;
+    _BitScanForward64(&dx, v);
+    return (int)dx;
+#elif defined(_MSC_VER)
+    unsigned long dx = 0;
+    if (0 != _BitScanForward(&dx, (unsigned long)v)) {
+      return (int)dx;
+    }
+    _BitScanForward(&dx, (unsigned long)(v >> 32));
+    return (int)dx + 32;
+#else
+    return __builtin_ctzll(v);
+#endif
+  }
+
+  /* ------------------------------------------------ */
+
+  /* Reference implementation; also used for the bytes that don't fill a complete vector. */
+  static const uint8_t* find_start_code_scalar(const uint8_t* data, const uint8_t* end) {
+
+    if (end - data < 3) {
+      return end;
+    }
+
+    const uint8_t* last = end - 2;
+    for (const uint8_t* p = data; p < last; ++p) {
+      if (0x00 == p[0] && 0x00 == p[1] && 0x01 == p[2]) {
+        return p;
+      }
+    }
+
+    return end;
+  }
+
+  /*
+    The vector versions compare three overlapping loads at
+    offsets 0, 1 and 2 against `00`, `00` and `01`. The AND of
+    the three masks has a bit set for every position where a
+    start code begins.
+  */
+#if defined(ANNEXB_HAVE_SSE2)
+  static const uint8_t* find_start_code_sse2(const uint8_t* data, const uint8_t* end) {
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    const uint8_t* p = data;
+
+    while ((end - p) >= 18) {
+      __m128i a = _mm_loadu_si128((const __m128i*)(p + 0));
+      __m128i b = _mm_loadu_si128((const __m128i*)(p + 1));
+      __m128i c = _mm_loadu_si128((const __m128i*)(p + 2));
+      __m128i m = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(a, zero), _mm_cmpeq_epi8(b, zero)), _mm_cmpeq_epi8(c, one));
+      int mask = _mm_movemask_epi8(m);
+      if (0 != mask) {
+        return p + count_trailing_zeros((uint64_t)(uint32_t)mask);
+      }
+      p += 16;
+    }
+
+    return find_start_code_scalar(p, end);
+  }
+#endif
+
+#if defined(ANNEXB_HAVE_AVX2)
+  ANNEXB_TARGET_AVX2 static const uint8_t* find_start_code_avx2(const uint8_t* data, const uint8_t* end) {
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi8(1);
+    const uint8_t* p = data;
+
+    while ((end - p) >= 34) {
+      __m256i a = _mm256_loadu_si256((const __m256i*)(p + 0));
+      __m256i b = _mm256_loadu_si256((const __m256i*)(p + 1));
+      __m256i c = _mm256_loadu_si256((const __m256i*)(p + 2));
+      __m256i m = _mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi8(a, zero), _mm256_cmpeq_epi8(b, zero)), _mm256_cmpeq_epi8(c, one));
+      uint32_t mask = (uint32_t)_mm256_movemask_epi8(m);
+      if (0 != mask) {
+        return p + count_trailing_zeros((uint64_t)mask);
+      }
+      p += 32;
+    }
+
+    return find_start_code_scalar(p, end);
+  }
+#endif
+
+#if defined(ANNEXB_HAVE_NEON)
+  static const uint8_t* find_start_code_neon(const uint8_t* data, const uint8_t* end) {
+
+    const uint8x16_t zero = vdupq_n_u8(0);
+    const uint8x16_t one = vdupq_n_u8(1);
+    const uint8_t* p = data;
+
+    while ((end - p) >= 18) {
+      uint8x16_t a = vld1q_u8(p + 0);
+      uint8x16_t b = vld1q_u8(p + 1);
+      uint8x16_t c = vld1q_u8(p + 2);
+      uint8x16_t m = vandq_u8(vandq_u8(vceqq_u8(a, zero), vceqq_u8(b, zero)), vceqq_u8(c, one));
+      /* NEON has no movemask; narrowing by 4 bits gives us a nibble per byte. */
+      uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+      if (0 != mask) {
+        return p + (count_trailing_zeros(mask) >> 2);
+      }
+      p += 16;
+    }
+
+    return find_start_code_scalar(p, end);
+  }
+#endif
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
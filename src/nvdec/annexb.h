@@ -0,0 +1,157 @@
+/*
+  ANNEX-B SCANNER
+  ===============
+
+  GENERAL INFO:
+
+    Splits an H264 Annex-B byte stream into access units so we
+    can feed the parser one CUVIDSOURCEDATAPACKET per access unit
+    instead of one huge buffer. The start code search is the hot
+    loop; we have SSE2 and AVX2 versions for x86, a NEON version
+    for ARM and a plain C loop that we use as reference and for
+    the tail bytes.
+
+    A new access unit starts at the first AUD, SEI, SPS, PPS or
+    NAL type 14..18 that follows a VCL NAL, or at a VCL NAL with
+    `first_mb_in_slice` set to 0. See 7.4.1.2.3 of the H264 spec.
+    We don't compare the other slice header fields (frame_num,
+    pps_id, etc.) which is fine for streams that don't use
+    arbitrary slice order.
+
+  USAGE:
+
+    AnnexbSplitter splitter;
+    AccessUnit au;
+
+    while (ANNEXB_OK == splitter.next(data, nbytes, true, au)) {
+      ... use au.data and au.size ...
+      data += au.size;
+      nbytes -= au.size;
+    }
+
+    When `next()` returns ANNEXB_NEED_MORE_DATA you should call it
+    again with the same start pointer and more bytes appended
+    (the pointer itself may change, e.g. when you move the bytes
+    into another buffer). The splitter only remembers offsets.
+
+  TIMESTAMPS:
+
+    Annex-B has no timestamps, so the AnnexbTimestamper makes
+    them from the timing info in the VUI of the SPS:
+    `time_scale / (2 * num_units_in_tick)` frames per second,
+    or ANNEXB_DEFAULT_FRAME_RATE when the SPS has none. The DTS
+    counts the access units in decode order. The PTS comes from
+    the picture order count: at every IDR we start a new period
+    whose POC 0 is displayed `num_reorder_frames` frames after
+    its DTS, so the pictures that are displayed later than they
+    are decoded always have PTS >= DTS. We assume that the POC
+    goes up by 2 per frame, which is what encoders do; a field
+    counts as half a frame. Timestamps are in ticks of
+    ANNEXB_CLOCK_RATE.
+
+    The timestamper only looks at the parameter sets and the
+    first slice of an access unit. An access unit without a
+    slice (or with one that refers to a parameter set we didn't
+    see) gets ANNEXB_NO_TIMESTAMP. After a seek you tell it the
+    frame number and give it the parameter sets, so the
+    timestamps are those we'd have made when decoding from the
+    start; the InputSource does this (see input.h).
+
+      AnnexbTimestamper timestamper;
+      timestamper.stamp(au);                // Sets au.pts and au.dts.
+
+ */
+#ifndef NVDEC_ANNEXB_H
+#define NVDEC_ANNEXB_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <nvdec/h264.h>
+
+#define ANNEXB_OK 0
+#define ANNEXB_NEED_MORE_DATA 1
+#define ANNEXB_END_OF_STREAM 2
+
+#define ANNEXB_AU_FLAG_IDR (1 << 0)         /* Contains a slice of an IDR picture. */
+#define ANNEXB_AU_FLAG_SPS (1 << 1)         /* Contains a sequence parameter set. */
+#define ANNEXB_AU_FLAG_PPS (1 << 2)         /* Contains a picture parameter set. */
+#define ANNEXB_AU_FLAG_SEI (1 << 3)         /* Contains one or more SEI NALs. */
+#define ANNEXB_AU_FLAG_REFERENCE (1 << 4)   /* At least one slice has a nal_ref_idc != 0. */
+
+#define ANNEXB_CLOCK_RATE 90000             /* Ticks per second of the timestamps, like MPEG-TS. */
+#define ANNEXB_NO_TIMESTAMP INT64_MIN
+#define ANNEXB_DEFAULT_FRAME_RATE 25        /* Frames per second when the SPS has no timing info. */
+
+#define ANNEXB_ISA_SCALAR 0
+#define ANNEXB_ISA_SSE2 1
+#define ANNEXB_ISA_AVX2 2
+#define ANNEXB_ISA_NEON 3
+#define ANNEXB_ISA_COUNT 4
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  struct AccessUnit {
+    const uint8_t* data;                      /* Points to the first byte of the access unit, including the start code. */
+    size_t size;                              /* Number of bytes in this access unit. */
+    uint32_t flags;                           /* Bitmask with ANNEXB_AU_FLAG_* values. */
+    int num_nals;                             /* Number of NAL units in this access unit. */
+    int64_t pts;                              /* In ANNEXB_CLOCK_RATE ticks; ANNEXB_NO_TIMESTAMP until an AnnexbTimestamper stamps it. */
+    int64_t dts;
+  };
+
+  /* ------------------------------------------------ */
+
+  class AnnexbSplitter {
+  public:
+    AnnexbSplitter();
+    void reset();
+    int next(const uint8_t* data, size_t nbytes, bool is_eos, AccessUnit& result); /* Returns ANNEXB_OK when `result` holds an access unit. */
+
+  private:
+    void add_nal(uint8_t nal_header);
+
+  private:
+    size_t scan_offset;                       /* Offset (relative to the start of the current access unit) from where we continue searching for start codes. */
+    bool has_vcl;                             /* Set when we've seen a slice for the current access unit. */
+    uint32_t flags;
+    int num_nals;
+  };
+
+  /* ------------------------------------------------ */
+
+  class AnnexbTimestamper {
+  public:
+    AnnexbTimestamper();
+    void reset();                                                 /* Forgets the parameter sets and starts at 0 again. */
+    void seek(uint64_t frame);                                    /* The next access unit is the random access point with this frame number (in decode order). */
+    int add_parameter_sets(const uint8_t* data, size_t nbytes);  /* Annex-B SPS and PPS that the next access units use but don't carry, e.g. from a StreamIndex. */
+    int stamp(AccessUnit& au);                                    /* Sets the pts and dts of the next access unit; < 0 when we can't parse its slice. */
+
+  private:
+    int64_t get_ticks(int64_t fields);
+
+  private:
+    H264ParameterSets parameter_sets;
+    H264PictureOrder picture_order;
+    int64_t rate_num;                                             /* Frames per second of the current SPS, 0 before the first picture. */
+    int64_t rate_den;
+    int64_t origin_fields;                                        /* We count from here since the last frame rate change ... */
+    int64_t origin_ticks;                                         /* ... which was at this time. */
+    int64_t num_fields;                                           /* The decode position; a frame is 2 fields. */
+    int64_t period_fields;                                        /* The display position of POC 0 of the current IDR period. */
+    int64_t max_fields;                                           /* The display position of the last picture in display order. */
+    bool has_period;                                              /* False until we saw an IDR (or any picture after a seek). */
+  };
+
+  /* ------------------------------------------------ */
+
+  const uint8_t* annexb_find_start_code(const uint8_t* data, const uint8_t* end);                  /* Returns a pointer to the first `00 00 01` in [data, end) or `end` when not found. Uses the fastest ISA we support. */
+  const uint8_t* annexb_find_start_code_with_isa(int isa, const uint8_t* data, const uint8_t* end); /* Same as `annexb_find_start_code()` but using the given ANNEXB_ISA_*. */
+  bool annexb_is_isa_supported(int isa);
+  const char* annexb_isa_to_string(int isa);
+
+} /* namespace nvdec */
+
+#endif
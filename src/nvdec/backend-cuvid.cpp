@@ -0,0 +1,385 @@
+#include <stdio.h>
+#include <string.h>
+#include <nvdec/backend-cuvid.h>
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  CuvidBackend::CuvidBackend()
+    :device(0)
+    ,context(nullptr)
+    ,context_lock(nullptr)
+  {
+  }
+
+  CuvidBackend::~CuvidBackend() {
+    shutdown();
+  }
+
+  int CuvidBackend::get_device_count() {
+
+    const char* err_str = nullptr;
+
+    CUresult r = cuInit(0);
+    if (CUDA_SUCCESS != r) {
+      cuGetErrorString(r, &err_str);
+      printf("Failed to initialize cuda: %s.\n", err_str);
+      return -1;
+    }
+
+    int device_count = 0;
+    r = cuDeviceGetCount(&device_count);
+    if (CUDA_SUCCESS != r) {
+      cuGetErrorString(r, &err_str);
+      printf("Failed to get the cuda device count: %s.\n", err_str);
+      return -2;
+    }
+
+    return device_count;
+  }
+
+  int CuvidBackend::init(int device_index) {
+
+    if (nullptr != context) {
+      printf("Cannot initialize the cuvid backend, already initialized. Call shutdown() first.\n");
+      return -1;
+    }
+
+    const char* err_str = nullptr;
+
+    /* Initialize cuda, must be done before anything else. */
+    CUresult r = cuInit(0);
+    if (CUDA_SUCCESS != r) {
+      cuGetErrorString(r, &err_str);
+      printf("Failed to initialize cuda: %s.\n", err_str);
+      return -2;
+    }
+
+    int device_count = 0;
+    r = cuDeviceGetCount(&device_count);
+    if (CUDA_SUCCESS != r) {
+      cuGetErrorString(r, &err_str);
+      printf("Failed to get the cuda device count: %s.\n", err_str);
+      return -3;
+    }
+
+    if (device_index < 0 || device_index >= device_count) {
+      printf("Invalid device index %d, we have %d cuda device(s).\n", device_index, device_count);
+      return -4;
+    }
+
+    r = cuDeviceGet(&device, device_index);
+    if (CUDA_SUCCESS != r) {
+      cuGetErrorString(r, &err_str);
+      printf("Failed to get a handle to the cuda device: %s.\n", err_str);
+      return -5;
+    }
+
+    char name[80] = { 0 };
+    r = cuDeviceGetName(name, sizeof(name), device);
+    if (CUDA_SUCCESS != r) {
+      cuGetErrorString(r, &err_str);
+      printf("Failed to get the cuda device name: %s.\n", err_str);
+      return -6;
+    }
+
+    device_name = name;
+
+    r = cuCtxCreate(&context, 0, device);
+    if (CUDA_SUCCESS != r) {
+      cuGetErrorString(r, &err_str);
+      printf("Failed to create a cuda context: %s.\n", err_str);
+      context = nullptr;
+      return -7;
+    }
+
+    /* cuCtxCreate() makes the context current; we push it when we need it, on whatever thread that is. */
+    cuCtxPopCurrent(nullptr);
+
+    r = cuvidCtxLockCreate(&context_lock, context);
+    if (CUDA_SUCCESS != r) {
+      cuGetErrorString(r, &err_str);
+      printf("Failed to create the context lock: %s.\n", err_str);
+      context_lock = nullptr;
+      cuCtxDestroy(context);
+      context = nullptr;
+      return -8;
+    }
+
+    return 0;
+  }
+
+  int CuvidBackend::shutdown() {
+
+    if (nullptr == context) {
+      return 0;
+    }
+
+    const char* err_str = nullptr;
+    CUresult r = CUDA_SUCCESS;
+
+    if (nullptr != context_lock) {
+      r = cuvidCtxLockDestroy(context_lock);
+      context_lock = nullptr;
+      if (CUDA_SUCCESS != r) {
+        cuGetErrorString(r, &err_str);
+        printf("Failed to destroy the context lock: %s.\n", err_str);
+      }
+    }
+
+    r = cuCtxDestroy(context);
+    context = nullptr;
+
+    if (CUDA_SUCCESS != r) {
+      cuGetErrorString(r, &err_str);
+      printf("Failed to cleanly destroy the cuda context: %s.\n", err_str);
+      return -1;
+    }
+
+    return 0;
+  }
+
+  int CuvidBackend::get_type() {
+    return BACKEND_TYPE_CUVID;
+  }
+
+  std::string CuvidBackend::get_device_name() {
+    return device_name;
+  }
+
+  const char* CuvidBackend::get_error_string(CUresult r) {
+
+    const char* err_str = nullptr;
+
+    if (CUDA_SUCCESS != cuGetErrorString(r, &err_str) || nullptr == err_str) {
+      return "unknown error";
+    }
+
+    return err_str;
+  }
+
+  /* ------------------------------------------------ */
+
+  CUresult CuvidBackend::push_context() {
+    return cuCtxPushCurrent(context);
+  }
+
+  CUresult CuvidBackend::pop_context() {
+    return cuCtxPopCurrent(nullptr);
+  }
+
+  CUvideoctxlock CuvidBackend::get_context_lock() {
+    return context_lock;
+  }
+
+  /* ------------------------------------------------ */
+
+  CUresult CuvidBackend::create_parser(CUvideoparser* parser, CUVIDPARSERPARAMS* params) {
+    return cuvidCreateVideoParser(parser, params);
+  }
+
+  CUresult CuvidBackend::parse_video_data(CUvideoparser parser, CUVIDSOURCEDATAPACKET* pkt) {
+    return cuvidParseVideoData(parser, pkt);
+  }
+
+  CUresult CuvidBackend::destroy_parser(CUvideoparser parser) {
+    return cuvidDestroyVideoParser(parser);
+  }
+
+  /* ------------------------------------------------ */
+
+  CUresult CuvidBackend::get_decoder_caps(CUVIDDECODECAPS* caps) {
+
+    cuCtxPushCurrent(context);
+    CUresult r = cuvidGetDecoderCaps(caps);
+    cuCtxPopCurrent(nullptr);
+
+    return r;
+  }
+
+  CUresult CuvidBackend::create_decoder(CUvideodecoder* decoder, CUVIDDECODECREATEINFO* info) {
+
+    cuCtxPushCurrent(context);
+    CUresult r = cuvidCreateDecoder(decoder, info);
+    cuCtxPopCurrent(nullptr);
+
+    return r;
+  }
+
+  CUresult CuvidBackend::destroy_decoder(CUvideodecoder decoder) {
+
+    cuCtxPushCurrent(context);
+    CUresult r = cuvidDestroyDecoder(decoder);
+    cuCtxPopCurrent(nullptr);
+
+    return r;
+  }
+
+  CUresult CuvidBackend::reconfigure_decoder(CUvideodecoder decoder, CUVIDRECONFIGUREDECODERINFO* info) {
+
+    cuCtxPushCurrent(context);
+    CUresult r = cuvidReconfigureDecoder(decoder, info);
+    cuCtxPopCurrent(nullptr);
+
+    return r;
+  }
+
+  CUresult CuvidBackend::decode_picture(CUvideodecoder decoder, CUVIDPICPARAMS* pic) {
+    return cuvidDecodePicture(decoder, pic);
+  }
+
+  CUresult CuvidBackend::map_video_frame(CUvideodecoder decoder, int picture_index, CUdeviceptr* device_ptr, unsigned int* pitch, CUVIDPROCPARAMS* vpp) {
+
+    cuCtxPushCurrent(context);
+    CUresult r = cuvidMapVideoFrame(decoder, picture_index, device_ptr, pitch, vpp);
+    cuCtxPopCurrent(nullptr);
+
+    return r;
+  }
+
+  CUresult CuvidBackend::unmap_video_frame(CUvideodecoder decoder, CUdeviceptr device_ptr) {
+
+    cuCtxPushCurrent(context);
+    CUresult r = cuvidUnmapVideoFrame(decoder, device_ptr);
+    cuCtxPopCurrent(nullptr);
+
+    return r;
+  }
+
+  /* ------------------------------------------------ */
+
+  CUresult CuvidBackend::alloc_host(void** ptr, size_t nbytes) {
+
+    cuCtxPushCurrent(context);
+    CUresult r = cuMemAllocHost(ptr, nbytes);
+    cuCtxPopCurrent(nullptr);
+
+    return r;
+  }
+
+  CUresult CuvidBackend::free_host(void* ptr) {
+
+    cuCtxPushCurrent(context);
+    CUresult r = cuMemFreeHost(ptr);
+    cuCtxPopCurrent(nullptr);
+
+    return r;
+  }
+
+  CUresult CuvidBackend::copy_to_host(void* dst, CUdeviceptr src, size_t nbytes) {
+
+    cuCtxPushCurrent(context);
+    CUresult r = cuMemcpyDtoH(dst, src, nbytes);
+    cuCtxPopCurrent(nullptr);
+
+    return r;
+  }
+
+  CUresult CuvidBackend::copy_to_host_async(void* dst, CUdeviceptr src, size_t nbytes, CUstream stream) {
+
+    cuCtxPushCurrent(context);
+    CUresult r = cuMemcpyDtoHAsync(dst, src, nbytes, stream);
+    cuCtxPopCurrent(nullptr);
+
+    return r;
+  }
+
+  CUresult CuvidBackend::copy_2d_to_host_async(void* dst, size_t dst_pitch, CUdeviceptr src, size_t src_pitch, size_t width, size_t height, CUstream stream) {
+
+    CUDA_MEMCPY2D copy;
+    memset((char*)&copy, 0x00, sizeof(copy));
+    copy.srcMemoryType = CU_MEMORYTYPE_DEVICE;
+    copy.srcDevice = src;
+    copy.srcPitch = src_pitch;
+    copy.dstMemoryType = CU_MEMORYTYPE_HOST;
+    copy.dstHost = dst;
+    copy.dstPitch = dst_pitch;
+    copy.WidthInBytes = width;
+    copy.Height = height;
+
+    cuCtxPushCurrent(context);
+    CUresult r = cuMemcpy2DAsync(&copy, stream);
+    cuCtxPopCurrent(nullptr);
+
+    return r;
+  }
+
+  CUresult CuvidBackend::get_memory_info(size_t* free_nbytes, size_t* total_nbytes) {
+
+    cuCtxPushCurrent(context);
+    CUresult r = cuMemGetInfo(free_nbytes, total_nbytes);
+    cuCtxPopCurrent(nullptr);
+
+    return r;
+  }
+
+  /* ------------------------------------------------ */
+
+  CUresult CuvidBackend::create_stream(CUstream* stream) {
+
+    cuCtxPushCurrent(context);
+    CUresult r = cuStreamCreate(stream, CU_STREAM_NON_BLOCKING);
+    cuCtxPopCurrent(nullptr);
+
+    return r;
+  }
+
+  CUresult CuvidBackend::destroy_stream(CUstream stream) {
+
+    cuCtxPushCurrent(context);
+    CUresult r = cuStreamDestroy(stream);
+    cuCtxPopCurrent(nullptr);
+
+    return r;
+  }
+
+  /* We never read the elapsed time so we disable timing which makes the events cheaper. */
+  CUresult CuvidBackend::create_event(CUevent* event) {
+
+    cuCtxPushCurrent(context);
+    CUresult r = cuEventCreate(event, CU_EVENT_DISABLE_TIMING);
+    cuCtxPopCurrent(nullptr);
+
+    return r;
+  }
+
+  CUresult CuvidBackend::destroy_event(CUevent event) {
+
+    cuCtxPushCurrent(context);
+    CUresult r = cuEventDestroy(event);
+    cuCtxPopCurrent(nullptr);
+
+    return r;
+  }
+
+  CUresult CuvidBackend::record_event(CUevent event, CUstream stream) {
+
+    cuCtxPushCurrent(context);
+    CUresult r = cuEventRecord(event, stream);
+    cuCtxPopCurrent(nullptr);
+
+    return r;
+  }
+
+  CUresult CuvidBackend::query_event(CUevent event) {
+
+    cuCtxPushCurrent(context);
+    CUresult r = cuEventQuery(event);
+    cuCtxPopCurrent(nullptr);
+
+    return r;
+  }
+
+  CUresult CuvidBackend::synchronize_event(CUevent event) {
+
+    cuCtxPushCurrent(context);
+    CUresult r = cuEventSynchronize(event);
+    cuCtxPopCurrent(nullptr);
+
+    return r;
+  }
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
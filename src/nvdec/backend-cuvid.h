@@ -0,0 +1,76 @@
+/*
+  CUVID BACKEND
+  =============
+
+  GENERAL INFO:
+
+    DecodeBackend that forwards to nvcuvid and the cuda driver
+    API. `init()` initializes cuda and creates a context for the
+    given device; the decoder and map functions don't touch the
+    context stack, we push and pop around the calls that need it
+    just like v3 does.
+
+ */
+#ifndef NVDEC_BACKEND_CUVID_H
+#define NVDEC_BACKEND_CUVID_H
+
+#include <nvdec/backend.h>
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  class CuvidBackend : public DecodeBackend {
+  public:
+    CuvidBackend();
+    ~CuvidBackend();
+    static int get_device_count();                                  /* Initializes cuda; returns < 0 on error. */
+    int init(int device_index);
+    int shutdown();
+    int get_type();
+    std::string get_device_name();
+    const char* get_error_string(CUresult r);
+
+    CUresult push_context();
+    CUresult pop_context();
+    CUvideoctxlock get_context_lock();
+
+    CUresult create_parser(CUvideoparser* parser, CUVIDPARSERPARAMS* params);
+    CUresult parse_video_data(CUvideoparser parser, CUVIDSOURCEDATAPACKET* pkt);
+    CUresult destroy_parser(CUvideoparser parser);
+
+    CUresult get_decoder_caps(CUVIDDECODECAPS* caps);
+    CUresult create_decoder(CUvideodecoder* decoder, CUVIDDECODECREATEINFO* info);
+    CUresult destroy_decoder(CUvideodecoder decoder);
+    CUresult reconfigure_decoder(CUvideodecoder decoder, CUVIDRECONFIGUREDECODERINFO* info);
+    CUresult decode_picture(CUvideodecoder decoder, CUVIDPICPARAMS* pic);
+    CUresult map_video_frame(CUvideodecoder decoder, int picture_index, CUdeviceptr* device_ptr, unsigned int* pitch, CUVIDPROCPARAMS* vpp);
+    CUresult unmap_video_frame(CUvideodecoder decoder, CUdeviceptr device_ptr);
+
+    CUresult alloc_host(void** ptr, size_t nbytes);
+    CUresult free_host(void* ptr);
+    CUresult copy_to_host(void* dst, CUdeviceptr src, size_t nbytes);
+    CUresult copy_to_host_async(void* dst, CUdeviceptr src, size_t nbytes, CUstream stream);
+    CUresult copy_2d_to_host_async(void* dst, size_t dst_pitch, CUdeviceptr src, size_t src_pitch, size_t width, size_t height, CUstream stream);
+    CUresult get_memory_info(size_t* free_nbytes, size_t* total_nbytes);
+
+    CUresult create_stream(CUstream* stream);
+    CUresult destroy_stream(CUstream stream);
+    CUresult create_event(CUevent* event);
+    CUresult destroy_event(CUevent event);
+    CUresult record_event(CUevent event, CUstream stream);
+    CUresult query_event(CUevent event);
+    CUresult synchronize_event(CUevent event);
+
+  private:
+    CUdevice device;
+    CUcontext context;
+    CUvideoctxlock context_lock;
+    std::string device_name;
+  };
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
+
+#endif
@@ -0,0 +1,1589 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <nvdec/backend-fake.h>
+#include <nvdec/annexb.h>
+#include <nvdec/h264.h>
+#include <nvdec/scale.h>
+
+#if defined(_WIN32)
+#  include <malloc.h>
+#endif
+
+#define FAKE_HOST_ALIGNMENT 4096       /* Host allocations are page aligned, like cuMemAllocHost(). */
+#define FAKE_COMPACT_SIZE (1024 * 1024) /* Remove the parsed bytes from the pending buffer once we have this many. */
+#define FAKE_JOB_COPY 1
+#define FAKE_JOB_EVENT 2
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  struct FakeTimestamp {
+    uint64_t offset;                    /* Stream offset of the first byte of the packet. */
+    CUvideotimestamp timestamp;
+  };
+
+  struct FakePicture {
+    int picture_index;
+    int poc;
+    bool is_reference;
+    CUvideotimestamp timestamp;
+  };
+
+  struct FakeDecodeSurface {
+    bool is_decoded;
+    uint32_t seed;                      /* The pattern we render when this surface gets mapped. */
+  };
+
+  struct FakeOutputSurface {
+    uint8_t* data;
+    unsigned int pitch;
+    bool is_mapped;
+  };
+
+  /* ------------------------------------------------ */
+
+  /* An event is done when the last record has been executed by the stream. */
+  class FakeEvent {
+  public:
+    FakeEvent();
+    void record();                      /* Records on the default stream; done immediately. */
+    uint64_t begin_record();            /* Records on a stream; returns the generation that the stream completes. */
+    void complete(uint64_t generation);
+    bool is_done();
+    void wait();
+
+  private:
+    std::mutex mtx;
+    std::condition_variable cv;
+    uint64_t num_recorded;
+    uint64_t num_completed;
+  };
+
+  /* A copy of `height` rows of `width` bytes; a linear copy is one row. */
+  struct FakeJob {
+    int type;
+    void* dst;
+    size_t dst_pitch;
+    const void* src;
+    size_t src_pitch;
+    size_t width;
+    size_t height;
+    FakeEvent* event;
+    uint64_t generation;
+  };
+
+  /* Executes the jobs in the order they were queued on its own thread. */
+  class FakeStream {
+  public:
+    FakeStream();
+    ~FakeStream();
+    void push(const FakeJob& job);
+
+  private:
+    void run();
+
+  private:
+    std::thread thread;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<FakeJob> jobs;
+    bool must_stop;
+  };
+
+  /* ------------------------------------------------ */
+
+  class FakeParser {
+  public:
+    FakeParser(CUVIDPARSERPARAMS* params);
+    CUresult parse(CUVIDSOURCEDATAPACKET* pkt);
+
+  private:
+    CUresult process_nals(bool flush);
+    CUresult handle_nal(const uint8_t* nal, size_t nbytes, uint64_t offset);
+    CUresult start_picture(const H264SliceHeader& sh, uint64_t offset);
+    CUresult finish_picture();
+    CUresult display_pictures(size_t keep);
+    CUresult handle_sequence(const H264Sps& sps);
+    int allocate_picture_index();
+    CUvideotimestamp get_timestamp(uint64_t offset);
+    void reset_stream();
+
+  private:
+    CUVIDPARSERPARAMS params;
+    H264ParameterSets parameter_sets;
+
+    /* Bytes that we didn't split into NALs yet. */
+    std::vector<uint8_t> pending;
+    size_t pending_offset;
+    uint64_t pending_stream_offset;     /* Stream offset of `pending[0]`. */
+    std::deque<FakeTimestamp> timestamps;
+
+    /* Sequence */
+    bool has_format;
+    CUVIDEOFORMAT format;
+    int num_decode_surfaces;
+    int num_reorder_frames;
+    int max_num_ref_frames;
+
+    /* Picture that we're collecting slices for. */
+    bool has_picture;
+    bool is_intra;
+    H264SliceHeader picture_slice;
+    FakePicture picture;
+    std::vector<uint8_t> bitstream;
+    std::vector<unsigned int> slice_offsets;
+    CUVIDPICPARAMS pic_params;
+
+    /* Reference and display state. */
+    std::vector<int> references;        /* Picture indices of the reference frames, oldest first. */
+    std::vector<FakePicture> reorder;   /* Decoded pictures that we didn't display yet. */
+    int next_picture_index;
+    H264PictureOrder picture_order;
+    bool warned_about_fields;
+  };
+
+  /* ------------------------------------------------ */
+
+  class FakeDecoder {
+  public:
+    FakeDecoder();
+    ~FakeDecoder();
+    CUresult init(CUVIDDECODECREATEINFO* info);
+    CUresult reconfigure(CUVIDRECONFIGUREDECODERINFO* info);
+    CUresult decode(CUVIDPICPARAMS* pic);
+    CUresult map(int picture_index, CUdeviceptr* device_ptr, unsigned int* pitch);
+    CUresult unmap(CUdeviceptr device_ptr);
+    uint64_t get_device_nbytes();       /* What the decoder would allocate on a GPU. */
+
+  private:
+    void render(uint32_t seed, FakeOutputSurface& surface);
+    void render_area(uint32_t seed, uint8_t* luma, uint8_t* chroma, size_t pitch, int width, int height);
+    void update_crop();
+
+  private:
+    CUVIDDECODECREATEINFO info;
+    std::vector<FakeDecodeSurface> decode_surfaces;
+    std::vector<FakeOutputSurface> output_surfaces;
+    std::vector<uint8_t> luma_pattern;
+    std::vector<uint8_t> chroma_pattern;
+    int crop_left;
+    int crop_top;
+    int crop_width;
+    int crop_height;
+    Scaler scaler;                      /* Stands in for the scaler of the GPU when the target size isn't the display area. */
+    std::vector<uint8_t> unscaled;      /* The display area before we scale it. */
+    unsigned long max_width;            /* The largest coded size we accept in reconfigure(). */
+    unsigned long max_height;
+    unsigned long max_target_width;     /* The largest target size the output surfaces can hold. */
+    unsigned long max_target_height;
+    unsigned long max_decode_surfaces;  /* reconfigure() can't add decode surfaces, like cuvid. */
+    size_t output_surface_nbytes;
+  };
+
+  /* ------------------------------------------------ */
+
+  static void* aligned_alloc_host(size_t nbytes);
+  static void aligned_free_host(void* ptr);
+  static unsigned int align_up(unsigned int v, unsigned int alignment);
+  static int greatest_common_divisor(int a, int b);
+  static void copy_2d(void* dst, size_t dst_pitch, const void* src, size_t src_pitch, size_t width, size_t height);
+
+  /* ------------------------------------------------ */
+
+  FakeDeviceSettings::FakeDeviceSettings()
+    :memory_nbytes(FAKE_DEVICE_MEMORY)
+    ,decode_ns(0)
+  {
+  }
+
+  /* ------------------------------------------------ */
+
+  FakeBackend::FakeBackend()
+    :device_index(-1)
+    ,is_init(false)
+    ,device_nbytes(0)
+  {
+  }
+
+  FakeBackend::~FakeBackend() {
+    shutdown();
+  }
+
+  int FakeBackend::configure(const FakeDeviceSettings& cfg) {
+
+    if (true == is_init) {
+      printf("Cannot configure the fake backend, already initialized.\n");
+      return -1;
+    }
+
+    if (0 == cfg.memory_nbytes) {
+      printf("Cannot configure the fake backend, the device memory is 0.\n");
+      return -2;
+    }
+
+    settings = cfg;
+
+    return 0;
+  }
+
+  int FakeBackend::init(int index) {
+
+    if (true == is_init) {
+      printf("Cannot initialize the fake backend, already initialized. Call shutdown() first.\n");
+      return -1;
+    }
+
+    device_index = index;
+    is_init = true;
+
+    return 0;
+  }
+
+  int FakeBackend::shutdown() {
+    is_init = false;
+    device_index = -1;
+    return 0;
+  }
+
+  int FakeBackend::get_type() {
+    return BACKEND_TYPE_FAKE;
+  }
+
+  std::string FakeBackend::get_device_name() {
+    char name[64] = { 0 };
+    snprintf(name, sizeof(name), "Fake CPU device %d", device_index);
+    return name;
+  }
+
+  const char* FakeBackend::get_error_string(CUresult r) {
+
+    switch (r) {
+      case CUDA_SUCCESS:               { return "no error";          }
+      case CUDA_ERROR_INVALID_VALUE:   { return "invalid value";     }
+      case CUDA_ERROR_OUT_OF_MEMORY:   { return "out of memory";     }
+      case CUDA_ERROR_NOT_INITIALIZED: { return "not initialized";   }
+      case CUDA_ERROR_INVALID_HANDLE:  { return "invalid handle";    }
+      case CUDA_ERROR_NOT_SUPPORTED:   { return "not supported";     }
+      default:                         { return "unknown error";     }
+    }
+  }
+
+  CUresult FakeBackend::push_context() {
+    return CUDA_SUCCESS;
+  }
+
+  CUresult FakeBackend::pop_context() {
+    return CUDA_SUCCESS;
+  }
+
+  CUvideoctxlock FakeBackend::get_context_lock() {
+    return (CUvideoctxlock)&context_lock;
+  }
+
+  /* ------------------------------------------------ */
+
+  CUresult FakeBackend::create_parser(CUvideoparser* parser, CUVIDPARSERPARAMS* params) {
+
+    if (nullptr == parser || nullptr == params) {
+      return CUDA_ERROR_INVALID_VALUE;
+    }
+
+    if (cudaVideoCodec_H264 != params->CodecType) {
+      printf("The fake backend only supports H264.\n");
+      return CUDA_ERROR_NOT_SUPPORTED;
+    }
+
+    *parser = (CUvideoparser)new FakeParser(params);
+
+    return CUDA_SUCCESS;
+  }
+
+  CUresult FakeBackend::parse_video_data(CUvideoparser parser, CUVIDSOURCEDATAPACKET* pkt) {
+
+    if (nullptr == parser || nullptr == pkt) {
+      return CUDA_ERROR_INVALID_VALUE;
+    }
+
+    return ((FakeParser*)parser)->parse(pkt);
+  }
+
+  CUresult FakeBackend::destroy_parser(CUvideoparser parser) {
+
+    if (nullptr == parser) {
+      return CUDA_ERROR_INVALID_VALUE;
+    }
+
+    delete (FakeParser*)parser;
+
+    return CUDA_SUCCESS;
+  }
+
+  /* ------------------------------------------------ */
+
+  CUresult FakeBackend::get_decoder_caps(CUVIDDECODECAPS* caps) {
+
+    if (nullptr == caps) {
+      return CUDA_ERROR_INVALID_VALUE;
+    }
+
+    caps->bIsSupported = (cudaVideoCodec_H264 == caps->eCodecType
+                          && cudaVideoChromaFormat_420 == caps->eChromaFormat
+                          && 0 == caps->nBitDepthMinus8) ? 1 : 0;
+
+    caps->nOutputFormatMask = (1 << cudaVideoSurfaceFormat_NV12);
+    caps->nMaxWidth = FAKE_MAX_WIDTH;
+    caps->nMaxHeight = FAKE_MAX_HEIGHT;
+    caps->nMaxMBCount = (FAKE_MAX_WIDTH / 16) * (FAKE_MAX_HEIGHT / 16);
+    caps->nMinWidth = 48;
+    caps->nMinHeight = 16;
+
+    return CUDA_SUCCESS;
+  }
+
+  CUresult FakeBackend::create_decoder(CUvideodecoder* decoder, CUVIDDECODECREATEINFO* info) {
+
+    if (nullptr == decoder || nullptr == info) {
+      return CUDA_ERROR_INVALID_VALUE;
+    }
+
+    FakeDecoder* dec = new FakeDecoder();
+
+    CUresult r = dec->init(info);
+    if (CUDA_SUCCESS != r) {
+      delete dec;
+      return r;
+    }
+
+    /* Other threads may create decoders at the same time, so reserve first and check what we got. */
+    uint64_t nbytes = dec->get_device_nbytes();
+    if (device_nbytes.fetch_add(nbytes) + nbytes > settings.memory_nbytes) {
+      device_nbytes -= nbytes;
+      delete dec;
+      return CUDA_ERROR_OUT_OF_MEMORY;
+    }
+
+    *decoder = (CUvideodecoder)dec;
+
+    return CUDA_SUCCESS;
+  }
+
+  CUresult FakeBackend::destroy_decoder(CUvideodecoder decoder) {
+
+    if (nullptr == decoder) {
+      return CUDA_ERROR_INVALID_VALUE;
+    }
+
+    FakeDecoder* dec = (FakeDecoder*)decoder;
+    device_nbytes -= dec->get_device_nbytes();
+    delete dec;
+
+    return CUDA_SUCCESS;
+  }
+
+  CUresult FakeBackend::reconfigure_decoder(CUvideodecoder decoder, CUVIDRECONFIGUREDECODERINFO* info) {
+
+    if (nullptr == decoder || nullptr == info) {
+      return CUDA_ERROR_INVALID_VALUE;
+    }
+
+    return ((FakeDecoder*)decoder)->reconfigure(info);
+  }
+
+  CUresult FakeBackend::decode_picture(CUvideodecoder decoder, CUVIDPICPARAMS* pic) {
+
+    if (nullptr == decoder || nullptr == pic) {
+      return CUDA_ERROR_INVALID_VALUE;
+    }
+
+    CUresult r = ((FakeDecoder*)decoder)->decode(pic);
+    if (CUDA_SUCCESS != r || 0 == settings.decode_ns) {
+      return r;
+    }
+
+    /* Like cuvidDecodePicture() we return when the engine accepted the picture; that's when it's done with the previous one. */
+    std::lock_guard<std::mutex> lock(engine_lock);
+    std::this_thread::sleep_for(std::chrono::nanoseconds(settings.decode_ns));
+
+    return CUDA_SUCCESS;
+  }
+
+  CUresult FakeBackend::map_video_frame(CUvideodecoder decoder, int picture_index, CUdeviceptr* device_ptr, unsigned int* pitch, CUVIDPROCPARAMS* vpp) {
+
+    if (nullptr == decoder || nullptr == device_ptr || nullptr == pitch || nullptr == vpp) {
+      return CUDA_ERROR_INVALID_VALUE;
+    }
+
+    return ((FakeDecoder*)decoder)->map(picture_index, device_ptr, pitch);
+  }
+
+  CUresult FakeBackend::unmap_video_frame(CUvideodecoder decoder, CUdeviceptr device_ptr) {
+
+    if (nullptr == decoder) {
+      return CUDA_ERROR_INVALID_VALUE;
+    }
+
+    return ((FakeDecoder*)decoder)->unmap(device_ptr);
+  }
+
+  /* ------------------------------------------------ */
+
+  CUresult FakeBackend::alloc_host(void** ptr, size_t nbytes) {
+
+    if (nullptr == ptr || 0 == nbytes) {
+      return CUDA_ERROR_INVALID_VALUE;
+    }
+
+    *ptr = aligned_alloc_host(nbytes);
+    if (nullptr == *ptr) {
+      return CUDA_ERROR_OUT_OF_MEMORY;
+    }
+
+    return CUDA_SUCCESS;
+  }
+
+  CUresult FakeBackend::free_host(void* ptr) {
+
+    if (nullptr == ptr) {
+      return CUDA_ERROR_INVALID_VALUE;
+    }
+
+    aligned_free_host(ptr);
+
+    return CUDA_SUCCESS;
+  }
+
+  CUresult FakeBackend::copy_to_host(void* dst, CUdeviceptr src, size_t nbytes) {
+
+    if (nullptr == dst || 0 == src) {
+      return CUDA_ERROR_INVALID_VALUE;
+    }
+
+    memcpy(dst, (const void*)(uintptr_t)src, nbytes);
+
+    return CUDA_SUCCESS;
+  }
+
+  CUresult FakeBackend::copy_to_host_async(void* dst, CUdeviceptr src, size_t nbytes, CUstream stream) {
+
+    if (nullptr == stream) {
+      return copy_to_host(dst, src, nbytes);
+    }
+
+    if (nullptr == dst || 0 == src) {
+      return CUDA_ERROR_INVALID_VALUE;
+    }
+
+    FakeJob job;
+    job.type = FAKE_JOB_COPY;
+    job.dst = dst;
+    job.dst_pitch = nbytes;
+    job.src = (const void*)(uintptr_t)src;
+    job.src_pitch = nbytes;
+    job.width = nbytes;
+    job.height = 1;
+    job.event = nullptr;
+    job.generation = 0;
+
+    ((FakeStream*)stream)->push(job);
+
+    return CUDA_SUCCESS;
+  }
+
+  CUresult FakeBackend::copy_2d_to_host_async(void* dst, size_t dst_pitch, CUdeviceptr src, size_t src_pitch, size_t width, size_t height, CUstream stream) {
+
+    if (nullptr == dst || 0 == src || width > dst_pitch || width > src_pitch) {
+      return CUDA_ERROR_INVALID_VALUE;
+    }
+
+    if (nullptr == stream) {
+      copy_2d(dst, dst_pitch, (const void*)(uintptr_t)src, src_pitch, width, height);
+      return CUDA_SUCCESS;
+    }
+
+    FakeJob job;
+    job.type = FAKE_JOB_COPY;
+    job.dst = dst;
+    job.dst_pitch = dst_pitch;
+    job.src = (const void*)(uintptr_t)src;
+    job.src_pitch = src_pitch;
+    job.width = width;
+    job.height = height;
+    job.event = nullptr;
+    job.generation = 0;
+
+    ((FakeStream*)stream)->push(job);
+
+    return CUDA_SUCCESS;
+  }
+
+  CUresult FakeBackend::get_memory_info(size_t* free_nbytes, size_t* total_nbytes) {
+
+    if (nullptr == free_nbytes || nullptr == total_nbytes) {
+      return CUDA_ERROR_INVALID_VALUE;
+    }
+
+    uint64_t used = device_nbytes;
+    *total_nbytes = (size_t)settings.memory_nbytes;
+    *free_nbytes = (used < settings.memory_nbytes) ? (size_t)(settings.memory_nbytes - used) : 0;
+
+    return CUDA_SUCCESS;
+  }
+
+  /* ------------------------------------------------ */
+
+  CUresult FakeBackend::create_stream(CUstream* stream) {
+
+    if (nullptr == stream) {
+      return CUDA_ERROR_INVALID_VALUE;
+    }
+
+    *stream = (CUstream)new FakeStream();
+
+    return CUDA_SUCCESS;
+  }
+
+  /* Like cuStreamDestroy() the queued work is finished first. */
+  CUresult FakeBackend::destroy_stream(CUstream stream) {
+
+    if (nullptr == stream) {
+      return CUDA_ERROR_INVALID_HANDLE;
+    }
+
+    delete (FakeStream*)stream;
+
+    return CUDA_SUCCESS;
+  }
+
+  CUresult FakeBackend::create_event(CUevent* event) {
+
+    if (nullptr == event) {
+      return CUDA_ERROR_INVALID_VALUE;
+    }
+
+    *event = (CUevent)new FakeEvent();
+
+    return CUDA_SUCCESS;
+  }
+
+  /* We wait for pending records because the stream thread still references the event. */
+  CUresult FakeBackend::destroy_event(CUevent event) {
+
+    if (nullptr == event) {
+      return CUDA_ERROR_INVALID_HANDLE;
+    }
+
+    FakeEvent* ev = (FakeEvent*)event;
+    ev->wait();
+    delete ev;
+
+    return CUDA_SUCCESS;
+  }
+
+  CUresult FakeBackend::record_event(CUevent event, CUstream stream) {
+
+    if (nullptr == event) {
+      return CUDA_ERROR_INVALID_HANDLE;
+    }
+
+    FakeEvent* ev = (FakeEvent*)event;
+
+    if (nullptr == stream) {
+      ev->record();
+      return CUDA_SUCCESS;
+    }
+
+    FakeJob job;
+    job.type = FAKE_JOB_EVENT;
+    job.dst = nullptr;
+    job.dst_pitch = 0;
+    job.src = nullptr;
+    job.src_pitch = 0;
+    job.width = 0;
+    job.height = 0;
+    job.event = ev;
+    job.generation = ev->begin_record();
+
+    ((FakeStream*)stream)->push(job);
+
+    return CUDA_SUCCESS;
+  }
+
+  CUresult FakeBackend::query_event(CUevent event) {
+
+    if (nullptr == event) {
+      return CUDA_ERROR_INVALID_HANDLE;
+    }
+
+    return (true == ((FakeEvent*)event)->is_done()) ? CUDA_SUCCESS : CUDA_ERROR_NOT_READY;
+  }
+
+  CUresult FakeBackend::synchronize_event(CUevent event) {
+
+    if (nullptr == event) {
+      return CUDA_ERROR_INVALID_HANDLE;
+    }
+
+    ((FakeEvent*)event)->wait();
+
+    return CUDA_SUCCESS;
+  }
+
+  /* ------------------------------------------------ */
+
+  FakeEvent::FakeEvent()
+    :num_recorded(0)
+    ,num_completed(0)
+  {
+  }
+
+  void FakeEvent::record() {
+    std::lock_guard<std::mutex> lock(mtx);
+    num_recorded++;
+    num_completed = num_recorded;
+    cv.notify_all();
+  }
+
+  uint64_t FakeEvent::begin_record() {
+    std::lock_guard<std::mutex> lock(mtx);
+    num_recorded++;
+    return num_recorded;
+  }
+
+  void FakeEvent::complete(uint64_t generation) {
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    if (generation > num_completed) {
+      num_completed = generation;
+    }
+
+    cv.notify_all();
+  }
+
+  bool FakeEvent::is_done() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return num_completed >= num_recorded;
+  }
+
+  void FakeEvent::wait() {
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [this] { return num_completed >= num_recorded; });
+  }
+
+  /* ------------------------------------------------ */
+
+  FakeStream::FakeStream()
+    :must_stop(false)
+  {
+    thread = std::thread(&FakeStream::run, this);
+  }
+
+  FakeStream::~FakeStream() {
+
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      must_stop = true;
+    }
+
+    cv.notify_one();
+    thread.join();
+  }
+
+  void FakeStream::push(const FakeJob& job) {
+
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      jobs.push_back(job);
+    }
+
+    cv.notify_one();
+  }
+
+  /* We only stop when all jobs have been executed. */
+  void FakeStream::run() {
+
+    while (true) {
+
+      FakeJob job;
+
+      {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [this] { return true == must_stop || false == jobs.empty(); });
+
+        if (true == jobs.empty()) {
+          return;
+        }
+
+        job = jobs.front();
+        jobs.pop_front();
+      }
+
+      switch (job.type) {
+        case FAKE_JOB_COPY: {
+          copy_2d(job.dst, job.dst_pitch, job.src, job.src_pitch, job.width, job.height);
+          break;
+        }
+        case FAKE_JOB_EVENT: {
+          job.event->complete(job.generation);
+          break;
+        }
+      }
+    }
+  }
+
+  /* ------------------------------------------------ */
+
+  FakeParser::FakeParser(CUVIDPARSERPARAMS* p)
+    :params(*p)
+    ,pending_offset(0)
+    ,pending_stream_offset(0)
+    ,has_format(false)
+    ,num_decode_surfaces(p->ulMaxNumDecodeSurfaces)
+    ,num_reorder_frames(0)
+    ,max_num_ref_frames(1)
+    ,has_picture(false)
+    ,is_intra(true)
+    ,next_picture_index(0)
+    ,warned_about_fields(false)
+  {
+    memset((char*)&format, 0x00, sizeof(format));
+    memset((char*)&picture, 0x00, sizeof(picture));
+
+    if (num_decode_surfaces <= 0) {
+      num_decode_surfaces = 1;
+    }
+  }
+
+  CUresult FakeParser::parse(CUVIDSOURCEDATAPACKET* pkt) {
+
+    if (0 != (pkt->flags & CUVID_PKT_DISCONTINUITY)) {
+      pending.clear();
+      pending_offset = 0;
+    }
+
+    if (0 != (pkt->flags & CUVID_PKT_TIMESTAMP)) {
+      FakeTimestamp ts;
+      ts.offset = pending_stream_offset + pending.size();
+      ts.timestamp = pkt->timestamp;
+      timestamps.push_back(ts);
+    }
+
+    if (nullptr != pkt->payload && pkt->payload_size > 0) {
+      pending.insert(pending.end(), pkt->payload, pkt->payload + pkt->payload_size);
+    }
+
+    bool is_eos = (0 != (pkt->flags & CUVID_PKT_ENDOFSTREAM));
+    bool is_eop = (0 != (pkt->flags & CUVID_PKT_ENDOFPICTURE));
+
+    CUresult r = process_nals(is_eos || is_eop);
+    if (CUDA_SUCCESS != r) {
+      return r;
+    }
+
+    if (true == is_eos || true == is_eop) {
+      r = finish_picture();
+      if (CUDA_SUCCESS != r) {
+        return r;
+      }
+    }
+
+    if (true == is_eos) {
+      r = display_pictures(0);
+      reset_stream();
+    }
+
+    return r;
+  }
+
+  /* Splits the pending bytes into NALs; without `flush` we keep the last NAL as it might not be complete. */
+  CUresult FakeParser::process_nals(bool flush) {
+
+    const uint8_t* data = pending.data();
+    const uint8_t* end = data + pending.size();
+    const uint8_t* sc = annexb_find_start_code(data + pending_offset, end);
+
+    while (sc != end) {
+
+      const uint8_t* nal = sc + 3;
+      const uint8_t* next = annexb_find_start_code(nal, end);
+
+      if (next == end && false == flush) {
+        break;
+      }
+
+      const uint8_t* nal_end = next;
+      while (nal_end > nal && 0x00 == nal_end[-1]) {
+        nal_end--;
+      }
+
+      if (nal_end > nal) {
+        CUresult r = handle_nal(nal, nal_end - nal, pending_stream_offset + (sc - data));
+        if (CUDA_SUCCESS != r) {
+          return r;
+        }
+      }
+
+      sc = next;
+    }
+
+    pending_offset = (flush) ? pending.size() : (sc - data);
+
+    /* Drop what we've parsed so the buffer doesn't grow. */
+    if (pending_offset >= FAKE_COMPACT_SIZE || pending_offset == pending.size()) {
+      pending.erase(pending.begin(), pending.begin() + pending_offset);
+      pending_stream_offset += pending_offset;
+      pending_offset = 0;
+    }
+
+    return CUDA_SUCCESS;
+  }
+
+  CUresult FakeParser::handle_nal(const uint8_t* nal, size_t nbytes, uint64_t offset) {
+
+    int nal_type = nal[0] & 0x1F;
+    CUresult r = CUDA_SUCCESS;
+
+    if (false == h264_is_vcl(nal_type)) {
+
+      /* Anything but a slice ends the picture we're collecting. */
+      r = finish_picture();
+      if (CUDA_SUCCESS != r) {
+        return r;
+      }
+
+      if (H264_NAL_SPS == nal_type || H264_NAL_PPS == nal_type) {
+        if (0 != parameter_sets.parse(nal, nbytes)) {
+          printf("Warning: the fake parser failed to parse a parameter set, ignoring it.\n");
+        }
+      }
+
+      return CUDA_SUCCESS;
+    }
+
+    /* We only handle the IDR and non-IDR slices. */
+    if (H264_NAL_SLICE != nal_type && H264_NAL_IDR != nal_type) {
+      return CUDA_SUCCESS;
+    }
+
+    H264SliceHeader sh;
+    if (0 != parameter_sets.parse_slice_header(nal, nbytes, sh)) {
+      /* E.g. when we start in the middle of a stream, before the first SPS/PPS. */
+      return CUDA_SUCCESS;
+    }
+
+    if (0 == sh.first_mb_in_slice || false == has_picture) {
+      r = finish_picture();
+      if (CUDA_SUCCESS != r) {
+        return r;
+      }
+      r = start_picture(sh, offset);
+      if (CUDA_SUCCESS != r) {
+        return r;
+      }
+    }
+
+    if (false == has_picture) {
+      return CUDA_SUCCESS;
+    }
+
+    if (H264_SLICE_TYPE_I != sh.slice_type && H264_SLICE_TYPE_SI != sh.slice_type) {
+      is_intra = false;
+    }
+
+    /* The decoder gets the slices including their start code, like the cuvid parser does. */
+    static const uint8_t start_code[] = { 0x00, 0x00, 0x01 };
+    slice_offsets.push_back((unsigned int)bitstream.size());
+    bitstream.insert(bitstream.end(), start_code, start_code + sizeof(start_code));
+    bitstream.insert(bitstream.end(), nal, nal + nbytes);
+
+    return CUDA_SUCCESS;
+  }
+
+  CUresult FakeParser::start_picture(const H264SliceHeader& sh, uint64_t offset) {
+
+    const H264Sps* sps = parameter_sets.get_sps_for_pps(sh.pps_id);
+    if (nullptr == sps) {
+      return CUDA_SUCCESS;
+    }
+
+    if (1 == sh.field_pic_flag && false == warned_about_fields) {
+      printf("Warning: the fake parser doesn't support field coding; fields are handled as frames.\n");
+      warned_about_fields = true;
+    }
+
+    CUresult r = handle_sequence(*sps);
+    if (CUDA_SUCCESS != r) {
+      return r;
+    }
+
+    /* An IDR outputs all the pictures before it and empties the reference list. */
+    if (H264_NAL_IDR == sh.nal_type) {
+      r = display_pictures(0);
+      if (CUDA_SUCCESS != r) {
+        return r;
+      }
+      references.clear();
+    }
+
+    int picture_index = allocate_picture_index();
+    if (picture_index < 0) {
+      printf("The fake parser ran out of decode surfaces (%d).\n", num_decode_surfaces);
+      return CUDA_ERROR_OUT_OF_MEMORY;
+    }
+
+    picture.picture_index = picture_index;
+    picture.poc = picture_order.compute(*sps, sh);
+    picture.is_reference = (0 != sh.nal_ref_idc);
+    picture.timestamp = get_timestamp(offset);
+    picture_slice = sh;
+    is_intra = true;
+    has_picture = true;
+    bitstream.clear();
+    slice_offsets.clear();
+
+    return CUDA_SUCCESS;
+  }
+
+  CUresult FakeParser::finish_picture() {
+
+    if (false == has_picture) {
+      return CUDA_SUCCESS;
+    }
+
+    has_picture = false;
+
+    const H264Sps* sps = parameter_sets.get_sps_for_pps(picture_slice.pps_id);
+    const H264Pps* pps = parameter_sets.get_pps(picture_slice.pps_id);
+    if (nullptr == sps || nullptr == pps) {
+      return CUDA_SUCCESS;
+    }
+
+    memset((char*)&pic_params, 0x00, sizeof(pic_params));
+    pic_params.PicWidthInMbs = sps->coded_width / 16;
+    pic_params.FrameHeightInMbs = sps->coded_height / 16;
+    pic_params.CurrPicIdx = picture.picture_index;
+    pic_params.field_pic_flag = picture_slice.field_pic_flag;
+    pic_params.bottom_field_flag = picture_slice.bottom_field_flag;
+    pic_params.second_field = 0;
+    pic_params.nBitstreamDataLen = (unsigned int)bitstream.size();
+    pic_params.pBitstreamData = bitstream.data();
+    pic_params.nNumSlices = (unsigned int)slice_offsets.size();
+    pic_params.pSliceDataOffsets = slice_offsets.data();
+    pic_params.ref_pic_flag = (true == picture.is_reference) ? 1 : 0;
+    pic_params.intra_pic_flag = (true == is_intra) ? 1 : 0;
+
+    CUVIDH264PICPARAMS& h264 = pic_params.CodecSpecific.h264;
+    h264.log2_max_frame_num_minus4 = sps->log2_max_frame_num_minus4;
+    h264.pic_order_cnt_type = sps->pic_order_cnt_type;
+    h264.log2_max_pic_order_cnt_lsb_minus4 = sps->log2_max_pic_order_cnt_lsb_minus4;
+    h264.delta_pic_order_always_zero_flag = sps->delta_pic_order_always_zero_flag;
+    h264.frame_mbs_only_flag = sps->frame_mbs_only_flag;
+    h264.num_ref_frames = sps->max_num_ref_frames;
+    h264.bit_depth_luma_minus8 = (unsigned char)sps->bit_depth_luma_minus8;
+    h264.bit_depth_chroma_minus8 = (unsigned char)sps->bit_depth_chroma_minus8;
+    h264.entropy_coding_mode_flag = pps->entropy_coding_mode_flag;
+    h264.pic_order_present_flag = pps->bottom_field_pic_order_in_frame_present_flag;
+    h264.ref_pic_flag = pic_params.ref_pic_flag;
+    h264.frame_num = picture_slice.frame_num;
+    h264.CurrFieldOrderCnt[0] = picture.poc;
+    h264.CurrFieldOrderCnt[1] = picture.poc;
+
+    if (nullptr != params.pfnDecodePicture) {
+      if (0 == params.pfnDecodePicture(params.pUserData, &pic_params)) {
+        printf("The decode callback returned 0, stopping.\n");
+        return CUDA_ERROR_UNKNOWN;
+      }
+    }
+
+    /* Sliding window reference marking; good enough for the streams we test with. */
+    if (true == picture.is_reference) {
+      references.push_back(picture.picture_index);
+      while ((int)references.size() > max_num_ref_frames) {
+        references.erase(references.begin());
+      }
+    }
+
+    reorder.push_back(picture);
+
+    return display_pictures(num_reorder_frames + params.ulMaxDisplayDelay);
+  }
+
+  /* Displays pictures in poc order until `keep` pictures are left. */
+  CUresult FakeParser::display_pictures(size_t keep) {
+
+    while (reorder.size() > keep) {
+
+      size_t dx = 0;
+      for (size_t i = 1; i < reorder.size(); ++i) {
+        if (reorder[i].poc < reorder[dx].poc) {
+          dx = i;
+        }
+      }
+
+      CUVIDPARSERDISPINFO info;
+      memset((char*)&info, 0x00, sizeof(info));
+      info.picture_index = reorder[dx].picture_index;
+      info.progressive_frame = 1;
+      info.top_field_first = 0;
+      info.repeat_first_field = 0;
+      info.timestamp = reorder[dx].timestamp;
+
+      reorder.erase(reorder.begin() + dx);
+
+      if (nullptr != params.pfnDisplayPicture) {
+        if (0 == params.pfnDisplayPicture(params.pUserData, &info)) {
+          printf("The display callback returned 0, stopping.\n");
+          return CUDA_ERROR_UNKNOWN;
+        }
+      }
+    }
+
+    return CUDA_SUCCESS;
+  }
+
+  /* Calls the sequence callback when this SPS changes the format. */
+  CUresult FakeParser::handle_sequence(const H264Sps& sps) {
+
+    CUVIDEOFORMAT fmt;
+    memset((char*)&fmt, 0x00, sizeof(fmt));
+
+    fmt.codec = cudaVideoCodec_H264;
+    fmt.progressive_sequence = (unsigned char)sps.frame_mbs_only_flag;
+    fmt.bit_depth_luma_minus8 = (unsigned char)sps.bit_depth_luma_minus8;
+    fmt.bit_depth_chroma_minus8 = (unsigned char)sps.bit_depth_chroma_minus8;
+    fmt.min_num_decode_surfaces = (unsigned char)(h264_get_dpb_size(sps) + 1);
+    fmt.coded_width = sps.coded_width;
+    fmt.coded_height = sps.coded_height;
+    fmt.display_area.left = sps.display_left;
+    fmt.display_area.top = sps.display_top;
+    fmt.display_area.right = sps.display_right;
+    fmt.display_area.bottom = sps.display_bottom;
+    fmt.chroma_format = (cudaVideoChromaFormat)sps.chroma_format_idc;
+    fmt.bitrate = 0;
+    fmt.seqhdr_data_length = (unsigned int)sps.nbytes;
+
+    if (1 == sps.timing_info_present_flag && 0 != sps.num_units_in_tick) {
+      int gcd = greatest_common_divisor((int)sps.time_scale, (int)(2 * sps.num_units_in_tick));
+      fmt.frame_rate.numerator = sps.time_scale / gcd;
+      fmt.frame_rate.denominator = (2 * sps.num_units_in_tick) / gcd;
+    }
+
+    /* Table E-1 */
+    static const int sar_table[17][2] = {
+      { 0, 0 }, { 1, 1 }, { 12, 11 }, { 10, 11 }, { 16, 11 }, { 40, 33 }, { 24, 11 }, { 20, 11 }, { 32, 11 },
+      { 80, 33 }, { 18, 11 }, { 15, 11 }, { 64, 33 }, { 160, 99 }, { 4, 3 }, { 3, 2 }, { 2, 1 }
+    };
+
+    int sar_w = 1;
+    int sar_h = 1;
+    if (255 == sps.aspect_ratio_idc && 0 != sps.sar_width && 0 != sps.sar_height) {
+      sar_w = sps.sar_width;
+      sar_h = sps.sar_height;
+    }
+    else if (sps.aspect_ratio_idc > 0 && sps.aspect_ratio_idc < 17) {
+      sar_w = sar_table[sps.aspect_ratio_idc][0];
+      sar_h = sar_table[sps.aspect_ratio_idc][1];
+    }
+
+    int dar_x = (sps.display_right - sps.display_left) * sar_w;
+    int dar_y = (sps.display_bottom - sps.display_top) * sar_h;
+    int gcd = greatest_common_divisor(dar_x, dar_y);
+    fmt.display_aspect_ratio.x = dar_x / gcd;
+    fmt.display_aspect_ratio.y = dar_y / gcd;
+
+    fmt.video_signal_description.video_format = sps.video_format & 0x07;
+    fmt.video_signal_description.video_full_range_flag = sps.video_full_range_flag & 0x01;
+    fmt.video_signal_description.color_primaries = (unsigned char)sps.colour_primaries;
+    fmt.video_signal_description.transfer_characteristics = (unsigned char)sps.transfer_characteristics;
+    fmt.video_signal_description.matrix_coefficients = (unsigned char)sps.matrix_coefficients;
+
+    if (true == has_format
+        && fmt.coded_width == format.coded_width
+        && fmt.coded_height == format.coded_height
+        && fmt.chroma_format == format.chroma_format
+        && fmt.bit_depth_luma_minus8 == format.bit_depth_luma_minus8
+        && fmt.min_num_decode_surfaces == format.min_num_decode_surfaces
+        && 0 == memcmp((const char*)&fmt.display_area, (const char*)&format.display_area, sizeof(fmt.display_area)))
+      {
+        return CUDA_SUCCESS;
+      }
+
+    /* Display everything from the previous sequence before the decoder gets reconfigured. */
+    CUresult r = display_pictures(0);
+    if (CUDA_SUCCESS != r) {
+      return r;
+    }
+
+    references.clear();
+    format = fmt;
+    has_format = true;
+    num_reorder_frames = h264_get_num_reorder_frames(sps);
+    max_num_ref_frames = (sps.max_num_ref_frames > 0) ? sps.max_num_ref_frames : 1;
+    num_decode_surfaces = params.ulMaxNumDecodeSurfaces;
+
+    if (nullptr != params.pfnSequenceCallback) {
+      int result = params.pfnSequenceCallback(params.pUserData, &fmt);
+      if (0 == result) {
+        printf("The sequence callback returned 0, stopping.\n");
+        return CUDA_ERROR_UNKNOWN;
+      }
+      if (result > 1) {
+        num_decode_surfaces = result;
+      }
+    }
+
+    if (num_decode_surfaces <= 0) {
+      num_decode_surfaces = 1;
+    }
+
+    return CUDA_SUCCESS;
+  }
+
+  /* A picture index is free when it's not used for reference and not waiting to be displayed. */
+  int FakeParser::allocate_picture_index() {
+
+    for (int i = 0; i < num_decode_surfaces; ++i) {
+
+      int dx = (next_picture_index + i) % num_decode_surfaces;
+      bool is_used = false;
+
+      for (size_t j = 0; j < references.size() && false == is_used; ++j) {
+        is_used = (references[j] == dx);
+      }
+
+      for (size_t j = 0; j < reorder.size() && false == is_used; ++j) {
+        is_used = (reorder[j].picture_index == dx);
+      }
+
+      if (false == is_used) {
+        next_picture_index = (dx + 1) % num_decode_surfaces;
+        return dx;
+      }
+    }
+
+    return -1;
+  }
+
+  /* Returns the timestamp of the packet that holds the byte at `offset`. */
+  CUvideotimestamp FakeParser::get_timestamp(uint64_t offset) {
+
+    CUvideotimestamp result = 0;
+
+    while (false == timestamps.empty() && timestamps.front().offset <= offset) {
+      result = timestamps.front().timestamp;
+      timestamps.pop_front();
+    }
+
+    return result;
+  }
+
+  void FakeParser::reset_stream() {
+    pending.clear();
+    pending_offset = 0;
+    timestamps.clear();
+    references.clear();
+    reorder.clear();
+    has_picture = false;
+    picture_order.reset();
+  }
+
+  /* ------------------------------------------------ */
+
+  FakeDecoder::FakeDecoder()
+    :crop_left(0)
+    ,crop_top(0)
+    ,crop_width(0)
+    ,crop_height(0)
+    ,max_width(0)
+    ,max_height(0)
+    ,max_target_width(0)
+    ,max_target_height(0)
+    ,max_decode_surfaces(0)
+    ,output_surface_nbytes(0)
+  {
+    memset((char*)&info, 0x00, sizeof(info));
+  }
+
+  FakeDecoder::~FakeDecoder() {
+
+    for (size_t i = 0; i < output_surfaces.size(); ++i) {
+      aligned_free_host(output_surfaces[i].data);
+    }
+
+    output_surfaces.clear();
+  }
+
+  CUresult FakeDecoder::init(CUVIDDECODECREATEINFO* ci) {
+
+    if (cudaVideoCodec_H264 != ci->CodecType
+        || cudaVideoChromaFormat_420 != ci->ChromaFormat
+        || cudaVideoSurfaceFormat_NV12 != ci->OutputFormat
+        || 0 != ci->bitDepthMinus8)
+      {
+        printf("The fake decoder only supports 8 bit H264 4:2:0 with NV12 output.\n");
+        return CUDA_ERROR_NOT_SUPPORTED;
+      }
+
+    if (0 == ci->ulWidth || 0 == ci->ulHeight
+        || ci->ulWidth > FAKE_MAX_WIDTH || ci->ulHeight > FAKE_MAX_HEIGHT
+        || 0 == ci->ulTargetWidth || 0 == ci->ulTargetHeight
+        || ci->ulTargetWidth > FAKE_MAX_WIDTH || ci->ulTargetHeight > FAKE_MAX_HEIGHT
+        || 0 != (ci->ulTargetWidth & 1) || 0 != (ci->ulTargetHeight & 1))
+      {
+        printf("Invalid decoder size: %lu x %lu, target: %lu x %lu.\n", ci->ulWidth, ci->ulHeight, ci->ulTargetWidth, ci->ulTargetHeight);
+        return CUDA_ERROR_INVALID_VALUE;
+      }
+
+    if (0 == ci->ulNumDecodeSurfaces
+        || ci->ulNumDecodeSurfaces > FAKE_MAX_DECODE_SURFACES
+        || 0 == ci->ulNumOutputSurfaces)
+      {
+        printf("Invalid number of surfaces, decode: %lu, output: %lu.\n", ci->ulNumDecodeSurfaces, ci->ulNumOutputSurfaces);
+        return CUDA_ERROR_INVALID_VALUE;
+      }
+
+    if (ci->ulMaxWidth > FAKE_MAX_WIDTH || ci->ulMaxHeight > FAKE_MAX_HEIGHT) {
+      printf("Invalid decoder max size: %lu x %lu.\n", ci->ulMaxWidth, ci->ulMaxHeight);
+      return CUDA_ERROR_INVALID_VALUE;
+    }
+
+    info = *ci;
+    update_crop();
+
+    /* Like cuvid, a max size of 0 means the decoder can't grow. */
+    max_width = (info.ulMaxWidth > info.ulWidth) ? info.ulMaxWidth : info.ulWidth;
+    max_height = (info.ulMaxHeight > info.ulHeight) ? info.ulMaxHeight : info.ulHeight;
+    max_target_width = (max_width > info.ulTargetWidth) ? max_width : info.ulTargetWidth;
+    max_target_height = (max_height > info.ulTargetHeight) ? max_height : info.ulTargetHeight;
+
+    FakeDecodeSurface ds;
+    ds.is_decoded = false;
+    ds.seed = 0;
+    decode_surfaces.assign(info.ulNumDecodeSurfaces, ds);
+    max_decode_surfaces = info.ulNumDecodeSurfaces;
+
+    /* The output surfaces are allocated for the max size so reconfigure() never has to allocate. */
+    unsigned int pitch = align_up((unsigned int)info.ulTargetWidth, FAKE_PITCH_ALIGNMENT);
+    unsigned int max_pitch = align_up((unsigned int)max_target_width, FAKE_PITCH_ALIGNMENT);
+    size_t nbytes = (size_t)max_pitch * (max_target_height + max_target_height / 2);
+    output_surface_nbytes = nbytes;
+
+    for (unsigned long i = 0; i < info.ulNumOutputSurfaces; ++i) {
+      FakeOutputSurface os;
+      os.data = (uint8_t*)aligned_alloc_host(nbytes);
+      os.pitch = pitch;
+      os.is_mapped = false;
+      if (nullptr == os.data) {
+        return CUDA_ERROR_OUT_OF_MEMORY;
+      }
+      output_surfaces.push_back(os);
+    }
+
+    ScaleSettings scale_settings;
+    scale_settings.filter = SCALE_FILTER_BILINEAR;
+    if (0 != scaler.init(scale_settings)) {
+      return CUDA_ERROR_NOT_SUPPORTED;
+    }
+
+    /* Y(x, y) = x + y + seed and the chroma has U rising and V falling; we render a row with one memcpy. */
+    size_t pattern_size = max_width + 512;
+    luma_pattern.resize(pattern_size);
+    chroma_pattern.resize(2 * pattern_size);
+
+    for (size_t i = 0; i < pattern_size; ++i) {
+      luma_pattern[i] = (uint8_t)(i & 0xFF);
+      chroma_pattern[2 * i + 0] = (uint8_t)((64 + i) & 0xFF);
+      chroma_pattern[2 * i + 1] = (uint8_t)((192 - i) & 0xFF);
+    }
+
+    return CUDA_SUCCESS;
+  }
+
+  /* Only the sizes change; the surfaces and patterns were allocated for the max size in init(). */
+  CUresult FakeDecoder::reconfigure(CUVIDRECONFIGUREDECODERINFO* ri) {
+
+    for (size_t i = 0; i < output_surfaces.size(); ++i) {
+      if (true == output_surfaces[i].is_mapped) {
+        printf("Cannot reconfigure the fake decoder, output surface %zu is still mapped.\n", i);
+        return CUDA_ERROR_INVALID_VALUE;
+      }
+    }
+
+    if (0 == ri->ulWidth || 0 == ri->ulHeight
+        || ri->ulWidth > max_width || ri->ulHeight > max_height)
+      {
+        printf("Cannot reconfigure the fake decoder to %u x %u, the max size is %lu x %lu.\n", ri->ulWidth, ri->ulHeight, max_width, max_height);
+        return CUDA_ERROR_INVALID_VALUE;
+      }
+
+    if (0 == ri->ulTargetWidth || 0 == ri->ulTargetHeight
+        || ri->ulTargetWidth > max_target_width || ri->ulTargetHeight > max_target_height
+        || 0 != (ri->ulTargetWidth & 1) || 0 != (ri->ulTargetHeight & 1))
+      {
+        printf("Cannot reconfigure the fake decoder, invalid target size: %u x %u.\n", ri->ulTargetWidth, ri->ulTargetHeight);
+        return CUDA_ERROR_INVALID_VALUE;
+      }
+
+    if (0 == ri->ulNumDecodeSurfaces || ri->ulNumDecodeSurfaces > max_decode_surfaces) {
+      printf("Cannot reconfigure the fake decoder to %u decode surfaces, it was created with %lu.\n", ri->ulNumDecodeSurfaces, max_decode_surfaces);
+      return CUDA_ERROR_INVALID_VALUE;
+    }
+
+    info.ulWidth = ri->ulWidth;
+    info.ulHeight = ri->ulHeight;
+    info.ulTargetWidth = ri->ulTargetWidth;
+    info.ulTargetHeight = ri->ulTargetHeight;
+    info.ulNumDecodeSurfaces = ri->ulNumDecodeSurfaces;
+    info.display_area.left = ri->display_area.left;
+    info.display_area.top = ri->display_area.top;
+    info.display_area.right = ri->display_area.right;
+    info.display_area.bottom = ri->display_area.bottom;
+    update_crop();
+
+    FakeDecodeSurface ds;
+    ds.is_decoded = false;
+    ds.seed = 0;
+    decode_surfaces.assign(info.ulNumDecodeSurfaces, ds);
+
+    unsigned int pitch = align_up((unsigned int)info.ulTargetWidth, FAKE_PITCH_ALIGNMENT);
+    for (size_t i = 0; i < output_surfaces.size(); ++i) {
+      output_surfaces[i].pitch = pitch;
+    }
+
+    return CUDA_SUCCESS;
+  }
+
+  CUresult FakeDecoder::decode(CUVIDPICPARAMS* pic) {
+
+    if (pic->CurrPicIdx < 0 || pic->CurrPicIdx >= (int)decode_surfaces.size()) {
+      printf("Invalid CurrPicIdx: %d, we have %zu decode surfaces.\n", pic->CurrPicIdx, decode_surfaces.size());
+      return CUDA_ERROR_INVALID_VALUE;
+    }
+
+    /* FNV-1a over the first bytes of the bitstream so the same stream gives the same output. */
+    uint32_t seed = 2166136261u;
+    unsigned int num_bytes = (pic->nBitstreamDataLen < 64) ? pic->nBitstreamDataLen : 64;
+
+    for (unsigned int i = 0; i < num_bytes; ++i) {
+      seed = (seed ^ pic->pBitstreamData[i]) * 16777619u;
+    }
+
+    std::unique_lock<std::mutex> lock;
+    if (nullptr != info.vidLock) {
+      lock = std::unique_lock<std::mutex>(*(std::mutex*)info.vidLock);
+    }
+
+    if (0 != info.ulIntraDecodeOnly && 0 == pic->intra_pic_flag) {
+      printf("The fake decoder was created for intra pictures only but got an inter picture.\n");
+      return CUDA_ERROR_INVALID_VALUE;
+    }
+
+    FakeDecodeSurface& ds = decode_surfaces[pic->CurrPicIdx];
+    ds.seed = seed ^ (uint32_t)pic->CodecSpecific.h264.CurrFieldOrderCnt[0];
+    ds.is_decoded = true;
+
+    return CUDA_SUCCESS;
+  }
+
+  CUresult FakeDecoder::map(int picture_index, CUdeviceptr* device_ptr, unsigned int* pitch) {
+
+    if (picture_index < 0 || picture_index >= (int)decode_surfaces.size()) {
+      return CUDA_ERROR_INVALID_VALUE;
+    }
+
+    if (false == decode_surfaces[picture_index].is_decoded) {
+      printf("Cannot map picture %d, it hasn't been decoded.\n", picture_index);
+      return CUDA_ERROR_INVALID_VALUE;
+    }
+
+    for (size_t i = 0; i < output_surfaces.size(); ++i) {
+
+      FakeOutputSurface& os = output_surfaces[i];
+      if (true == os.is_mapped) {
+        continue;
+      }
+
+      render(decode_surfaces[picture_index].seed, os);
+      os.is_mapped = true;
+
+      *device_ptr = (CUdeviceptr)(uintptr_t)os.data;
+      *pitch = os.pitch;
+
+      return CUDA_SUCCESS;
+    }
+
+    /* Like cuvid: you can't map more frames than ulNumOutputSurfaces at the same time. */
+    return CUDA_ERROR_OUT_OF_MEMORY;
+  }
+
+  CUresult FakeDecoder::unmap(CUdeviceptr device_ptr) {
+
+    for (size_t i = 0; i < output_surfaces.size(); ++i) {
+      FakeOutputSurface& os = output_surfaces[i];
+      if ((CUdeviceptr)(uintptr_t)os.data == device_ptr && true == os.is_mapped) {
+        os.is_mapped = false;
+        return CUDA_SUCCESS;
+      }
+    }
+
+    return CUDA_ERROR_INVALID_VALUE;
+  }
+
+  /* A decode surface is a NV12 picture of the max size with the pitch and height aligned like the hardware does. */
+  uint64_t FakeDecoder::get_device_nbytes() {
+
+    uint64_t pitch = align_up((unsigned int)max_width, FAKE_PITCH_ALIGNMENT);
+    uint64_t height = align_up((unsigned int)max_height, 16);
+    uint64_t decode_nbytes = max_decode_surfaces * pitch * (height + height / 2);
+    uint64_t output_nbytes = output_surfaces.size() * (uint64_t)output_surface_nbytes;
+    uint64_t motion_nbytes = 0;
+
+    if (0 == info.ulIntraDecodeOnly) {
+      uint64_t num_mbs = (uint64_t)(align_up((unsigned int)max_width, 16) / 16) * (height / 16);
+      motion_nbytes = max_decode_surfaces * num_mbs * FAKE_MOTION_VECTOR_NBYTES;
+    }
+
+    return decode_nbytes + output_nbytes + motion_nbytes;
+  }
+
+  /* When no display area is given we use the full coded size, like cuvid. */
+  void FakeDecoder::update_crop() {
+
+    crop_left = info.display_area.left;
+    crop_top = info.display_area.top;
+    crop_width = info.display_area.right - info.display_area.left;
+    crop_height = info.display_area.bottom - info.display_area.top;
+
+    if (crop_width <= 0 || crop_height <= 0) {
+      crop_left = 0;
+      crop_top = 0;
+      crop_width = (int)info.ulWidth;
+      crop_height = (int)info.ulHeight;
+    }
+  }
+
+  /*
+    Applies the display area and scales it into the target size
+    with a bilinear filter, like the post-processing on the GPU.
+    The scaler needs even sizes, so an odd display area loses
+    its last column or row when we scale.
+  */
+  void FakeDecoder::render(uint32_t seed, FakeOutputSurface& surface) {
+
+    int target_width = (int)info.ulTargetWidth;
+    int target_height = (int)info.ulTargetHeight;
+    uint8_t* luma = surface.data;
+    uint8_t* chroma = surface.data + (size_t)surface.pitch * target_height;
+
+    if (target_width == crop_width && target_height == crop_height) {
+      render_area(seed, luma, chroma, surface.pitch, target_width, target_height);
+      return;
+    }
+
+    int width = (crop_width < 2) ? 2 : (crop_width & ~1);
+    int height = (crop_height < 2) ? 2 : (crop_height & ~1);
+
+    unscaled.resize((size_t)width * (height + height / 2));
+    render_area(seed, unscaled.data(), unscaled.data() + (size_t)width * height, width, width, height);
+
+    ConvertSource src;
+    ConvertTarget dst;
+    convert_source_init(unscaled.data(), width, width, height, src);
+    dst.planes[0] = luma;
+    dst.planes[1] = chroma;
+    dst.planes[2] = nullptr;
+    dst.pitches[0] = surface.pitch;
+    dst.pitches[1] = surface.pitch;
+    dst.pitches[2] = 0;
+
+    if (0 != scaler.scale(src, dst, target_width, target_height)) {
+      printf("The fake decoder failed to scale %d x %d to %d x %d.\n", width, height, target_width, target_height);
+    }
+  }
+
+  /* The top left `width` x `height` of the display area. */
+  void FakeDecoder::render_area(uint32_t seed, uint8_t* luma, uint8_t* chroma, size_t pitch, int width, int height) {
+
+    int shift = (int)(seed & 0xFF);
+
+    for (int y = 0; y < height; ++y) {
+      int src_y = crop_top + y;
+      memcpy(luma + (size_t)y * pitch, &luma_pattern[(crop_left + src_y + shift) & 0xFF], width);
+    }
+
+    for (int y = 0; y < height / 2; ++y) {
+      int src_y = crop_top / 2 + y;
+      memcpy(chroma + (size_t)y * pitch, &chroma_pattern[2 * ((crop_left / 2 + src_y + shift) & 0xFF)], width);
+    }
+  }
+
+  /* ------------------------------------------------ */
+
+  static void* aligned_alloc_host(size_t nbytes) {
+
+#if defined(_WIN32)
+    return _aligned_malloc(nbytes, FAKE_HOST_ALIGNMENT);
+#else
+    void* ptr = nullptr;
+    if (0 != posix_memalign(&ptr, FAKE_HOST_ALIGNMENT, nbytes)) {
+      return nullptr;
+    }
+    return ptr;
+#endif
+  }
+
+  static void aligned_free_host(void* ptr) {
+
+    if (nullptr == ptr) {
+      return;
+    }
+
+#if defined(_WIN32)
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+  }
+
+  static unsigned int align_up(unsigned int v, unsigned int alignment) {
+    return ((v + alignment - 1) / alignment) * alignment;
+  }
+
+  static int greatest_common_divisor(int a, int b) {
+
+    while (0 != b) {
+      int t = a % b;
+      a = b;
+      b = t;
+    }
+
+    return (0 == a) ? 1 : a;
+  }
+
+  static void copy_2d(void* dst, size_t dst_pitch, const void* src, size_t src_pitch, size_t width, size_t height) {
+
+    /* Both sides packed: one memcpy. */
+    if (dst_pitch == width && src_pitch == width) {
+      memcpy(dst, src, width * height);
+      return;
+    }
+
+    uint8_t* d = (uint8_t*)dst;
+    const uint8_t* s = (const uint8_t*)src;
+
+    for (size_t i = 0; i < height; ++i) {
+      memcpy(d + i * dst_pitch, s + i * src_pitch, width);
+    }
+  }
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
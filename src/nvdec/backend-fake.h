@@ -0,0 +1,146 @@
+/*
+  FAKE BACKEND
+  ============
+
+  GENERAL INFO:
+
+    A DecodeBackend that runs on the CPU so we can test and
+    benchmark the host side of the decode pipeline on machines
+    without an NVIDIA GPU (e.g. CI).
+
+    Parser:  parses the SPS, PPS and slice headers (see h264.h)
+             and calls the sequence callback when the format
+             changes, the decode callback once a picture is
+             complete and the display callback in picture order
+             count order. Like the cuvid parser, a picture is
+             complete when we see the start of the next one or
+             when a packet has the CUVID_PKT_ENDOFPICTURE flag;
+             CUVID_PKT_ENDOFSTREAM flushes everything. The return
+             value of the sequence callback overrides
+             ulMaxNumDecodeSurfaces when it's > 1. Only
+             progressive (frame) coding is supported.
+
+    Decoder: we don't decode anything. A decode surface only
+             remembers a seed that we derive from the bitstream;
+             when a picture is mapped we render a NV12 gradient
+             for that seed into one of the `ulNumOutputSurfaces`
+             output surfaces, applying the display area and target
+             size like the hardware post-processing does. Output
+             surfaces have a pitch aligned to FAKE_PITCH_ALIGNMENT
+             bytes. The same bitstream always gives the same
+             pixels. The output surfaces are allocated for
+             ulMaxWidth x ulMaxHeight so reconfigure_decoder()
+             only changes the sizes, up to that max, like cuvid.
+             When created with a `vidLock` (see
+             get_context_lock()) a decoder holds that lock while
+             it decodes a picture, like cuvid does with the
+             context. get_memory_info() reports the device memory
+             minus what the decoders would allocate on a GPU:
+             their decode surfaces at the max size, the motion
+             vectors that inter prediction keeps per decode
+             surface and their output surfaces. A decoder
+             created with `ulIntraDecodeOnly` has no motion
+             vectors and fails on pictures that aren't intra.
+             create_decoder() fails with CUDA_ERROR_OUT_OF_MEMORY
+             when they don't fit.
+
+    Device:  use configure() before init() to give the fake
+             device a capacity (see FakeDeviceSettings): the
+             device memory and the time that one picture keeps
+             the decode engine busy. A device has one engine, so
+             the sessions on it wait for each other like they do
+             on one NVDEC; the engine sleeps so it doesn't take
+             CPU time. This is how we run several fake devices
+             with different capacities, e.g. to test the
+             SessionScheduler.
+
+    Streams: every stream has a thread that executes the async
+             copies and event records in the order they were
+             queued, so async copies really overlap with the
+             work on the calling thread. Work on the default
+             stream (nullptr) runs synchronously.
+
+ */
+#ifndef NVDEC_BACKEND_FAKE_H
+#define NVDEC_BACKEND_FAKE_H
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <nvdec/backend.h>
+
+#define FAKE_PITCH_ALIGNMENT 512   /* The pitch of the mapped surfaces is a multiple of this. */
+#define FAKE_MAX_WIDTH 4096
+#define FAKE_MAX_HEIGHT 4096
+#define FAKE_MAX_DECODE_SURFACES 32
+#define FAKE_MOTION_VECTOR_NBYTES 64   /* Per macroblock per decode surface, the co-located motion vectors of B and P pictures. */
+#define FAKE_DEVICE_MEMORY (8ull * 1024ull * 1024ull * 1024ull)  /* What get_memory_info() reports as the total by default. */
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  struct FakeDeviceSettings {
+    FakeDeviceSettings();
+    uint64_t memory_nbytes;               /* Total device memory; FAKE_DEVICE_MEMORY by default. */
+    uint64_t decode_ns;                   /* Time one picture keeps the decode engine busy; 0 by default. */
+  };
+
+  /* ------------------------------------------------ */
+
+  class FakeBackend : public DecodeBackend {
+  public:
+    FakeBackend();
+    ~FakeBackend();
+    int configure(const FakeDeviceSettings& cfg);                  /* Call before init(). */
+    int init(int device_index);
+    int shutdown();
+    int get_type();
+    std::string get_device_name();
+    const char* get_error_string(CUresult r);
+
+    CUresult push_context();
+    CUresult pop_context();
+    CUvideoctxlock get_context_lock();
+
+    CUresult create_parser(CUvideoparser* parser, CUVIDPARSERPARAMS* params);
+    CUresult parse_video_data(CUvideoparser parser, CUVIDSOURCEDATAPACKET* pkt);
+    CUresult destroy_parser(CUvideoparser parser);
+
+    CUresult get_decoder_caps(CUVIDDECODECAPS* caps);
+    CUresult create_decoder(CUvideodecoder* decoder, CUVIDDECODECREATEINFO* info);
+    CUresult destroy_decoder(CUvideodecoder decoder);
+    CUresult reconfigure_decoder(CUvideodecoder decoder, CUVIDRECONFIGUREDECODERINFO* info);
+    CUresult decode_picture(CUvideodecoder decoder, CUVIDPICPARAMS* pic);
+    CUresult map_video_frame(CUvideodecoder decoder, int picture_index, CUdeviceptr* device_ptr, unsigned int* pitch, CUVIDPROCPARAMS* vpp);
+    CUresult unmap_video_frame(CUvideodecoder decoder, CUdeviceptr device_ptr);
+
+    CUresult alloc_host(void** ptr, size_t nbytes);
+    CUresult free_host(void* ptr);
+    CUresult copy_to_host(void* dst, CUdeviceptr src, size_t nbytes);
+    CUresult copy_to_host_async(void* dst, CUdeviceptr src, size_t nbytes, CUstream stream);
+    CUresult copy_2d_to_host_async(void* dst, size_t dst_pitch, CUdeviceptr src, size_t src_pitch, size_t width, size_t height, CUstream stream);
+    CUresult get_memory_info(size_t* free_nbytes, size_t* total_nbytes);
+
+    CUresult create_stream(CUstream* stream);
+    CUresult destroy_stream(CUstream stream);
+    CUresult create_event(CUevent* event);
+    CUresult destroy_event(CUevent event);
+    CUresult record_event(CUevent event, CUstream stream);
+    CUresult query_event(CUevent event);
+    CUresult synchronize_event(CUevent event);
+
+  private:
+    int device_index;
+    bool is_init;
+    FakeDeviceSettings settings;
+    std::atomic<uint64_t> device_nbytes;  /* The "device" memory of all decoders that exist; see FakeDecoder::get_device_nbytes(). */
+    std::mutex context_lock;              /* Handed out as CUvideoctxlock; the decoders hold it while decoding. */
+    std::mutex engine_lock;               /* Held while a picture occupies the decode engine; see FakeDeviceSettings::decode_ns. */
+  };
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
+
+#endif
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <nvdec/backend.h>
+#include <nvdec/backend-fake.h>
+
+#if defined(USE_CUVID)
+#  include <nvdec/backend-cuvid.h>
+#endif
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  DecodeBackend* backend_create(int type) {
+
+    switch (type) {
+#if defined(USE_CUVID)
+      case BACKEND_TYPE_CUVID: {
+        return new CuvidBackend();
+      }
+#endif
+      case BACKEND_TYPE_FAKE: {
+        return new FakeBackend();
+      }
+      default: {
+        printf("Cannot create a decode backend for type %d (%s).\n", type, backend_type_to_string(type));
+        return nullptr;
+      }
+    }
+  }
+
+  int backend_get_default_type() {
+#if defined(USE_CUVID)
+    return BACKEND_TYPE_CUVID;
+#else
+    return BACKEND_TYPE_FAKE;
+#endif
+  }
+
+  int backend_get_device_count(int type) {
+
+    switch (type) {
+#if defined(USE_CUVID)
+      case BACKEND_TYPE_CUVID: {
+        return CuvidBackend::get_device_count();
+      }
+#endif
+      case BACKEND_TYPE_FAKE: {
+        return 1;
+      }
+      default: {
+        printf("Cannot get the device count for backend type %d (%s).\n", type, backend_type_to_string(type));
+        return -1;
+      }
+    }
+  }
+
+  int backend_type_from_string(const std::string& name) {
+
+    if ("cuvid" == name) {
+      return BACKEND_TYPE_CUVID;
+    }
+
+    if ("fake" == name) {
+      return BACKEND_TYPE_FAKE;
+    }
+
+    return BACKEND_TYPE_NONE;
+  }
+
+  const char* backend_type_to_string(int type) {
+
+    switch (type) {
+      case BACKEND_TYPE_CUVID: { return "cuvid"; }
+      case BACKEND_TYPE_FAKE:  { return "fake";  }
+      default:                 { return "none";  }
+    }
+  }
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
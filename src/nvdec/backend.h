@@ -0,0 +1,125 @@
+/*
+  DECODE BACKEND
+  ==============
+
+  GENERAL INFO:
+
+    The DecodeBackend wraps the cuvid and cu functions that the
+    decode experiments use: creating a parser, creating a
+    decoder, decoding, mapping and unmapping pictures and copying
+    them to host memory, (a)synchronously using streams and
+    events. The functions have the same arguments
+    and return values as the functions they wrap so the code that
+    uses a backend reads the same as the code in v0..v3.
+
+    BACKEND_TYPE_CUVID: calls into nvcuvid and the cuda driver
+                        API; one backend is one device with one
+                        context. Only available when we're
+                        compiled with USE_CUVID.
+
+    One backend can be used by several threads at the same time,
+    e.g. one per decode session (see decode-session.h); the
+    calls push the context on the calling thread and the
+    decoders share the context lock from get_context_lock().
+
+    BACKEND_TYPE_FAKE:  a CPU-only stand-in that doesn't need a
+                        GPU. The parser parses the SPS, PPS and
+                        slice headers and calls the sequence,
+                        decode and display callbacks in the same
+                        order as the cuvid parser (including
+                        reordering on the picture order count).
+                        The decoder fills NV12 surfaces with a
+                        pattern and hands them out with a pitch
+                        that's aligned like the hardware does.
+                        "Device" pointers are host pointers. Use
+                        this to test and benchmark everything that
+                        happens on the host.
+
+  USAGE:
+
+    DecodeBackend* backend = backend_create(BACKEND_TYPE_FAKE);
+    backend->init(0);
+
+    CUvideoparser parser = nullptr;
+    r = backend->create_parser(&parser, &parser_params);
+    ...
+
+    backend->shutdown();
+    delete backend;
+
+    Use a SessionScheduler (see session-scheduler.h) to create
+    one backend per device and place sessions on them.
+
+ */
+#ifndef NVDEC_BACKEND_H
+#define NVDEC_BACKEND_H
+
+#include <string>
+#include <NvDecoder/nvcuvid.h>
+#include <NvDecoder/cuviddec.h>
+
+#define BACKEND_TYPE_NONE 0
+#define BACKEND_TYPE_CUVID 1
+#define BACKEND_TYPE_FAKE 2
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  class DecodeBackend {
+  public:
+    virtual ~DecodeBackend() {}
+    virtual int init(int device_index) = 0;                                          /* Creates the context for the given device. Returns 0 on success. */
+    virtual int shutdown() = 0;
+    virtual int get_type() = 0;
+    virtual std::string get_device_name() = 0;
+    virtual const char* get_error_string(CUresult r) = 0;
+
+    /* Context */
+    virtual CUresult push_context() = 0;
+    virtual CUresult pop_context() = 0;
+    virtual CUvideoctxlock get_context_lock() = 0;                                   /* Created in init(); pass it as CUVIDDECODECREATEINFO::vidLock when several threads use the context. */
+
+    /* Parser */
+    virtual CUresult create_parser(CUvideoparser* parser, CUVIDPARSERPARAMS* params) = 0;
+    virtual CUresult parse_video_data(CUvideoparser parser, CUVIDSOURCEDATAPACKET* pkt) = 0;
+    virtual CUresult destroy_parser(CUvideoparser parser) = 0;
+
+    /* Decoder */
+    virtual CUresult get_decoder_caps(CUVIDDECODECAPS* caps) = 0;
+    virtual CUresult create_decoder(CUvideodecoder* decoder, CUVIDDECODECREATEINFO* info) = 0;
+    virtual CUresult destroy_decoder(CUvideodecoder decoder) = 0;
+    virtual CUresult reconfigure_decoder(CUvideodecoder decoder, CUVIDRECONFIGUREDECODERINFO* info) = 0;  /* Changes the size without re-allocating; the new size must fit in ulMaxWidth x ulMaxHeight and ulNumDecodeSurfaces of the create info. */
+    virtual CUresult decode_picture(CUvideodecoder decoder, CUVIDPICPARAMS* pic) = 0;
+    virtual CUresult map_video_frame(CUvideodecoder decoder, int picture_index, CUdeviceptr* device_ptr, unsigned int* pitch, CUVIDPROCPARAMS* vpp) = 0;
+    virtual CUresult unmap_video_frame(CUvideodecoder decoder, CUdeviceptr device_ptr) = 0;
+
+    /* Memory */
+    virtual CUresult alloc_host(void** ptr, size_t nbytes) = 0;                     /* Page-locked memory for the cuvid backend. */
+    virtual CUresult free_host(void* ptr) = 0;
+    virtual CUresult copy_to_host(void* dst, CUdeviceptr src, size_t nbytes) = 0;
+    virtual CUresult copy_to_host_async(void* dst, CUdeviceptr src, size_t nbytes, CUstream stream) = 0;  /* `dst` must be allocated with alloc_host(). */
+    virtual CUresult copy_2d_to_host_async(void* dst, size_t dst_pitch, CUdeviceptr src, size_t src_pitch, size_t width, size_t height, CUstream stream) = 0;  /* Copies `height` rows of `width` bytes, e.g. to strip the pitch. */
+    virtual CUresult get_memory_info(size_t* free_nbytes, size_t* total_nbytes) = 0;  /* Free and total device memory, like cuMemGetInfo(). */
+
+    /* Streams and events */
+    virtual CUresult create_stream(CUstream* stream) = 0;                           /* Creates a stream that doesn't synchronize with the default stream. */
+    virtual CUresult destroy_stream(CUstream stream) = 0;
+    virtual CUresult create_event(CUevent* event) = 0;
+    virtual CUresult destroy_event(CUevent event) = 0;
+    virtual CUresult record_event(CUevent event, CUstream stream) = 0;
+    virtual CUresult query_event(CUevent event) = 0;                                 /* Returns CUDA_SUCCESS when all work before the event is done, CUDA_ERROR_NOT_READY when not. */
+    virtual CUresult synchronize_event(CUevent event) = 0;                           /* Blocks until all work before the event is done. */
+  };
+
+  /* ------------------------------------------------ */
+
+  DecodeBackend* backend_create(int type);
+  int backend_get_default_type();                                                   /* BACKEND_TYPE_CUVID when compiled in, otherwise BACKEND_TYPE_FAKE. */
+  int backend_get_device_count(int type);                                           /* The device indices init() accepts, < 0 on error. The fake backend has one per backend you create; we return 1. */
+  int backend_type_from_string(const std::string& name);                            /* Returns BACKEND_TYPE_NONE for unknown names. */
+  const char* backend_type_to_string(int type);
+
+} /* namespace nvdec */
+
+#endif
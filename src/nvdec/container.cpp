@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <string.h>
+#include <nvdec/container.h>
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  static uint64_t greatest_common_divisor(uint64_t a, uint64_t b);
+
+  /* ------------------------------------------------ */
+
+  /*
+    The parser gives us the display aspect ratio; the pixel
+    aspect ratio is that divided by the aspect ratio of the
+    output. `width` x `height` show the whole display area, so
+    when we scale it non-uniformly the pixels change shape too.
+  */
+  int container_get_stream_info(const CUVIDEOFORMAT* fmt, int width, int height, ContainerStreamInfo& result) {
+
+    if (nullptr == fmt) {
+      printf("Cannot get the container stream info, the given format is nullptr.\n");
+      return -1;
+    }
+
+    if (width <= 0 || height <= 0) {
+      printf("Cannot get the container stream info, invalid size %d x %d.\n", width, height);
+      return -2;
+    }
+
+    memset((char*)&result, 0x00, sizeof(result));
+    result.width = width;
+    result.height = height;
+    result.is_progressive = (0 != fmt->progressive_sequence);
+    result.is_full_range = (0 != fmt->video_signal_description.video_full_range_flag);
+
+    result.fps_num = CONTAINER_DEFAULT_FPS_NUM;
+    result.fps_den = CONTAINER_DEFAULT_FPS_DEN;
+    if (0 != fmt->frame_rate.numerator && 0 != fmt->frame_rate.denominator) {
+      result.fps_num = fmt->frame_rate.numerator;
+      result.fps_den = fmt->frame_rate.denominator;
+    }
+
+    if (fmt->display_aspect_ratio.x > 0
+        && fmt->display_aspect_ratio.y > 0)
+      {
+        uint64_t num = (uint64_t)fmt->display_aspect_ratio.x * (uint64_t)height;
+        uint64_t den = (uint64_t)fmt->display_aspect_ratio.y * (uint64_t)width;
+        uint64_t gcd = greatest_common_divisor(num, den);
+        result.sar_num = (uint32_t)(num / gcd);
+        result.sar_den = (uint32_t)(den / gcd);
+      }
+
+    return 0;
+  }
+
+  bool container_stream_info_equals(const ContainerStreamInfo& a, const ContainerStreamInfo& b) {
+    return a.width == b.width
+      && a.height == b.height
+      && a.fps_num == b.fps_num
+      && a.fps_den == b.fps_den
+      && a.sar_num == b.sar_num
+      && a.sar_den == b.sar_den
+      && a.is_progressive == b.is_progressive
+      && a.is_full_range == b.is_full_range;
+  }
+
+  /*
+    H264 puts the chroma samples between the two luma rows, left
+    aligned (chroma_sample_loc_type 0), which is what Y4M calls
+    420mpeg2. We don't know the field order of interlaced
+    content, so we use '?'. XCOLORRANGE is the extension that
+    ffmpeg reads and writes.
+  */
+  int container_get_y4m_stream_header(const ContainerStreamInfo& info, std::string& result) {
+
+    char header[CONTAINER_MAX_HEADER_NBYTES];
+
+    int r = snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%u:%u I%c A%u:%u C420mpeg2 XCOLORRANGE=%s\n",
+                     info.width,
+                     info.height,
+                     info.fps_num,
+                     info.fps_den,
+                     (true == info.is_progressive) ? 'p' : '?',
+                     info.sar_num,
+                     info.sar_den,
+                     (true == info.is_full_range) ? "FULL" : "LIMITED");
+
+    if (r < 0 || (size_t)r + strlen(CONTAINER_Y4M_FRAME_HEADER) > sizeof(header)) {
+      printf("Cannot create the Y4M stream header, it doesn't fit in %d bytes.\n", CONTAINER_MAX_HEADER_NBYTES);
+      return -1;
+    }
+
+    result.assign(header, (size_t)r);
+
+    return 0;
+  }
+
+  int container_type_from_string(const std::string& name) {
+
+    if ("raw" == name) {
+      return CONTAINER_TYPE_RAW;
+    }
+
+    if ("y4m" == name) {
+      return CONTAINER_TYPE_Y4M;
+    }
+
+    return CONTAINER_TYPE_NONE;
+  }
+
+  const char* container_type_to_string(int type) {
+
+    switch (type) {
+      case CONTAINER_TYPE_RAW: { return "raw";  }
+      case CONTAINER_TYPE_Y4M: { return "y4m";  }
+      default:                 { return "none"; }
+    }
+  }
+
+  /* ------------------------------------------------ */
+
+  static uint64_t greatest_common_divisor(uint64_t a, uint64_t b) {
+
+    while (0 != b) {
+      uint64_t t = a % b;
+      a = b;
+      b = t;
+    }
+
+    return a;
+  }
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
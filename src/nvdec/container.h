@@ -0,0 +1,84 @@
+/*
+  CONTAINER
+  =========
+
+  GENERAL INFO:
+
+    What we wrap the decoded pictures in when we write them.
+
+      CONTAINER_TYPE_RAW:  the bare pictures, back to back. The
+                           reader must know the size and format,
+                           and a file with a resolution change
+                           can't be played.
+
+      CONTAINER_TYPE_Y4M:  YUV4MPEG2. Every file starts with a
+                           stream header with the size, frame
+                           rate, pixel aspect ratio, interlacing,
+                           chroma siting and range, and every
+                           picture with a "FRAME" line, so
+                           ffplay/ffmpeg/x264 read it without
+                           extra options. Y4M only has planar
+                           formats, so we write I420.
+
+    The headers are small so the DecodeSession renders them into
+    the room it keeps in front of every picture, and the writer
+    writes header and picture with one write without copying
+    the picture. A Y4M file can't change its format, so when
+    the stream info changes the session starts a new segment: a
+    new file next to the first one (see
+    frame_writer_get_segment_path()), which starts with its own
+    stream header.
+
+  USAGE:
+
+    ContainerStreamInfo info;
+    container_get_stream_info(fmt, fmt->coded_width, fmt->coded_height, info);
+
+    std::string header;
+    container_get_y4m_stream_header(info, header);
+
+ */
+#ifndef NVDEC_CONTAINER_H
+#define NVDEC_CONTAINER_H
+
+#include <stdint.h>
+#include <string>
+#include <NvDecoder/nvcuvid.h>
+
+#define CONTAINER_TYPE_NONE 0
+#define CONTAINER_TYPE_RAW 1
+#define CONTAINER_TYPE_Y4M 2
+
+#define CONTAINER_MAX_HEADER_NBYTES 256          /* The room we keep in front of a picture for the stream and frame headers. */
+#define CONTAINER_Y4M_FRAME_HEADER "FRAME\n"
+#define CONTAINER_DEFAULT_FPS_NUM 25             /* When the stream doesn't have timing info. */
+#define CONTAINER_DEFAULT_FPS_DEN 1
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  struct ContainerStreamInfo {
+    int width;                                   /* The size of the pictures we write. */
+    int height;
+    uint32_t fps_num;
+    uint32_t fps_den;
+    uint32_t sar_num;                            /* Pixel aspect ratio; 0:0 when unknown. */
+    uint32_t sar_den;
+    bool is_progressive;
+    bool is_full_range;
+  };
+
+  /* ------------------------------------------------ */
+
+  int container_get_stream_info(const CUVIDEOFORMAT* fmt, int width, int height, ContainerStreamInfo& result);
+  bool container_stream_info_equals(const ContainerStreamInfo& a, const ContainerStreamInfo& b);
+  int container_get_y4m_stream_header(const ContainerStreamInfo& info, std::string& result);
+  int container_type_from_string(const std::string& name);            /* Returns CONTAINER_TYPE_NONE for unknown names. */
+  const char* container_type_to_string(int type);
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
+
+#endif
@@ -0,0 +1,166 @@
+/*
+  Only this file is compiled with AVX2 enabled; convert.cpp
+  only calls into it when the CPU supports AVX2. The math is
+  the same as convert_row_rgb_scalar(), see convert.h.
+*/
+#include <string.h>
+#include <nvdec/convert.h>
+
+#if defined(USE_AVX2)
+
+#include <immintrin.h>
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  static void convert_row_rgb_avx2(const uint8_t* y, const uint8_t* uv, uint8_t* dst, const ConvertCoefficients& k, int format, int width);
+  static void convert_row_deinterleave_avx2(const uint8_t* uv, uint8_t* u, uint8_t* v, int num_samples);
+
+  /* ------------------------------------------------ */
+
+  void convert_rows_avx2(const ConvertSource& src, const ConvertTarget& dst, const ConvertCoefficients& k, int format, int y_start, int y_end) {
+
+    int chroma_width = (src.width + 1) / 2;
+
+    for (int j = y_start; j < y_end; ++j) {
+
+      const uint8_t* y = src.y + (size_t)j * src.y_pitch;
+      const uint8_t* uv = src.uv + (size_t)(j / 2) * src.uv_pitch;
+
+      switch (format) {
+
+        case CONVERT_FORMAT_NV12: {
+          memcpy(dst.planes[0] + (size_t)j * dst.pitches[0], y, src.width);
+          if (0 == (j & 1)) {
+            memcpy(dst.planes[1] + (size_t)(j / 2) * dst.pitches[1], uv, (size_t)chroma_width * 2);
+          }
+          break;
+        }
+
+        case CONVERT_FORMAT_I420: {
+          memcpy(dst.planes[0] + (size_t)j * dst.pitches[0], y, src.width);
+          if (0 == (j & 1)) {
+            convert_row_deinterleave_avx2(uv,
+                                          dst.planes[1] + (size_t)(j / 2) * dst.pitches[1],
+                                          dst.planes[2] + (size_t)(j / 2) * dst.pitches[2],
+                                          chroma_width);
+          }
+          break;
+        }
+
+        case CONVERT_FORMAT_RGB24:
+        case CONVERT_FORMAT_BGRA: {
+          convert_row_rgb_avx2(y, uv, dst.planes[0] + (size_t)j * dst.pitches[0], k, format, src.width);
+          break;
+        }
+      }
+    }
+  }
+
+  /* ------------------------------------------------ */
+
+  /*
+    16 pixels per iteration: the 16 luma samples and the 8 U/V
+    pairs they share are widened to 16 bit, so one 256 bit
+    register holds one channel of all 16 pixels. Saturating adds
+    are enough to stay exact: only the blue channel can
+    overflow, and then it's clamped to 255 anyway.
+  */
+  static void convert_row_rgb_avx2(const uint8_t* y, const uint8_t* uv, uint8_t* dst, const ConvertCoefficients& k, int format, int width) {
+
+    const __m128i dup_u = _mm_setr_epi8(0, 0, 2, 2, 4, 4, 6, 6, 8, 8, 10, 10, 12, 12, 14, 14);
+    const __m128i dup_v = _mm_setr_epi8(1, 1, 3, 3, 5, 5, 7, 7, 9, 9, 11, 11, 13, 13, 15, 15);
+    const __m128i drop_alpha = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m256i y_offset = _mm256_set1_epi16(k.y_offset);
+    const __m256i y_scale = _mm256_set1_epi16(k.y_scale);
+    const __m256i half = _mm256_set1_epi16(1 << (CONVERT_FRACTION_BITS - 1));
+    const __m256i chroma_offset = _mm256_set1_epi16(128);
+    const __m256i v_to_r = _mm256_set1_epi16(k.v_to_r);
+    const __m256i u_to_g = _mm256_set1_epi16(k.u_to_g);
+    const __m256i v_to_g = _mm256_set1_epi16(k.v_to_g);
+    const __m256i u_to_b = _mm256_set1_epi16(k.u_to_b);
+    const __m256i alpha = _mm256_set1_epi16(255);
+
+    /* A RGB24 store writes 4 bytes past the 16 pixels, which must still be ours. */
+    int num_channels = (CONVERT_FORMAT_BGRA == format) ? 4 : 3;
+    int x_end = (CONVERT_FORMAT_BGRA == format) ? (width & ~15) : ((width - 2) & ~15);
+    int x = 0;
+
+    for (x = 0; x < x_end; x += 16) {
+
+      __m128i y8 = _mm_loadu_si128((const __m128i*)(y + x));
+      __m128i uv8 = _mm_loadu_si128((const __m128i*)(uv + x));
+
+      __m256i yy = _mm256_cvtepu8_epi16(y8);
+      __m256i u = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_shuffle_epi8(uv8, dup_u)), chroma_offset);
+      __m256i v = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_shuffle_epi8(uv8, dup_v)), chroma_offset);
+
+      yy = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(yy, y_offset), y_scale), half);
+
+      __m256i r = _mm256_adds_epi16(yy, _mm256_mullo_epi16(v, v_to_r));
+      __m256i g = _mm256_subs_epi16(_mm256_subs_epi16(yy, _mm256_mullo_epi16(u, u_to_g)), _mm256_mullo_epi16(v, v_to_g));
+      __m256i b = _mm256_adds_epi16(yy, _mm256_mullo_epi16(u, u_to_b));
+
+      r = _mm256_srai_epi16(r, CONVERT_FRACTION_BITS);
+      g = _mm256_srai_epi16(g, CONVERT_FRACTION_BITS);
+      b = _mm256_srai_epi16(b, CONVERT_FRACTION_BITS);
+
+      /* packus works per 128 bit lane; the permute puts the 16 bytes of each channel together. */
+      __m256i rg = _mm256_permute4x64_epi64(_mm256_packus_epi16(r, g), 0xD8);
+      __m256i ba = _mm256_permute4x64_epi64(_mm256_packus_epi16(b, alpha), 0xD8);
+      __m128i r8 = _mm256_castsi256_si128(rg);
+      __m128i g8 = _mm256_extracti128_si256(rg, 1);
+      __m128i b8 = _mm256_castsi256_si128(ba);
+      __m128i a8 = _mm256_extracti128_si256(ba, 1);
+
+      uint8_t* out = dst + (size_t)x * num_channels;
+
+      if (CONVERT_FORMAT_BGRA == format) {
+        __m128i bg_lo = _mm_unpacklo_epi8(b8, g8);
+        __m128i bg_hi = _mm_unpackhi_epi8(b8, g8);
+        __m128i ra_lo = _mm_unpacklo_epi8(r8, a8);
+        __m128i ra_hi = _mm_unpackhi_epi8(r8, a8);
+        _mm_storeu_si128((__m128i*)(out + 0), _mm_unpacklo_epi16(bg_lo, ra_lo));
+        _mm_storeu_si128((__m128i*)(out + 16), _mm_unpackhi_epi16(bg_lo, ra_lo));
+        _mm_storeu_si128((__m128i*)(out + 32), _mm_unpacklo_epi16(bg_hi, ra_hi));
+        _mm_storeu_si128((__m128i*)(out + 48), _mm_unpackhi_epi16(bg_hi, ra_hi));
+      }
+      else {
+        /* Build RGBA and drop the A; every store overwrites the 4 garbage bytes of the previous one. */
+        __m128i rg_lo = _mm_unpacklo_epi8(r8, g8);
+        __m128i rg_hi = _mm_unpackhi_epi8(r8, g8);
+        __m128i ba_lo = _mm_unpacklo_epi8(b8, a8);
+        __m128i ba_hi = _mm_unpackhi_epi8(b8, a8);
+        _mm_storeu_si128((__m128i*)(out + 0), _mm_shuffle_epi8(_mm_unpacklo_epi16(rg_lo, ba_lo), drop_alpha));
+        _mm_storeu_si128((__m128i*)(out + 12), _mm_shuffle_epi8(_mm_unpackhi_epi16(rg_lo, ba_lo), drop_alpha));
+        _mm_storeu_si128((__m128i*)(out + 24), _mm_shuffle_epi8(_mm_unpacklo_epi16(rg_hi, ba_hi), drop_alpha));
+        _mm_storeu_si128((__m128i*)(out + 36), _mm_shuffle_epi8(_mm_unpackhi_epi16(rg_hi, ba_hi), drop_alpha));
+      }
+    }
+
+    convert_row_rgb_scalar(y, uv, dst, k, format, x, width);
+  }
+
+  /* 16 U/V pairs per iteration: split them per lane, then gather the U and V halves of both lanes. */
+  static void convert_row_deinterleave_avx2(const uint8_t* uv, uint8_t* u, uint8_t* v, int num_samples) {
+
+    const __m256i split = _mm256_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15,
+                                           0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+    int i = 0;
+
+    for (i = 0; i + 16 <= num_samples; i += 16) {
+      __m256i pairs = _mm256_loadu_si256((const __m256i*)(uv + i * 2));
+      __m256i planar = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(pairs, split), 0xD8);
+      _mm_storeu_si128((__m128i*)(u + i), _mm256_castsi256_si128(planar));
+      _mm_storeu_si128((__m128i*)(v + i), _mm256_extracti128_si256(planar, 1));
+    }
+
+    convert_row_deinterleave_scalar(uv, u, v, i, num_samples);
+  }
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
+
+#endif
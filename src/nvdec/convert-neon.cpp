@@ -0,0 +1,141 @@
+/*
+  The NEON kernels; compiled for 64 bit ARM where NEON is
+  always available. The math is the same as
+  convert_row_rgb_scalar(), see convert.h.
+*/
+#include <string.h>
+#include <nvdec/convert.h>
+
+#if defined(USE_NEON)
+
+#include <arm_neon.h>
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  static void convert_row_rgb_neon(const uint8_t* y, const uint8_t* uv, uint8_t* dst, const ConvertCoefficients& k, int format, int width);
+  static void convert_row_deinterleave_neon(const uint8_t* uv, uint8_t* u, uint8_t* v, int num_samples);
+
+  /* ------------------------------------------------ */
+
+  void convert_rows_neon(const ConvertSource& src, const ConvertTarget& dst, const ConvertCoefficients& k, int format, int y_start, int y_end) {
+
+    int chroma_width = (src.width + 1) / 2;
+
+    for (int j = y_start; j < y_end; ++j) {
+
+      const uint8_t* y = src.y + (size_t)j * src.y_pitch;
+      const uint8_t* uv = src.uv + (size_t)(j / 2) * src.uv_pitch;
+
+      switch (format) {
+
+        case CONVERT_FORMAT_NV12: {
+          memcpy(dst.planes[0] + (size_t)j * dst.pitches[0], y, src.width);
+          if (0 == (j & 1)) {
+            memcpy(dst.planes[1] + (size_t)(j / 2) * dst.pitches[1], uv, (size_t)chroma_width * 2);
+          }
+          break;
+        }
+
+        case CONVERT_FORMAT_I420: {
+          memcpy(dst.planes[0] + (size_t)j * dst.pitches[0], y, src.width);
+          if (0 == (j & 1)) {
+            convert_row_deinterleave_neon(uv,
+                                          dst.planes[1] + (size_t)(j / 2) * dst.pitches[1],
+                                          dst.planes[2] + (size_t)(j / 2) * dst.pitches[2],
+                                          chroma_width);
+          }
+          break;
+        }
+
+        case CONVERT_FORMAT_RGB24:
+        case CONVERT_FORMAT_BGRA: {
+          convert_row_rgb_neon(y, uv, dst.planes[0] + (size_t)j * dst.pitches[0], k, format, src.width);
+          break;
+        }
+      }
+    }
+  }
+
+  /* ------------------------------------------------ */
+
+  /* Converts 8 pixels that are widened to 16 bit, like the AVX2 kernel does. */
+  static inline void convert_pixels_neon(int16x8_t yy, int16x8_t u, int16x8_t v, const ConvertCoefficients& k,
+                                         uint8x8_t& r, uint8x8_t& g, uint8x8_t& b)
+  {
+    yy = vaddq_s16(vmulq_n_s16(vsubq_s16(yy, vdupq_n_s16(k.y_offset)), k.y_scale), vdupq_n_s16(1 << (CONVERT_FRACTION_BITS - 1)));
+
+    int16x8_t r16 = vqaddq_s16(yy, vmulq_n_s16(v, k.v_to_r));
+    int16x8_t g16 = vqsubq_s16(vqsubq_s16(yy, vmulq_n_s16(u, k.u_to_g)), vmulq_n_s16(v, k.v_to_g));
+    int16x8_t b16 = vqaddq_s16(yy, vmulq_n_s16(u, k.u_to_b));
+
+    r = vqmovun_s16(vshrq_n_s16(r16, CONVERT_FRACTION_BITS));
+    g = vqmovun_s16(vshrq_n_s16(g16, CONVERT_FRACTION_BITS));
+    b = vqmovun_s16(vshrq_n_s16(b16, CONVERT_FRACTION_BITS));
+  }
+
+  /* 16 pixels per iteration; vld2 splits the U and V and vzip repeats every chroma sample for two pixels. */
+  static void convert_row_rgb_neon(const uint8_t* y, const uint8_t* uv, uint8_t* dst, const ConvertCoefficients& k, int format, int width) {
+
+    const int16x8_t chroma_offset = vdupq_n_s16(128);
+    int x = 0;
+
+    for (x = 0; x + 16 <= width; x += 16) {
+
+      uint8x16_t y8 = vld1q_u8(y + x);
+      uint8x8x2_t uv8 = vld2_u8(uv + x);
+      uint8x8x2_t u8 = vzip_u8(uv8.val[0], uv8.val[0]);
+      uint8x8x2_t v8 = vzip_u8(uv8.val[1], uv8.val[1]);
+
+      uint8x8_t r_lo, g_lo, b_lo;
+      uint8x8_t r_hi, g_hi, b_hi;
+
+      convert_pixels_neon(vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(y8))),
+                          vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(u8.val[0])), chroma_offset),
+                          vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(v8.val[0])), chroma_offset),
+                          k, r_lo, g_lo, b_lo);
+
+      convert_pixels_neon(vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(y8))),
+                          vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(u8.val[1])), chroma_offset),
+                          vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(v8.val[1])), chroma_offset),
+                          k, r_hi, g_hi, b_hi);
+
+      if (CONVERT_FORMAT_BGRA == format) {
+        uint8x16x4_t bgra;
+        bgra.val[0] = vcombine_u8(b_lo, b_hi);
+        bgra.val[1] = vcombine_u8(g_lo, g_hi);
+        bgra.val[2] = vcombine_u8(r_lo, r_hi);
+        bgra.val[3] = vdupq_n_u8(255);
+        vst4q_u8(dst + (size_t)x * 4, bgra);
+      }
+      else {
+        uint8x16x3_t rgb;
+        rgb.val[0] = vcombine_u8(r_lo, r_hi);
+        rgb.val[1] = vcombine_u8(g_lo, g_hi);
+        rgb.val[2] = vcombine_u8(b_lo, b_hi);
+        vst3q_u8(dst + (size_t)x * 3, rgb);
+      }
+    }
+
+    convert_row_rgb_scalar(y, uv, dst, k, format, x, width);
+  }
+
+  static void convert_row_deinterleave_neon(const uint8_t* uv, uint8_t* u, uint8_t* v, int num_samples) {
+
+    int i = 0;
+
+    for (i = 0; i + 16 <= num_samples; i += 16) {
+      uint8x16x2_t planar = vld2q_u8(uv + i * 2);
+      vst1q_u8(u + i, planar.val[0]);
+      vst1q_u8(v + i, planar.val[1]);
+    }
+
+    convert_row_deinterleave_scalar(uv, u, v, i, num_samples);
+  }
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
+
+#endif
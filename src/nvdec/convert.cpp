@@ -0,0 +1,615 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <nvdec/convert.h>
+
+#if defined(_MSC_VER) && defined(USE_AVX2)
+#  include <intrin.h>
+#  include <immintrin.h>
+#endif
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  static uint8_t clamp_pixel(int v);
+  static int16_t to_fixed(double v);
+
+  /* ------------------------------------------------ */
+
+  ConvertSettings::ConvertSettings()
+    :format(CONVERT_FORMAT_NV12)
+    ,matrix(CONVERT_MATRIX_BT601)
+    ,range(CONVERT_RANGE_LIMITED)
+    ,isa(CONVERT_ISA_NONE)
+    ,num_threads(1)
+  {
+  }
+
+  /* ------------------------------------------------ */
+
+  Converter::Converter()
+    :convert_rows(nullptr)
+    ,generation(0)
+    ,num_pending(0)
+    ,must_stop(false)
+    ,job_src(nullptr)
+    ,job_dst(nullptr)
+    ,is_init(false)
+  {
+    memset((char*)&coefficients, 0x00, sizeof(coefficients));
+  }
+
+  Converter::~Converter() {
+    shutdown();
+  }
+
+  int Converter::init(const ConvertSettings& cfg) {
+
+    if (true == is_init) {
+      printf("Cannot initialize the converter, already initialized. Call shutdown() first.\n");
+      return -1;
+    }
+
+    if (CONVERT_FORMAT_NV12 != cfg.format
+        && CONVERT_FORMAT_I420 != cfg.format
+        && CONVERT_FORMAT_RGB24 != cfg.format
+        && CONVERT_FORMAT_BGRA != cfg.format)
+      {
+        printf("Cannot initialize the converter, invalid format %d.\n", cfg.format);
+        return -2;
+      }
+
+    if (cfg.num_threads <= 0) {
+      printf("Cannot initialize the converter, invalid number of threads %d.\n", cfg.num_threads);
+      return -3;
+    }
+
+    if (0 != convert_get_coefficients(cfg.matrix, cfg.range, coefficients)) {
+      printf("Cannot initialize the converter, invalid matrix (%d) or range (%d).\n", cfg.matrix, cfg.range);
+      return -4;
+    }
+
+    settings = cfg;
+    if (CONVERT_ISA_NONE == settings.isa) {
+      settings.isa = convert_get_best_isa();
+    }
+
+    convert_rows = convert_get_rows_func(settings.isa);
+    if (nullptr == convert_rows) {
+      printf("Cannot initialize the converter, %s is not supported by this build or CPU.\n", convert_isa_to_string(settings.isa));
+      return -5;
+    }
+
+    generation = 0;
+    num_pending = 0;
+    must_stop = false;
+
+    for (int i = 1; i < settings.num_threads; ++i) {
+      threads.push_back(std::thread(&Converter::run, this, i));
+    }
+
+    is_init = true;
+
+    return 0;
+  }
+
+  int Converter::shutdown() {
+
+    if (false == is_init) {
+      return 0;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      must_stop = true;
+    }
+
+    start_cv.notify_all();
+
+    for (size_t i = 0; i < threads.size(); ++i) {
+      if (true == threads[i].joinable()) {
+        threads[i].join();
+      }
+    }
+
+    threads.clear();
+    convert_rows = nullptr;
+    is_init = false;
+
+    return 0;
+  }
+
+  int Converter::convert(const ConvertSource& src, const ConvertTarget& dst) {
+
+    if (false == is_init) {
+      printf("Cannot convert, the converter is not initialized.\n");
+      return -1;
+    }
+
+    if (nullptr == src.y || nullptr == src.uv || src.width <= 0 || src.height <= 0) {
+      printf("Cannot convert, invalid source.\n");
+      return -2;
+    }
+
+    if (nullptr == dst.planes[0]
+        || (CONVERT_FORMAT_NV12 == settings.format && nullptr == dst.planes[1])
+        || (CONVERT_FORMAT_I420 == settings.format && (nullptr == dst.planes[1] || nullptr == dst.planes[2])))
+      {
+        printf("Cannot convert, the target misses a plane for %s.\n", convert_format_to_string(settings.format));
+        return -3;
+      }
+
+    if (true == threads.empty()) {
+      convert_rows(src, dst, coefficients, settings.format, 0, src.height);
+      return 0;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      job_src = &src;
+      job_dst = &dst;
+      num_pending = (int)threads.size();
+      generation++;
+    }
+
+    start_cv.notify_all();
+
+    convert_band(0);
+
+    std::unique_lock<std::mutex> lock(mtx);
+    done_cv.wait(lock, [this] { return 0 == num_pending; });
+    job_src = nullptr;
+    job_dst = nullptr;
+
+    return 0;
+  }
+
+  int Converter::get_format() {
+    return settings.format;
+  }
+
+  int Converter::get_isa() {
+    return settings.isa;
+  }
+
+  /* ------------------------------------------------ */
+
+  void Converter::run(int band) {
+
+    uint64_t seen = 0;
+
+    while (true) {
+
+      {
+        std::unique_lock<std::mutex> lock(mtx);
+        start_cv.wait(lock, [this, seen] { return true == must_stop || generation != seen; });
+        if (true == must_stop) {
+          break;
+        }
+        seen = generation;
+      }
+
+      convert_band(band);
+
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        num_pending--;
+      }
+
+      done_cv.notify_one();
+    }
+  }
+
+  /* Bands have an even number of rows so every band starts with its own row of chroma. */
+  void Converter::convert_band(int band) {
+
+    int num_bands = (int)threads.size() + 1;
+    int height = job_src->height;
+    int band_rows = ((height + num_bands - 1) / num_bands + 1) & ~1;
+    int y_start = band * band_rows;
+    int y_end = y_start + band_rows;
+
+    if (y_start >= height) {
+      return;
+    }
+
+    if (y_end > height) {
+      y_end = height;
+    }
+
+    convert_rows(*job_src, *job_dst, coefficients, settings.format, y_start, y_end);
+  }
+
+  /* ------------------------------------------------ */
+
+  void convert_rows_scalar(const ConvertSource& src, const ConvertTarget& dst, const ConvertCoefficients& k, int format, int y_start, int y_end) {
+
+    int chroma_width = (src.width + 1) / 2;
+
+    for (int j = y_start; j < y_end; ++j) {
+
+      const uint8_t* y = src.y + (size_t)j * src.y_pitch;
+      const uint8_t* uv = src.uv + (size_t)(j / 2) * src.uv_pitch;
+
+      switch (format) {
+
+        case CONVERT_FORMAT_NV12: {
+          memcpy(dst.planes[0] + (size_t)j * dst.pitches[0], y, src.width);
+          if (0 == (j & 1)) {
+            memcpy(dst.planes[1] + (size_t)(j / 2) * dst.pitches[1], uv, (size_t)chroma_width * 2);
+          }
+          break;
+        }
+
+        case CONVERT_FORMAT_I420: {
+          memcpy(dst.planes[0] + (size_t)j * dst.pitches[0], y, src.width);
+          if (0 == (j & 1)) {
+            convert_row_deinterleave_scalar(uv,
+                                            dst.planes[1] + (size_t)(j / 2) * dst.pitches[1],
+                                            dst.planes[2] + (size_t)(j / 2) * dst.pitches[2],
+                                            0, chroma_width);
+          }
+          break;
+        }
+
+        case CONVERT_FORMAT_RGB24:
+        case CONVERT_FORMAT_BGRA: {
+          convert_row_rgb_scalar(y, uv, dst.planes[0] + (size_t)j * dst.pitches[0], k, format, 0, src.width);
+          break;
+        }
+      }
+    }
+  }
+
+  /* Converts the pixels [x_start, width) of one row; `x_start` must be even. */
+  void convert_row_rgb_scalar(const uint8_t* y, const uint8_t* uv, uint8_t* dst, const ConvertCoefficients& k, int format, int x_start, int width) {
+
+    int num_channels = (CONVERT_FORMAT_BGRA == format) ? 4 : 3;
+    int half = 1 << (CONVERT_FRACTION_BITS - 1);
+
+    for (int i = x_start; i < width; ++i) {
+
+      int u = (int)uv[(i / 2) * 2 + 0] - 128;
+      int v = (int)uv[(i / 2) * 2 + 1] - 128;
+      int yy = ((int)y[i] - k.y_offset) * k.y_scale + half;
+      uint8_t r = clamp_pixel((yy + k.v_to_r * v) >> CONVERT_FRACTION_BITS);
+      uint8_t g = clamp_pixel((yy - k.u_to_g * u - k.v_to_g * v) >> CONVERT_FRACTION_BITS);
+      uint8_t b = clamp_pixel((yy + k.u_to_b * u) >> CONVERT_FRACTION_BITS);
+      uint8_t* p = dst + (size_t)i * num_channels;
+
+      if (CONVERT_FORMAT_BGRA == format) {
+        p[0] = b;
+        p[1] = g;
+        p[2] = r;
+        p[3] = 255;
+      }
+      else {
+        p[0] = r;
+        p[1] = g;
+        p[2] = b;
+      }
+    }
+  }
+
+  void convert_row_deinterleave_scalar(const uint8_t* uv, uint8_t* u, uint8_t* v, int x_start, int num_samples) {
+
+    for (int i = x_start; i < num_samples; ++i) {
+      u[i] = uv[i * 2 + 0];
+      v[i] = uv[i * 2 + 1];
+    }
+  }
+
+  /* ------------------------------------------------ */
+
+  int convert_source_init(const uint8_t* nv12, size_t pitch, int width, int height, ConvertSource& result) {
+
+    if (nullptr == nv12) {
+      printf("Cannot initialize the convert source, the given data is nullptr.\n");
+      return -1;
+    }
+
+    /* A row of chroma holds (width + 1) / 2 pairs. */
+    if (width <= 0 || height <= 0 || pitch < (size_t)((width + 1) & ~1)) {
+      printf("Cannot initialize the convert source, invalid size %d x %d or pitch %zu.\n", width, height, pitch);
+      return -2;
+    }
+
+    result.y = nv12;
+    result.uv = nv12 + pitch * height;
+    result.y_pitch = pitch;
+    result.uv_pitch = pitch;
+    result.width = width;
+    result.height = height;
+
+    return 0;
+  }
+
+  int convert_target_init(int format, int width, int height, uint8_t* data, ConvertTarget& result) {
+
+    if (nullptr == data) {
+      printf("Cannot initialize the convert target, the given data is nullptr.\n");
+      return -1;
+    }
+
+    if (width <= 0 || height <= 0) {
+      printf("Cannot initialize the convert target, invalid size %d x %d.\n", width, height);
+      return -2;
+    }
+
+    size_t chroma_width = (size_t)(width + 1) / 2;
+    size_t chroma_height = (size_t)(height + 1) / 2;
+
+    memset((char*)&result, 0x00, sizeof(result));
+
+    switch (format) {
+
+      case CONVERT_FORMAT_NV12: {
+        result.planes[0] = data;
+        result.pitches[0] = width;
+        result.planes[1] = data + (size_t)width * height;
+        result.pitches[1] = chroma_width * 2;
+        return 0;
+      }
+
+      case CONVERT_FORMAT_I420: {
+        result.planes[0] = data;
+        result.pitches[0] = width;
+        result.planes[1] = data + (size_t)width * height;
+        result.pitches[1] = chroma_width;
+        result.planes[2] = result.planes[1] + chroma_width * chroma_height;
+        result.pitches[2] = chroma_width;
+        return 0;
+      }
+
+      case CONVERT_FORMAT_RGB24:
+      case CONVERT_FORMAT_BGRA: {
+        result.planes[0] = data;
+        result.pitches[0] = convert_get_row_nbytes(format, width);
+        return 0;
+      }
+    }
+
+    printf("Cannot initialize the convert target, invalid format %d.\n", format);
+
+    return -3;
+  }
+
+  size_t convert_get_nbytes(int format, int width, int height) {
+
+    if (width <= 0 || height <= 0) {
+      return 0;
+    }
+
+    size_t chroma_nbytes = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+
+    switch (format) {
+      case CONVERT_FORMAT_NV12:
+      case CONVERT_FORMAT_I420:  { return (size_t)width * height + chroma_nbytes * 2; }
+      case CONVERT_FORMAT_RGB24:
+      case CONVERT_FORMAT_BGRA:  { return convert_get_row_nbytes(format, width) * height; }
+    }
+
+    return 0;
+  }
+
+  size_t convert_get_row_nbytes(int format, int width) {
+
+    switch (format) {
+      case CONVERT_FORMAT_NV12:
+      case CONVERT_FORMAT_I420:  { return (size_t)width; }
+      case CONVERT_FORMAT_RGB24: { return (size_t)width * 3; }
+      case CONVERT_FORMAT_BGRA:  { return (size_t)width * 4; }
+    }
+
+    return 0;
+  }
+
+  /*
+    From the luma weights Kr and Kb (Kg = 1 - Kr - Kb):
+
+      R = Y + 2(1 - Kr) V
+      G = Y - 2(1 - Kb) Kb / Kg U - 2(1 - Kr) Kr / Kg V
+      B = Y + 2(1 - Kb) U
+
+    Limited range luma is 16-235 and chroma is 16-240, so we
+    stretch the luma by 255 / 219 and the chroma by 255 / 224.
+  */
+  int convert_get_coefficients(int matrix, int range, ConvertCoefficients& result) {
+
+    double kr = 0.0;
+    double kb = 0.0;
+
+    switch (matrix) {
+      case CONVERT_MATRIX_BT601: { kr = 0.299;  kb = 0.114;  break; }
+      case CONVERT_MATRIX_BT709: { kr = 0.2126; kb = 0.0722; break; }
+      default: {
+        printf("Cannot get the convert coefficients, invalid matrix %d.\n", matrix);
+        return -1;
+      }
+    }
+
+    double y_scale = 1.0;
+    double c_scale = 1.0;
+
+    switch (range) {
+      case CONVERT_RANGE_FULL:    { result.y_offset = 0;  break; }
+      case CONVERT_RANGE_LIMITED: { result.y_offset = 16; y_scale = 255.0 / 219.0; c_scale = 255.0 / 224.0; break; }
+      default: {
+        printf("Cannot get the convert coefficients, invalid range %d.\n", range);
+        return -2;
+      }
+    }
+
+    double kg = 1.0 - kr - kb;
+
+    result.y_scale = to_fixed(y_scale);
+    result.v_to_r = to_fixed(2.0 * (1.0 - kr) * c_scale);
+    result.u_to_g = to_fixed(2.0 * (1.0 - kb) * kb / kg * c_scale);
+    result.v_to_g = to_fixed(2.0 * (1.0 - kr) * kr / kg * c_scale);
+    result.u_to_b = to_fixed(2.0 * (1.0 - kb) * c_scale);
+
+    return 0;
+  }
+
+  ConvertRowsFunc convert_get_rows_func(int isa) {
+
+    if (false == convert_is_isa_supported(isa)) {
+      return nullptr;
+    }
+
+    switch (isa) {
+      case CONVERT_ISA_SCALAR: { return convert_rows_scalar; }
+#if defined(USE_AVX2)
+      case CONVERT_ISA_AVX2:   { return convert_rows_avx2; }
+#endif
+#if defined(USE_NEON)
+      case CONVERT_ISA_NEON:   { return convert_rows_neon; }
+#endif
+    }
+
+    return nullptr;
+  }
+
+  /* Whether the ISA is compiled in and the CPU we run on has it. */
+  bool convert_is_isa_supported(int isa) {
+
+    switch (isa) {
+
+      case CONVERT_ISA_SCALAR: {
+        return true;
+      }
+
+      case CONVERT_ISA_AVX2: {
+#if defined(USE_AVX2) && defined(_MSC_VER)
+        /* AVX2 in the CPU, and the OS saves the YMM registers (OSXSAVE and XCR0). */
+        int regs[4];
+        __cpuid(regs, 0);
+        if (regs[0] < 7) {
+          return false;
+        }
+        __cpuid(regs, 1);
+        if (0 == (regs[2] & (1 << 27))) {
+          return false;
+        }
+        if (0x6 != (_xgetbv(0) & 0x6)) {
+          return false;
+        }
+        __cpuidex(regs, 7, 0);
+        return 0 != (regs[1] & (1 << 5));
+#elif defined(USE_AVX2)
+        return 0 != __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+      }
+
+      case CONVERT_ISA_NEON: {
+#if defined(USE_NEON)
+        return true;
+#else
+        return false;
+#endif
+      }
+    }
+
+    return false;
+  }
+
+  int convert_get_best_isa() {
+
+    if (true == convert_is_isa_supported(CONVERT_ISA_AVX2)) {
+      return CONVERT_ISA_AVX2;
+    }
+
+    if (true == convert_is_isa_supported(CONVERT_ISA_NEON)) {
+      return CONVERT_ISA_NEON;
+    }
+
+    return CONVERT_ISA_SCALAR;
+  }
+
+  /* ------------------------------------------------ */
+
+  int convert_format_from_string(const std::string& name) {
+
+    if ("nv12" == name)  { return CONVERT_FORMAT_NV12; }
+    if ("i420" == name)  { return CONVERT_FORMAT_I420; }
+    if ("rgb24" == name) { return CONVERT_FORMAT_RGB24; }
+    if ("bgra" == name)  { return CONVERT_FORMAT_BGRA; }
+
+    return CONVERT_FORMAT_NONE;
+  }
+
+  const char* convert_format_to_string(int format) {
+
+    switch (format) {
+      case CONVERT_FORMAT_NV12:  { return "nv12"; }
+      case CONVERT_FORMAT_I420:  { return "i420"; }
+      case CONVERT_FORMAT_RGB24: { return "rgb24"; }
+      case CONVERT_FORMAT_BGRA:  { return "bgra"; }
+    }
+
+    return "unknown";
+  }
+
+  int convert_matrix_from_string(const std::string& name) {
+
+    if ("bt601" == name) { return CONVERT_MATRIX_BT601; }
+    if ("bt709" == name) { return CONVERT_MATRIX_BT709; }
+
+    return CONVERT_MATRIX_NONE;
+  }
+
+  const char* convert_matrix_to_string(int matrix) {
+
+    switch (matrix) {
+      case CONVERT_MATRIX_BT601: { return "bt601"; }
+      case CONVERT_MATRIX_BT709: { return "bt709"; }
+    }
+
+    return "unknown";
+  }
+
+  int convert_range_from_string(const std::string& name) {
+
+    if ("limited" == name) { return CONVERT_RANGE_LIMITED; }
+    if ("full" == name)    { return CONVERT_RANGE_FULL; }
+
+    return CONVERT_RANGE_NONE;
+  }
+
+  const char* convert_range_to_string(int range) {
+
+    switch (range) {
+      case CONVERT_RANGE_LIMITED: { return "limited"; }
+      case CONVERT_RANGE_FULL:    { return "full"; }
+    }
+
+    return "unknown";
+  }
+
+  const char* convert_isa_to_string(int isa) {
+
+    switch (isa) {
+      case CONVERT_ISA_SCALAR: { return "scalar"; }
+      case CONVERT_ISA_AVX2:   { return "avx2"; }
+      case CONVERT_ISA_NEON:   { return "neon"; }
+    }
+
+    return "unknown";
+  }
+
+  /* ------------------------------------------------ */
+
+  static uint8_t clamp_pixel(int v) {
+    return (uint8_t)((v < 0) ? 0 : ((v > 255) ? 255 : v));
+  }
+
+  static int16_t to_fixed(double v) {
+    return (int16_t)floor(v * (1 << CONVERT_FRACTION_BITS) + 0.5);
+  }
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
@@ -0,0 +1,210 @@
+/*
+  CONVERT
+  =======
+
+  GENERAL INFO:
+
+    Converts the NV12 pictures that we download from the GPU into
+    the formats our consumers want, on the CPU:
+
+      CONVERT_FORMAT_NV12:   a copy that strips the pitch.
+      CONVERT_FORMAT_I420:   planar Y, U and V; the chroma is
+                             de-interleaved, the samples don't
+                             change.
+      CONVERT_FORMAT_RGB24:  packed R, G, B bytes.
+      CONVERT_FORMAT_BGRA:   packed B, G, R, A bytes with A = 255.
+
+    For RGB we use the BT.601 or BT.709 matrix and limited
+    (16-235) or full (0-255) range YUV; the chroma is
+    upsampled by repeating every sample (nearest). The math is
+    fixed point with 6 fractional bits in 16 bit integers with
+    saturating adds; all ISAs compute exactly the same bytes,
+    so the scalar code is the reference for the vectorized code.
+    Compared to a float implementation a channel is off by at
+    most a few levels.
+
+    ISAs: CONVERT_ISA_SCALAR always works. CONVERT_ISA_AVX2
+    is compiled when we build for x86 (USE_AVX2, only
+    convert-avx2.cpp is compiled with AVX2 enabled) and used
+    when the CPU supports it. CONVERT_ISA_NEON is compiled when
+    we build for 64 bit ARM (USE_NEON), where NEON is always
+    available. The vectorized code converts 16 pixels at a time
+    and leaves the last pixels of a row to the scalar code.
+
+    A Converter splits the picture into bands of rows and
+    converts them on `num_threads` threads; the calling thread
+    converts the first band, so with one thread we don't create
+    any threads. A band always starts on an even row because
+    two rows share a row of chroma.
+
+    The source is a pitched NV12 buffer, e.g. the host buffer
+    of a CopySlot: `height` rows of luma followed by
+    `(height + 1) / 2` rows of interleaved chroma. The target
+    planes can be pitched too; convert_target_init() sets up a
+    packed target in one buffer of convert_get_nbytes() bytes.
+
+  USAGE:
+
+    ConvertSettings settings;
+    settings.format = CONVERT_FORMAT_RGB24;
+    settings.matrix = CONVERT_MATRIX_BT709;
+    settings.range = CONVERT_RANGE_LIMITED;
+    settings.num_threads = 4;
+
+    Converter converter;
+    converter.init(settings);
+
+    ConvertSource src;
+    convert_source_init(slot->data, slot->pitch, width, height, src);
+
+    std::vector<uint8_t> rgb(convert_get_nbytes(CONVERT_FORMAT_RGB24, width, height));
+    ConvertTarget dst;
+    convert_target_init(CONVERT_FORMAT_RGB24, width, height, rgb.data(), dst);
+
+    converter.convert(src, dst);
+    converter.shutdown();
+
+ */
+#ifndef NVDEC_CONVERT_H
+#define NVDEC_CONVERT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define CONVERT_FORMAT_NONE 0
+#define CONVERT_FORMAT_NV12 1
+#define CONVERT_FORMAT_I420 2
+#define CONVERT_FORMAT_RGB24 3
+#define CONVERT_FORMAT_BGRA 4
+
+#define CONVERT_MATRIX_NONE 0
+#define CONVERT_MATRIX_BT601 1
+#define CONVERT_MATRIX_BT709 2
+
+#define CONVERT_RANGE_NONE 0
+#define CONVERT_RANGE_LIMITED 1
+#define CONVERT_RANGE_FULL 2
+
+#define CONVERT_ISA_NONE 0         /* When used in the settings: the best ISA this CPU supports. */
+#define CONVERT_ISA_SCALAR 1
+#define CONVERT_ISA_AVX2 2
+#define CONVERT_ISA_NEON 3
+
+#define CONVERT_FRACTION_BITS 6    /* The fixed point coefficients are multiplied by 1 << CONVERT_FRACTION_BITS. */
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  struct ConvertSource {
+    const uint8_t* y;
+    const uint8_t* uv;              /* Interleaved U and V; one row for every two rows of luma. */
+    size_t y_pitch;
+    size_t uv_pitch;
+    int width;
+    int height;
+  };
+
+  /* I420 uses all three planes, the packed formats only the first one. */
+  struct ConvertTarget {
+    uint8_t* planes[3];
+    size_t pitches[3];
+  };
+
+  struct ConvertCoefficients {
+    int16_t y_offset;               /* 16 for limited range, 0 for full range. */
+    int16_t y_scale;                /* The coefficients are fixed point; see CONVERT_FRACTION_BITS. */
+    int16_t v_to_r;
+    int16_t u_to_g;                 /* Subtracted. */
+    int16_t v_to_g;                 /* Subtracted. */
+    int16_t u_to_b;
+  };
+
+  struct ConvertSettings {
+    ConvertSettings();
+    int format;                     /* CONVERT_FORMAT_* */
+    int matrix;                     /* CONVERT_MATRIX_*; only used for RGB. */
+    int range;                      /* CONVERT_RANGE_* of the YUV; only used for RGB. */
+    int isa;                        /* CONVERT_ISA_*; CONVERT_ISA_NONE picks the best one. */
+    int num_threads;                /* The bands we convert at the same time, including the calling thread. */
+  };
+
+  /* Converts the rows [y_start, y_end) of `src`; `y_start` must be even. */
+  typedef void (*ConvertRowsFunc)(const ConvertSource& src, const ConvertTarget& dst, const ConvertCoefficients& k, int format, int y_start, int y_end);
+
+  /* ------------------------------------------------ */
+
+  class Converter {
+  public:
+    Converter();
+    ~Converter();
+    int init(const ConvertSettings& settings);
+    int shutdown();
+    int convert(const ConvertSource& src, const ConvertTarget& dst);  /* Blocks until all bands are converted. */
+    int get_format();
+    int get_isa();
+
+  private:
+    void run(int band);
+    void convert_band(int band);
+
+  private:
+    ConvertSettings settings;
+    ConvertCoefficients coefficients;
+    ConvertRowsFunc convert_rows;
+    std::vector<std::thread> threads;                  /* Band 1 and up; the calling thread converts band 0. */
+    std::mutex mtx;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    uint64_t generation;                               /* Bumped for every convert() so the threads know there's work. */
+    int num_pending;                                   /* Bands of the current convert() that the threads didn't finish yet. */
+    bool must_stop;
+    const ConvertSource* job_src;
+    const ConvertTarget* job_dst;
+    bool is_init;
+  };
+
+  /* ------------------------------------------------ */
+
+  int convert_source_init(const uint8_t* nv12, size_t pitch, int width, int height, ConvertSource& result);      /* The chroma follows `height` rows of luma. */
+  int convert_target_init(int format, int width, int height, uint8_t* data, ConvertTarget& result);             /* Packed planes in one buffer of convert_get_nbytes(). */
+  size_t convert_get_nbytes(int format, int width, int height);
+  size_t convert_get_row_nbytes(int format, int width);                                                        /* Bytes per row of the first plane. */
+  int convert_get_coefficients(int matrix, int range, ConvertCoefficients& result);
+  ConvertRowsFunc convert_get_rows_func(int isa);                                                              /* nullptr when the ISA isn't compiled in or not supported by this CPU. */
+  bool convert_is_isa_supported(int isa);
+  int convert_get_best_isa();
+
+  int convert_format_from_string(const std::string& name);         /* Returns CONVERT_FORMAT_NONE for unknown names. */
+  const char* convert_format_to_string(int format);
+  int convert_matrix_from_string(const std::string& name);
+  const char* convert_matrix_to_string(int matrix);
+  int convert_range_from_string(const std::string& name);
+  const char* convert_range_to_string(int range);
+  const char* convert_isa_to_string(int isa);
+
+  /* ------------------------------------------------ */
+
+  /* Kernels; the vectorized ones use the scalar ones for the pixels at the end of a row. */
+  void convert_rows_scalar(const ConvertSource& src, const ConvertTarget& dst, const ConvertCoefficients& k, int format, int y_start, int y_end);
+  void convert_row_rgb_scalar(const uint8_t* y, const uint8_t* uv, uint8_t* dst, const ConvertCoefficients& k, int format, int x_start, int width);
+  void convert_row_deinterleave_scalar(const uint8_t* uv, uint8_t* u, uint8_t* v, int x_start, int num_samples);
+
+#if defined(USE_AVX2)
+  void convert_rows_avx2(const ConvertSource& src, const ConvertTarget& dst, const ConvertCoefficients& k, int format, int y_start, int y_end);
+#endif
+
+#if defined(USE_NEON)
+  void convert_rows_neon(const ConvertSource& src, const ConvertTarget& dst, const ConvertCoefficients& k, int format, int y_start, int y_end);
+#endif
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
+
+#endif
@@ -0,0 +1,376 @@
+#include <stdio.h>
+#include <string.h>
+#include <nvdec/copy-pool.h>
+#include <nvdec/trace.h>
+#include <nvdec/utils.h>
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  CopyPool::CopyPool()
+    :backend(nullptr)
+  {
+    memset((char*)&stats, 0x00, sizeof(stats));
+  }
+
+  CopyPool::~CopyPool() {
+    shutdown();
+  }
+
+  int CopyPool::init(DecodeBackend* be, int depth) {
+
+    if (nullptr == be) {
+      printf("Cannot initialize the copy pool, the given backend is nullptr.\n");
+      return -1;
+    }
+
+    if (nullptr != backend) {
+      printf("Cannot initialize the copy pool, already initialized. Call shutdown() first.\n");
+      return -2;
+    }
+
+    if (depth < 1 || depth > COPY_POOL_MAX_DEPTH) {
+      printf("Cannot initialize the copy pool, invalid depth %d; use 1..%d.\n", depth, COPY_POOL_MAX_DEPTH);
+      return -3;
+    }
+
+    /* We keep one set of buffers of a previous resolution around. */
+    if (0 != buffers.init(be, depth, COPY_POOL_MAX_LEAD)) {
+      return -4;
+    }
+
+    backend = be;
+    slots.resize(depth);
+    memset((char*)&stats, 0x00, sizeof(stats));
+
+    for (int i = 0; i < depth; ++i) {
+
+      CopySlot& slot = slots[i];
+      memset((char*)&slot, 0x00, sizeof(slot));
+      slot.index = i;
+      slot.state = COPY_SLOT_STATE_FREE;
+
+      CUresult r = backend->create_stream(&slot.stream);
+      if (CUDA_SUCCESS != r) {
+        printf("Failed to create the stream for copy slot %d: %s.\n", i, backend->get_error_string(r));
+        shutdown();
+        return -5;
+      }
+
+      r = backend->create_event(&slot.event);
+      if (CUDA_SUCCESS != r) {
+        printf("Failed to create the event for copy slot %d: %s.\n", i, backend->get_error_string(r));
+        shutdown();
+        return -6;
+      }
+    }
+
+    return 0;
+  }
+
+  int CopyPool::shutdown() {
+
+    if (nullptr == backend) {
+      return 0;
+    }
+
+    int result = 0;
+    CopySlot* slot = nullptr;
+
+    while (0 == wait(&slot)) {
+      release(slot);
+    }
+
+    for (size_t i = 0; i < slots.size(); ++i) {
+
+      CopySlot& s = slots[i];
+
+      if (0 != buffers.release(s.buffer)) {
+        result = -3;
+      }
+      s.data = nullptr;
+
+      if (nullptr != s.event && CUDA_SUCCESS != backend->destroy_event(s.event)) {
+        printf("Failed to destroy the event of copy slot %zu.\n", i);
+        result = -1;
+      }
+
+      if (nullptr != s.stream && CUDA_SUCCESS != backend->destroy_stream(s.stream)) {
+        printf("Failed to destroy the stream of copy slot %zu.\n", i);
+        result = -2;
+      }
+
+      s.event = nullptr;
+      s.stream = nullptr;
+    }
+
+    if (0 != buffers.shutdown()) {
+      result = -4;
+    }
+
+    slots.clear();
+    in_flight.clear();
+    backend = nullptr;
+
+    return result;
+  }
+
+  /* We hand out the slots round robin; this keeps all buffers warm. */
+  int CopyPool::acquire(CopySlot** slot) {
+
+    if (nullptr == slot) {
+      printf("Cannot acquire a copy slot, the given pointer is nullptr.\n");
+      return -1;
+    }
+
+    if (nullptr == backend) {
+      printf("Cannot acquire a copy slot, not initialized.\n");
+      return -2;
+    }
+
+    for (size_t i = 0; i < slots.size(); ++i) {
+      size_t dx = (stats.num_copies + i) % slots.size();
+      if (COPY_SLOT_STATE_FREE == slots[dx].state) {
+        slots[dx].state = COPY_SLOT_STATE_ACQUIRED;
+        *slot = &slots[dx];
+        return 0;
+      }
+    }
+
+    return 1;
+  }
+
+  /* The chroma plane starts `surface_height` rows after the luma plane. */
+  int CopyPool::submit(CopySlot* slot, CUvideodecoder decoder, CUdeviceptr device_ptr, unsigned int pitch, int left, int top, int width, int height, int surface_height, size_t lead) {
+
+    if (nullptr == slot || COPY_SLOT_STATE_ACQUIRED != slot->state) {
+      printf("Cannot submit a copy, the slot hasn't been acquired.\n");
+      return -1;
+    }
+
+    if (0 == device_ptr
+        || width <= 0
+        || height <= 0
+        || left < 0
+        || top < 0
+        || surface_height < top + height
+        || (unsigned int)(left + width) > pitch)
+      {
+        printf("Cannot submit a copy, invalid device pointer or size.\n");
+        return -2;
+      }
+
+    if (0 != (left & 1) || 0 != (top & 1)) {
+      printf("Cannot submit a copy, the offset %d, %d is not even.\n", left, top);
+      return -2;
+    }
+
+    if (lead >= COPY_POOL_MAX_LEAD) {
+      printf("Cannot submit a copy, the lead %zu is too big; it must be < %d.\n", lead, COPY_POOL_MAX_LEAD);
+      return -2;
+    }
+
+    size_t luma_nbytes = (size_t)width * height;
+    size_t nbytes = luma_nbytes + (size_t)width * (height / 2);
+
+    /* Swap the buffer when the picture size changed; every buffer has room for the biggest lead. */
+    HostBufferKey key;
+    key.pitch = (unsigned int)width;
+    key.height = (unsigned int)height;
+    key.format = cudaVideoSurfaceFormat_NV12;
+
+    if (nullptr == slot->buffer.data || false == host_buffer_key_equals(slot->buffer.key, key)) {
+
+      /* Acquire before we release so we don't evict a buffer that we can use. */
+      HostBuffer previous = slot->buffer;
+      slot->buffer.data = nullptr;
+      slot->data = nullptr;
+
+      int r = buffers.acquire(key, slot->buffer);
+      buffers.release(previous);
+
+      if (0 != r) {
+        printf("Failed to get a %d x %d buffer for copy slot %d.\n", width, height, slot->index);
+        return -3;
+      }
+    }
+
+    TRACE_SPAN_ARG("copy", slot->index);
+
+    slot->lead = lead;
+    slot->data = slot->buffer.data + lead;
+    slot->submit_ns = get_time_ns();
+
+    /* Luma and chroma are separate copies because the chroma plane doesn't have to follow the visible luma rows. */
+    CUresult r = backend->copy_2d_to_host_async(slot->data, width,
+                                                device_ptr + (CUdeviceptr)pitch * top + left, pitch,
+                                                width, height,
+                                                slot->stream);
+    if (CUDA_SUCCESS != r) {
+      printf("Failed to start the luma copy for slot %d: %s.\n", slot->index, backend->get_error_string(r));
+      return -4;
+    }
+
+    r = backend->copy_2d_to_host_async(slot->data + luma_nbytes, width,
+                                       device_ptr + (CUdeviceptr)pitch * (surface_height + top / 2) + left, pitch,
+                                       width, height / 2,
+                                       slot->stream);
+    if (CUDA_SUCCESS != r) {
+      printf("Failed to start the chroma copy for slot %d: %s.\n", slot->index, backend->get_error_string(r));
+      return -4;
+    }
+
+    r = backend->record_event(slot->event, slot->stream);
+    if (CUDA_SUCCESS != r) {
+      printf("Failed to record the event for slot %d: %s.\n", slot->index, backend->get_error_string(r));
+      return -5;
+    }
+
+    slot->state = COPY_SLOT_STATE_COPYING;
+    slot->decoder = decoder;
+    slot->device_ptr = device_ptr;
+    slot->pitch = width;
+    slot->width = width;
+    slot->height = height;
+    slot->nbytes = nbytes;
+
+    in_flight.push_back(slot->index);
+
+    stats.num_copies++;
+    stats.num_bytes += nbytes;
+    stats.num_pitched_bytes += (uint64_t)pitch * (height + height / 2);
+
+    return 0;
+  }
+
+  int CopyPool::poll(CopySlot** slot) {
+
+    if (nullptr == slot) {
+      printf("Cannot poll the copy pool, the given pointer is nullptr.\n");
+      return -1;
+    }
+
+    if (true == in_flight.empty()) {
+      return 1;
+    }
+
+    CopySlot* oldest = &slots[in_flight.front()];
+
+    CUresult r = backend->query_event(oldest->event);
+    if (CUDA_ERROR_NOT_READY == r) {
+      return 1;
+    }
+
+    if (CUDA_SUCCESS != r) {
+      printf("Failed to query the event for copy slot %d: %s.\n", oldest->index, backend->get_error_string(r));
+      return -2;
+    }
+
+    if (0 != complete(oldest)) {
+      return -3;
+    }
+
+    *slot = oldest;
+
+    return 0;
+  }
+
+  int CopyPool::wait(CopySlot** slot) {
+
+    if (nullptr == slot) {
+      printf("Cannot wait for the copy pool, the given pointer is nullptr.\n");
+      return -1;
+    }
+
+    if (true == in_flight.empty()) {
+      return 1;
+    }
+
+    CopySlot* oldest = &slots[in_flight.front()];
+
+    CUresult r = backend->query_event(oldest->event);
+    if (CUDA_ERROR_NOT_READY == r) {
+
+      TRACE_SPAN_ARG("copy_wait", oldest->index);
+      uint64_t t0 = get_time_ns();
+
+      r = backend->synchronize_event(oldest->event);
+
+      stats.stall_ns += get_time_ns() - t0;
+      stats.num_stalls++;
+    }
+
+    if (CUDA_SUCCESS != r) {
+      printf("Failed to wait for the event of copy slot %d: %s.\n", oldest->index, backend->get_error_string(r));
+      return -2;
+    }
+
+    if (0 != complete(oldest)) {
+      return -3;
+    }
+
+    *slot = oldest;
+
+    return 0;
+  }
+
+  int CopyPool::release(CopySlot* slot) {
+
+    if (nullptr == slot) {
+      printf("Cannot release the copy slot, nullptr given.\n");
+      return -1;
+    }
+
+    if (COPY_SLOT_STATE_COPYING == slot->state) {
+      printf("Cannot release copy slot %d, the copy is still in flight.\n", slot->index);
+      return -2;
+    }
+
+    slot->state = COPY_SLOT_STATE_FREE;
+
+    return 0;
+  }
+
+  int CopyPool::get_depth() {
+    return (int)slots.size();
+  }
+
+  int CopyPool::get_num_in_flight() {
+    return (int)in_flight.size();
+  }
+
+  CopyPoolStats CopyPool::get_stats() {
+    return stats;
+  }
+
+  HostBufferPoolStats CopyPool::get_buffer_stats() {
+    return buffers.get_stats();
+  }
+
+  /* ------------------------------------------------ */
+
+  int CopyPool::complete(CopySlot* slot) {
+
+    TRACE_SPAN_ARG("unmap", slot->index);
+    int result = 0;
+
+    CUresult r = backend->unmap_video_frame(slot->decoder, slot->device_ptr);
+    if (CUDA_SUCCESS != r) {
+      printf("Failed to unmap the picture of copy slot %d: %s.\n", slot->index, backend->get_error_string(r));
+      result = -1;
+    }
+
+    stats.copy_ns += get_time_ns() - slot->submit_ns;
+
+    in_flight.pop_front();
+    slot->state = COPY_SLOT_STATE_DONE;
+    slot->device_ptr = 0;
+    slot->decoder = nullptr;
+
+    return result;
+  }
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
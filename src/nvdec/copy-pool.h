@@ -0,0 +1,161 @@
+/*
+  COPY POOL
+  =========
+
+  GENERAL INFO:
+
+    A pool of page-locked host buffers that we use to copy the
+    decoded pictures from the GPU without blocking the
+    decoder. Every slot has its own stream and event; submit()
+    starts an async device to host copy of a mapped picture and
+    records the event behind it. The picture stays mapped until
+    the copy has finished, after which we unmap it and the slot
+    can be written by the caller. Slots complete in the order
+    they were submitted so frames come out in display order.
+
+    The copy strips the pitch: we do a 2D copy of the visible
+    luma rows and one of the chroma rows, so a slot holds a
+    tightly packed NV12 frame (width x height luma followed by
+    width x height / 2 interleaved chroma) that can be written
+    with one write() call and we don't move the padding over
+    the bus. `left` and `top` select where the picture starts
+    in the surface, so you can copy only the display area of a
+    picture that was decoded at its coded size. They must be
+    even because of the interleaved chroma.
+
+    submit() takes a `lead`: the number of bytes we keep free in
+    front of the frame. The buffers from alloc_host() are page
+    aligned so `data - lead` is aligned too; the O_DIRECT frame
+    sinks use this to write the frame without a bounce buffer
+    (see frame-sink.h). Pass 0 when you don't need it.
+
+    The slot buffers come from a HostBufferPool (see
+    host-buffer-pool.h) keyed on the packed size of the
+    picture. When the resolution changes a slot gives its
+    buffer back to that pool and takes one of the new size, so
+    switching back to a resolution we've seen before doesn't
+    allocate. get_buffer_stats() gives the hits and misses.
+
+    With a depth of N we can have N copies in flight, which
+    means that mapping picture k+1 overlaps with copying
+    picture k and writing picture k-1. Every copy that's in
+    flight keeps a picture mapped, so the decoder must be
+    created with at least as many output surfaces
+    (ulNumOutputSurfaces) as you allow copies in flight; use
+    get_num_in_flight() when the pool has more slots than that,
+    e.g. because done slots are queued for a writer thread.
+
+  USAGE:
+
+    CopyPool pool;
+    pool.init(backend, 3);
+
+    // For each picture you want to download:
+    CopySlot* slot = nullptr;
+    if (0 != pool.acquire(&slot)) {
+      pool.wait(&done);           // All slots are busy, wait for the oldest.
+      write(done);
+      pool.release(done);
+      pool.acquire(&slot);
+    }
+
+    vpp.output_stream = slot->stream;
+    backend->map_video_frame(decoder, idx, &ptr, &pitch, &vpp);
+    pool.submit(slot, decoder, ptr, pitch, 0, 0, width, height, surface_height, 0);
+
+    while (0 == pool.poll(&done)) {
+      write(done);
+      pool.release(done);
+    }
+
+    // At the end of the stream:
+    while (0 == pool.wait(&done)) {
+      write(done);
+      pool.release(done);
+    }
+
+    pool.shutdown();
+
+ */
+#ifndef NVDEC_COPY_POOL_H
+#define NVDEC_COPY_POOL_H
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+#include <nvdec/backend.h>
+#include <nvdec/host-buffer-pool.h>
+
+#define COPY_POOL_MAX_DEPTH 64
+#define COPY_POOL_MAX_LEAD 4096     /* The alignment of the buffers we get from alloc_host(). */
+
+#define COPY_SLOT_STATE_FREE 0      /* Can be acquired. */
+#define COPY_SLOT_STATE_ACQUIRED 1  /* Acquired, the caller is mapping a picture. */
+#define COPY_SLOT_STATE_COPYING 2   /* The copy is in flight, the picture is mapped. */
+#define COPY_SLOT_STATE_DONE 3      /* The copy finished and the picture is unmapped; `data` can be read until release(). */
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  struct CopySlot {
+    int index;
+    int state;
+    HostBuffer buffer;              /* Page-locked host memory from the HostBufferPool. */
+    uint8_t* data;                  /* The picture; `buffer.data + lead`. */
+    size_t lead;
+    size_t nbytes;                  /* The number of bytes of the current picture. */
+    unsigned int pitch;             /* Pitch of `data`; the same as `width` as we strip the padding. */
+    int width;
+    int height;
+    CUstream stream;
+    CUevent event;
+    CUvideodecoder decoder;         /* The decoder of the mapped picture. */
+    CUdeviceptr device_ptr;         /* The mapped picture, 0 when nothing is mapped. */
+    uint64_t submit_ns;             /* When the copy was submitted. */
+    int64_t pts;                    /* Of the mapped picture; set by the user of the pool. */
+  };
+
+  struct CopyPoolStats {
+    uint64_t num_copies;
+    uint64_t num_bytes;
+    uint64_t num_pitched_bytes;     /* What we would have copied when we copied the padding too. */
+    uint64_t copy_ns;               /* Sum of the time between submit() and the moment we saw the copy done; an upper bound of the transfer time. */
+    uint64_t num_stalls;            /* The number of times we had to block for a copy to finish. */
+    uint64_t stall_ns;              /* The total time we blocked. */
+  };
+
+  /* ------------------------------------------------ */
+
+  class CopyPool {
+  public:
+    CopyPool();
+    ~CopyPool();
+    int init(DecodeBackend* backend, int depth);
+    int shutdown();                                                                   /* Waits for all copies that are in flight and unmaps their pictures. */
+    int acquire(CopySlot** slot);                                                     /* Returns 0 when we have a free slot, 1 when all slots are in use, < 0 on error. */
+    int submit(CopySlot* slot, CUvideodecoder decoder, CUdeviceptr device_ptr, unsigned int pitch, int left, int top, int width, int height, int surface_height, size_t lead);  /* Copies the `width` x `height` NV12 picture at `left`, `top` of the surface into a packed buffer, `lead` bytes after its start. */
+    int poll(CopySlot** slot);                                                        /* Returns 0 when the oldest copy is done, 1 when it's not done or when nothing is in flight. */
+    int wait(CopySlot** slot);                                                        /* Blocks until the oldest copy is done; returns 1 when nothing is in flight. */
+    int release(CopySlot* slot);                                                      /* Gives a slot back that we acquired or that was done. */
+    int get_depth();
+    int get_num_in_flight();
+    CopyPoolStats get_stats();
+    HostBufferPoolStats get_buffer_stats();
+
+  private:
+    int complete(CopySlot* slot);                                                     /* Unmaps the picture of the oldest slot and removes it from the in flight list. */
+
+  private:
+    DecodeBackend* backend;
+    HostBufferPool buffers;
+    std::vector<CopySlot> slots;
+    std::deque<int> in_flight;                                                        /* Indices into `slots` in submit order. */
+    CopyPoolStats stats;
+  };
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
+
+#endif
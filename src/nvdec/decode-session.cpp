@@ -0,0 +1,2008 @@
+#include <stdio.h>
+#include <string.h>
+#include <new>
+#include <nvdec/annexb.h>
+#include <nvdec/decode-session.h>
+#include <nvdec/h264.h>
+#include <nvdec/trace.h>
+#include <nvdec/utils.h>
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  DecodeSessionSettings::DecodeSessionSettings()
+    :id(0)
+    ,copy_depth(3)
+    ,write_queue_size(8)
+    ,sink_type(FRAME_SINK_TYPE_FD)
+    ,max_width(0)
+    ,max_height(0)
+    ,container(CONTAINER_TYPE_RAW)
+    ,crop(DECODE_SESSION_CROP_DECODER)
+    ,scale_mode(DECODE_SESSION_SCALE_DECODER)
+    ,frames(DECODE_SESSION_FRAMES_ALL)
+    ,latency(DECODE_SESSION_LATENCY_THROUGHPUT)
+    ,download(DECODE_SESSION_DOWNLOAD_COPY)
+    ,is_verbose(false)
+  {
+  }
+
+  /* ------------------------------------------------ */
+
+  DecodeSession::DecodeSession()
+    :backend(nullptr)
+    ,parser(nullptr)
+    ,decoder(nullptr)
+    ,decoder_max_width(0)
+    ,decoder_max_height(0)
+    ,queue_read_dx(0)
+    ,queue_count(0)
+    ,queue_depth(DECODE_SESSION_QUEUE_SIZE)
+    ,queue_max_depth(DECODE_SESSION_MAX_QUEUE_SIZE)
+    ,queue_window_count(0)
+    ,queue_window_stall_ns(0)
+    ,queue_depth_start_ns(0)
+    ,proxy_offset(0)
+    ,has_writer(false)
+    ,has_converter(false)
+    ,has_decoder_scaler(false)
+    ,has_scaler(false)
+    ,has_proxy_writer(false)
+    ,has_error(false)
+    ,output_offset(0)
+    ,segment(0)
+    ,num_segment_frames(0)
+    ,has_timestamps(false)
+  {
+    memset((char*)&decoder_format, 0x00, sizeof(decoder_format));
+    memset((char*)&stats, 0x00, sizeof(stats));
+    stats.last_pts = ANNEXB_NO_TIMESTAMP;
+    memset((char*)&stream_info, 0x00, sizeof(stream_info));
+    memset((char*)&output_layout, 0x00, sizeof(output_layout));
+    memset((char*)queue, 0x00, sizeof(queue));
+  }
+
+  DecodeSession::~DecodeSession() {
+    shutdown();
+  }
+
+  void* DecodeSession::operator new(size_t nbytes) {
+
+    void* ptr = alloc_aligned(nbytes, alignof(DecodeSession));
+    if (nullptr == ptr) {
+      throw std::bad_alloc();
+    }
+
+    return ptr;
+  }
+
+  void DecodeSession::operator delete(void* ptr) {
+    free_aligned(ptr);
+  }
+
+  int DecodeSession::init(DecodeBackend* be, const DecodeSessionSettings& cfg) {
+
+    if (nullptr == be) {
+      printf("Cannot initialize decode session %d, the given backend is nullptr.\n", cfg.id);
+      return -1;
+    }
+
+    if (nullptr != backend) {
+      printf("Cannot initialize decode session %d, already initialized. Call shutdown() first.\n", cfg.id);
+      return -2;
+    }
+
+    if (cfg.copy_depth <= 0) {
+      printf("Cannot initialize decode session %d, invalid copy depth %d.\n", cfg.id, cfg.copy_depth);
+      return -3;
+    }
+
+    if (CONTAINER_TYPE_RAW != cfg.container && CONTAINER_TYPE_Y4M != cfg.container) {
+      printf("Cannot initialize decode session %d, invalid container %d.\n", cfg.id, cfg.container);
+      return -3;
+    }
+
+    if (DECODE_SESSION_CROP_CODED != cfg.crop
+        && DECODE_SESSION_CROP_DECODER != cfg.crop
+        && DECODE_SESSION_CROP_COPY != cfg.crop)
+      {
+        printf("Cannot initialize decode session %d, invalid crop %d.\n", cfg.id, cfg.crop);
+        return -3;
+      }
+
+    if (DECODE_SESSION_SCALE_DECODER != cfg.scale_mode && DECODE_SESSION_SCALE_CPU != cfg.scale_mode) {
+      printf("Cannot initialize decode session %d, invalid scale mode %d.\n", cfg.id, cfg.scale_mode);
+      return -3;
+    }
+
+    if (DECODE_SESSION_FRAMES_ALL != cfg.frames
+        && DECODE_SESSION_FRAMES_REFERENCE != cfg.frames
+        && DECODE_SESSION_FRAMES_INTRA != cfg.frames)
+      {
+        printf("Cannot initialize decode session %d, invalid frames mode %d.\n", cfg.id, cfg.frames);
+        return -3;
+      }
+
+    if (DECODE_SESSION_LATENCY_THROUGHPUT != cfg.latency && DECODE_SESSION_LATENCY_LOW != cfg.latency) {
+      printf("Cannot initialize decode session %d, invalid latency mode %d.\n", cfg.id, cfg.latency);
+      return -3;
+    }
+
+    if (DECODE_SESSION_DOWNLOAD_COPY != cfg.download && DECODE_SESSION_DOWNLOAD_SKIP != cfg.download) {
+      printf("Cannot initialize decode session %d, invalid download mode %d.\n", cfg.id, cfg.download);
+      return -3;
+    }
+
+    if (DECODE_SESSION_DOWNLOAD_SKIP == cfg.download && (false == cfg.output_path.empty() || false == cfg.proxy_path.empty())) {
+      printf("Cannot initialize decode session %d, we don't download the pictures so there is nothing to write.\n", cfg.id);
+      return -3;
+    }
+
+    if (cfg.scale.width < 0 || cfg.scale.height < 0) {
+      printf("Cannot initialize decode session %d, invalid scale size %d x %d.\n", cfg.id, cfg.scale.width, cfg.scale.height);
+      return -3;
+    }
+
+    if (CONTAINER_TYPE_Y4M == cfg.container
+        && CONVERT_FORMAT_NV12 != cfg.convert.format
+        && CONVERT_FORMAT_I420 != cfg.convert.format)
+      {
+        printf("Cannot initialize decode session %d, Y4M can't hold %s.\n", cfg.id, convert_format_to_string(cfg.convert.format));
+        return -3;
+      }
+
+    settings = cfg;
+    memset((char*)&stats, 0x00, sizeof(stats));
+    stats.last_pts = ANNEXB_NO_TIMESTAMP;
+    memset((char*)&decoder_format, 0x00, sizeof(decoder_format));
+    decoder_max_width = 0;
+    decoder_max_height = 0;
+    queue_read_dx = 0;
+    queue_count = 0;
+    queue_depth = (DECODE_SESSION_LATENCY_LOW == cfg.latency) ? 0 : DECODE_SESSION_QUEUE_SIZE;
+    queue_max_depth = (DECODE_SESSION_LATENCY_LOW == cfg.latency) ? 0 : DECODE_SESSION_MAX_QUEUE_SIZE;
+    queue_window_count = 0;
+    queue_window_stall_ns = 0;
+    has_error = false;
+    output_offset = 0;
+    proxy_offset = 0;
+    segment = 0;
+    num_segment_frames = 0;
+    stream_header.clear();
+    pending_timestamps.clear();
+    has_timestamps = false;
+
+    /* Y4M has no NV12, the closest is I420. */
+    if (CONTAINER_TYPE_Y4M == settings.container) {
+      settings.convert.format = CONVERT_FORMAT_I420;
+    }
+
+    stats.time_start_ns = get_time_ns();
+    stats.queue_depth = queue_depth;
+    stats.min_queue_depth = queue_depth;
+    stats.max_queue_depth = queue_depth;
+    queue_depth_start_ns = stats.time_start_ns;
+
+    has_converter = (CONVERT_FORMAT_NV12 != settings.convert.format);
+    if (true == has_converter) {
+      if (0 != converter.init(settings.convert)) {
+        printf("Cannot initialize decode session %d, failed to initialize the %s converter.\n", settings.id, convert_format_to_string(settings.convert.format));
+        has_converter = false;
+        return -4;
+      }
+      stats.convert_isa = converter.get_isa();
+    }
+
+    bool has_scale_size = (settings.scale.width > 0 || settings.scale.height > 0);
+    has_decoder_scaler = (true == has_scale_size && DECODE_SESSION_SCALE_DECODER == settings.scale_mode);
+    has_scaler = (true == has_scale_size && DECODE_SESSION_SCALE_CPU == settings.scale_mode);
+    if (true == has_scaler) {
+      if (0 != scaler.init(settings.scale)) {
+        printf("Cannot initialize decode session %d, failed to initialize the scaler.\n", settings.id);
+        converter.shutdown();
+        has_scaler = false;
+        return -4;
+      }
+      stats.scale_isa = scaler.get_isa();
+    }
+
+    has_writer = (false == settings.output_path.empty());
+    if (true == has_writer) {
+      if (0 != writer.init(settings.output_path, settings.write_queue_size, settings.sink_type)) {
+        printf("Cannot initialize decode session %d, failed to open %s.\n", settings.id, settings.output_path.c_str());
+        converter.shutdown();
+        scaler.shutdown();
+        has_writer = false;
+        return -5;
+      }
+    }
+
+    has_proxy_writer = (true == has_scaler && false == settings.proxy_path.empty());
+    if (true == has_proxy_writer) {
+      if (0 != proxy_writer.init(settings.proxy_path, settings.write_queue_size, settings.sink_type)) {
+        printf("Cannot initialize decode session %d, failed to open %s.\n", settings.id, settings.proxy_path.c_str());
+        converter.shutdown();
+        scaler.shutdown();
+        if (true == has_writer) {
+          writer.shutdown();
+          has_writer = false;
+        }
+        has_proxy_writer = false;
+        return -5;
+      }
+    }
+
+    if (0 != copy_pool.init(be, get_num_copy_buffers())) {
+      printf("Cannot initialize decode session %d, failed to initialize the copy pool.\n", settings.id);
+      converter.shutdown();
+      scaler.shutdown();
+      if (true == has_writer) {
+        writer.shutdown();
+        has_writer = false;
+      }
+      if (true == has_proxy_writer) {
+        proxy_writer.shutdown();
+        has_proxy_writer = false;
+      }
+      return -6;
+    }
+
+    if (0 != create_parser(be)) {
+      copy_pool.shutdown();
+      converter.shutdown();
+      scaler.shutdown();
+      if (true == has_writer) {
+        writer.shutdown();
+        has_writer = false;
+      }
+      if (true == has_proxy_writer) {
+        proxy_writer.shutdown();
+        has_proxy_writer = false;
+      }
+      return -7;
+    }
+
+    backend = be;
+
+    return 0;
+  }
+
+  int DecodeSession::shutdown() {
+
+    if (nullptr == backend) {
+      return 0;
+    }
+
+    int result = 0;
+
+    /* Let the writer finish the queued frames. */
+    if (true == has_writer) {
+      stats.is_direct = writer.is_direct();
+      if (0 != writer.shutdown()) {
+        printf("Decode session %d failed to write all frames.\n", settings.id);
+        result = -1;
+      }
+      recycle_written_pictures();
+      stats.writer = writer.get_stats();
+      has_writer = false;
+    }
+
+    if (true == has_proxy_writer) {
+      if (0 != proxy_writer.shutdown()) {
+        printf("Decode session %d failed to write all proxy frames.\n", settings.id);
+        result = -1;
+      }
+      recycle_proxy_buffers();
+      stats.proxy_writer = proxy_writer.get_stats();
+      has_proxy_writer = false;
+    }
+
+    stats.time_end_ns = get_time_ns();
+
+    converter.shutdown();
+    for (size_t i = 0; i < convert_buffers.size(); ++i) {
+      free_aligned(convert_buffers[i]->data);
+      delete convert_buffers[i];
+    }
+    convert_buffers.clear();
+    free_convert_buffers.clear();
+
+    scaler.shutdown();
+    for (size_t i = 0; i < proxy_buffers.size(); ++i) {
+      free_aligned(proxy_buffers[i]->data);
+      delete proxy_buffers[i];
+    }
+    proxy_buffers.clear();
+    free_proxy_buffers.clear();
+    has_scaler = false;
+
+    /* Must be done before we destroy the decoder as the in flight copies keep their picture mapped. */
+    stats.copy = copy_pool.get_stats();
+    stats.buffers = copy_pool.get_buffer_stats();
+    if (0 != copy_pool.shutdown()) {
+      printf("Decode session %d failed to cleanly shutdown the copy pool.\n", settings.id);
+      result = -2;
+    }
+
+    if (nullptr != parser) {
+      CUresult r = backend->destroy_parser(parser);
+      if (CUDA_SUCCESS != r) {
+        printf("Decode session %d failed to destroy the parser: %s.\n", settings.id, backend->get_error_string(r));
+        result = -3;
+      }
+      parser = nullptr;
+    }
+
+    if (nullptr != decoder) {
+      CUresult r = backend->destroy_decoder(decoder);
+      if (CUDA_SUCCESS != r) {
+        printf("Decode session %d failed to destroy the decoder: %s.\n", settings.id, backend->get_error_string(r));
+        result = -4;
+      }
+      decoder = nullptr;
+    }
+
+    backend = nullptr;
+
+    return result;
+  }
+
+  int DecodeSession::decode(const uint8_t* data, size_t nbytes) {
+    return submit(data, nbytes, ANNEXB_NO_TIMESTAMP);
+  }
+
+  int DecodeSession::decode(const AccessUnit& au) {
+    return submit(au.data, au.size, au.pts);
+  }
+
+  int DecodeSession::flush() {
+
+    if (nullptr == backend) {
+      printf("Cannot flush, session %d is not initialized.\n", settings.id);
+      return -1;
+    }
+
+    if (true == has_error) {
+      return -2;
+    }
+
+    if (0 != end_stream()) {
+      has_error = true;
+      return -3;
+    }
+
+    stats.time_decoded_ns = get_time_ns();
+
+    return 0;
+  }
+
+  int DecodeSession::move_to(DecodeBackend* be) {
+
+    if (nullptr == backend) {
+      printf("Cannot move, session %d is not initialized.\n", settings.id);
+      return -1;
+    }
+
+    if (nullptr == be) {
+      printf("Cannot move session %d, the given backend is nullptr.\n", settings.id);
+      return -2;
+    }
+
+    if (true == has_error) {
+      return -3;
+    }
+
+    if (be == backend) {
+      return 0;
+    }
+
+    /* Nothing may refer to the old device when we leave it: all pictures must be copied and written. */
+    if (0 != end_stream()) {
+      has_error = true;
+      return -4;
+    }
+
+    if (true == has_writer) {
+      WriterFrame frame;
+      while (0 == writer.wait_written(frame)) {
+        release_written(frame);
+      }
+    }
+
+    if (0 != copy_pool.shutdown()) {
+      printf("Session %d failed to cleanly shutdown the copy pool while moving.\n", settings.id);
+      has_error = true;
+      return -5;
+    }
+
+    CUresult r = backend->destroy_parser(parser);
+    parser = nullptr;
+    if (CUDA_SUCCESS != r) {
+      printf("Session %d failed to destroy the parser while moving: %s.\n", settings.id, backend->get_error_string(r));
+      has_error = true;
+      return -6;
+    }
+
+    if (nullptr != decoder && 0 != destroy_decoder()) {
+      has_error = true;
+      return -7;
+    }
+
+    /* From here on the session lives on the new device; the next sequence creates the decoder. */
+    backend = be;
+    memset((char*)&decoder_format, 0x00, sizeof(decoder_format));
+    decoder_max_width = 0;
+    decoder_max_height = 0;
+
+    if (0 != copy_pool.init(be, get_num_copy_buffers())) {
+      printf("Session %d failed to initialize the copy pool on the new device.\n", settings.id);
+      has_error = true;
+      return -8;
+    }
+
+    if (0 != create_parser(be)) {
+      has_error = true;
+      return -9;
+    }
+
+    stats.num_moves++;
+
+    return 0;
+  }
+
+  /* The parser holds the references and picture order of the old position, so we start a new one. */
+  int DecodeSession::seek(const uint8_t* parameter_sets, size_t nbytes) {
+
+    if (nullptr == backend) {
+      printf("Cannot seek, session %d is not initialized.\n", settings.id);
+      return -1;
+    }
+
+    if (true == has_error) {
+      return -2;
+    }
+
+    if (0 != end_stream()) {
+      has_error = true;
+      return -3;
+    }
+
+    pending_timestamps.clear();
+
+    CUresult r = backend->destroy_parser(parser);
+    parser = nullptr;
+    if (CUDA_SUCCESS != r) {
+      printf("Session %d failed to destroy the parser while seeking: %s.\n", settings.id, backend->get_error_string(r));
+      has_error = true;
+      return -4;
+    }
+
+    if (0 != create_parser(backend)) {
+      has_error = true;
+      return -5;
+    }
+
+    stats.num_seeks++;
+
+    if (nullptr == parameter_sets || 0 == nbytes) {
+      return 0;
+    }
+
+    if (0 != decode(parameter_sets, nbytes)) {
+      return -6;
+    }
+
+    return 0;
+  }
+
+  bool DecodeSession::has_failed() {
+    return has_error;
+  }
+
+  DecodeSessionStats DecodeSession::get_stats() {
+
+    uint64_t now_ns = get_time_ns();
+    stats.queue_depth_ns[queue_depth] += now_ns - queue_depth_start_ns;
+    queue_depth_start_ns = now_ns;
+
+    return stats;
+  }
+
+  /* ------------------------------------------------ */
+
+  int DecodeSession::on_sequence(void* user, CUVIDEOFORMAT* fmt) {
+
+    DecodeSession* session = (DecodeSession*)user;
+
+    int result = session->handle_sequence(fmt);
+    if (result <= 0) {
+      session->has_error = true;
+      return 0;
+    }
+
+    return result;
+  }
+
+  int DecodeSession::on_decode_picture(void* user, CUVIDPICPARAMS* pic) {
+
+    DecodeSession* session = (DecodeSession*)user;
+
+    if (0 != session->handle_decode_picture(pic)) {
+      session->has_error = true;
+      return 0;
+    }
+
+    return 1;
+  }
+
+  int DecodeSession::on_display_picture(void* user, CUVIDPARSERDISPINFO* info) {
+
+    DecodeSession* session = (DecodeSession*)user;
+
+    if (0 != session->handle_display_picture(info)) {
+      session->has_error = true;
+      return 0;
+    }
+
+    return 1;
+  }
+
+  /* Returns the number of decode surfaces for the parser, or 0 on error. */
+  int DecodeSession::handle_sequence(CUVIDEOFORMAT* fmt) {
+
+    TRACE_SPAN("sequence");
+
+    /*
+      The format changed. The parser displayed all pictures of the
+      previous sequence, but we may still hold some in our delay
+      queue and the copies in flight keep pictures of the old
+      decoder mapped; write those out before we reconfigure or
+      destroy it.
+    */
+    if (nullptr != decoder && true == is_current_format(fmt)) {
+      return stats.num_decode_surfaces;
+    }
+
+    if (nullptr != decoder && 0 != flush_pictures()) {
+      return 0;
+    }
+
+    if (0 != update_segment(fmt)) {
+      return 0;
+    }
+
+    if (nullptr != decoder) {
+
+      const char* reason = get_recreate_reason(fmt);
+      if (nullptr == reason) {
+        printf("Session %d: the format changed from %d x %d to %d x %d, reconfiguring the decoder.\n",
+               settings.id, stats.coded_width, stats.coded_height, fmt->coded_width, fmt->coded_height);
+        if (0 != reconfigure_decoder(fmt)) {
+          return 0;
+        }
+        return stats.num_decode_surfaces;
+      }
+
+      printf("Session %d: the format changed from %d x %d to %d x %d and %s, destroying the previous decoder.\n",
+             settings.id, stats.coded_width, stats.coded_height, fmt->coded_width, fmt->coded_height, reason);
+
+      if (0 != destroy_decoder()) {
+        return 0;
+      }
+    }
+
+    stats.coded_width = fmt->coded_width;
+    stats.coded_height = fmt->coded_height;
+
+    if (true == settings.is_verbose) {
+      printf("CUVIDEOFORMAT.Coded size: %d x %d\n", fmt->coded_width, fmt->coded_height);
+      printf("CUVIDEOFORMAT.Display area: %d %d %d %d\n", fmt->display_area.left, fmt->display_area.top, fmt->display_area.right, fmt->display_area.bottom);
+      printf("CUVIDEOFORMAT.Bitrate: %u\n", fmt->bitrate);
+    }
+
+    CUVIDDECODECAPS decode_caps;
+    memset((char*)&decode_caps, 0x00, sizeof(decode_caps));
+    decode_caps.eCodecType = fmt->codec;
+    decode_caps.eChromaFormat = fmt->chroma_format;
+    decode_caps.nBitDepthMinus8 = fmt->bit_depth_luma_minus8;
+
+    CUresult r = backend->get_decoder_caps(&decode_caps);
+    if (CUDA_SUCCESS != r) {
+      printf("Session %d failed to get the decoder caps: %s.\n", settings.id, backend->get_error_string(r));
+      return 0;
+    }
+
+    if (!decode_caps.bIsSupported) {
+      printf("Session %d: the video format is not supported by NVDECODE.\n", settings.id);
+      return 0;
+    }
+
+    if (0 != create_decoder(fmt)) {
+      return 0;
+    }
+
+    return stats.num_decode_surfaces;
+  }
+
+  int DecodeSession::handle_decode_picture(CUVIDPICPARAMS* pic) {
+
+    TRACE_SPAN_ARG("decode", pic->CurrPicIdx);
+
+    if (nullptr == decoder) {
+      printf("Session %d cannot decode a picture, the decoder is nullptr.\n", settings.id);
+      return -1;
+    }
+
+    /* The parser doesn't know about our delay queue; map what we hold before the surface gets decoded into again. */
+    for (int i = 0; i < queue_count; ++i) {
+      if (queue[(queue_read_dx + i) % DECODE_SESSION_MAX_QUEUE_SIZE].picture_index == pic->CurrPicIdx) {
+        if (0 != map_queued(i + 1)) {
+          return -3;
+        }
+        break;
+      }
+    }
+
+    uint64_t start_ns = get_time_ns();
+
+    CUresult r = backend->decode_picture(decoder, pic);
+    if (CUDA_SUCCESS != r) {
+      printf("Session %d failed to decode the picture: %s.\n", settings.id, backend->get_error_string(r));
+      return -2;
+    }
+
+    stats.decode_ns += get_time_ns() - start_ns;
+    stats.num_decoded++;
+
+    return 0;
+  }
+
+  /* Perform a delayed map, the picture leaves the queue after `queue_depth` displays. */
+  int DecodeSession::handle_display_picture(CUVIDPARSERDISPINFO* info) {
+
+    TRACE_SPAN_ARG("display", info->picture_index);
+
+    if (true == has_timestamps) {
+      update_latency(info->timestamp);
+    }
+
+    /* Make room; after the queue got shallower this maps more than one. */
+    if (queue_count > 0 && queue_count >= queue_depth) {
+      if (0 != map_queued(queue_count - queue_depth + 1)) {
+        return -1;
+      }
+    }
+
+    if (0 == queue_depth) {
+      return map_picture(info);
+    }
+
+    queue[(queue_read_dx + queue_count) % DECODE_SESSION_MAX_QUEUE_SIZE] = *info;
+    queue_count++;
+
+    return 0;
+  }
+
+  /* All state is reached through `pUserData`, that's what makes multiple sessions possible. */
+  int DecodeSession::create_parser(DecodeBackend* be) {
+
+    CUVIDPARSERPARAMS parser_params;
+    memset((void*)&parser_params, 0x00, sizeof(parser_params));
+    parser_params.CodecType = cudaVideoCodec_H264;
+    parser_params.ulMaxNumDecodeSurfaces = 1; /* The sequence callback returns the number we need. */
+    parser_params.ulClockRate = ANNEXB_CLOCK_RATE;
+    parser_params.ulErrorThreshold = 0;
+    parser_params.ulMaxDisplayDelay = get_display_delay();
+    parser_params.pUserData = this;
+    parser_params.pfnSequenceCallback = on_sequence;
+    parser_params.pfnDecodePicture = on_decode_picture;
+    parser_params.pfnDisplayPicture = on_display_picture;
+
+    CUresult r = be->create_parser(&parser, &parser_params);
+    if (CUDA_SUCCESS != r) {
+      printf("Session %d failed to create the parser: %s.\n", settings.id, be->get_error_string(r));
+      parser = nullptr;
+      return -1;
+    }
+
+    return 0;
+  }
+
+  int DecodeSession::submit(const uint8_t* data, size_t nbytes, int64_t pts) {
+
+    if (nullptr == backend) {
+      printf("Cannot decode, session %d is not initialized.\n", settings.id);
+      return -1;
+    }
+
+    if (true == has_error) {
+      return -2;
+    }
+
+    /* The parser still needs the parameter sets of the pictures we skip. */
+    if (DECODE_SESSION_FRAMES_ALL != settings.frames && true == is_picture_skipped(data, nbytes)) {
+      stats.num_skipped++;
+      stats.num_skipped_bytes += nbytes - skipped_parameter_sets.size();
+      if (true == skipped_parameter_sets.empty()) {
+        return 0;
+      }
+      data = skipped_parameter_sets.data();
+      nbytes = skipped_parameter_sets.size();
+      pts = ANNEXB_NO_TIMESTAMP;
+    }
+
+    CUVIDSOURCEDATAPACKET pkt;
+    memset((char*)&pkt, 0x00, sizeof(pkt));
+    pkt.flags = 0;
+    pkt.payload_size = (unsigned long)nbytes;
+    pkt.payload = data;
+    pkt.timestamp = 0;
+
+    /* Otherwise the parser waits for the next start code before it decodes the picture. */
+    if (DECODE_SESSION_LATENCY_LOW == settings.latency) {
+      pkt.flags |= CUVID_PKT_ENDOFPICTURE;
+    }
+
+    /* The parser may display the picture before it returns, so we remember the time first. */
+    if (ANNEXB_NO_TIMESTAMP != pts) {
+      pkt.flags |= CUVID_PKT_TIMESTAMP;
+      pkt.timestamp = pts;
+      has_timestamps = true;
+      PendingTimestamp pending;
+      pending.pts = pts;
+      pending.submit_ns = get_time_ns();
+      pending_timestamps.push_back(pending);
+      if (pending_timestamps.size() > DECODE_SESSION_MAX_PENDING_TIMESTAMPS) {
+        pending_timestamps.pop_front();
+      }
+    }
+
+    CUresult r = CUDA_SUCCESS;
+    {
+      TRACE_SPAN_ARG("parse", nbytes);
+      r = backend->parse_video_data(parser, &pkt);
+    }
+
+    if (CUDA_SUCCESS != r) {
+      printf("Decode session %d failed to parse a packet: %s.\n", settings.id, backend->get_error_string(r));
+      has_error = true;
+      return -3;
+    }
+
+    if (true == has_error) {
+      printf("Decode session %d failed to handle a packet, one of the parser callbacks failed.\n", settings.id);
+      return -4;
+    }
+
+    stats.num_packets++;
+
+    return 0;
+  }
+
+  int DecodeSession::end_stream() {
+
+    /* Let the parser know there is no more data so it will display the frames it still holds. */
+    CUVIDSOURCEDATAPACKET pkt;
+    memset((char*)&pkt, 0x00, sizeof(pkt));
+    pkt.flags = CUVID_PKT_ENDOFSTREAM;
+    pkt.payload_size = 0;
+    pkt.payload = nullptr;
+    pkt.timestamp = 0;
+
+    CUresult r = CUDA_SUCCESS;
+    {
+      TRACE_SPAN("parse");
+      r = backend->parse_video_data(parser, &pkt);
+    }
+
+    if (CUDA_SUCCESS != r) {
+      printf("Decode session %d failed to flush the parser: %s.\n", settings.id, backend->get_error_string(r));
+      return -1;
+    }
+
+    if (true == has_error) {
+      printf("Decode session %d failed to flush the parser, one of the parser callbacks failed.\n", settings.id);
+      return -2;
+    }
+
+    /* Map the pictures that are still in our delay queue and queue the frames that are still being copied. */
+    if (0 != flush_pictures()) {
+      return -3;
+    }
+
+    return 0;
+  }
+
+  /*
+    We need buffers for the copies in flight and for the frames
+    that are queued for or being written by the writer. When we
+    convert, the writer uses the convert buffers instead.
+  */
+  int DecodeSession::get_num_copy_buffers() {
+
+    int num_buffers = settings.copy_depth;
+    if (true == has_writer && false == has_converter) {
+      num_buffers += settings.write_queue_size + writer.get_max_in_flight();
+    }
+
+    return num_buffers;
+  }
+
+  /*
+    A Y4M file has one format. The pictures of the previous
+    sequence are queued for the writer when we get here, so the
+    next picture is the first one of the new segment.
+  */
+  int DecodeSession::update_segment(CUVIDEOFORMAT* fmt) {
+
+    if (CONTAINER_TYPE_Y4M != settings.container) {
+      return 0;
+    }
+
+    OutputLayout layout;
+    get_output_layout(fmt, layout);
+
+    ContainerStreamInfo info;
+    if (0 != container_get_stream_info(fmt, layout.copy.width, layout.copy.height, info)) {
+      return -1;
+    }
+
+    if (num_segment_frames > 0 && true == container_stream_info_equals(info, stream_info)) {
+      return 0;
+    }
+
+    if (0 != container_get_y4m_stream_header(info, stream_header)) {
+      return -2;
+    }
+
+    if (num_segment_frames > 0) {
+      segment++;
+      num_segment_frames = 0;
+      output_offset = 0;
+      printf("Session %d: the stream info changed, starting segment %d.\n", settings.id, segment);
+    }
+
+    stream_info = info;
+
+    return 0;
+  }
+
+  /* Starts an async copy of the picture; the picture is written once its copy is done. */
+  int DecodeSession::map_picture(CUVIDPARSERDISPINFO* info) {
+
+    CUVIDPROCPARAMS vpp;
+    unsigned int pitch = 0;
+    CUdeviceptr device_ptr = 0;
+    CopySlot* slot = nullptr;
+    CopySlot* done = nullptr;
+    uint64_t stall_ns = 0;
+    uint64_t start_ns = 0;
+
+    if (DECODE_SESSION_DOWNLOAD_SKIP == settings.download) {
+      return skip_picture(info);
+    }
+
+    recycle_written_pictures();
+
+    /* Every copy in flight holds a mapped picture, so we can't have more than `copy_depth`. */
+    while (copy_pool.get_num_in_flight() >= settings.copy_depth) {
+      start_ns = get_time_ns();
+      if (0 != copy_pool.wait(&done)) {
+        printf("Session %d failed to wait for a copy.\n", settings.id);
+        return -1;
+      }
+      stall_ns += get_time_ns() - start_ns;
+      if (0 != write_picture(done)) {
+        return -2;
+      }
+    }
+
+    /* All other buffers are queued for the writer; wait until it's done with one. */
+    while (1 == copy_pool.acquire(&slot)) {
+      WriterFrame frame;
+      start_ns = get_time_ns();
+      if (false == has_writer || 0 != writer.wait_written(frame)) {
+        printf("Session %d failed to wait for the writer.\n", settings.id);
+        return -3;
+      }
+      stall_ns += get_time_ns() - start_ns;
+      release_written(frame);
+    }
+
+    if (nullptr == slot) {
+      printf("Session %d failed to acquire a copy slot.\n", settings.id);
+      return -4;
+    }
+
+    slot->pts = (true == has_timestamps) ? info->timestamp : ANNEXB_NO_TIMESTAMP;
+
+    memset((char*)&vpp, 0x00, sizeof(vpp));
+    vpp.progressive_frame = info->progressive_frame;
+    vpp.top_field_first = info->top_field_first;
+    vpp.output_stream = slot->stream;
+
+    start_ns = get_time_ns();
+
+    CUresult r = CUDA_SUCCESS;
+    {
+      TRACE_SPAN_ARG("map", info->picture_index);
+      r = backend->map_video_frame(decoder, info->picture_index, &device_ptr, &pitch, &vpp);
+    }
+
+    if (CUDA_SUCCESS != r) {
+      printf("Session %d: mapping %d failed: %s\n", settings.id, info->picture_index, backend->get_error_string(r));
+      copy_pool.release(slot);
+      has_error = true;
+      return -5;
+    }
+
+    stall_ns += get_time_ns() - start_ns;
+
+    /* The chroma plane starts after the rows of the target size. Converted pictures get their lead in convert_picture(). */
+    const OutputArea& area = output_layout.copy;
+    size_t lead = (true == has_writer && false == has_converter) ? (size_t)(output_offset % writer.get_alignment()) : 0;
+    if (0 != copy_pool.submit(slot, decoder, device_ptr, pitch, area.left, area.top, area.width, area.height, output_layout.target_height, lead)) {
+      printf("Session %d failed to copy the decoded frame into our (cpu) buffer.\n", settings.id);
+      /* The slot only owns the picture once the copy started. */
+      r = backend->unmap_video_frame(decoder, device_ptr);
+      if (CUDA_SUCCESS != r) {
+        printf("Session %d: unmapping %d failed: %s\n", settings.id, info->picture_index, backend->get_error_string(r));
+      }
+      copy_pool.release(slot);
+      has_error = true;
+      return -6;
+    }
+
+    stats.num_crop_saved_bytes += (uint64_t)stats.coded_width * (stats.coded_height + stats.coded_height / 2) - slot->nbytes;
+
+    if (false == has_converter) {
+      output_offset += slot->nbytes;
+    }
+
+    if (true == settings.is_verbose) {
+      printf("Mapping Picture Index: %d (%llu), pitch: %u, YUV buffer size: %zu, pts: %lld\n",
+             info->picture_index, (unsigned long long)device_ptr, pitch, slot->nbytes, (long long)slot->pts);
+    }
+
+    /* Queue the frames whose copies finished while we were mapping. */
+    while (0 == copy_pool.poll(&done)) {
+      if (0 != write_picture(done)) {
+        return -7;
+      }
+    }
+
+    /* The picture is ready when its copy is, not when we map the next one. */
+    if (DECODE_SESSION_LATENCY_LOW == settings.latency) {
+      while (0 == copy_pool.wait(&done)) {
+        if (0 != write_picture(done)) {
+          return -8;
+        }
+      }
+    }
+
+    update_queue_depth(stall_ns);
+
+    return 0;
+  }
+
+  /* The map waits until the picture is decoded and post-processes it; that's all the work we measure. */
+  int DecodeSession::skip_picture(CUVIDPARSERDISPINFO* info) {
+
+    CUVIDPROCPARAMS vpp;
+    unsigned int pitch = 0;
+    CUdeviceptr device_ptr = 0;
+
+    memset((char*)&vpp, 0x00, sizeof(vpp));
+    vpp.progressive_frame = info->progressive_frame;
+    vpp.top_field_first = info->top_field_first;
+
+    uint64_t start_ns = get_time_ns();
+
+    CUresult r = CUDA_SUCCESS;
+    {
+      TRACE_SPAN_ARG("map", info->picture_index);
+      r = backend->map_video_frame(decoder, info->picture_index, &device_ptr, &pitch, &vpp);
+    }
+
+    if (CUDA_SUCCESS != r) {
+      printf("Session %d: mapping %d failed: %s\n", settings.id, info->picture_index, backend->get_error_string(r));
+      has_error = true;
+      return -1;
+    }
+
+    {
+      TRACE_SPAN_ARG("unmap", info->picture_index);
+      r = backend->unmap_video_frame(decoder, device_ptr);
+    }
+
+    if (CUDA_SUCCESS != r) {
+      printf("Session %d: unmapping %d failed: %s\n", settings.id, info->picture_index, backend->get_error_string(r));
+      has_error = true;
+      return -2;
+    }
+
+    uint64_t end_ns = get_time_ns();
+
+    stats.num_frames++;
+    if (0 == stats.time_first_frame_ns) {
+      stats.time_first_frame_ns = end_ns;
+    }
+
+    if (true == has_timestamps) {
+      update_ready_latency(info->timestamp);
+    }
+
+    if (true == settings.is_verbose) {
+      printf("Mapping Picture Index: %d (%llu), pitch: %u, skipped the copy, pts: %lld\n",
+             info->picture_index, (unsigned long long)device_ptr, pitch, (long long)info->timestamp);
+    }
+
+    update_queue_depth(end_ns - start_ns);
+
+    return 0;
+  }
+
+  /* Hands the downloaded picture to the writer thread; the slot is released once it's written. */
+  int DecodeSession::write_picture(CopySlot* slot) {
+
+    stats.num_frames++;
+
+    if (true == has_timestamps) {
+      update_ready_latency(slot->pts);
+    }
+
+    if (true == has_scaler && 0 != scale_picture(slot)) {
+      return -2;
+    }
+
+    if (true == has_converter) {
+      return convert_picture(slot);
+    }
+
+    if (false == has_writer) {
+      if (0 == stats.time_first_frame_ns) {
+        stats.time_first_frame_ns = get_time_ns();
+      }
+      return copy_pool.release(slot);
+    }
+
+    WriterFrame frame;
+    frame.data = slot->data;
+    frame.pitch = slot->pitch;
+    frame.width = slot->width;
+    frame.height = slot->height;
+    frame.num_rows = slot->height + slot->height / 2;
+    frame.segment = 0;
+    frame.lead = slot->lead;
+    frame.pts = slot->pts;
+    frame.user = slot;
+
+    if (0 != writer.push(frame)) {
+      printf("Session %d failed to queue the frame for the writer.\n", settings.id);
+      return -1;
+    }
+
+    return 0;
+  }
+
+  /* Makes the proxy of a copied picture; the copy itself goes on to the converter or writer. */
+  int DecodeSession::scale_picture(CopySlot* slot) {
+
+    ConvertBuffer* buffer = nullptr;
+    ConvertSource src;
+    ConvertTarget dst;
+    int width = 0;
+    int height = 0;
+
+    if (0 != scale_get_size(slot->width, slot->height, settings.scale.width, settings.scale.height, width, height)) {
+      printf("Session %d cannot scale %d x %d to %d x %d.\n", settings.id, slot->width, slot->height, settings.scale.width, settings.scale.height);
+      return -1;
+    }
+
+    size_t nbytes = convert_get_nbytes(CONVERT_FORMAT_NV12, width, height);
+    size_t lead = (true == has_proxy_writer) ? (size_t)(proxy_offset % proxy_writer.get_alignment()) : 0;
+    size_t capacity = COPY_POOL_MAX_LEAD + nbytes;
+
+    if (0 != acquire_proxy_buffer(&buffer)) {
+      return -2;
+    }
+
+    if (buffer->capacity < capacity) {
+      free_aligned(buffer->data);
+      buffer->capacity = 0;
+      buffer->data = (uint8_t*)alloc_aligned(capacity, COPY_POOL_MAX_LEAD);
+      if (nullptr == buffer->data) {
+        printf("Session %d failed to allocate a proxy buffer of %zu bytes.\n", settings.id, nbytes);
+        free_proxy_buffers.push_back(buffer);
+        return -3;
+      }
+      buffer->capacity = capacity;
+    }
+
+    if (0 != convert_source_init(slot->data, slot->pitch, slot->width, slot->height, src)
+        || 0 != convert_target_init(CONVERT_FORMAT_NV12, width, height, buffer->data + lead, dst))
+      {
+        free_proxy_buffers.push_back(buffer);
+        return -4;
+      }
+
+    uint64_t start_ns = get_time_ns();
+
+    if (0 != scaler.scale(src, dst, width, height)) {
+      printf("Session %d failed to scale the picture.\n", settings.id);
+      free_proxy_buffers.push_back(buffer);
+      return -5;
+    }
+
+    stats.scale_ns += get_time_ns() - start_ns;
+    stats.num_scaled++;
+    stats.proxy_width = width;
+    stats.proxy_height = height;
+
+    if (false == has_proxy_writer) {
+      free_proxy_buffers.push_back(buffer);
+      return 0;
+    }
+
+    WriterFrame frame;
+    frame.data = buffer->data + lead;
+    frame.pitch = (unsigned int)nbytes;
+    frame.width = (int)nbytes;
+    frame.height = height;
+    frame.num_rows = 1;
+    frame.segment = 0;
+    frame.lead = lead;
+    frame.pts = slot->pts;
+    frame.user = buffer;
+
+    proxy_offset += nbytes;
+
+    if (0 != proxy_writer.push(frame)) {
+      printf("Session %d failed to queue the proxy frame for the writer.\n", settings.id);
+      return -6;
+    }
+
+    return 0;
+  }
+
+  /* The lead of a converted picture depends on the converted bytes we wrote before it, so we set it here and not in map_picture(). */
+  int DecodeSession::convert_picture(CopySlot* slot) {
+
+    ConvertBuffer* buffer = nullptr;
+    ConvertSource src;
+    ConvertTarget dst;
+    int width = slot->width;
+    int height = slot->height;
+    int64_t pts = slot->pts;
+    size_t nbytes = convert_get_nbytes(settings.convert.format, width, height);
+    size_t lead = (true == has_writer) ? (size_t)(output_offset % writer.get_alignment()) : 0;
+    size_t capacity = COPY_POOL_MAX_LEAD + CONTAINER_MAX_HEADER_NBYTES + nbytes;
+    size_t header_nbytes = 0;
+
+    /* The first frame of a segment carries the stream header. */
+    if (CONTAINER_TYPE_Y4M == settings.container) {
+      header_nbytes = strlen(CONTAINER_Y4M_FRAME_HEADER);
+      if (0 == num_segment_frames) {
+        header_nbytes += stream_header.size();
+      }
+    }
+
+    if (0 != acquire_convert_buffer(&buffer)) {
+      return -1;
+    }
+
+    if (buffer->capacity < capacity) {
+      free_aligned(buffer->data);
+      buffer->capacity = 0;
+      buffer->data = (uint8_t*)alloc_aligned(capacity, COPY_POOL_MAX_LEAD);
+      if (nullptr == buffer->data) {
+        printf("Session %d failed to allocate a convert buffer of %zu bytes.\n", settings.id, nbytes);
+        free_convert_buffers.push_back(buffer);
+        return -2;
+      }
+      buffer->capacity = capacity;
+    }
+
+    uint8_t* header = buffer->data + lead;
+    if (CONTAINER_TYPE_Y4M == settings.container) {
+      size_t frame_header_nbytes = strlen(CONTAINER_Y4M_FRAME_HEADER);
+      if (0 == num_segment_frames) {
+        memcpy(header, stream_header.data(), stream_header.size());
+      }
+      memcpy(header + header_nbytes - frame_header_nbytes, CONTAINER_Y4M_FRAME_HEADER, frame_header_nbytes);
+    }
+
+    if (0 != convert_source_init(slot->data, slot->pitch, width, height, src)
+        || 0 != convert_target_init(settings.convert.format, width, height, header + header_nbytes, dst))
+      {
+        free_convert_buffers.push_back(buffer);
+        return -3;
+      }
+
+    uint64_t start_ns = get_time_ns();
+
+    if (0 != converter.convert(src, dst)) {
+      printf("Session %d failed to convert the picture.\n", settings.id);
+      free_convert_buffers.push_back(buffer);
+      return -4;
+    }
+
+    stats.convert_ns += get_time_ns() - start_ns;
+    stats.num_converted++;
+
+    copy_pool.release(slot);
+
+    if (false == has_writer) {
+      if (0 == stats.time_first_frame_ns) {
+        stats.time_first_frame_ns = get_time_ns();
+      }
+      free_convert_buffers.push_back(buffer);
+      return 0;
+    }
+
+    /* The converted picture is packed, so we hand it to the writer as one row, together with its headers. */
+    WriterFrame frame;
+    frame.data = header;
+    frame.pitch = (unsigned int)(header_nbytes + nbytes);
+    frame.width = (int)(header_nbytes + nbytes);
+    frame.height = height;
+    frame.num_rows = 1;
+    frame.segment = segment;
+    frame.lead = lead;
+    frame.pts = pts;
+    frame.user = buffer;
+
+    output_offset += header_nbytes + nbytes;
+
+    if (CONTAINER_TYPE_Y4M == settings.container) {
+      if (0 == num_segment_frames) {
+        stats.num_segments++;
+      }
+      num_segment_frames++;
+    }
+
+    if (0 != writer.push(frame)) {
+      printf("Session %d failed to queue the converted frame for the writer.\n", settings.id);
+      return -5;
+    }
+
+    return 0;
+  }
+
+  /* We create up to as many buffers as the writer can hold on to. */
+  int DecodeSession::acquire_convert_buffer(ConvertBuffer** buffer) {
+
+    int max_buffers = 1;
+    if (true == has_writer) {
+      max_buffers = settings.write_queue_size + writer.get_max_in_flight();
+    }
+
+    while (true == free_convert_buffers.empty()) {
+
+      if (convert_buffers.size() < (size_t)max_buffers) {
+        ConvertBuffer* created = new ConvertBuffer();
+        created->data = nullptr;
+        created->capacity = 0;
+        convert_buffers.push_back(created);
+        free_convert_buffers.push_back(created);
+        break;
+      }
+
+      WriterFrame frame;
+      if (false == has_writer || 0 != writer.wait_written(frame)) {
+        printf("Session %d failed to wait for a convert buffer.\n", settings.id);
+        return -1;
+      }
+
+      release_written(frame);
+    }
+
+    *buffer = free_convert_buffers.back();
+    free_convert_buffers.pop_back();
+
+    return 0;
+  }
+
+  /* Like acquire_convert_buffer(), for the proxy writer. */
+  int DecodeSession::acquire_proxy_buffer(ConvertBuffer** buffer) {
+
+    int max_buffers = 1;
+    if (true == has_proxy_writer) {
+      max_buffers = settings.write_queue_size + proxy_writer.get_max_in_flight();
+    }
+
+    while (true == free_proxy_buffers.empty()) {
+
+      if (proxy_buffers.size() < (size_t)max_buffers) {
+        ConvertBuffer* created = new ConvertBuffer();
+        created->data = nullptr;
+        created->capacity = 0;
+        proxy_buffers.push_back(created);
+        free_proxy_buffers.push_back(created);
+        break;
+      }
+
+      WriterFrame frame;
+      if (false == has_proxy_writer || 0 != proxy_writer.wait_written(frame)) {
+        printf("Session %d failed to wait for a proxy buffer.\n", settings.id);
+        return -1;
+      }
+
+      free_proxy_buffers.push_back((ConvertBuffer*)frame.user);
+    }
+
+    *buffer = free_proxy_buffers.back();
+    free_proxy_buffers.pop_back();
+
+    return 0;
+  }
+
+  int DecodeSession::recycle_proxy_buffers() {
+
+    if (false == has_proxy_writer) {
+      return 0;
+    }
+
+    WriterFrame frame;
+    int num_recycled = 0;
+
+    while (0 == proxy_writer.pop_written(frame)) {
+      free_proxy_buffers.push_back((ConvertBuffer*)frame.user);
+      num_recycled++;
+    }
+
+    return num_recycled;
+  }
+
+  int DecodeSession::release_written(const WriterFrame& frame) {
+
+    if (true == has_converter) {
+      free_convert_buffers.push_back((ConvertBuffer*)frame.user);
+      return 0;
+    }
+
+    return copy_pool.release((CopySlot*)frame.user);
+  }
+
+  int DecodeSession::recycle_written_pictures() {
+
+    recycle_proxy_buffers();
+
+    if (false == has_writer) {
+      return 0;
+    }
+
+    WriterFrame frame;
+    int num_recycled = 0;
+
+    while (0 == writer.pop_written(frame)) {
+      release_written(frame);
+      num_recycled++;
+    }
+
+    if (num_recycled > 0 && 0 == stats.time_first_frame_ns) {
+      stats.time_first_frame_ns = get_time_ns();
+    }
+
+    return num_recycled;
+  }
+
+  /* Pictures are displayed about in decode order, so the one we look for is near the front. */
+  void DecodeSession::update_latency(int64_t pts) {
+
+    stats.last_pts = pts;
+
+    for (size_t i = 0; i < pending_timestamps.size(); ++i) {
+
+      if (pending_timestamps[i].pts != pts) {
+        continue;
+      }
+
+      uint64_t latency_ns = get_time_ns() - pending_timestamps[i].submit_ns;
+      stats.num_latencies++;
+      stats.latency_ns += latency_ns;
+      if (latency_ns > stats.max_latency_ns) {
+        stats.max_latency_ns = latency_ns;
+      }
+
+      return;
+    }
+  }
+
+  void DecodeSession::update_ready_latency(int64_t pts) {
+
+    for (size_t i = 0; i < pending_timestamps.size(); ++i) {
+      if (pending_timestamps[i].pts == pts) {
+        latency_histogram_add(stats.ready_latency, get_time_ns() - pending_timestamps[i].submit_ns);
+        pending_timestamps.erase(pending_timestamps.begin() + i);
+        return;
+      }
+    }
+  }
+
+  int DecodeSession::get_display_delay() {
+    return (DECODE_SESSION_LATENCY_LOW == settings.latency) ? 0 : DECODE_SESSION_MAX_DISPLAY_DELAY;
+  }
+
+  /* The surfaces beyond what the DPB and the parser need; the queue must not hold more or the parser decodes into them. */
+  int DecodeSession::get_queue_max_depth(CUVIDEOFORMAT* fmt) {
+
+    if (DECODE_SESSION_LATENCY_LOW == settings.latency) {
+      return 0;
+    }
+
+    if (0 == fmt->min_num_decode_surfaces) {
+      return DECODE_SESSION_MAX_QUEUE_SIZE;
+    }
+
+    int num_free = stats.num_decode_surfaces - fmt->min_num_decode_surfaces - get_display_delay();
+    if (num_free < 0) {
+      return 0;
+    }
+
+    return (num_free < DECODE_SESSION_MAX_QUEUE_SIZE) ? num_free : DECODE_SESSION_MAX_QUEUE_SIZE;
+  }
+
+  /* Oldest first. */
+  int DecodeSession::map_queued(int num) {
+
+    while (num > 0 && queue_count > 0) {
+
+      CUVIDPARSERDISPINFO info = queue[queue_read_dx];
+      queue_read_dx = (queue_read_dx + 1) % DECODE_SESSION_MAX_QUEUE_SIZE;
+      queue_count--;
+      num--;
+
+      if (0 != map_picture(&info)) {
+        return -1;
+      }
+    }
+
+    return 0;
+  }
+
+  /* See the delay queue in decode-session.h. */
+  void DecodeSession::update_queue_depth(uint64_t stall_ns) {
+
+    stats.map_stall_ns += stall_ns;
+
+    if (DECODE_SESSION_LATENCY_LOW == settings.latency) {
+      return;
+    }
+
+    queue_window_stall_ns += stall_ns;
+    queue_window_count++;
+
+    if (queue_window_count < DECODE_SESSION_QUEUE_WINDOW) {
+      return;
+    }
+
+    uint64_t stall_per_picture_ns = queue_window_stall_ns / queue_window_count;
+    queue_window_stall_ns = 0;
+    queue_window_count = 0;
+
+    if (stall_per_picture_ns > DECODE_SESSION_QUEUE_GROW_NS && queue_depth < queue_max_depth) {
+      set_queue_depth(queue_depth + 1);
+    }
+    else if (stall_per_picture_ns < DECODE_SESSION_QUEUE_SHRINK_NS && queue_depth > DECODE_SESSION_MIN_QUEUE_SIZE) {
+      set_queue_depth(queue_depth - 1);
+    }
+
+    if (true == settings.is_verbose) {
+      printf("Session %d: map_picture() blocked %.3f ms per picture, delay queue depth: %d.\n",
+             settings.id, double(stall_per_picture_ns) * 1e-6, queue_depth);
+    }
+  }
+
+  void DecodeSession::set_queue_depth(int depth) {
+
+    if (depth == queue_depth) {
+      return;
+    }
+
+    uint64_t now_ns = get_time_ns();
+    stats.queue_depth_ns[queue_depth] += now_ns - queue_depth_start_ns;
+    queue_depth_start_ns = now_ns;
+    queue_depth = depth;
+
+    stats.queue_depth = depth;
+    stats.num_queue_changes++;
+    stats.min_queue_depth = (depth < stats.min_queue_depth) ? depth : stats.min_queue_depth;
+    stats.max_queue_depth = (depth > stats.max_queue_depth) ? depth : stats.max_queue_depth;
+  }
+
+  /* Oldest first. */
+  int DecodeSession::flush_pictures() {
+
+    if (0 != map_queued(queue_count)) {
+      return -1;
+    }
+
+    CopySlot* slot = nullptr;
+    while (0 == copy_pool.wait(&slot)) {
+      if (0 != write_picture(slot)) {
+        return -2;
+      }
+    }
+
+    return 0;
+  }
+
+  /* All slices of a picture have the same nal_ref_idc, but each has its own slice type. */
+  bool DecodeSession::is_picture_skipped(const uint8_t* data, size_t nbytes) {
+
+    const uint8_t* end = data + nbytes;
+    const uint8_t* sc = annexb_find_start_code(data, end);
+    bool has_slice = false;
+    bool is_skipped = false;
+
+    skipped_parameter_sets.clear();
+
+    while (sc < end) {
+
+      const uint8_t* nal = sc + 3;
+      const uint8_t* next = annexb_find_start_code(nal, end);
+      const uint8_t* nal_end = next;
+
+      /* The zero of a 4 byte start code belongs to the next NAL. */
+      while (nal_end > nal && 0x00 == nal_end[-1]) {
+        nal_end--;
+      }
+
+      if (nal_end > nal) {
+
+        int nal_type = nal[0] & 0x1F;
+        int nal_ref_idc = (nal[0] >> 5) & 0x03;
+
+        if (H264_NAL_SLICE == nal_type || H264_NAL_IDR == nal_type) {
+          has_slice = true;
+          if (DECODE_SESSION_FRAMES_REFERENCE == settings.frames && 0 == nal_ref_idc) {
+            is_skipped = true;
+          }
+          if (DECODE_SESSION_FRAMES_INTRA == settings.frames && H264_NAL_IDR != nal_type) {
+            int slice_type = h264_get_slice_type(nal, nal_end - nal);
+            if (H264_SLICE_TYPE_I != slice_type && H264_SLICE_TYPE_SI != slice_type) {
+              is_skipped = true;
+            }
+          }
+        }
+        else if (H264_NAL_SPS == nal_type || H264_NAL_PPS == nal_type) {
+          skipped_parameter_sets.insert(skipped_parameter_sets.end(), sc, nal_end);
+        }
+      }
+
+      sc = next;
+    }
+
+    return (true == has_slice && true == is_skipped);
+  }
+
+  bool DecodeSession::is_current_format(CUVIDEOFORMAT* fmt) {
+
+    const CUVIDEOFORMAT& cur = decoder_format;
+
+    return fmt->codec == cur.codec
+      && fmt->frame_rate.numerator == cur.frame_rate.numerator
+      && fmt->frame_rate.denominator == cur.frame_rate.denominator
+      && fmt->progressive_sequence == cur.progressive_sequence
+      && fmt->bit_depth_luma_minus8 == cur.bit_depth_luma_minus8
+      && fmt->bit_depth_chroma_minus8 == cur.bit_depth_chroma_minus8
+      && fmt->min_num_decode_surfaces == cur.min_num_decode_surfaces
+      && fmt->coded_width == cur.coded_width
+      && fmt->coded_height == cur.coded_height
+      && fmt->display_area.left == cur.display_area.left
+      && fmt->display_area.top == cur.display_area.top
+      && fmt->display_area.right == cur.display_area.right
+      && fmt->display_area.bottom == cur.display_area.bottom
+      && fmt->chroma_format == cur.chroma_format
+      && fmt->display_aspect_ratio.x == cur.display_aspect_ratio.x
+      && fmt->display_aspect_ratio.y == cur.display_aspect_ratio.y
+      && fmt->video_signal_description.video_full_range_flag == cur.video_signal_description.video_full_range_flag
+      && fmt->video_signal_description.matrix_coefficients == cur.video_signal_description.matrix_coefficients;
+  }
+
+  const char* DecodeSession::get_recreate_reason(CUVIDEOFORMAT* fmt) {
+
+    if (fmt->codec != decoder_format.codec) {
+      return "the codec changed";
+    }
+
+    if (fmt->chroma_format != decoder_format.chroma_format) {
+      return "the chroma format changed";
+    }
+
+    if (fmt->bit_depth_luma_minus8 != decoder_format.bit_depth_luma_minus8
+        || fmt->bit_depth_chroma_minus8 != decoder_format.bit_depth_chroma_minus8)
+      {
+        return "the bit depth changed";
+      }
+
+    if (fmt->coded_width > decoder_max_width || fmt->coded_height > decoder_max_height) {
+      return "it's larger than the max size of the decoder";
+    }
+
+    if (get_num_decode_surfaces(fmt) > stats.num_decode_surfaces) {
+      return "it needs more decode surfaces than the decoder has";
+    }
+
+    return nullptr;
+  }
+
+  /* The surfaces the DPB needs, plus the pictures the parser and our delay queue hold on to after decoding. We keep these in the low latency mode too; surfaces cost memory, not latency. */
+  int DecodeSession::get_num_decode_surfaces(CUVIDEOFORMAT* fmt) {
+
+    int num_surfaces = DECODE_SESSION_DEFAULT_DECODE_SURFACES;
+
+    if (fmt->min_num_decode_surfaces > 0) {
+      num_surfaces = fmt->min_num_decode_surfaces + DECODE_SESSION_MAX_DISPLAY_DELAY + DECODE_SESSION_MAX_QUEUE_SIZE;
+    }
+
+    if (num_surfaces > DECODE_SESSION_MAX_DECODE_SURFACES) {
+      num_surfaces = DECODE_SESSION_MAX_DECODE_SURFACES;
+    }
+
+    return num_surfaces;
+  }
+
+  void DecodeSession::get_output_area(CUVIDEOFORMAT* fmt, OutputArea& area) {
+
+    area.left = 0;
+    area.top = 0;
+    area.width = (int)fmt->coded_width;
+    area.height = (int)fmt->coded_height;
+
+    if (DECODE_SESSION_CROP_CODED == settings.crop) {
+      return;
+    }
+
+    /* NV12 has one chroma sample per 2x2 luma samples. */
+    int left = fmt->display_area.left & ~1;
+    int top = fmt->display_area.top & ~1;
+    int right = (fmt->display_area.right + 1) & ~1;
+    int bottom = (fmt->display_area.bottom + 1) & ~1;
+
+    if (right > (int)fmt->coded_width) {
+      right = (int)fmt->coded_width;
+    }
+
+    if (bottom > (int)fmt->coded_height) {
+      bottom = (int)fmt->coded_height;
+    }
+
+    /* The parser gives an empty display area when the stream has none. */
+    if (left < 0 || top < 0 || right <= left || bottom <= top) {
+      return;
+    }
+
+    area.left = left;
+    area.top = top;
+    area.width = right - left;
+    area.height = bottom - top;
+  }
+
+  /*
+    Decides what the decoder crops and scales and what we copy:
+    the decoder crops to `display` and scales that to the target
+    size, then we copy `copy` out of the target surface. When we
+    crop in the copy the decoder outputs the coded picture, unless
+    it scales; it has to crop before it scales.
+  */
+  void DecodeSession::get_output_layout(CUVIDEOFORMAT* fmt, OutputLayout& layout) {
+
+    OutputArea area;
+    get_output_area(fmt, area);
+
+    layout.display = area;
+    layout.target_width = area.width;
+    layout.target_height = area.height;
+    layout.copy.left = 0;
+    layout.copy.top = 0;
+    layout.copy.width = area.width;
+    layout.copy.height = area.height;
+
+    if (true == has_decoder_scaler) {
+      int width = 0;
+      int height = 0;
+      scale_get_size(area.width, area.height, settings.scale.width, settings.scale.height, width, height);
+      /* The decoder only makes smaller pictures; a larger target would also copy more than the coded picture. */
+      if (width > area.width || height > area.height) {
+        width = area.width;
+        height = area.height;
+      }
+      layout.target_width = width;
+      layout.target_height = height;
+      layout.copy.width = width;
+      layout.copy.height = height;
+      return;
+    }
+
+    if (DECODE_SESSION_CROP_COPY == settings.crop) {
+      layout.display.left = 0;
+      layout.display.top = 0;
+      layout.display.width = (int)fmt->coded_width;
+      layout.display.height = (int)fmt->coded_height;
+      layout.target_width = (int)fmt->coded_width;
+      layout.target_height = (int)fmt->coded_height;
+      layout.copy = area;
+    }
+  }
+
+  /* Creates the decoder with room to grow to the max size so later sequences can reconfigure it. */
+  int DecodeSession::create_decoder(CUVIDEOFORMAT* fmt) {
+
+    CUVIDDECODECREATEINFO create_info;
+    memset((char*)&create_info, 0x00, sizeof(create_info));
+    create_info.CodecType = fmt->codec;
+    create_info.ChromaFormat = fmt->chroma_format;
+    create_info.OutputFormat = (fmt->bit_depth_luma_minus8) ? cudaVideoSurfaceFormat_P016 : cudaVideoSurfaceFormat_NV12;
+    create_info.bitDepthMinus8 = fmt->bit_depth_luma_minus8;
+    create_info.DeinterlaceMode = cudaVideoDeinterlaceMode_Weave;
+    create_info.ulNumOutputSurfaces = settings.copy_depth; /* Every copy in flight keeps a picture mapped. */
+    create_info.ulNumDecodeSurfaces = get_num_decode_surfaces(fmt);
+    create_info.ulCreationFlags = cudaVideoCreate_PreferCUVID;
+    create_info.vidLock = backend->get_context_lock();    /* Shared by all sessions on this context. */
+    create_info.ulIntraDecodeOnly = (DECODE_SESSION_FRAMES_INTRA == settings.frames) ? 1 : 0;
+    create_info.ulWidth = fmt->coded_width;
+    create_info.ulHeight = fmt->coded_height;
+    create_info.ulMaxWidth = (settings.max_width > (int)fmt->coded_width) ? settings.max_width : fmt->coded_width;
+    create_info.ulMaxHeight = (settings.max_height > (int)fmt->coded_height) ? settings.max_height : fmt->coded_height;
+
+    OutputLayout layout;
+    get_output_layout(fmt, layout);
+
+    create_info.display_area.left = (short)layout.display.left;
+    create_info.display_area.top = (short)layout.display.top;
+    create_info.display_area.right = (short)(layout.display.left + layout.display.width);
+    create_info.display_area.bottom = (short)(layout.display.top + layout.display.height);
+    create_info.ulTargetWidth = layout.target_width;
+    create_info.ulTargetHeight = layout.target_height;
+
+    size_t free_before = 0;
+    size_t free_after = 0;
+    size_t total = 0;
+
+    CUresult r = backend->get_memory_info(&free_before, &total);
+    if (CUDA_SUCCESS != r) {
+      printf("Session %d failed to get the device memory info: %s.\n", settings.id, backend->get_error_string(r));
+      return -1;
+    }
+
+    uint64_t start_ns = get_time_ns();
+
+    r = backend->create_decoder(&decoder, &create_info);
+    if (CUDA_SUCCESS != r) {
+      printf("Session %d failed to create the decoder: %s.\n", settings.id, backend->get_error_string(r));
+      decoder = nullptr;
+      return -2;
+    }
+
+    stats.create_decoder_ns += get_time_ns() - start_ns;
+    stats.num_decoders_created++;
+
+    decoder_format = *fmt;
+    decoder_max_width = create_info.ulMaxWidth;
+    decoder_max_height = create_info.ulMaxHeight;
+    output_layout = layout;
+    stats.width = layout.copy.width;
+    stats.height = layout.copy.height;
+    stats.num_decode_surfaces = (int)create_info.ulNumDecodeSurfaces;
+    queue_max_depth = get_queue_max_depth(fmt);
+    if (queue_depth > queue_max_depth) {
+      set_queue_depth(queue_max_depth);
+    }
+
+    r = backend->get_memory_info(&free_after, &total);
+    if (CUDA_SUCCESS != r) {
+      printf("Session %d failed to get the device memory info: %s.\n", settings.id, backend->get_error_string(r));
+      return -3;
+    }
+
+    /* Other sessions that allocate at the same time make this off a bit. */
+    stats.decoder_vram_nbytes = (free_before > free_after) ? (free_before - free_after) : 0;
+    stats.device_total_nbytes = total;
+    if (stats.decoder_vram_nbytes > stats.peak_decoder_vram_nbytes) {
+      stats.peak_decoder_vram_nbytes = stats.decoder_vram_nbytes;
+    }
+
+    if (true == settings.is_verbose) {
+      printf("Session %d: created the decoder, max size: %lu x %lu, decode surfaces: %d (min: %d), output surfaces: %lu, VRAM: %.2f MB.\n",
+             settings.id,
+             decoder_max_width,
+             decoder_max_height,
+             stats.num_decode_surfaces,
+             (int)fmt->min_num_decode_surfaces,
+             create_info.ulNumOutputSurfaces,
+             double(stats.decoder_vram_nbytes) / (1024.0 * 1024.0));
+    }
+
+    return 0;
+  }
+
+  int DecodeSession::destroy_decoder() {
+
+    uint64_t start_ns = get_time_ns();
+
+    CUresult r = backend->destroy_decoder(decoder);
+    decoder = nullptr;
+
+    if (CUDA_SUCCESS != r) {
+      printf("Session %d failed to destroy the previous decoder: %s.\n", settings.id, backend->get_error_string(r));
+      return -1;
+    }
+
+    stats.destroy_decoder_ns += get_time_ns() - start_ns;
+    stats.num_decoders_destroyed++;
+
+    return 0;
+  }
+
+  /* All pictures of the previous sequence must be unmapped; see flush_pictures(). */
+  int DecodeSession::reconfigure_decoder(CUVIDEOFORMAT* fmt) {
+
+    CUVIDRECONFIGUREDECODERINFO reconfigure_info;
+    memset((char*)&reconfigure_info, 0x00, sizeof(reconfigure_info));
+    reconfigure_info.ulWidth = fmt->coded_width;
+    reconfigure_info.ulHeight = fmt->coded_height;
+    reconfigure_info.ulNumDecodeSurfaces = stats.num_decode_surfaces;   /* They're allocated anyway; see get_recreate_reason(). */
+
+    OutputLayout layout;
+    get_output_layout(fmt, layout);
+
+    reconfigure_info.display_area.left = (short)layout.display.left;
+    reconfigure_info.display_area.top = (short)layout.display.top;
+    reconfigure_info.display_area.right = (short)(layout.display.left + layout.display.width);
+    reconfigure_info.display_area.bottom = (short)(layout.display.top + layout.display.height);
+    reconfigure_info.ulTargetWidth = layout.target_width;
+    reconfigure_info.ulTargetHeight = layout.target_height;
+
+    uint64_t start_ns = get_time_ns();
+
+    CUresult r = backend->reconfigure_decoder(decoder, &reconfigure_info);
+    if (CUDA_SUCCESS != r) {
+      printf("Session %d failed to reconfigure the decoder: %s.\n", settings.id, backend->get_error_string(r));
+      return -1;
+    }
+
+    stats.reconfigure_decoder_ns += get_time_ns() - start_ns;
+    stats.num_decoders_reconfigured++;
+
+    decoder_format = *fmt;
+    stats.coded_width = fmt->coded_width;
+    stats.coded_height = fmt->coded_height;
+    output_layout = layout;
+    stats.width = layout.copy.width;
+    stats.height = layout.copy.height;
+    queue_max_depth = get_queue_max_depth(fmt);
+    if (queue_depth > queue_max_depth) {
+      set_queue_depth(queue_max_depth);
+    }
+
+    return 0;
+  }
+
+  /* ------------------------------------------------ */
+
+  int decode_session_crop_from_string(const std::string& name) {
+
+    if ("coded" == name) {
+      return DECODE_SESSION_CROP_CODED;
+    }
+
+    if ("decoder" == name) {
+      return DECODE_SESSION_CROP_DECODER;
+    }
+
+    if ("copy" == name) {
+      return DECODE_SESSION_CROP_COPY;
+    }
+
+    return DECODE_SESSION_CROP_NONE;
+  }
+
+  const char* decode_session_crop_to_string(int crop) {
+
+    switch (crop) {
+      case DECODE_SESSION_CROP_CODED:   { return "coded";   }
+      case DECODE_SESSION_CROP_DECODER: { return "decoder"; }
+      case DECODE_SESSION_CROP_COPY:    { return "copy";    }
+      default:                          { return "none";    }
+    }
+  }
+
+  int decode_session_scale_from_string(const std::string& name) {
+
+    if ("decoder" == name) {
+      return DECODE_SESSION_SCALE_DECODER;
+    }
+
+    if ("cpu" == name) {
+      return DECODE_SESSION_SCALE_CPU;
+    }
+
+    return DECODE_SESSION_SCALE_NONE;
+  }
+
+  const char* decode_session_scale_to_string(int scale) {
+
+    switch (scale) {
+      case DECODE_SESSION_SCALE_DECODER: { return "decoder"; }
+      case DECODE_SESSION_SCALE_CPU:     { return "cpu";     }
+      default:                           { return "none";    }
+    }
+  }
+
+  int decode_session_frames_from_string(const std::string& name) {
+
+    if ("all" == name) {
+      return DECODE_SESSION_FRAMES_ALL;
+    }
+
+    if ("reference" == name) {
+      return DECODE_SESSION_FRAMES_REFERENCE;
+    }
+
+    if ("intra" == name) {
+      return DECODE_SESSION_FRAMES_INTRA;
+    }
+
+    return DECODE_SESSION_FRAMES_NONE;
+  }
+
+  const char* decode_session_frames_to_string(int frames) {
+
+    switch (frames) {
+      case DECODE_SESSION_FRAMES_ALL:       { return "all";       }
+      case DECODE_SESSION_FRAMES_REFERENCE: { return "reference"; }
+      case DECODE_SESSION_FRAMES_INTRA:     { return "intra";     }
+      default:                              { return "none";      }
+    }
+  }
+
+  int decode_session_download_from_string(const std::string& name) {
+
+    if ("copy" == name) {
+      return DECODE_SESSION_DOWNLOAD_COPY;
+    }
+
+    if ("skip" == name) {
+      return DECODE_SESSION_DOWNLOAD_SKIP;
+    }
+
+    return DECODE_SESSION_DOWNLOAD_NONE;
+  }
+
+  const char* decode_session_download_to_string(int download) {
+
+    switch (download) {
+      case DECODE_SESSION_DOWNLOAD_COPY: { return "copy"; }
+      case DECODE_SESSION_DOWNLOAD_SKIP: { return "skip"; }
+      default:                           { return "none"; }
+    }
+  }
+
+  int decode_session_latency_from_string(const std::string& name) {
+
+    if ("throughput" == name) {
+      return DECODE_SESSION_LATENCY_THROUGHPUT;
+    }
+
+    if ("low" == name) {
+      return DECODE_SESSION_LATENCY_LOW;
+    }
+
+    return DECODE_SESSION_LATENCY_NONE;
+  }
+
+  const char* decode_session_latency_to_string(int latency) {
+
+    switch (latency) {
+      case DECODE_SESSION_LATENCY_THROUGHPUT: { return "throughput"; }
+      case DECODE_SESSION_LATENCY_LOW:        { return "low";        }
+      default:                                { return "none";       }
+    }
+  }
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
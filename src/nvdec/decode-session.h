@@ -0,0 +1,446 @@
+/*
+  DECODE SESSION
+  ==============
+
+  GENERAL INFO:
+
+    A DecodeSession decodes one H264 stream: it owns the
+    parser, the decoder, the delay queue for the displayed
+    pictures, the copy pool that downloads them and the writer
+    that writes them. All state travels through the
+    `pUserData` of the parser, so one process can run as many
+    sessions as the GPU can hold, each on its own thread.
+
+    Sessions don't own the device; they share a DecodeBackend,
+    which is one CUcontext per device. The decoders are created
+    with the context lock of the backend as `vidLock` so the
+    driver can serialize its use of the context between the
+    threads. All backend calls push the context on the calling
+    thread, so a session can be driven from any thread, but a
+    single session must only be used by one thread at a time.
+
+    When the resolution changes we write out the pictures of
+    the old sequence and reconfigure the decoder when the new
+    format allows it, otherwise we create a new one (see
+    `max_width`, `max_height`). The number of decode surfaces
+    is `min_num_decode_surfaces` of the stream plus the pictures
+    that the parser (DECODE_SESSION_MAX_DISPLAY_DELAY) and our
+    delay queue (DECODE_SESSION_MAX_QUEUE_SIZE) hold on to; the
+    sequence callback returns it so the parser uses the same
+    count.
+
+    The delay queue holds displayed pictures before we map
+    them, so the decoder can finish them meanwhile and mapping
+    doesn't block. How deep it has to be depends on the
+    resolution, the load of the GPU and how fast the sink is,
+    so it adapts: it starts at DECODE_SESSION_QUEUE_SIZE and
+    every DECODE_SESSION_QUEUE_WINDOW mapped pictures we look at
+    how long map_picture() blocked per picture, in the map
+    itself and waiting for copies and the writer. Above
+    DECODE_SESSION_QUEUE_GROW_NS the queue gets one deeper,
+    below DECODE_SESSION_QUEUE_SHRINK_NS one shallower, so we
+    only trade latency for throughput when we need to. It's
+    never deeper than the decode surfaces of the current decoder
+    allow, and it doesn't shrink below
+    DECODE_SESSION_MIN_QUEUE_SIZE; when the surfaces leave no
+    room for a queue at all the limit of the surfaces wins and
+    we map every picture as soon as it's displayed. The stats
+    have the time the queue spent at every depth; with
+    `is_verbose` we log every change.
+
+    H264 codes whole macroblocks, so a 1080p stream has a coded
+    height of 1088; the display area of the sequence tells
+    which part is the picture. By default
+    (DECODE_SESSION_CROP_DECODER) we give the decoder the display
+    area and a target size of the same size, so the output
+    surfaces only hold the picture and we copy and write nothing
+    else. DECODE_SESSION_CROP_COPY has the decoder output the
+    coded size and offsets the 2D copy instead, and
+    DECODE_SESSION_CROP_CODED writes the coded size like before.
+    The stats count the bytes we saved.
+
+    Set the `scale` size to make smaller pictures, e.g. a 320
+    wide proxy for analytics. With DECODE_SESSION_SCALE_DECODER
+    the scaler of the decoder makes them: the output surfaces
+    have the scaled size so we only copy and write those bytes;
+    it doesn't upscale, a size larger than the display area
+    gives the display area.
+    With DECODE_SESSION_SCALE_CPU we copy and write the full
+    pictures and also scale them on the CPU (see scale.h) into
+    buffers of our own that a second writer writes to
+    `proxy_path`: a full and a proxy output from one decode.
+
+    For thumbnails and scrubbing we don't need every picture.
+    With `frames` set to DECODE_SESSION_FRAMES_REFERENCE we look
+    at the NAL headers of every access unit before it goes to
+    the parser and drop the pictures with a `nal_ref_idc` of 0;
+    nothing refers to them so the other pictures still decode
+    correctly. DECODE_SESSION_FRAMES_INTRA only keeps the
+    pictures that only have I slices (IDR or not); the decoder
+    then only sees intra pictures so we create it with
+    `ulIntraDecodeOnly`, which lets the driver leave out the
+    buffers that inter prediction needs. The SPS and PPS of a
+    dropped access unit still go to the parser. In these modes
+    decode() must get whole access units.
+
+    decode() of an AccessUnit gives the parser its pts (see the
+    AnnexbTimestamper in annexb.h) and sets `ulClockRate` to
+    ANNEXB_CLOCK_RATE. The parser returns the pts of every
+    picture in display order; we keep it with the picture
+    through our delay queue, the copy and the conversion, and
+    hand it to the sinks in WriterFrame::pts. We remember when
+    each pts was submitted, so the stats have the latency from
+    decode() to the display callback of every picture.
+
+    By default (DECODE_SESSION_LATENCY_THROUGHPUT) we trade
+    latency for throughput like v3 does: the parser holds a
+    picture for DECODE_SESSION_MAX_DISPLAY_DELAY more pictures,
+    our delay queue holds a few more (see above) before
+    we map it, and we only see that a copy is done when we map
+    the next picture. For live and interactive streams use
+    DECODE_SESSION_LATENCY_LOW: the parser gets a display delay
+    of 0 and every packet is marked CUVID_PKT_ENDOFPICTURE, so
+    it decodes a picture as soon as we hand it over instead of
+    waiting for the start code of the next one; we map a picture
+    in its display callback and wait for its copy right away.
+    The parser still waits for the pictures it needs to get the
+    display order right, but streams whose SPS says there are
+    no B-frames (e.g. baseline) don't wait. decode() must get
+    whole access units in this mode. The stats have a histogram
+    of the time from decode() until a picture is in host memory,
+    in both modes.
+
+    When `output_path` is empty the frames are downloaded but
+    not written; use this to measure decode throughput without
+    the disk. The FRAME_SINK_TYPE_NULL sink also runs the
+    writer thread, and FRAME_SINK_TYPE_HASH writes a CRC per
+    frame instead of the frame. With `download` set to
+    DECODE_SESSION_DOWNLOAD_SKIP we don't even copy: every
+    picture is mapped, which waits for the decoder and
+    post-processes it, and unmapped right away. That's the speed
+    of the decoder without the bus.
+
+    seek() restarts the parser so we can continue at another
+    position in the stream: call it right before a random access
+    point with the SPS and PPS that it uses, e.g. from a
+    StreamIndex (see stream-index.h). The pictures before the
+    seek are still output. We keep the decoder when the new
+    position has the same format.
+
+    move_to() moves a session to another backend (device), e.g.
+    when the SessionScheduler finds that its device is
+    saturated. We end the stream on the current device, write
+    out everything it decoded and create a new parser on the
+    new device; the writer stays open so the output continues.
+    The new parser starts without parameter sets, so only move
+    right before an access unit that starts with an IDR and
+    carries the SPS and PPS (see ANNEXB_AU_FLAG_*). The copy and
+    buffer stats are those of the last device.
+
+    Set `convert` to write I420, RGB24 or BGRA instead of the
+    NV12 that we download (see convert.h). We convert a picture
+    as soon as its copy is done, into a buffer of our own, and
+    give its copy slot back right away; the writer writes from
+    that buffer. With a `convert.num_threads` > 1 the conversion
+    of one picture is split over that many threads. Without an
+    `output_path` we still convert, so you can measure the cost.
+
+    With `container` set to CONTAINER_TYPE_Y4M we write I420 in
+    a Y4M file whose header comes from the CUVIDEOFORMAT of the
+    sequence (see container.h). The headers are rendered into
+    the convert buffer right in front of the picture. When a new
+    sequence changes the stream info we start a new segment, a
+    new file next to `output_path`.
+
+  USAGE:
+
+    DecodeSessionSettings settings;
+    settings.output_path = "out.nv12";
+
+    DecodeSession session;
+    session.init(backend, settings);
+
+    while (ANNEXB_OK == input->next(au)) {
+      session.decode(au);
+    }
+
+    session.flush();
+    session.shutdown();
+
+    DecodeSessionStats stats = session.get_stats();
+
+ */
+#ifndef NVDEC_DECODE_SESSION_H
+#define NVDEC_DECODE_SESSION_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <nvdec/annexb.h>
+#include <nvdec/backend.h>
+#include <nvdec/container.h>
+#include <nvdec/convert.h>
+#include <nvdec/copy-pool.h>
+#include <nvdec/frame-writer.h>
+#include <nvdec/host-buffer-pool.h>
+#include <nvdec/scale.h>
+#include <nvdec/utils.h>
+
+#define DECODE_SESSION_QUEUE_SIZE 3                    /* The depth the delay queue starts with. */
+#define DECODE_SESSION_MIN_QUEUE_SIZE 1
+#define DECODE_SESSION_MAX_QUEUE_SIZE 6                /* We create the decoder with surfaces for this many. */
+#define DECODE_SESSION_QUEUE_WINDOW 16                 /* The pictures we map before we adapt the depth of the delay queue. */
+#define DECODE_SESSION_QUEUE_GROW_NS 1000000           /* Deepen the delay queue when map_picture() blocked longer than this per picture ... */
+#define DECODE_SESSION_QUEUE_SHRINK_NS 100000          /* ... and make it shallower when it blocked shorter than this. */
+#define DECODE_SESSION_MAX_DISPLAY_DELAY 1
+#define DECODE_SESSION_MAX_DECODE_SURFACES 32          /* The most decode surfaces cuvid supports. */
+#define DECODE_SESSION_DEFAULT_DECODE_SURFACES 20      /* When the parser doesn't give us min_num_decode_surfaces. */
+#define DECODE_SESSION_MAX_PENDING_TIMESTAMPS 64       /* The submitted pts we remember for the latency; pictures that are never displayed drop out. */
+
+#define DECODE_SESSION_CROP_NONE 0
+#define DECODE_SESSION_CROP_CODED 1                    /* Don't crop; write the coded size. */
+#define DECODE_SESSION_CROP_DECODER 2                  /* The decoder crops to the display area when it post-processes the picture. */
+#define DECODE_SESSION_CROP_COPY 3                     /* The decoder outputs the coded size and we only copy the display area. */
+
+#define DECODE_SESSION_SCALE_NONE 0
+#define DECODE_SESSION_SCALE_DECODER 1                 /* The decoder scales; we copy and write the scaled pictures. */
+#define DECODE_SESSION_SCALE_CPU 2                     /* We copy and write the full pictures and scale a proxy of them on the CPU. */
+
+#define DECODE_SESSION_FRAMES_NONE 0
+#define DECODE_SESSION_FRAMES_ALL 1                    /* Decode every picture. */
+#define DECODE_SESSION_FRAMES_REFERENCE 2              /* Drop the pictures that aren't used for reference. */
+#define DECODE_SESSION_FRAMES_INTRA 3                  /* Only decode the intra pictures; uses ulIntraDecodeOnly. */
+
+#define DECODE_SESSION_DOWNLOAD_NONE 0
+#define DECODE_SESSION_DOWNLOAD_COPY 1                 /* Copy every picture to host memory. */
+#define DECODE_SESSION_DOWNLOAD_SKIP 2                 /* Map and unmap every picture but don't copy it; nothing is written. */
+
+#define DECODE_SESSION_LATENCY_NONE 0
+#define DECODE_SESSION_LATENCY_THROUGHPUT 1            /* Display delay and delay queue; copies complete in the background. */
+#define DECODE_SESSION_LATENCY_LOW 2                   /* No display delay, no delay queue, end of picture per packet and we wait for every copy. */
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  struct DecodeSessionSettings {
+    DecodeSessionSettings();
+    int id;                                     /* Only used in the log messages. */
+    std::string output_path;                    /* Empty: download the frames but don't write them. */
+    int copy_depth;
+    int write_queue_size;
+    int sink_type;                              /* FRAME_SINK_TYPE_* */
+    int max_width;                              /* We can reconfigure the decoder up to this size; 0 means the size of the first sequence. */
+    int max_height;
+    ConvertSettings convert;                    /* The format we write; CONVERT_FORMAT_NV12 writes what we download. */
+    int container;                              /* CONTAINER_TYPE_*; Y4M converts to I420. */
+    int crop;                                   /* DECODE_SESSION_CROP_* */
+    ScaleSettings scale;                        /* With a width or height: the size of the scaled pictures; see `scale_mode`. */
+    int scale_mode;                             /* DECODE_SESSION_SCALE_* */
+    std::string proxy_path;                     /* Where DECODE_SESSION_SCALE_CPU writes the proxy (NV12); empty: scale but don't write. */
+    int frames;                                 /* DECODE_SESSION_FRAMES_*; which pictures we decode. */
+    int latency;                                /* DECODE_SESSION_LATENCY_* */
+    int download;                               /* DECODE_SESSION_DOWNLOAD_*; with DECODE_SESSION_DOWNLOAD_SKIP `output_path` and `proxy_path` must be empty. */
+    bool is_verbose;                            /* Log every sequence and picture. */
+  };
+
+  struct DecodeSessionStats {
+    uint64_t num_packets;
+    uint64_t num_frames;
+    uint64_t num_decoded;                       /* Pictures we handed to the decoder. */
+    uint64_t num_skipped;                       /* Access units we didn't give to the parser; see `frames`. */
+    uint64_t num_skipped_bytes;
+    uint64_t decode_ns;                         /* Time spent in decode_picture(); it blocks while the decode engine is busy, so it grows with the load of the device. */
+    uint64_t num_latencies;                     /* Displayed pictures whose pts we submitted. */
+    uint64_t latency_ns;                        /* Sum of the time from decode() to the display callback of these pictures; includes the reorder delay. */
+    uint64_t max_latency_ns;
+    int64_t last_pts;                           /* Of the last displayed picture; ANNEXB_NO_TIMESTAMP when we had none. */
+    LatencyHistogram ready_latency;             /* From decode() until the copy of the picture is done, of the pictures whose pts we submitted. */
+    int queue_depth;                            /* Of the delay queue now; 0 with DECODE_SESSION_LATENCY_LOW. */
+    int min_queue_depth;
+    int max_queue_depth;
+    int num_queue_changes;
+    uint64_t queue_depth_ns[DECODE_SESSION_MAX_QUEUE_SIZE + 1];  /* How long the delay queue had each depth, up to the last get_stats(). */
+    uint64_t map_stall_ns;                      /* Time map_picture() blocked: mapping and waiting for copies and the writer. */
+    int num_moves;                              /* See move_to(). */
+    int num_seeks;                              /* See seek(). */
+    uint64_t num_converted;                     /* Pictures we converted; 0 for NV12. */
+    uint64_t convert_ns;                        /* Time spent converting, on the decode thread. */
+    int convert_isa;                            /* CONVERT_ISA_* we used. */
+    int num_segments;                           /* The files we started; 0 for raw output. */
+    uint64_t time_start_ns;                     /* When init() was called. */
+    uint64_t time_first_frame_ns;               /* When the first frame was written (or downloaded without an output). */
+    uint64_t time_decoded_ns;                   /* When flush() was done. */
+    uint64_t time_end_ns;                       /* When shutdown() finished writing. */
+    int width;                                  /* The size of the pictures we write; the display area unless we use DECODE_SESSION_CROP_CODED. */
+    int height;
+    int coded_width;
+    int coded_height;
+    uint64_t num_crop_saved_bytes;              /* NV12 bytes of the coded pictures that we didn't copy because we cropped or the decoder scaled. */
+    int proxy_width;                            /* The size of the last proxy we scaled on the CPU. */
+    int proxy_height;
+    uint64_t num_scaled;
+    uint64_t scale_ns;                          /* Time spent scaling the proxies, on the decode thread. */
+    int scale_isa;                              /* CONVERT_ISA_* of the CPU scaler. */
+    int num_decode_surfaces;
+    int num_decoders_created;
+    int num_decoders_destroyed;
+    int num_decoders_reconfigured;
+    uint64_t create_decoder_ns;
+    uint64_t destroy_decoder_ns;
+    uint64_t reconfigure_decoder_ns;
+    uint64_t decoder_vram_nbytes;               /* Device memory of the current (or last) decoder. */
+    uint64_t peak_decoder_vram_nbytes;
+    uint64_t device_total_nbytes;
+    bool is_direct;                             /* True when the writer used O_DIRECT. */
+    CopyPoolStats copy;
+    HostBufferPoolStats buffers;
+    FrameWriterStats writer;
+    FrameWriterStats proxy_writer;
+  };
+
+  /* ------------------------------------------------ */
+
+  class DecodeSession {
+  public:
+    DecodeSession();
+    ~DecodeSession();
+    static void* operator new(size_t nbytes);                                 /* Aligned for the cache line aligned queue of our writer, which a plain new doesn't do before C++17. */
+    static void operator delete(void* ptr);
+    int init(DecodeBackend* backend, const DecodeSessionSettings& settings);
+    int shutdown();                                                           /* Writes the queued frames and destroys the parser and decoder. */
+    int decode(const uint8_t* data, size_t nbytes);                           /* Feeds one access unit (or any chunk of the stream) into the parser, without a timestamp. */
+    int decode(const AccessUnit& au);                                         /* Feeds one access unit with its pts. */
+    int flush();                                                              /* Ends the stream: the parser and our queue output all pictures and we wait for their copies. */
+    int move_to(DecodeBackend* backend);                                      /* Continues on another device; only call this before an IDR access unit with SPS and PPS. */
+    int seek(const uint8_t* parameter_sets, size_t nbytes);                   /* Outputs what we have and restarts the parser with the given SPS and PPS (Annex-B). */
+    bool has_failed();
+    DecodeSessionStats get_stats();                                           /* Complete after shutdown(). */
+
+  private:
+    struct ConvertBuffer {
+      uint8_t* data;                                                          /* Aligned to COPY_POOL_MAX_LEAD so we can leave room for the lead of the O_DIRECT sinks. */
+      size_t capacity;
+    };
+
+    struct PendingTimestamp {
+      int64_t pts;
+      uint64_t submit_ns;
+    };
+
+    struct OutputArea {
+      int left;
+      int top;
+      int width;
+      int height;
+    };
+
+    struct OutputLayout {                                                     /* What we ask the decoder for and what we copy from its output surfaces. */
+      OutputArea display;                                                     /* The display_area of the decoder, in the coded picture. */
+      int target_width;                                                       /* The size of the output surfaces. */
+      int target_height;
+      OutputArea copy;                                                        /* The part of an output surface that we copy. */
+    };
+
+    static int on_sequence(void* user, CUVIDEOFORMAT* fmt);
+    static int on_decode_picture(void* user, CUVIDPICPARAMS* pic);
+    static int on_display_picture(void* user, CUVIDPARSERDISPINFO* info);
+    int handle_sequence(CUVIDEOFORMAT* fmt);
+    int handle_decode_picture(CUVIDPICPARAMS* pic);
+    int handle_display_picture(CUVIDPARSERDISPINFO* info);
+    int create_parser(DecodeBackend* be);
+    int submit(const uint8_t* data, size_t nbytes, int64_t pts);              /* Gives a packet to the parser; `pts` can be ANNEXB_NO_TIMESTAMP. */
+    void update_latency(int64_t pts);                                         /* Called when the picture with `pts` is displayed. */
+    int skip_picture(CUVIDPARSERDISPINFO* info);                              /* map_picture() for DECODE_SESSION_DOWNLOAD_SKIP. */
+    void update_ready_latency(int64_t pts);                                   /* Called when the picture with `pts` is in host memory; forgets the pts. */
+    int get_display_delay();
+    int get_queue_max_depth(CUVIDEOFORMAT* fmt);                              /* The pictures the delay queue can hold with the decode surfaces we have. */
+    int map_queued(int num);                                                  /* Maps the `num` oldest pictures of the delay queue. */
+    void update_queue_depth(uint64_t stall_ns);                               /* Called for every mapped picture with the time map_picture() blocked. */
+    void set_queue_depth(int depth);
+    int end_stream();                                                         /* Flushes the parser and our delay queue; see flush(). */
+    int get_num_copy_buffers();
+    int update_segment(CUVIDEOFORMAT* fmt);                                   /* Starts a new segment when the stream info of the container changes. */
+    int map_picture(CUVIDPARSERDISPINFO* info);
+    int write_picture(CopySlot* slot);
+    int convert_picture(CopySlot* slot);                                      /* Converts the slot into a ConvertBuffer, releases the slot and hands the buffer to the writer. */
+    int scale_picture(CopySlot* slot);                                        /* Scales the slot into a proxy buffer and hands that to the proxy writer. */
+    int acquire_proxy_buffer(ConvertBuffer** buffer);
+    int recycle_proxy_buffers();
+    int acquire_convert_buffer(ConvertBuffer** buffer);                       /* Waits for the writer when all buffers are queued. */
+    int release_written(const WriterFrame& frame);                            /* Gives the slot or convert buffer of a written frame back. */
+    int recycle_written_pictures();
+    int flush_pictures();                                                     /* Maps the pictures in our delay queue and waits until all copies are done. */
+    bool is_picture_skipped(const uint8_t* data, size_t nbytes);              /* Returns true when `frames` drops this access unit; collects its parameter sets in `skipped_parameter_sets`. */
+    const char* get_recreate_reason(CUVIDEOFORMAT* fmt);                      /* Returns nullptr when we can reconfigure the decoder for `fmt`. */
+    bool is_current_format(CUVIDEOFORMAT* fmt);                               /* True when the decoder already has this format, e.g. after seek(). */
+    int get_num_decode_surfaces(CUVIDEOFORMAT* fmt);
+    void get_output_area(CUVIDEOFORMAT* fmt, OutputArea& area);             /* The display area, rounded out to even; the coded size when we don't crop. */
+    void get_output_layout(CUVIDEOFORMAT* fmt, OutputLayout& layout);
+    int create_decoder(CUVIDEOFORMAT* fmt);
+    int destroy_decoder();
+    int reconfigure_decoder(CUVIDEOFORMAT* fmt);
+
+  private:
+    DecodeBackend* backend;
+    DecodeSessionSettings settings;
+    CUvideoparser parser;
+    CUvideodecoder decoder;
+    CUVIDEOFORMAT decoder_format;                                             /* The format we created or reconfigured the current decoder for. */
+    unsigned long decoder_max_width;
+    unsigned long decoder_max_height;
+    OutputLayout output_layout;                                               /* Of the current decoder. */
+    CUVIDPARSERDISPINFO queue[DECODE_SESSION_MAX_QUEUE_SIZE];                 /* Delay queue; a ring of `queue_count` pictures from `queue_read_dx`, oldest first. */
+    int queue_read_dx;
+    int queue_count;
+    int queue_depth;                                                          /* We map the oldest picture when the queue holds this many. */
+    int queue_max_depth;                                                      /* See get_queue_max_depth(). */
+    int queue_window_count;                                                   /* Pictures mapped since we last adapted the depth ... */
+    uint64_t queue_window_stall_ns;                                           /* ... and how long map_picture() blocked for them. */
+    uint64_t queue_depth_start_ns;                                            /* When the queue got its current depth. */
+    CopyPool copy_pool;
+    FrameWriter writer;
+    Converter converter;
+    std::vector<ConvertBuffer*> convert_buffers;                              /* All of them; we create them when we need them. */
+    std::vector<ConvertBuffer*> free_convert_buffers;
+    Scaler scaler;
+    FrameWriter proxy_writer;
+    std::vector<ConvertBuffer*> proxy_buffers;
+    std::vector<ConvertBuffer*> free_proxy_buffers;
+    uint64_t proxy_offset;                                                    /* See `output_offset`. */
+    bool has_writer;
+    bool has_converter;
+    bool has_decoder_scaler;                                                  /* DECODE_SESSION_SCALE_DECODER with a size. */
+    bool has_scaler;                                                          /* DECODE_SESSION_SCALE_CPU with a size. */
+    bool has_proxy_writer;
+    bool has_error;
+    uint64_t output_offset;                                                   /* Bytes of the frames we submitted to the current segment; the sinks that use O_DIRECT need this to place the frames. */
+    int segment;                                                              /* See WriterFrame::segment. */
+    uint64_t num_segment_frames;                                              /* The frames we wrote to the current segment; the first one carries the stream header. */
+    ContainerStreamInfo stream_info;
+    std::string stream_header;
+    std::vector<uint8_t> skipped_parameter_sets;                              /* The SPS and PPS NALs of a skipped access unit, with start codes. */
+    std::deque<PendingTimestamp> pending_timestamps;                          /* Submitted and not yet displayed, in decode order. */
+    bool has_timestamps;                                                      /* True once we submitted a pts; before that the parser's timestamps mean nothing. */
+    DecodeSessionStats stats;
+  };
+
+  /* ------------------------------------------------ */
+
+  int decode_session_crop_from_string(const std::string& name);               /* Returns DECODE_SESSION_CROP_NONE for unknown names. */
+  const char* decode_session_crop_to_string(int crop);
+  int decode_session_scale_from_string(const std::string& name);              /* Returns DECODE_SESSION_SCALE_NONE for unknown names. */
+  const char* decode_session_scale_to_string(int scale);
+  int decode_session_frames_from_string(const std::string& name);             /* Returns DECODE_SESSION_FRAMES_NONE for unknown names. */
+  const char* decode_session_frames_to_string(int frames);
+  int decode_session_download_from_string(const std::string& name);           /* Returns DECODE_SESSION_DOWNLOAD_NONE for unknown names. */
+  const char* decode_session_download_to_string(int download);
+  int decode_session_latency_from_string(const std::string& name);            /* Returns DECODE_SESSION_LATENCY_NONE for unknown names. */
+  const char* decode_session_latency_to_string(int latency);
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
+
+#endif
@@ -0,0 +1,559 @@
+#if defined(__linux__)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <nvdec/frame-sink-direct.h>
+
+/* We only need the kernel header; without it we always use pwritev(). */
+#if defined(__has_include)
+#  if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#    include <linux/io_uring.h>
+#    define DIRECT_SINK_HAS_URING 1
+#  endif
+#endif
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+#if defined(DIRECT_SINK_HAS_URING)
+  static int sys_io_uring_setup(unsigned int entries, struct io_uring_params* params);
+  static int sys_io_uring_enter(int ring_fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags);
+#endif
+
+  /* ------------------------------------------------ */
+
+  DirectSink::DirectSink(bool uring)
+    :use_uring(uring)
+    ,has_ring(false)
+    ,has_direct(false)
+    ,fd(-1)
+    ,carry(nullptr)
+    ,carry_nbytes(0)
+    ,file_size(0)
+    ,num_completed_since_reap(0)
+    ,has_error(false)
+  {
+    memset((char*)&ring, 0x00, sizeof(ring));
+    memset((char*)&stats, 0x00, sizeof(stats));
+    ring.fd = -1;
+  }
+
+  DirectSink::~DirectSink() {
+    close();
+  }
+
+  int DirectSink::open(const std::string& filepath) {
+
+    if (fd >= 0) {
+      printf("Cannot open the direct sink, already opened. Call close() first.\n");
+      return -1;
+    }
+
+    if (0 != posix_memalign((void**)&carry, DIRECT_SINK_ALIGNMENT, DIRECT_SINK_ALIGNMENT)) {
+      printf("Cannot open the direct sink, failed to allocate the carry block.\n");
+      carry = nullptr;
+      return -2;
+    }
+
+    has_direct = true;
+    fd = ::open(filepath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+
+    if (fd < 0 && EINVAL == errno) {
+      printf("Warning: %s doesn't support O_DIRECT, we write through the page cache.\n", filepath.c_str());
+      has_direct = false;
+      fd = ::open(filepath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+
+    if (fd < 0) {
+      printf("Cannot open the direct sink, failed to open %s: %s.\n", filepath.c_str(), strerror(errno));
+      free(carry);
+      carry = nullptr;
+      return -3;
+    }
+
+    writes.resize(DIRECT_SINK_QUEUE_DEPTH);
+    free_writes.clear();
+    in_order.clear();
+
+    for (int i = DIRECT_SINK_QUEUE_DEPTH - 1; i >= 0; --i) {
+      free_writes.push_back(i);
+    }
+
+    memset((char*)&stats, 0x00, sizeof(stats));
+    carry_nbytes = 0;
+    file_size = 0;
+    num_completed_since_reap = 0;
+    has_error = false;
+    has_ring = false;
+
+    if (true == use_uring) {
+      if (0 == ring_init()) {
+        has_ring = true;
+      }
+      else {
+        printf("Warning: io_uring is not available, we fall back to pwritev().\n");
+      }
+    }
+
+    return 0;
+  }
+
+  int DirectSink::close() {
+
+    if (fd < 0) {
+      return 0;
+    }
+
+    int result = 0;
+    uint64_t num_completed = 0;
+
+    while (false == in_order.empty()) {
+      if (0 != reap(true, &num_completed)) {
+        result = -1;
+        break;
+      }
+    }
+
+    /* The last partial block: we write it with padding and cut the padding off. */
+    if (carry_nbytes > 0 && false == has_error) {
+      memset(carry + carry_nbytes, 0x00, DIRECT_SINK_ALIGNMENT - carry_nbytes);
+      if (0 != write_sync(carry, DIRECT_SINK_ALIGNMENT, file_size - carry_nbytes)) {
+        result = -2;
+      }
+    }
+
+    stats.num_syscalls++;
+    if (0 != ftruncate(fd, (off_t)file_size)) {
+      printf("Failed to truncate the output file to %llu bytes: %s.\n", (unsigned long long)file_size, strerror(errno));
+      result = -3;
+    }
+
+    ring_shutdown();
+
+    if (0 != ::close(fd)) {
+      printf("Failed to close the direct sink: %s.\n", strerror(errno));
+      result = -4;
+    }
+
+    fd = -1;
+    has_ring = false;
+    free(carry);
+    carry = nullptr;
+    carry_nbytes = 0;
+    writes.clear();
+    free_writes.clear();
+    in_order.clear();
+
+    return result;
+  }
+
+  /*
+    The frame buffer starts `lead` bytes in front of `data` at an
+    aligned address; we put the carried bytes there and write
+    all whole blocks from `data - lead`. What's left goes into
+    the carry block for the next frame.
+  */
+  int DirectSink::write(const WriterFrame& frame) {
+
+    if (fd < 0) {
+      printf("Cannot write a frame, the direct sink is not opened.\n");
+      return -1;
+    }
+
+    if (true == has_error) {
+      return -2;
+    }
+
+    if ((unsigned int)frame.width != frame.pitch) {
+      printf("Cannot write the frame, the direct sink needs packed frames (pitch %u, width %d).\n", frame.pitch, frame.width);
+      return -3;
+    }
+
+    if (frame.lead != carry_nbytes) {
+      printf("Cannot write the frame, its lead is %zu bytes but we need %zu.\n", frame.lead, carry_nbytes);
+      return -4;
+    }
+
+    uint8_t* start = (uint8_t*)frame.data - frame.lead;
+    if (0 != ((uintptr_t)start % DIRECT_SINK_ALIGNMENT)) {
+      printf("Cannot write the frame, the buffer isn't aligned to %d bytes.\n", DIRECT_SINK_ALIGNMENT);
+      return -5;
+    }
+
+    while (true == free_writes.empty()) {
+      if (0 != ring_reap(true)) {
+        return -6;
+      }
+    }
+
+    size_t nbytes = (size_t)frame.width * frame.num_rows;
+    size_t total = carry_nbytes + nbytes;
+    size_t body = total - (total % DIRECT_SINK_ALIGNMENT);
+    uint64_t offset = file_size - carry_nbytes;
+
+    memcpy(start, carry, carry_nbytes);
+    memcpy(carry, start + body, total - body);
+    carry_nbytes = total - body;
+    file_size += nbytes;
+
+    int index = free_writes.back();
+    free_writes.pop_back();
+    in_order.push_back(index);
+
+    DirectWrite& w = writes[index];
+    w.iov.iov_base = start;
+    w.iov.iov_len = body;
+    w.offset = offset;
+    w.result = 0;
+    w.is_done = false;
+
+    if (in_order.size() > stats.max_in_flight) {
+      stats.max_in_flight = in_order.size();
+    }
+
+    /* Smaller than what we need to fill the carry block. */
+    if (0 == body) {
+      w.is_done = true;
+      retire();
+      return 0;
+    }
+
+    stats.num_writes++;
+
+    if (true == has_ring) {
+      if (0 != ring_submit(index)) {
+        in_order.pop_back();
+        free_writes.push_back(index);
+        has_error = true;
+        return -7;
+      }
+      return 0;
+    }
+
+    if (0 != write_sync(start, body, offset)) {
+      in_order.pop_back();
+      free_writes.push_back(index);
+      has_error = true;
+      return -8;
+    }
+
+    w.result = (int)body;
+    w.is_done = true;
+    retire();
+
+    return 0;
+  }
+
+  int DirectSink::reap(bool must_wait, uint64_t* num_completed) {
+
+    if (nullptr == num_completed) {
+      printf("Cannot reap the direct sink, the given pointer is nullptr.\n");
+      return -1;
+    }
+
+    *num_completed = 0;
+
+    if (true == has_ring && false == in_order.empty()) {
+
+      if (0 != ring_reap(false)) {
+        return -2;
+      }
+
+      while (true == must_wait
+             && 0 == num_completed_since_reap
+             && false == in_order.empty())
+        {
+          if (0 != ring_reap(true)) {
+            return -3;
+          }
+        }
+    }
+
+    *num_completed = num_completed_since_reap;
+    num_completed_since_reap = 0;
+
+    return (true == has_error) ? -4 : 0;
+  }
+
+  int DirectSink::get_num_in_flight() {
+    return (int)in_order.size();
+  }
+
+  int DirectSink::get_max_in_flight() {
+    return DIRECT_SINK_QUEUE_DEPTH;
+  }
+
+  size_t DirectSink::get_alignment() {
+    return DIRECT_SINK_ALIGNMENT;
+  }
+
+  bool DirectSink::is_direct() {
+    return has_direct;
+  }
+
+  int DirectSink::get_type() {
+    return (true == use_uring) ? FRAME_SINK_TYPE_URING : FRAME_SINK_TYPE_PWRITEV;
+  }
+
+  FrameSinkStats DirectSink::get_stats() {
+    return stats;
+  }
+
+  /* ------------------------------------------------ */
+
+  void DirectSink::retire() {
+
+    while (false == in_order.empty()) {
+
+      DirectWrite& w = writes[in_order.front()];
+      if (false == w.is_done) {
+        break;
+      }
+
+      if (w.result < 0) {
+        printf("Failed to write %zu bytes at offset %llu: %s.\n", w.iov.iov_len, (unsigned long long)w.offset, strerror(-w.result));
+        has_error = true;
+      }
+      else if ((size_t)w.result != w.iov.iov_len) {
+        printf("Short write, wrote %d of %zu bytes at offset %llu.\n", w.result, w.iov.iov_len, (unsigned long long)w.offset);
+        has_error = true;
+      }
+
+      free_writes.push_back(in_order.front());
+      in_order.pop_front();
+      num_completed_since_reap++;
+    }
+  }
+
+  /* Blocks until everything is written; O_DIRECT may write less than we ask for. */
+  int DirectSink::write_sync(const void* data, size_t nbytes, uint64_t offset) {
+
+    struct iovec iov;
+    iov.iov_base = (void*)data;
+    iov.iov_len = nbytes;
+
+    while (iov.iov_len > 0) {
+
+      ssize_t r = pwritev(fd, &iov, 1, (off_t)offset);
+      stats.num_syscalls++;
+
+      if (r < 0 && EINTR == errno) {
+        continue;
+      }
+
+      if (r <= 0) {
+        printf("Failed to write %zu bytes at offset %llu: %s.\n", iov.iov_len, (unsigned long long)offset, strerror(errno));
+        return -1;
+      }
+
+      stats.num_bytes += (uint64_t)r;
+      iov.iov_base = (uint8_t*)iov.iov_base + r;
+      iov.iov_len -= (size_t)r;
+      offset += (uint64_t)r;
+    }
+
+    return 0;
+  }
+
+  /* ------------------------------------------------ */
+
+#if defined(DIRECT_SINK_HAS_URING)
+
+  int DirectSink::ring_init() {
+
+    struct io_uring_params params;
+    memset((char*)&params, 0x00, sizeof(params));
+
+    ring.fd = sys_io_uring_setup(DIRECT_SINK_QUEUE_DEPTH, &params);
+    if (ring.fd < 0) {
+      printf("io_uring_setup() failed: %s.\n", strerror(errno));
+      ring.fd = -1;
+      return -1;
+    }
+
+    ring.sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    ring.cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    /* Since 5.4 both rings live in one mapping. */
+    bool is_single_mmap = (0 != (params.features & IORING_FEAT_SINGLE_MMAP));
+    if (true == is_single_mmap) {
+      ring.sq_size = (ring.cq_size > ring.sq_size) ? ring.cq_size : ring.sq_size;
+      ring.cq_size = ring.sq_size;
+    }
+
+    ring.sq_ptr = mmap(nullptr, ring.sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+    if (MAP_FAILED == ring.sq_ptr) {
+      printf("Failed to map the io_uring submission ring: %s.\n", strerror(errno));
+      ring.sq_ptr = nullptr;
+      ring_shutdown();
+      return -2;
+    }
+
+    if (true == is_single_mmap) {
+      ring.cq_ptr = ring.sq_ptr;
+    }
+    else {
+      ring.cq_ptr = mmap(nullptr, ring.cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_CQ_RING);
+      if (MAP_FAILED == ring.cq_ptr) {
+        printf("Failed to map the io_uring completion ring: %s.\n", strerror(errno));
+        ring.cq_ptr = nullptr;
+        ring_shutdown();
+        return -3;
+      }
+    }
+
+    ring.sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring.sqes = (io_uring_sqe*)mmap(nullptr, ring.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+    if (MAP_FAILED == (void*)ring.sqes) {
+      printf("Failed to map the io_uring submission entries: %s.\n", strerror(errno));
+      ring.sqes = nullptr;
+      ring_shutdown();
+      return -4;
+    }
+
+    uint8_t* sq = (uint8_t*)ring.sq_ptr;
+    uint8_t* cq = (uint8_t*)ring.cq_ptr;
+    ring.sq_tail = (unsigned int*)(sq + params.sq_off.tail);
+    ring.sq_mask = (unsigned int*)(sq + params.sq_off.ring_mask);
+    ring.sq_array = (unsigned int*)(sq + params.sq_off.array);
+    ring.cq_head = (unsigned int*)(cq + params.cq_off.head);
+    ring.cq_tail = (unsigned int*)(cq + params.cq_off.tail);
+    ring.cq_mask = (unsigned int*)(cq + params.cq_off.ring_mask);
+    ring.cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    return 0;
+  }
+
+  void DirectSink::ring_shutdown() {
+
+    if (nullptr != ring.sqes) {
+      munmap(ring.sqes, ring.sqes_size);
+    }
+
+    if (nullptr != ring.cq_ptr && ring.cq_ptr != ring.sq_ptr) {
+      munmap(ring.cq_ptr, ring.cq_size);
+    }
+
+    if (nullptr != ring.sq_ptr) {
+      munmap(ring.sq_ptr, ring.sq_size);
+    }
+
+    if (ring.fd >= 0) {
+      ::close(ring.fd);
+    }
+
+    memset((char*)&ring, 0x00, sizeof(ring));
+    ring.fd = -1;
+  }
+
+  /* We're the only one who writes the tail, the kernel reads it. */
+  int DirectSink::ring_submit(int index) {
+
+    DirectWrite& w = writes[index];
+    unsigned int tail = *ring.sq_tail;
+    unsigned int dx = tail & *ring.sq_mask;
+
+    struct io_uring_sqe* sqe = &ring.sqes[dx];
+    memset((char*)sqe, 0x00, sizeof(*sqe));
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)&w.iov;
+    sqe->len = 1;
+    sqe->off = w.offset;
+    sqe->user_data = (uint64_t)index;
+
+    ring.sq_array[dx] = dx;
+    __atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    int r = -1;
+    do {
+      r = sys_io_uring_enter(ring.fd, 1, 0, 0);
+      stats.num_syscalls++;
+    } while (r < 0 && EINTR == errno);
+
+    if (1 != r) {
+      printf("Failed to submit the write to io_uring: %s.\n", (r < 0) ? strerror(errno) : "not consumed");
+      return -1;
+    }
+
+    return 0;
+  }
+
+  /* We're the only one who writes the head, the kernel writes the tail. */
+  int DirectSink::ring_reap(bool must_wait) {
+
+    if (true == must_wait) {
+
+      int r = sys_io_uring_enter(ring.fd, 0, 1, IORING_ENTER_GETEVENTS);
+      stats.num_syscalls++;
+
+      if (r < 0 && EINTR != errno) {
+        printf("Failed to wait for io_uring completions: %s.\n", strerror(errno));
+        has_error = true;
+        return -1;
+      }
+    }
+
+    unsigned int head = *ring.cq_head;
+    unsigned int tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+
+    while (head != tail) {
+
+      struct io_uring_cqe* cqe = &ring.cqes[head & *ring.cq_mask];
+      DirectWrite& w = writes[(size_t)cqe->user_data];
+      w.result = cqe->res;
+      w.is_done = true;
+
+      if (cqe->res > 0) {
+        stats.num_bytes += (uint64_t)cqe->res;
+      }
+
+      head++;
+    }
+
+    __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+
+    retire();
+
+    return 0;
+  }
+
+  static int sys_io_uring_setup(unsigned int entries, struct io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+  }
+
+  static int sys_io_uring_enter(int ring_fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags) {
+    return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0);
+  }
+
+#else
+
+  int DirectSink::ring_init() {
+    return -1;
+  }
+
+  void DirectSink::ring_shutdown() {
+  }
+
+  int DirectSink::ring_submit(int) {
+    return -1;
+  }
+
+  int DirectSink::ring_reap(bool) {
+    return -1;
+  }
+
+#endif /* DIRECT_SINK_HAS_URING */
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
+
+#endif /* __linux__ */
@@ -0,0 +1,116 @@
+/*
+  DIRECT SINK
+  ===========
+
+  GENERAL INFO:
+
+    A FrameSink that opens the file with O_DIRECT so the frames
+    go from our (page-locked) frame buffers to the disk without
+    being copied into the page cache. See frame-sink.h for how
+    we deal with the alignment that O_DIRECT needs.
+
+    With io_uring we keep up to DIRECT_SINK_QUEUE_DEPTH writes
+    in flight; submitting a write is one io_uring_enter() call
+    and completions are read from the completion ring without a
+    syscall. We don't depend on liburing: the rings are set up
+    with the io_uring_setup() syscall and mmap(). Without
+    io_uring, or when it's not allowed, every frame is written
+    with one blocking pwritev(); the writer thread still keeps
+    that off the decode thread.
+
+    Linux only.
+
+ */
+#ifndef NVDEC_FRAME_SINK_DIRECT_H
+#define NVDEC_FRAME_SINK_DIRECT_H
+
+#if defined(__linux__)
+
+#include <deque>
+#include <vector>
+#include <sys/uio.h>
+#include <nvdec/frame-sink.h>
+
+#define DIRECT_SINK_ALIGNMENT 4096     /* Covers the logical block size of all common file systems. */
+#define DIRECT_SINK_QUEUE_DEPTH 8      /* The number of writes we keep in flight with io_uring. */
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  struct DirectWrite {
+    struct iovec iov;
+    uint64_t offset;                   /* File offset, always aligned. */
+    int result;                        /* The result of the completion; < 0 is -errno. */
+    bool is_done;
+  };
+
+  /* The rings that we share with the kernel. */
+  struct DirectRing {
+    int fd;
+    void* sq_ptr;
+    size_t sq_size;
+    void* cq_ptr;
+    size_t cq_size;
+    io_uring_sqe* sqes;
+    size_t sqes_size;
+    unsigned int* sq_tail;
+    unsigned int* sq_mask;
+    unsigned int* sq_array;
+    unsigned int* cq_head;
+    unsigned int* cq_tail;
+    unsigned int* cq_mask;
+    io_uring_cqe* cqes;
+  };
+
+  /* ------------------------------------------------ */
+
+  class DirectSink : public FrameSink {
+  public:
+    DirectSink(bool use_uring);
+    ~DirectSink();
+    int open(const std::string& filepath);
+    int close();
+    int write(const WriterFrame& frame);
+    int reap(bool must_wait, uint64_t* num_completed);
+    int get_num_in_flight();
+    int get_max_in_flight();
+    size_t get_alignment();
+    bool is_direct();
+    int get_type();
+    FrameSinkStats get_stats();
+
+  private:
+    int ring_init();
+    void ring_shutdown();
+    int ring_submit(int index);
+    int ring_reap(bool must_wait);            /* Marks the writes that completed as done. */
+    void retire();                            /* Hands back the done writes at the front of `in_order`. */
+    int write_sync(const void* data, size_t nbytes, uint64_t offset);
+
+  private:
+    bool use_uring;                           /* What was asked for. */
+    bool has_ring;                            /* What we got. */
+    bool has_direct;
+    int fd;
+    DirectRing ring;
+    std::vector<DirectWrite> writes;          /* DIRECT_SINK_QUEUE_DEPTH entries. */
+    std::deque<int> in_order;                 /* Indices into `writes` in the order of the frames. */
+    std::vector<int> free_writes;
+    uint8_t* carry;                           /* The bytes of the last partial block; DIRECT_SINK_ALIGNMENT bytes, aligned. */
+    size_t carry_nbytes;
+    uint64_t file_size;                       /* The number of frame bytes we wrote or are writing. */
+    uint64_t num_completed_since_reap;
+    bool has_error;
+    FrameSinkStats stats;
+  };
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
+
+#endif /* __linux__ */
+#endif
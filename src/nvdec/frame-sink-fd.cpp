@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <nvdec/frame-sink-fd.h>
+
+#if defined(_WIN32)
+#  include <io.h>
+#  include <fcntl.h>
+#  include <sys/stat.h>
+#else
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <limits.h>
+#  include <sys/uio.h>
+#endif
+
+#if !defined(IOV_MAX)
+#  define IOV_MAX 1024
+#endif
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  FdSink::FdSink()
+    :fd(-1)
+    ,num_completed_since_reap(0)
+  {
+    memset((char*)&stats, 0x00, sizeof(stats));
+  }
+
+  FdSink::~FdSink() {
+    close();
+  }
+
+  int FdSink::open(const std::string& filepath) {
+
+    if (fd >= 0) {
+      printf("Cannot open the fd sink, already opened. Call close() first.\n");
+      return -1;
+    }
+
+#if defined(_WIN32)
+    fd = _open(filepath.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    fd = ::open(filepath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+
+    if (fd < 0) {
+      printf("Cannot open the fd sink, failed to open %s: %s.\n", filepath.c_str(), strerror(errno));
+      return -2;
+    }
+
+    memset((char*)&stats, 0x00, sizeof(stats));
+    num_completed_since_reap = 0;
+
+    return 0;
+  }
+
+  int FdSink::close() {
+
+    if (fd < 0) {
+      return 0;
+    }
+
+#if defined(_WIN32)
+    int r = _close(fd);
+#else
+    int r = ::close(fd);
+#endif
+
+    fd = -1;
+
+    if (0 != r) {
+      printf("Failed to close the fd sink: %s.\n", strerror(errno));
+      return -1;
+    }
+
+    return 0;
+  }
+
+  /* The rows are `pitch` apart; for NV12 the chroma rows follow the luma rows. */
+  int FdSink::write(const WriterFrame& frame) {
+
+    if (fd < 0) {
+      printf("Cannot write a frame, the fd sink is not opened.\n");
+      return -1;
+    }
+
+    int num_rows = frame.num_rows;
+
+    stats.num_writes++;
+    stats.max_in_flight = 1;
+
+    if ((unsigned int)frame.width == frame.pitch) {
+      if (0 != write_all(frame.data, (size_t)frame.width * num_rows)) {
+        return -2;
+      }
+      num_completed_since_reap++;
+      return 0;
+    }
+
+#if defined(_WIN32)
+    for (int j = 0; j < num_rows; ++j) {
+      if (0 != write_all(frame.data + (size_t)j * frame.pitch, frame.width)) {
+        return -3;
+      }
+    }
+#else
+    struct iovec rows[IOV_MAX];
+    int row = 0;
+
+    while (row < num_rows) {
+
+      int num_iov = 0;
+      while (num_iov < IOV_MAX && row < num_rows) {
+        rows[num_iov].iov_base = (void*)(frame.data + (size_t)row * frame.pitch);
+        rows[num_iov].iov_len = frame.width;
+        num_iov++;
+        row++;
+      }
+
+      /* When writev() doesn't write everything we continue with write() for the rest of this batch. */
+      size_t nbytes = (size_t)num_iov * frame.width;
+      ssize_t r = -1;
+
+      do {
+        r = ::writev(fd, rows, num_iov);
+      } while (r < 0 && EINTR == errno);
+
+      stats.num_syscalls++;
+
+      if (r < 0) {
+        printf("Failed to write: %s.\n", strerror(errno));
+        return -4;
+      }
+
+      stats.num_bytes += (uint64_t)r;
+
+      size_t written = (size_t)r;
+      for (int i = 0; i < num_iov && written < nbytes; ++i) {
+        size_t end = (size_t)(i + 1) * frame.width;
+        if (written >= end) {
+          continue;
+        }
+        size_t skip = frame.width - (end - written);
+        if (0 != write_all((const uint8_t*)rows[i].iov_base + skip, frame.width - skip)) {
+          return -5;
+        }
+        written = end;
+      }
+    }
+#endif
+
+    num_completed_since_reap++;
+
+    return 0;
+  }
+
+  /* Our writes are synchronous so there's never anything to wait for. */
+  int FdSink::reap(bool, uint64_t* num_completed) {
+
+    if (nullptr == num_completed) {
+      printf("Cannot reap the fd sink, the given pointer is nullptr.\n");
+      return -1;
+    }
+
+    *num_completed = num_completed_since_reap;
+    num_completed_since_reap = 0;
+
+    return 0;
+  }
+
+  int FdSink::get_num_in_flight() {
+    return 0;
+  }
+
+  int FdSink::get_max_in_flight() {
+    return 0;
+  }
+
+  size_t FdSink::get_alignment() {
+    return 1;
+  }
+
+  bool FdSink::is_direct() {
+    return false;
+  }
+
+  int FdSink::get_type() {
+    return FRAME_SINK_TYPE_FD;
+  }
+
+  FrameSinkStats FdSink::get_stats() {
+    return stats;
+  }
+
+  /* ------------------------------------------------ */
+
+  /* Loops on partial writes. */
+  int FdSink::write_all(const uint8_t* data, size_t nbytes) {
+
+    while (nbytes > 0) {
+
+#if defined(_WIN32)
+      int r = _write(fd, data, (unsigned int)nbytes);
+#else
+      ssize_t r = ::write(fd, data, nbytes);
+      if (r < 0 && EINTR == errno) {
+        continue;
+      }
+#endif
+
+      stats.num_syscalls++;
+
+      if (r <= 0) {
+        printf("Failed to write: %s.\n", strerror(errno));
+        return -1;
+      }
+
+      stats.num_bytes += (uint64_t)r;
+      data += r;
+      nbytes -= (size_t)r;
+    }
+
+    return 0;
+  }
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
@@ -0,0 +1,52 @@
+/*
+  FD SINK
+  =======
+
+  GENERAL INFO:
+
+    A FrameSink that writes to a plain file descriptor, through
+    the page cache. A packed frame (pitch == width) goes out
+    with one write() call; a pitched frame with one writev()
+    that has an iovec per row. There is no stream buffer and no
+    flush per frame. Writes are synchronous so a frame is done
+    when write() returns.
+
+ */
+#ifndef NVDEC_FRAME_SINK_FD_H
+#define NVDEC_FRAME_SINK_FD_H
+
+#include <nvdec/frame-sink.h>
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  class FdSink : public FrameSink {
+  public:
+    FdSink();
+    ~FdSink();
+    int open(const std::string& filepath);
+    int close();
+    int write(const WriterFrame& frame);
+    int reap(bool must_wait, uint64_t* num_completed);
+    int get_num_in_flight();
+    int get_max_in_flight();
+    size_t get_alignment();
+    bool is_direct();
+    int get_type();
+    FrameSinkStats get_stats();
+
+  private:
+    int write_all(const uint8_t* data, size_t nbytes);
+
+  private:
+    int fd;
+    uint64_t num_completed_since_reap;
+    FrameSinkStats stats;
+  };
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
+
+#endif
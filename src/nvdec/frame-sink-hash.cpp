@@ -0,0 +1,371 @@
+#include <string.h>
+#include <errno.h>
+#include <nvdec/annexb.h>
+#include <nvdec/frame-sink-hash.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#  define HASH_SINK_HAVE_SSE42 1
+#  include <immintrin.h>
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  endif
+#elif defined(__ARM_FEATURE_CRC32)
+#  define HASH_SINK_HAVE_ARM 1
+#  include <arm_acle.h>
+#endif
+
+#if defined(_MSC_VER)
+#  define HASH_SINK_TARGET_SSE42
+#else
+#  define HASH_SINK_TARGET_SSE42 __attribute__((target("sse4.2")))
+#endif
+
+#define HASH_SINK_CRC32C_POLY 0x82f63b78u  /* Castagnoli, reflected. */
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  static uint32_t crc32c_scalar(uint32_t crc, const uint8_t* data, size_t nbytes);
+  static const uint32_t* get_crc32c_tables();
+
+#if defined(HASH_SINK_HAVE_SSE42)
+  static uint32_t crc32c_sse42(uint32_t crc, const uint8_t* data, size_t nbytes);
+#endif
+
+#if defined(HASH_SINK_HAVE_ARM)
+  static uint32_t crc32c_arm(uint32_t crc, const uint8_t* data, size_t nbytes);
+#endif
+
+  /* ------------------------------------------------ */
+
+  HashSink::HashSink()
+    :fp(nullptr)
+    ,num_frames(0)
+    ,num_completed_since_reap(0)
+  {
+    memset((char*)&stats, 0x00, sizeof(stats));
+  }
+
+  HashSink::~HashSink() {
+    close();
+  }
+
+  int HashSink::open(const std::string& filepath) {
+
+    if (nullptr != fp) {
+      printf("Cannot open the hash sink, already opened. Call close() first.\n");
+      return -1;
+    }
+
+    fp = fopen(filepath.c_str(), "wb");
+    if (nullptr == fp) {
+      printf("Cannot open the hash sink, failed to open %s: %s.\n", filepath.c_str(), strerror(errno));
+      return -2;
+    }
+
+    memset((char*)&stats, 0x00, sizeof(stats));
+    num_frames = 0;
+    num_completed_since_reap = 0;
+
+    if (fprintf(fp, "# frame pts crc32c\n") < 0) {
+      printf("Cannot open the hash sink, failed to write to %s.\n", filepath.c_str());
+      return -3;
+    }
+
+    return 0;
+  }
+
+  int HashSink::close() {
+
+    if (nullptr == fp) {
+      return 0;
+    }
+
+    int r = fclose(fp);
+    fp = nullptr;
+
+    if (0 != r) {
+      printf("Failed to close the hash sink: %s.\n", strerror(errno));
+      return -1;
+    }
+
+    return 0;
+  }
+
+  /* Only the `width` bytes of every row, so a pitched frame hashes like a packed one. */
+  int HashSink::write(const WriterFrame& frame) {
+
+    if (nullptr == fp) {
+      printf("Cannot write a frame, the hash sink is not opened.\n");
+      return -1;
+    }
+
+    uint32_t crc = 0;
+
+    if ((unsigned int)frame.width == frame.pitch) {
+      crc = hash_sink_crc32c(crc, frame.data, (size_t)frame.width * frame.num_rows);
+    }
+    else {
+      for (int j = 0; j < frame.num_rows; ++j) {
+        crc = hash_sink_crc32c(crc, frame.data + (size_t)j * frame.pitch, frame.width);
+      }
+    }
+
+    int r = 0;
+    if (ANNEXB_NO_TIMESTAMP == frame.pts) {
+      r = fprintf(fp, "%llu - %08x\n", (unsigned long long)num_frames, crc);
+    }
+    else {
+      r = fprintf(fp, "%llu %lld %08x\n", (unsigned long long)num_frames, (long long)frame.pts, crc);
+    }
+
+    if (r < 0) {
+      printf("Failed to write the digest of frame %llu.\n", (unsigned long long)num_frames);
+      return -2;
+    }
+
+    num_frames++;
+    stats.num_writes++;
+    stats.num_bytes += (uint64_t)frame.width * frame.num_rows;
+    stats.max_in_flight = 1;
+    num_completed_since_reap++;
+
+    return 0;
+  }
+
+  int HashSink::reap(bool, uint64_t* num_completed) {
+
+    if (nullptr == num_completed) {
+      printf("Cannot reap the hash sink, the given pointer is nullptr.\n");
+      return -1;
+    }
+
+    *num_completed = num_completed_since_reap;
+    num_completed_since_reap = 0;
+
+    return 0;
+  }
+
+  int HashSink::get_num_in_flight() {
+    return 0;
+  }
+
+  int HashSink::get_max_in_flight() {
+    return 0;
+  }
+
+  size_t HashSink::get_alignment() {
+    return 1;
+  }
+
+  bool HashSink::is_direct() {
+    return false;
+  }
+
+  int HashSink::get_type() {
+    return FRAME_SINK_TYPE_HASH;
+  }
+
+  FrameSinkStats HashSink::get_stats() {
+    return stats;
+  }
+
+  /* ------------------------------------------------ */
+
+  uint32_t hash_sink_crc32c(uint32_t crc, const uint8_t* data, size_t nbytes) {
+    static int best_isa = hash_sink_get_best_isa();
+    return hash_sink_crc32c_with_isa(best_isa, crc, data, nbytes);
+  }
+
+  uint32_t hash_sink_crc32c_with_isa(int isa, uint32_t crc, const uint8_t* data, size_t nbytes) {
+
+    switch (isa) {
+#if defined(HASH_SINK_HAVE_SSE42)
+      case HASH_SINK_ISA_SSE42: {
+        return crc32c_sse42(crc, data, nbytes);
+      }
+#endif
+#if defined(HASH_SINK_HAVE_ARM)
+      case HASH_SINK_ISA_ARM: {
+        return crc32c_arm(crc, data, nbytes);
+      }
+#endif
+      default: {
+        return crc32c_scalar(crc, data, nbytes);
+      }
+    }
+  }
+
+  /* Whether the ISA is compiled in and the CPU we run on has it. */
+  bool hash_sink_is_isa_supported(int isa) {
+
+    switch (isa) {
+
+      case HASH_SINK_ISA_SCALAR: {
+        return true;
+      }
+
+      case HASH_SINK_ISA_SSE42: {
+#if defined(HASH_SINK_HAVE_SSE42) && defined(_MSC_VER)
+        int regs[4];
+        __cpuid(regs, 1);
+        return 0 != (regs[2] & (1 << 20));
+#elif defined(HASH_SINK_HAVE_SSE42)
+        return 0 != __builtin_cpu_supports("sse4.2");
+#else
+        return false;
+#endif
+      }
+
+      case HASH_SINK_ISA_ARM: {
+#if defined(HASH_SINK_HAVE_ARM)
+        return true;
+#else
+        return false;
+#endif
+      }
+    }
+
+    return false;
+  }
+
+  int hash_sink_get_best_isa() {
+
+    if (true == hash_sink_is_isa_supported(HASH_SINK_ISA_SSE42)) {
+      return HASH_SINK_ISA_SSE42;
+    }
+
+    if (true == hash_sink_is_isa_supported(HASH_SINK_ISA_ARM)) {
+      return HASH_SINK_ISA_ARM;
+    }
+
+    return HASH_SINK_ISA_SCALAR;
+  }
+
+  const char* hash_sink_isa_to_string(int isa) {
+
+    switch (isa) {
+      case HASH_SINK_ISA_SCALAR: { return "scalar"; }
+      case HASH_SINK_ISA_SSE42:  { return "sse4.2"; }
+      case HASH_SINK_ISA_ARM:    { return "armv8";  }
+      default:                   { return "none";   }
+    }
+  }
+
+  /* ------------------------------------------------ */
+
+  /* Slicing by 8: table `k` has the CRC of a byte followed by `k` zero bytes. Called once, see crc32c_scalar(). */
+  static const uint32_t* get_crc32c_tables() {
+
+    static uint32_t tables[8 * 256];
+
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t crc = i;
+      for (int j = 0; j < 8; ++j) {
+        crc = (crc >> 1) ^ ((crc & 1) ? HASH_SINK_CRC32C_POLY : 0);
+      }
+      tables[i] = crc;
+    }
+
+    for (uint32_t i = 0; i < 256; ++i) {
+      for (int k = 1; k < 8; ++k) {
+        uint32_t prev = tables[(k - 1) * 256 + i];
+        tables[k * 256 + i] = (prev >> 8) ^ tables[prev & 0xff];
+      }
+    }
+
+    return tables;
+  }
+
+  static uint32_t crc32c_scalar(uint32_t crc, const uint8_t* data, size_t nbytes) {
+
+    static const uint32_t* t = get_crc32c_tables();
+
+    crc = ~crc;
+
+    while (nbytes >= 8) {
+      uint32_t lo = crc ^ ((uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24));
+      uint32_t hi = (uint32_t)data[4] | ((uint32_t)data[5] << 8) | ((uint32_t)data[6] << 16) | ((uint32_t)data[7] << 24);
+      crc = t[7 * 256 + (lo & 0xff)]
+          ^ t[6 * 256 + ((lo >> 8) & 0xff)]
+          ^ t[5 * 256 + ((lo >> 16) & 0xff)]
+          ^ t[4 * 256 + (lo >> 24)]
+          ^ t[3 * 256 + (hi & 0xff)]
+          ^ t[2 * 256 + ((hi >> 8) & 0xff)]
+          ^ t[1 * 256 + ((hi >> 16) & 0xff)]
+          ^ t[0 * 256 + (hi >> 24)];
+      data += 8;
+      nbytes -= 8;
+    }
+
+    while (nbytes > 0) {
+      crc = (crc >> 8) ^ t[(crc ^ *data) & 0xff];
+      data++;
+      nbytes--;
+    }
+
+    return ~crc;
+  }
+
+#if defined(HASH_SINK_HAVE_SSE42)
+  HASH_SINK_TARGET_SSE42 static uint32_t crc32c_sse42(uint32_t crc, const uint8_t* data, size_t nbytes) {
+
+    crc = ~crc;
+
+#if defined(__x86_64__) || defined(_M_X64)
+    uint64_t crc64 = crc;
+    while (nbytes >= 8) {
+      uint64_t v;
+      memcpy(&v, data, 8);
+      crc64 = _mm_crc32_u64(crc64, v);
+      data += 8;
+      nbytes -= 8;
+    }
+    crc = (uint32_t)crc64;
+#endif
+
+    while (nbytes >= 4) {
+      uint32_t v;
+      memcpy(&v, data, 4);
+      crc = _mm_crc32_u32(crc, v);
+      data += 4;
+      nbytes -= 4;
+    }
+
+    while (nbytes > 0) {
+      crc = _mm_crc32_u8(crc, *data);
+      data++;
+      nbytes--;
+    }
+
+    return ~crc;
+  }
+#endif
+
+#if defined(HASH_SINK_HAVE_ARM)
+  static uint32_t crc32c_arm(uint32_t crc, const uint8_t* data, size_t nbytes) {
+
+    crc = ~crc;
+
+    while (nbytes >= 8) {
+      uint64_t v;
+      memcpy(&v, data, 8);
+      crc = __crc32cd(crc, v);
+      data += 8;
+      nbytes -= 8;
+    }
+
+    while (nbytes > 0) {
+      crc = __crc32cb(crc, *data);
+      data++;
+      nbytes--;
+    }
+
+    return ~crc;
+  }
+#endif
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
@@ -0,0 +1,88 @@
+/*
+  HASH SINK
+  =========
+
+  GENERAL INFO:
+
+    A FrameSink that writes a digest per frame instead of the
+    frame: the CRC32C (Castagnoli) of the rows we would have
+    written, so the packed planes without the pitch. Two runs
+    that give the same digest list wrote the same bytes, which
+    makes it a cheap golden output check, and the file is tiny
+    so the disk doesn't limit the throughput.
+
+    The list is text, one line per frame in the order they were
+    written, after a line that starts with `#`:
+
+      <frame> <pts> <crc32c>
+
+    `frame` counts from 0 per file, `pts` is the
+    WriterFrame::pts or `-` when unknown and the CRC is 8 hex
+    digits. Compare two lists with diff(1).
+
+    We use the CRC32 instruction of SSE 4.2 when the CPU has it
+    (checked at runtime) and the one of ARMv8 when the compiler
+    targets it; otherwise a table based version that does 8
+    bytes per step. All of them give the same CRC.
+
+  USAGE:
+
+    FrameSink* sink = frame_sink_create(FRAME_SINK_TYPE_HASH);
+    sink->open("out.crc32c");
+    sink->write(frame);
+    sink->close();
+
+    uint32_t crc = hash_sink_crc32c(0, data, nbytes);
+    crc = hash_sink_crc32c(crc, more_data, more_nbytes);  // Continues the CRC.
+
+ */
+#ifndef NVDEC_FRAME_SINK_HASH_H
+#define NVDEC_FRAME_SINK_HASH_H
+
+#include <stdio.h>
+#include <nvdec/frame-sink.h>
+
+#define HASH_SINK_ISA_NONE 0
+#define HASH_SINK_ISA_SCALAR 1
+#define HASH_SINK_ISA_SSE42 2
+#define HASH_SINK_ISA_ARM 3            /* The CRC32 extension of ARMv8. */
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  class HashSink : public FrameSink {
+  public:
+    HashSink();
+    ~HashSink();
+    int open(const std::string& filepath);
+    int close();
+    int write(const WriterFrame& frame);
+    int reap(bool must_wait, uint64_t* num_completed);
+    int get_num_in_flight();
+    int get_max_in_flight();
+    size_t get_alignment();
+    bool is_direct();
+    int get_type();
+    FrameSinkStats get_stats();
+
+  private:
+    FILE* fp;
+    uint64_t num_frames;                                     /* Written to the current file. */
+    uint64_t num_completed_since_reap;
+    FrameSinkStats stats;                                    /* `num_bytes` is what we hashed. */
+  };
+
+  /* ------------------------------------------------ */
+
+  uint32_t hash_sink_crc32c(uint32_t crc, const uint8_t* data, size_t nbytes);                   /* Start with a `crc` of 0. Uses the fastest ISA we support. */
+  uint32_t hash_sink_crc32c_with_isa(int isa, uint32_t crc, const uint8_t* data, size_t nbytes); /* Same but with the given HASH_SINK_ISA_*, which must be supported. */
+  bool hash_sink_is_isa_supported(int isa);
+  int hash_sink_get_best_isa();
+  const char* hash_sink_isa_to_string(int isa);
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
+
+#endif
@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <string.h>
+#include <nvdec/frame-sink-null.h>
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  NullSink::NullSink()
+    :is_open(false)
+    ,num_completed_since_reap(0)
+  {
+    memset((char*)&stats, 0x00, sizeof(stats));
+  }
+
+  NullSink::~NullSink() {
+    close();
+  }
+
+  int NullSink::open(const std::string&) {
+
+    if (true == is_open) {
+      printf("Cannot open the null sink, already opened. Call close() first.\n");
+      return -1;
+    }
+
+    memset((char*)&stats, 0x00, sizeof(stats));
+    num_completed_since_reap = 0;
+    is_open = true;
+
+    return 0;
+  }
+
+  int NullSink::close() {
+    is_open = false;
+    return 0;
+  }
+
+  int NullSink::write(const WriterFrame& frame) {
+
+    if (false == is_open) {
+      printf("Cannot write a frame, the null sink is not opened.\n");
+      return -1;
+    }
+
+    stats.num_writes++;
+    stats.num_bytes += (uint64_t)frame.width * frame.num_rows;
+    stats.max_in_flight = 1;
+    num_completed_since_reap++;
+
+    return 0;
+  }
+
+  int NullSink::reap(bool, uint64_t* num_completed) {
+
+    if (nullptr == num_completed) {
+      printf("Cannot reap the null sink, the given pointer is nullptr.\n");
+      return -1;
+    }
+
+    *num_completed = num_completed_since_reap;
+    num_completed_since_reap = 0;
+
+    return 0;
+  }
+
+  int NullSink::get_num_in_flight() {
+    return 0;
+  }
+
+  int NullSink::get_max_in_flight() {
+    return 0;
+  }
+
+  size_t NullSink::get_alignment() {
+    return 1;
+  }
+
+  bool NullSink::is_direct() {
+    return false;
+  }
+
+  int NullSink::get_type() {
+    return FRAME_SINK_TYPE_NULL;
+  }
+
+  FrameSinkStats NullSink::get_stats() {
+    return stats;
+  }
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
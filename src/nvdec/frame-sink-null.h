@@ -0,0 +1,49 @@
+/*
+  NULL SINK
+  =========
+
+  GENERAL INFO:
+
+    A FrameSink that drops every frame. open() doesn't create a
+    file and write() only counts the frame, so a session with
+    this sink runs the whole pipeline (copy, conversion, writer
+    thread) without the disk; use it to tell the speed of the
+    decoder from the speed of the disk. The stats count the
+    bytes we would have written, the syscalls stay 0.
+
+ */
+#ifndef NVDEC_FRAME_SINK_NULL_H
+#define NVDEC_FRAME_SINK_NULL_H
+
+#include <nvdec/frame-sink.h>
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  class NullSink : public FrameSink {
+  public:
+    NullSink();
+    ~NullSink();
+    int open(const std::string& filepath);
+    int close();
+    int write(const WriterFrame& frame);
+    int reap(bool must_wait, uint64_t* num_completed);
+    int get_num_in_flight();
+    int get_max_in_flight();
+    size_t get_alignment();
+    bool is_direct();
+    int get_type();
+    FrameSinkStats get_stats();
+
+  private:
+    bool is_open;
+    uint64_t num_completed_since_reap;
+    FrameSinkStats stats;
+  };
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
+
+#endif
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <nvdec/frame-sink.h>
+#include <nvdec/frame-sink-fd.h>
+#include <nvdec/frame-sink-null.h>
+#include <nvdec/frame-sink-hash.h>
+
+#if defined(__linux__)
+#  include <nvdec/frame-sink-direct.h>
+#endif
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  FrameSink* frame_sink_create(int type) {
+
+    switch (type) {
+      case FRAME_SINK_TYPE_FD: {
+        return new FdSink();
+      }
+      case FRAME_SINK_TYPE_NULL: {
+        return new NullSink();
+      }
+      case FRAME_SINK_TYPE_HASH: {
+        return new HashSink();
+      }
+#if defined(__linux__)
+      case FRAME_SINK_TYPE_URING: {
+        return new DirectSink(true);
+      }
+      case FRAME_SINK_TYPE_PWRITEV: {
+        return new DirectSink(false);
+      }
+#endif
+      default: {
+        printf("Cannot create a frame sink for type %d (%s).\n", type, frame_sink_type_to_string(type));
+        return nullptr;
+      }
+    }
+  }
+
+  int frame_sink_type_from_string(const std::string& name) {
+
+    if ("fd" == name) {
+      return FRAME_SINK_TYPE_FD;
+    }
+
+    if ("uring" == name) {
+      return FRAME_SINK_TYPE_URING;
+    }
+
+    if ("pwritev" == name) {
+      return FRAME_SINK_TYPE_PWRITEV;
+    }
+
+    if ("null" == name) {
+      return FRAME_SINK_TYPE_NULL;
+    }
+
+    if ("hash" == name) {
+      return FRAME_SINK_TYPE_HASH;
+    }
+
+    return FRAME_SINK_TYPE_NONE;
+  }
+
+  const char* frame_sink_type_to_string(int type) {
+
+    switch (type) {
+      case FRAME_SINK_TYPE_FD:      { return "fd";      }
+      case FRAME_SINK_TYPE_URING:   { return "uring";   }
+      case FRAME_SINK_TYPE_PWRITEV: { return "pwritev"; }
+      case FRAME_SINK_TYPE_NULL:    { return "null";    }
+      case FRAME_SINK_TYPE_HASH:    { return "hash";    }
+      default:                      { return "none";    }
+    }
+  }
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
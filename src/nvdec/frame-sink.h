@@ -0,0 +1,145 @@
+/*
+  FRAME SINK
+  ==========
+
+  GENERAL INFO:
+
+    A FrameSink is where the FrameWriter puts the decoded
+    frames: it appends them to a file. Writes can be
+    asynchronous; write() starts writing a frame and reap()
+    tells how many of the frames finished, always in the order
+    they were written. Only then may the memory of a frame be
+    reused.
+
+    FRAME_SINK_TYPE_FD:      write() / writev() on a normal
+                             file descriptor. Goes through the
+                             page cache, which means the kernel
+                             copies every byte once more. Writes
+                             are done when write() returns.
+
+    FRAME_SINK_TYPE_URING:   opens the file with O_DIRECT and
+                             keeps several writes in flight with
+                             io_uring. We don't use liburing, the
+                             ring is set up with the raw
+                             syscalls. Falls back to pwritev()
+                             when io_uring is not available
+                             (old kernel, seccomp). Linux only.
+
+    FRAME_SINK_TYPE_PWRITEV: opens the file with O_DIRECT and
+                             writes with one pwritev() per frame.
+                             Linux only.
+
+    FRAME_SINK_TYPE_NULL:    drops the frames and doesn't create
+                             a file; for throughput numbers
+                             without the disk.
+
+    FRAME_SINK_TYPE_HASH:    writes a CRC32C per frame to a
+                             small text file instead of the
+                             frame; for golden output checks
+                             (see frame-sink-hash.h).
+
+    O_DIRECT needs the memory, the file offset and the size of
+    every write aligned to the block size of the file system
+    (get_alignment()). A frame in the file starts wherever the
+    previous one stopped, so it's not aligned; to write it
+    without copying it into a bounce buffer the buffer of the
+    frame has `lead` bytes in front of `data` with `data -
+    lead` aligned. The sink puts the bytes of the last,
+    partial, block of the previous frame there so that the
+    buffer starts at an aligned file offset, writes all the
+    whole blocks straight from the frame buffer and keeps the
+    remaining bytes for the next frame. `lead` must be the
+    number of bytes that were written before the frame modulo
+    get_alignment(); the CopyPool can place a frame like this.
+    When the file is closed we write the last block with
+    padding and truncate the file to its real size.
+
+    The O_DIRECT sinks need packed frames (pitch == width). On
+    file systems that don't support O_DIRECT (e.g. tmpfs) we
+    open the file without it and print a warning.
+
+  USAGE:
+
+    FrameSink* sink = frame_sink_create(FRAME_SINK_TYPE_URING);
+    sink->open("out.nv12");
+
+    frame.lead = bytes_written % sink->get_alignment();
+    sink->write(frame);
+    bytes_written += frame_nbytes;
+
+    uint64_t num_completed = 0;
+    sink->reap(false, &num_completed);  // Hand back `num_completed` frames.
+
+    while (sink->get_num_in_flight() > 0) {
+      sink->reap(true, &num_completed);
+    }
+
+    sink->close();
+    delete sink;
+
+ */
+#ifndef NVDEC_FRAME_SINK_H
+#define NVDEC_FRAME_SINK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+#define FRAME_SINK_TYPE_NONE 0
+#define FRAME_SINK_TYPE_FD 1
+#define FRAME_SINK_TYPE_URING 2
+#define FRAME_SINK_TYPE_PWRITEV 3
+#define FRAME_SINK_TYPE_NULL 4
+#define FRAME_SINK_TYPE_HASH 5
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  struct WriterFrame {
+    const uint8_t* data;          /* NV12: `height` rows of luma followed by `height / 2` rows of interleaved chroma. */
+    unsigned int pitch;
+    int width;                    /* The bytes we write of every row. */
+    int height;
+    int num_rows;                 /* The rows we write, `pitch` bytes apart; `height + height / 2` for NV12. */
+    int segment;                  /* The file the FrameWriter writes the frame to; see frame_writer_get_segment_path(). */
+    size_t lead;                  /* The number of bytes in front of `data` that the sink may overwrite; see above. */
+    int64_t pts;                  /* Presentation time in ANNEXB_CLOCK_RATE ticks, ANNEXB_NO_TIMESTAMP when unknown; see annexb.h. */
+    void* user;
+  };
+
+  struct FrameSinkStats {
+    uint64_t num_syscalls;        /* Every call into the kernel to write, including io_uring_enter(). */
+    uint64_t num_writes;          /* Write requests, e.g. one per frame. */
+    uint64_t num_bytes;           /* Bytes written to the file; includes the padding of the last block. */
+    uint64_t max_in_flight;       /* The most writes that were in flight at the same time. */
+  };
+
+  /* ------------------------------------------------ */
+
+  class FrameSink {
+  public:
+    virtual ~FrameSink() {}
+    virtual int open(const std::string& filepath) = 0;
+    virtual int close() = 0;                                       /* Waits for the writes that are in flight and closes the file. */
+    virtual int write(const WriterFrame& frame) = 0;               /* Starts writing the frame. When this fails the frame wasn't taken. */
+    virtual int reap(bool must_wait, uint64_t* num_completed) = 0; /* Sets the number of frames that finished since the last call; blocks for at least one when `must_wait` is true and a write is in flight. */
+    virtual int get_num_in_flight() = 0;
+    virtual int get_max_in_flight() = 0;                           /* The most frames the sink holds on to; size your buffer pool for it. */
+    virtual size_t get_alignment() = 0;                            /* See WriterFrame::lead; 1 when the sink doesn't care. */
+    virtual bool is_direct() = 0;                                  /* True when the file was opened with O_DIRECT. */
+    virtual int get_type() = 0;
+    virtual FrameSinkStats get_stats() = 0;
+  };
+
+  /* ------------------------------------------------ */
+
+  FrameSink* frame_sink_create(int type);                          /* Returns nullptr when the type isn't supported on this platform. */
+  int frame_sink_type_from_string(const std::string& name);        /* Returns FRAME_SINK_TYPE_NONE for unknown names. */
+  const char* frame_sink_type_to_string(int type);
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
+
+#endif
@@ -0,0 +1,453 @@
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <nvdec/frame-writer.h>
+#include <nvdec/trace.h>
+#include <nvdec/utils.h>
+
+#define WRITER_NUM_SPINS 64           /* Yield this many times before we start sleeping when the decode thread has to wait. */
+#define WRITER_SLEEP_US 100
+#define WRITER_REAP_US 100            /* How often an idle writer reaps the writes that are in flight. */
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  static void backoff(int& num_waits);
+  static void add_sink_stats(FrameSinkStats& total, const FrameSinkStats& stats);
+
+  /* ------------------------------------------------ */
+
+  FrameWriter::FrameWriter()
+    :sink(nullptr)
+    ,segment(0)
+    ,num_segments(0)
+    ,num_handed_back(0)
+    ,num_done(0)
+    ,must_stop(false)
+    ,is_waiting(false)
+    ,has_error(false)
+    ,num_frames(0)
+    ,num_bytes(0)
+    ,write_ns(0)
+    ,active_ns(0)
+    ,cpu_ns(0)
+    ,is_init(false)
+  {
+    memset((char*)&stats, 0x00, sizeof(stats));
+    memset((char*)&closed_sink_stats, 0x00, sizeof(closed_sink_stats));
+  }
+
+  FrameWriter::~FrameWriter() {
+    shutdown();
+  }
+
+  int FrameWriter::init(const std::string& path, int capacity, int sink_type) {
+
+    if (true == is_init) {
+      printf("Cannot initialize the frame writer, already initialized. Call shutdown() first.\n");
+      return -1;
+    }
+
+    if (capacity <= 0) {
+      printf("Cannot initialize the frame writer, invalid capacity %d.\n", capacity);
+      return -2;
+    }
+
+    sink = frame_sink_create(sink_type);
+    if (nullptr == sink) {
+      printf("Cannot initialize the frame writer, failed to create the %s sink.\n", frame_sink_type_to_string(sink_type));
+      return -3;
+    }
+
+    if (0 != sink->open(path)) {
+      delete sink;
+      sink = nullptr;
+      return -4;
+    }
+
+    if (0 != queue.init(capacity)) {
+      sink->close();
+      delete sink;
+      sink = nullptr;
+      return -5;
+    }
+
+    memset((char*)&stats, 0x00, sizeof(stats));
+    memset((char*)&closed_sink_stats, 0x00, sizeof(closed_sink_stats));
+    filepath = path;
+    segment = 0;
+    num_segments = 1;
+    must_stop = false;
+    is_waiting = false;
+    has_error = false;
+    num_frames = 0;
+    num_bytes = 0;
+    write_ns = 0;
+    active_ns = 0;
+    cpu_ns = 0;
+    num_done = 0;
+    num_handed_back = 0;
+    pushed.clear();
+    is_init = true;
+
+    thread = std::thread(&FrameWriter::run, this);
+
+    return 0;
+  }
+
+  int FrameWriter::shutdown() {
+
+    if (false == is_init) {
+      return 0;
+    }
+
+    must_stop = true;
+    wake_up();
+
+    if (true == thread.joinable()) {
+      thread.join();
+    }
+
+    /* Writes the last partial block of the O_DIRECT sinks. */
+    if (0 != sink->close()) {
+      has_error = true;
+    }
+
+    stats.sink = closed_sink_stats;
+    add_sink_stats(stats.sink, sink->get_stats());
+    delete sink;
+    sink = nullptr;
+    is_init = false;
+
+    return (true == has_error) ? -1 : 0;
+  }
+
+  int FrameWriter::push(const WriterFrame& frame) {
+
+    if (false == is_init) {
+      printf("Cannot push a frame, the writer is not initialized.\n");
+      return -1;
+    }
+
+    if (true == has_error) {
+      return -2;
+    }
+
+    uint64_t occupancy = queue.size();
+    stats.num_pushes++;
+    stats.total_occupancy += occupancy;
+    if (occupancy > stats.max_occupancy) {
+      stats.max_occupancy = occupancy;
+    }
+
+    if (false == queue.push(frame)) {
+
+      uint64_t t0 = get_time_ns();
+      int num_waits = 0;
+
+      while (false == queue.push(frame)) {
+        if (true == has_error) {
+          return -3;
+        }
+        backoff(num_waits);
+      }
+
+      stats.producer_stall_ns += get_time_ns() - t0;
+      stats.num_producer_stalls++;
+    }
+
+    /* Pairs with the fence in wait_for_frames(): either we see that the writer sleeps, or it sees our frame. */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (true == is_waiting.load(std::memory_order_relaxed)) {
+      wake_up();
+    }
+
+    pushed.push_back(frame);
+
+    return 0;
+  }
+
+  /* The acquire load makes sure the writer is done reading the frame before we hand it back. */
+  int FrameWriter::pop_written(WriterFrame& frame) {
+
+    if (true == pushed.empty()) {
+      return 1;
+    }
+
+    if (num_done.load(std::memory_order_acquire) <= num_handed_back) {
+      return 1;
+    }
+
+    frame = pushed.front();
+    pushed.pop_front();
+    num_handed_back++;
+
+    return 0;
+  }
+
+  int FrameWriter::wait_written(WriterFrame& frame) {
+
+    if (true == pushed.empty()) {
+      return 1;
+    }
+
+    if (0 == pop_written(frame)) {
+      return 0;
+    }
+
+    uint64_t t0 = get_time_ns();
+    int num_waits = 0;
+
+    while (1 == pop_written(frame)) {
+      backoff(num_waits);
+    }
+
+    stats.producer_stall_ns += get_time_ns() - t0;
+    stats.num_producer_stalls++;
+
+    return 0;
+  }
+
+  int FrameWriter::get_occupancy() {
+    return (int)queue.size();
+  }
+
+  int FrameWriter::get_max_in_flight() {
+    return (nullptr != sink) ? sink->get_max_in_flight() : 0;
+  }
+
+  size_t FrameWriter::get_alignment() {
+    return (nullptr != sink) ? sink->get_alignment() : 1;
+  }
+
+  bool FrameWriter::is_direct() {
+    return (nullptr != sink) ? sink->is_direct() : false;
+  }
+
+  FrameWriterStats FrameWriter::get_stats() {
+
+    FrameWriterStats result = stats;
+    result.num_frames = num_frames;
+    result.num_bytes = num_bytes;
+    result.write_ns = write_ns;
+    result.active_ns = active_ns;
+    result.cpu_ns = cpu_ns;
+    result.num_segments = num_segments;
+
+    return result;
+  }
+
+  /* ------------------------------------------------ */
+
+  /*
+    We only stop when the queue is empty and nothing is in flight
+    so every pushed frame gets written. After an error we still
+    pop the frames but drop them.
+  */
+  void FrameWriter::run() {
+
+    WriterFrame frame;
+    uint64_t first_write_ns = 0;
+
+    trace_set_thread_name("writer");
+
+    while (true) {
+
+      if (false == queue.pop(frame)) {
+
+        if (sink->get_num_in_flight() > 0) {
+          reap(false);
+        }
+
+        if (false == must_stop) {
+          wait_for_frames();
+          continue;
+        }
+
+        /* Pushes that happened before `must_stop` was set are visible now. */
+        if (false == queue.pop(frame)) {
+          break;
+        }
+      }
+
+      if (true == has_error) {
+        drain();
+        num_done.fetch_add(1, std::memory_order_release);
+        continue;
+      }
+
+      if (frame.segment != segment && 0 != open_segment(frame.segment)) {
+        printf("The frame writer failed to open segment %d, dropping the following frames.\n", frame.segment);
+        has_error = true;
+        num_done.fetch_add(1, std::memory_order_release);
+        continue;
+      }
+
+      uint64_t t0 = get_time_ns();
+      if (0 == first_write_ns) {
+        first_write_ns = t0;
+      }
+
+      int r = 0;
+      {
+        TRACE_SPAN("sink_write");
+        r = sink->write(frame);
+      }
+
+      if (0 != r) {
+        printf("The frame writer failed to write a frame, dropping the following frames.\n");
+        has_error = true;
+        drain();
+        num_done.fetch_add(1, std::memory_order_release);
+        continue;
+      }
+
+      write_ns += get_time_ns() - t0;
+      num_bytes += (uint64_t)frame.width * frame.num_rows;
+      num_frames++;
+
+      reap(false);
+    }
+
+    drain();
+
+    if (0 != first_write_ns) {
+      active_ns = get_time_ns() - first_write_ns;
+    }
+
+    cpu_ns = get_thread_cpu_time_ns();
+  }
+
+  /* The frames of the previous segment must be on disk before we close its file. */
+  int FrameWriter::open_segment(int index) {
+
+    drain();
+
+    if (true == has_error) {
+      return -1;
+    }
+
+    add_sink_stats(closed_sink_stats, sink->get_stats());
+
+    if (0 != sink->close()) {
+      return -2;
+    }
+
+    segment = index;
+
+    if (0 != sink->open(frame_writer_get_segment_path(filepath, index))) {
+      return -3;
+    }
+
+    num_segments++;
+
+    return 0;
+  }
+
+  /* Returns the number of frames that completed. */
+  uint64_t FrameWriter::reap(bool must_wait) {
+
+    uint64_t num_completed = 0;
+
+    if (0 != sink->reap(must_wait, &num_completed)) {
+      if (false == has_error) {
+        printf("The frame writer failed to write a frame, dropping the following frames.\n");
+      }
+      has_error = true;
+    }
+
+    if (num_completed > 0) {
+      num_done.fetch_add(num_completed, std::memory_order_release);
+    }
+
+    return num_completed;
+  }
+
+  /* When the sink fails without completing anything we give up and hand back the frames that are in flight so the decode thread doesn't wait forever. */
+  void FrameWriter::drain() {
+
+    while (sink->get_num_in_flight() > 0) {
+      if (0 == reap(true) && true == has_error) {
+        num_done.fetch_add((uint64_t)sink->get_num_in_flight(), std::memory_order_release);
+        break;
+      }
+    }
+  }
+
+  void FrameWriter::wait_for_frames() {
+
+    std::unique_lock<std::mutex> lock(wake_mutex);
+
+    is_waiting.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (0 == queue.size() && false == must_stop) {
+      if (sink->get_num_in_flight() > 0) {
+        wake_cond.wait_for(lock, std::chrono::microseconds(WRITER_REAP_US));
+      }
+      else {
+        wake_cond.wait(lock);
+      }
+    }
+
+    is_waiting.store(false, std::memory_order_relaxed);
+  }
+
+  /* Taking the mutex makes sure the writer is either still awake or already waiting, so the notify can't get lost. */
+  void FrameWriter::wake_up() {
+
+    {
+      std::lock_guard<std::mutex> lock(wake_mutex);
+    }
+
+    wake_cond.notify_one();
+  }
+
+  /* ------------------------------------------------ */
+
+  std::string frame_writer_get_segment_path(const std::string& filepath, int segment) {
+
+    if (0 == segment) {
+      return filepath;
+    }
+
+    /* Only a dot in the file name starts the extension. */
+    size_t slash = filepath.find_last_of("/\\");
+    size_t dot = filepath.find_last_of('.');
+    std::string index = "." + std::to_string(segment);
+
+    if (std::string::npos == dot || (std::string::npos != slash && dot < slash)) {
+      return filepath + index;
+    }
+
+    return filepath.substr(0, dot) + index + filepath.substr(dot);
+  }
+
+  /* ------------------------------------------------ */
+
+  static void backoff(int& num_waits) {
+
+    if (num_waits < WRITER_NUM_SPINS) {
+      num_waits++;
+      std::this_thread::yield();
+      return;
+    }
+
+    std::this_thread::sleep_for(std::chrono::microseconds(WRITER_SLEEP_US));
+  }
+
+  static void add_sink_stats(FrameSinkStats& total, const FrameSinkStats& stats) {
+
+    total.num_syscalls += stats.num_syscalls;
+    total.num_writes += stats.num_writes;
+    total.num_bytes += stats.num_bytes;
+
+    if (stats.max_in_flight > total.max_in_flight) {
+      total.max_in_flight = stats.max_in_flight;
+    }
+  }
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
@@ -0,0 +1,167 @@
+/*
+  FRAME WRITER
+  ============
+
+  GENERAL INFO:
+
+    Writes decoded frames to a file on its own thread so a slow
+    disk doesn't stall the parser and decoder. The decode thread
+    pushes a WriterFrame (a pointer to a downloaded or converted
+    picture plus its pitch and number of rows) into a SpscQueue;
+    the writer thread pops it, writes the rows (for NV12 the
+    visible rows of the luma and chroma planes) and bumps an
+    atomic counter. Frames are
+    written in the order they were pushed, so the decode thread
+    only needs that counter to know which of its pushed frames
+    are done; it takes them back with pop_written() or
+    wait_written() and can then reuse the memory (e.g. release
+    the CopySlot that's stored in `user`). The memory of a frame
+    must stay valid until it's been handed back.
+
+    The writing itself is done by a FrameSink (see
+    frame-sink.h) that you select with the `sink_type` of
+    init(). The FRAME_SINK_TYPE_FD sink writes every frame with
+    one syscall through the page cache; the O_DIRECT sinks
+    bypass the page cache and can keep several writes in
+    flight. With an async sink a frame is only handed back once
+    its write completed. For the O_DIRECT sinks, set the `lead`
+    of every frame to the number of bytes you pushed before it
+    modulo get_alignment(). The number of syscalls, the time
+    between the first write and the last completion and the
+    CPU time of the writer thread are part of the stats.
+
+    A stream can be split over several files, e.g. because the
+    container can't change its format mid-file: give the frames
+    of the next file a higher `segment` and the writer closes
+    the current file and opens frame_writer_get_segment_path()
+    of the path given to init() before it writes them. Segment
+    0 is the path itself. Every file starts at offset 0, so the
+    `lead` of the first frame of a segment is 0.
+
+    An idle writer sleeps on a condition variable; push() only
+    takes the mutex to wake it when it's sleeping, so a busy
+    writer costs the decode thread no lock. While writes of an
+    async sink are in flight the writer also wakes every
+    WRITER_REAP_US to reap them.
+
+    push() applies backpressure: when the queue is full it
+    blocks until the writer made room. The time we block, and
+    the queue occupancy at the moment of every push, are kept
+    in the FrameWriterStats so you can see whether the queue is
+    deep enough for your disk.
+
+  USAGE:
+
+    FrameWriter writer;
+    writer.init("out.nv12", 8, FRAME_SINK_TYPE_FD);
+
+    WriterFrame frame;
+    frame.data = slot->data;
+    frame.pitch = slot->pitch;
+    frame.width = coded_width;
+    frame.height = coded_height;
+    frame.num_rows = coded_height + coded_height / 2;
+    frame.segment = 0;
+    frame.lead = slot->lead;
+    frame.pts = slot->pts;
+    frame.user = slot;
+    writer.push(frame);
+
+    while (0 == writer.pop_written(frame)) {
+      copy_pool.release((CopySlot*)frame.user);
+    }
+
+    writer.shutdown();  // Writes all queued frames and joins the thread.
+
+ */
+#ifndef NVDEC_FRAME_WRITER_H
+#define NVDEC_FRAME_WRITER_H
+
+#include <stdint.h>
+#include <string>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <nvdec/spsc-queue.h>
+#include <nvdec/frame-sink.h>
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  struct FrameWriterStats {
+    uint64_t num_frames;          /* Frames that have been written. */
+    uint64_t num_bytes;
+    uint64_t write_ns;            /* Time the writer thread spent in FrameSink::write(). */
+    uint64_t active_ns;           /* Time between the first write and the last completion. */
+    uint64_t cpu_ns;              /* CPU time of the writer thread. */
+    uint64_t num_pushes;
+    uint64_t max_occupancy;       /* The most frames that were queued when we pushed. */
+    uint64_t total_occupancy;     /* Sum of the number of queued frames at each push; divide by `num_pushes` for the average. */
+    uint64_t num_producer_stalls; /* The number of times the decode thread had to wait for the writer. */
+    uint64_t producer_stall_ns;
+    int num_segments;             /* The files we opened. */
+    FrameSinkStats sink;          /* Of all segments. */
+  };
+
+  /* ------------------------------------------------ */
+
+  class FrameWriter {
+  public:
+    FrameWriter();
+    ~FrameWriter();
+    int init(const std::string& filepath, int capacity, int sink_type);
+    int shutdown();                                  /* Writes the queued frames, joins the thread and closes the file. Written frames can still be taken with pop_written(). */
+    int push(const WriterFrame& frame);              /* Blocks while the queue is full. Returns < 0 when the writer failed. */
+    int pop_written(WriterFrame& frame);             /* Returns 0 when we handed back a frame, 1 when there is none. */
+    int wait_written(WriterFrame& frame);            /* Blocks until a frame has been written; returns 1 when nothing is queued. */
+    int get_occupancy();
+    int get_max_in_flight();                         /* The most frames the sink holds on to besides the queued ones. */
+    size_t get_alignment();                          /* See WriterFrame::lead. */
+    bool is_direct();                                /* True when the sink bypasses the page cache. */
+    FrameWriterStats get_stats();                    /* The writer side counters are only exact after shutdown(). */
+
+  private:
+    void run();
+    int open_segment(int segment);                   /* Closes the current file and opens the one of `segment`. */
+    uint64_t reap(bool must_wait);                   /* Counts the frames whose writes completed as done. */
+    void drain();                                    /* Waits until no write is in flight. */
+    void wait_for_frames();                          /* Sleeps until a frame is pushed or we have to stop. */
+    void wake_up();                                  /* Called by the decode thread after it pushed, when the writer sleeps. */
+
+  private:
+    FrameSink* sink;
+    std::string filepath;
+    int segment;                                     /* The segment that's open; only used by the writer thread. */
+    std::atomic<int> num_segments;
+    FrameSinkStats closed_sink_stats;                /* The sink stats of the segments we closed; only written by the writer thread. */
+    std::thread thread;
+    SpscQueue<WriterFrame> queue;                    /* Decode thread -> writer thread. */
+    std::deque<WriterFrame> pushed;                  /* Frames we pushed but didn't hand back yet; only used on the decode thread. */
+    uint64_t num_handed_back;
+    std::atomic<uint64_t> num_done;                  /* Frames the writer is done with (written, or dropped after an error). */
+    std::atomic<bool> must_stop;
+    std::atomic<bool> is_waiting;                    /* The writer sleeps, or is about to, on `wake_cond`. */
+    std::mutex wake_mutex;
+    std::condition_variable wake_cond;
+    std::atomic<bool> has_error;
+    std::atomic<uint64_t> num_frames;
+    std::atomic<uint64_t> num_bytes;
+    std::atomic<uint64_t> write_ns;
+    uint64_t active_ns;                              /* Only written by the writer thread, read after join(). */
+    uint64_t cpu_ns;
+    bool is_init;
+    FrameWriterStats stats;
+  };
+
+  /* ------------------------------------------------ */
+
+  std::string frame_writer_get_segment_path(const std::string& filepath, int segment);   /* "out.y4m": 0 -> "out.y4m", 1 -> "out.1.y4m". */
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
+
+#endif
@@ -0,0 +1,740 @@
+#include <stdio.h>
+#include <string.h>
+#include <nvdec/h264.h>
+
+#define H264_MAX_HEADER_SIZE 256 /* We never need more than this many bytes of a slice header. */
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  static void skip_scaling_list(H264BitReader& br, int size);
+  static void skip_hrd_parameters(H264BitReader& br);
+  static int parse_vui(H264BitReader& br, H264Sps& sps);
+
+  /* ------------------------------------------------ */
+
+  H264Sps::H264Sps() {
+    memset((char*)this, 0x00, sizeof(*this));
+    chroma_format_idc = 1;
+    frame_mbs_only_flag = 1;
+    max_num_reorder_frames = -1;
+    max_dec_frame_buffering = -1;
+  }
+
+  H264Pps::H264Pps()
+    :is_valid(false)
+    ,pps_id(0)
+    ,sps_id(0)
+    ,entropy_coding_mode_flag(0)
+    ,bottom_field_pic_order_in_frame_present_flag(0)
+  {
+  }
+
+  H264SliceHeader::H264SliceHeader() {
+    memset((char*)this, 0x00, sizeof(*this));
+  }
+
+  /* ------------------------------------------------ */
+
+  H264BitReader::H264BitReader(const uint8_t* data, size_t nbytes)
+    :data(data)
+    ,nbits(nbytes * 8)
+    ,offset(0)
+  {
+  }
+
+  uint32_t H264BitReader::read_bit() {
+
+    if (offset >= nbits) {
+      offset++;
+      return 0;
+    }
+
+    uint32_t bit = (data[offset >> 3] >> (7 - (offset & 7))) & 0x01;
+    offset++;
+
+    return bit;
+  }
+
+  uint32_t H264BitReader::read_bits(int n) {
+
+    uint32_t result = 0;
+
+    for (int i = 0; i < n; ++i) {
+      result = (result << 1) | read_bit();
+    }
+
+    return result;
+  }
+
+  uint32_t H264BitReader::read_ue() {
+
+    int num_zeros = 0;
+
+    while (0 == read_bit()) {
+      num_zeros++;
+      if (num_zeros > 31 || offset > nbits) {
+        offset = nbits + 1;
+        return 0;
+      }
+    }
+
+    if (0 == num_zeros) {
+      return 0;
+    }
+
+    return ((1u << num_zeros) - 1) + read_bits(num_zeros);
+  }
+
+  int32_t H264BitReader::read_se() {
+
+    uint32_t v = read_ue();
+
+    if (v & 0x01) {
+      return (int32_t)((v + 1) / 2);
+    }
+
+    return -(int32_t)(v / 2);
+  }
+
+  void H264BitReader::skip_bits(size_t n) {
+    offset += n;
+  }
+
+  bool H264BitReader::is_overrun() {
+    return offset > nbits;
+  }
+
+  /* ------------------------------------------------ */
+
+  H264ParameterSets::H264ParameterSets() {
+    reset();
+  }
+
+  void H264ParameterSets::reset() {
+    sps_list.assign(H264_MAX_SPS, H264Sps());
+    pps_list.assign(H264_MAX_PPS, H264Pps());
+  }
+
+  int H264ParameterSets::parse(const uint8_t* nal, size_t nbytes) {
+
+    if (nullptr == nal || 0 == nbytes) {
+      return -1;
+    }
+
+    int nal_type = nal[0] & 0x1F;
+
+    if (H264_NAL_SPS == nal_type) {
+      H264Sps sps;
+      if (0 != h264_parse_sps(nal, nbytes, sps)) {
+        return -2;
+      }
+      sps_list[sps.sps_id] = sps;
+    }
+    else if (H264_NAL_PPS == nal_type) {
+      H264Pps pps;
+      if (0 != h264_parse_pps(nal, nbytes, pps)) {
+        return -3;
+      }
+      pps_list[pps.pps_id] = pps;
+    }
+
+    return 0;
+  }
+
+  int H264ParameterSets::parse_slice_header(const uint8_t* nal, size_t nbytes, H264SliceHeader& result) {
+
+    if (nullptr == nal || nbytes < 2) {
+      return -1;
+    }
+
+    uint8_t rbsp[H264_MAX_HEADER_SIZE];
+    size_t rbsp_size = h264_unescape(nal + 1, nbytes - 1, rbsp, sizeof(rbsp));
+    H264BitReader br(rbsp, rbsp_size);
+
+    result.nal_type = nal[0] & 0x1F;
+    result.nal_ref_idc = (nal[0] >> 5) & 0x03;
+    result.first_mb_in_slice = br.read_ue();
+    result.slice_type = br.read_ue() % 5;
+    result.pps_id = br.read_ue();
+
+    const H264Pps* pps = get_pps(result.pps_id);
+    if (nullptr == pps) {
+      return -2;
+    }
+
+    const H264Sps* sps = get_sps(pps->sps_id);
+    if (nullptr == sps) {
+      return -3;
+    }
+
+    if (1 == sps->separate_colour_plane_flag) {
+      br.skip_bits(2);
+    }
+
+    result.frame_num = br.read_bits(sps->log2_max_frame_num_minus4 + 4);
+
+    if (0 == sps->frame_mbs_only_flag) {
+      result.field_pic_flag = br.read_bit();
+      if (1 == result.field_pic_flag) {
+        result.bottom_field_flag = br.read_bit();
+      }
+    }
+
+    if (H264_NAL_IDR == result.nal_type) {
+      result.idr_pic_id = br.read_ue();
+    }
+
+    if (0 == sps->pic_order_cnt_type) {
+      result.pic_order_cnt_lsb = br.read_bits(sps->log2_max_pic_order_cnt_lsb_minus4 + 4);
+      if (1 == pps->bottom_field_pic_order_in_frame_present_flag && 0 == result.field_pic_flag) {
+        result.delta_pic_order_cnt_bottom = br.read_se();
+      }
+    }
+
+    if (1 == sps->pic_order_cnt_type && 0 == sps->delta_pic_order_always_zero_flag) {
+      result.delta_pic_order_cnt[0] = br.read_se();
+      if (1 == pps->bottom_field_pic_order_in_frame_present_flag && 0 == result.field_pic_flag) {
+        result.delta_pic_order_cnt[1] = br.read_se();
+      }
+    }
+
+    if (true == br.is_overrun()) {
+      return -4;
+    }
+
+    return 0;
+  }
+
+  const H264Sps* H264ParameterSets::get_sps(int id) {
+
+    if (id < 0 || id >= H264_MAX_SPS || false == sps_list[id].is_valid) {
+      return nullptr;
+    }
+
+    return &sps_list[id];
+  }
+
+  const H264Pps* H264ParameterSets::get_pps(int id) {
+
+    if (id < 0 || id >= H264_MAX_PPS || false == pps_list[id].is_valid) {
+      return nullptr;
+    }
+
+    return &pps_list[id];
+  }
+
+  const H264Sps* H264ParameterSets::get_sps_for_pps(int pps_id) {
+
+    const H264Pps* pps = get_pps(pps_id);
+    if (nullptr == pps) {
+      return nullptr;
+    }
+
+    return get_sps(pps->sps_id);
+  }
+
+  /* ------------------------------------------------ */
+
+  H264PictureOrder::H264PictureOrder() {
+    reset();
+  }
+
+  void H264PictureOrder::reset() {
+    prev_poc_msb = 0;
+    prev_poc_lsb = 0;
+    prev_frame_num = 0;
+    prev_frame_num_offset = 0;
+    num_pictures_since_idr = 0;
+  }
+
+  /* We don't handle memory_management_control_operation 5. */
+  int H264PictureOrder::compute(const H264Sps& sps, const H264SliceHeader& sh) {
+
+    if (H264_NAL_IDR == sh.nal_type) {
+      reset();
+    }
+
+    if (2 == sps.pic_order_cnt_type) {
+      return 2 * num_pictures_since_idr++;
+    }
+
+    if (1 == sps.pic_order_cnt_type) {
+      num_pictures_since_idr++;
+      return compute_type1(sps, sh);
+    }
+
+    int max_lsb = 1 << (sps.log2_max_pic_order_cnt_lsb_minus4 + 4);
+    int lsb = sh.pic_order_cnt_lsb;
+    int msb = prev_poc_msb;
+
+    if (lsb < prev_poc_lsb && (prev_poc_lsb - lsb) >= (max_lsb / 2)) {
+      msb = prev_poc_msb + max_lsb;
+    }
+    else if (lsb > prev_poc_lsb && (lsb - prev_poc_lsb) > (max_lsb / 2)) {
+      msb = prev_poc_msb - max_lsb;
+    }
+
+    if (0 != sh.nal_ref_idc) {
+      prev_poc_msb = msb;
+      prev_poc_lsb = lsb;
+    }
+
+    num_pictures_since_idr++;
+
+    return msb + lsb;
+  }
+
+  /* 8.2.1.2: the POC follows from frame_num and the expected offsets of the reference frames in the SPS. */
+  int H264PictureOrder::compute_type1(const H264Sps& sps, const H264SliceHeader& sh) {
+
+    int max_frame_num = 1 << (sps.log2_max_frame_num_minus4 + 4);
+    int frame_num_offset = 0;
+
+    if (H264_NAL_IDR != sh.nal_type) {
+      frame_num_offset = (prev_frame_num > sh.frame_num) ? prev_frame_num_offset + max_frame_num : prev_frame_num_offset;
+    }
+
+    prev_frame_num = sh.frame_num;
+    prev_frame_num_offset = frame_num_offset;
+
+    int64_t abs_frame_num = (0 != sps.num_ref_frames_in_pic_order_cnt_cycle) ? (int64_t)frame_num_offset + sh.frame_num : 0;
+    if (0 == sh.nal_ref_idc && abs_frame_num > 0) {
+      abs_frame_num--;
+    }
+
+    int64_t expected_poc = 0;
+
+    if (abs_frame_num > 0) {
+
+      int64_t delta_per_cycle = 0;
+      for (int i = 0; i < sps.num_ref_frames_in_pic_order_cnt_cycle; ++i) {
+        delta_per_cycle += sps.offset_for_ref_frame[i];
+      }
+
+      int64_t cycle_cnt = (abs_frame_num - 1) / sps.num_ref_frames_in_pic_order_cnt_cycle;
+      int64_t frame_num_in_cycle = (abs_frame_num - 1) % sps.num_ref_frames_in_pic_order_cnt_cycle;
+
+      expected_poc = cycle_cnt * delta_per_cycle;
+      for (int64_t i = 0; i <= frame_num_in_cycle; ++i) {
+        expected_poc += sps.offset_for_ref_frame[i];
+      }
+    }
+
+    if (0 == sh.nal_ref_idc) {
+      expected_poc += sps.offset_for_non_ref_pic;
+    }
+
+    if (1 == sh.field_pic_flag) {
+      return (1 == sh.bottom_field_flag)
+        ? (int)(expected_poc + sps.offset_for_top_to_bottom_field + sh.delta_pic_order_cnt[0])
+        : (int)(expected_poc + sh.delta_pic_order_cnt[0]);
+    }
+
+    int64_t top = expected_poc + sh.delta_pic_order_cnt[0];
+    int64_t bottom = top + sps.offset_for_top_to_bottom_field + sh.delta_pic_order_cnt[1];
+
+    return (int)((top < bottom) ? top : bottom);
+  }
+
+  /* ------------------------------------------------ */
+
+  size_t h264_unescape(const uint8_t* src, size_t nbytes, uint8_t* dst, size_t capacity) {
+
+    size_t num_written = 0;
+    int num_zeros = 0;
+
+    for (size_t i = 0; i < nbytes && num_written < capacity; ++i) {
+
+      if (num_zeros >= 2 && 0x03 == src[i]) {
+        num_zeros = 0;
+        continue;
+      }
+
+      dst[num_written++] = src[i];
+      num_zeros = (0x00 == src[i]) ? num_zeros + 1 : 0;
+    }
+
+    return num_written;
+  }
+
+  int h264_parse_sps(const uint8_t* nal, size_t nbytes, H264Sps& result) {
+
+    if (nullptr == nal || nbytes < 4) {
+      printf("Cannot parse the SPS, too small.\n");
+      return -1;
+    }
+
+    /* A SPS is small, but with scaling lists and a VUI it can be a couple hundred bytes. */
+    std::vector<uint8_t> rbsp(nbytes);
+    size_t rbsp_size = h264_unescape(nal + 1, nbytes - 1, rbsp.data(), rbsp.size());
+    H264BitReader br(rbsp.data(), rbsp_size);
+    H264Sps sps;
+
+    sps.nbytes = nbytes;
+    sps.profile_idc = br.read_bits(8);
+    sps.constraint_flags = br.read_bits(8);
+    sps.level_idc = br.read_bits(8);
+    sps.sps_id = br.read_ue();
+
+    if ((unsigned int)sps.sps_id >= H264_MAX_SPS) {
+      printf("Invalid SPS id: %d.\n", sps.sps_id);
+      return -2;
+    }
+
+    switch (sps.profile_idc) {
+      case 100: case 110: case 122: case 244: case 44:
+      case 83: case 86: case 118: case 128: case 138:
+      case 139: case 134: case 135: {
+        sps.chroma_format_idc = br.read_ue();
+        if (3 == sps.chroma_format_idc) {
+          sps.separate_colour_plane_flag = br.read_bit();
+        }
+        sps.bit_depth_luma_minus8 = br.read_ue();
+        sps.bit_depth_chroma_minus8 = br.read_ue();
+        br.read_bit(); /* qpprime_y_zero_transform_bypass_flag */
+        if (1 == br.read_bit()) { /* seq_scaling_matrix_present_flag */
+          int num_lists = (3 != sps.chroma_format_idc) ? 8 : 12;
+          for (int i = 0; i < num_lists; ++i) {
+            if (1 == br.read_bit()) {
+              skip_scaling_list(br, (i < 6) ? 16 : 64);
+            }
+          }
+        }
+        break;
+      }
+    }
+
+    sps.log2_max_frame_num_minus4 = br.read_ue();
+    sps.pic_order_cnt_type = br.read_ue();
+
+    if (0 == sps.pic_order_cnt_type) {
+      sps.log2_max_pic_order_cnt_lsb_minus4 = br.read_ue();
+    }
+    else if (1 == sps.pic_order_cnt_type) {
+      sps.delta_pic_order_always_zero_flag = br.read_bit();
+      sps.offset_for_non_ref_pic = br.read_se();
+      sps.offset_for_top_to_bottom_field = br.read_se();
+      uint32_t num_ref_frames_in_poc_cycle = br.read_ue();
+      if (num_ref_frames_in_poc_cycle > H264_MAX_POC_CYCLE) {
+        printf("Invalid SPS %d, a value is out of range.\n", sps.sps_id);
+        return -4;
+      }
+      sps.num_ref_frames_in_pic_order_cnt_cycle = (int)num_ref_frames_in_poc_cycle;
+      for (int i = 0; i < sps.num_ref_frames_in_pic_order_cnt_cycle && false == br.is_overrun(); ++i) {
+        sps.offset_for_ref_frame[i] = br.read_se();
+      }
+    }
+
+    sps.max_num_ref_frames = br.read_ue();
+    br.read_bit(); /* gaps_in_frame_num_value_allowed_flag */
+    sps.pic_width_in_mbs_minus1 = br.read_ue();
+    sps.pic_height_in_map_units_minus1 = br.read_ue();
+    sps.frame_mbs_only_flag = br.read_bit();
+
+    if (0 == sps.frame_mbs_only_flag) {
+      br.read_bit(); /* mb_adaptive_frame_field_flag */
+    }
+
+    br.read_bit(); /* direct_8x8_inference_flag */
+    sps.frame_cropping_flag = br.read_bit();
+
+    if (1 == sps.frame_cropping_flag) {
+      sps.frame_crop_left_offset = br.read_ue();
+      sps.frame_crop_right_offset = br.read_ue();
+      sps.frame_crop_top_offset = br.read_ue();
+      sps.frame_crop_bottom_offset = br.read_ue();
+    }
+
+    sps.vui_parameters_present_flag = br.read_bit();
+
+    if (true == br.is_overrun()) {
+      printf("Failed to parse SPS %d, not enough data.\n", sps.sps_id);
+      return -3;
+    }
+
+    /* We shift by and multiply with these, so don't trust a corrupt stream; the ranges are in 7.4.2.1.1. The casts catch a ue(v) that wrapped to a negative int. */
+    if ((unsigned int)sps.chroma_format_idc > 3
+        || (unsigned int)sps.bit_depth_luma_minus8 > 6
+        || (unsigned int)sps.bit_depth_chroma_minus8 > 6
+        || (unsigned int)sps.log2_max_frame_num_minus4 > H264_MAX_LOG2_MINUS4
+        || (unsigned int)sps.log2_max_pic_order_cnt_lsb_minus4 > H264_MAX_LOG2_MINUS4
+        || (unsigned int)sps.pic_order_cnt_type > 2
+        || (unsigned int)sps.pic_width_in_mbs_minus1 >= H264_MAX_SIZE_IN_MBS
+        || (unsigned int)sps.pic_height_in_map_units_minus1 >= H264_MAX_SIZE_IN_MBS)
+      {
+        printf("Invalid SPS %d, a value is out of range.\n", sps.sps_id);
+        return -4;
+      }
+
+    if ((unsigned int)sps.frame_crop_left_offset > (unsigned int)(sps.pic_width_in_mbs_minus1 * 16 + 16)
+        || (unsigned int)sps.frame_crop_right_offset > (unsigned int)(sps.pic_width_in_mbs_minus1 * 16 + 16)
+        || (unsigned int)sps.frame_crop_top_offset > (unsigned int)(sps.pic_height_in_map_units_minus1 * 32 + 32)
+        || (unsigned int)sps.frame_crop_bottom_offset > (unsigned int)(sps.pic_height_in_map_units_minus1 * 32 + 32))
+      {
+        printf("Invalid cropping in SPS %d.\n", sps.sps_id);
+        return -5;
+      }
+
+    /* Some encoders write a truncated VUI; we can live without it. */
+    if (1 == sps.vui_parameters_present_flag) {
+      if (0 != parse_vui(br, sps)) {
+        printf("Warning: failed to parse the VUI of SPS %d, ignoring it.\n", sps.sps_id);
+        sps.timing_info_present_flag = 0;
+        sps.bitstream_restriction_flag = 0;
+      }
+    }
+
+    /* Derived values, see 7.4.2.1.1 of the spec. */
+    int crop_unit_x = 1;
+    int crop_unit_y = 2 - sps.frame_mbs_only_flag;
+
+    if (0 == sps.separate_colour_plane_flag && 0 != sps.chroma_format_idc) {
+      crop_unit_x = (3 == sps.chroma_format_idc) ? 1 : 2;
+      crop_unit_y *= (1 == sps.chroma_format_idc) ? 2 : 1;
+    }
+
+    sps.coded_width = (sps.pic_width_in_mbs_minus1 + 1) * 16;
+    sps.coded_height = (2 - sps.frame_mbs_only_flag) * (sps.pic_height_in_map_units_minus1 + 1) * 16;
+    sps.display_left = crop_unit_x * sps.frame_crop_left_offset;
+    sps.display_top = crop_unit_y * sps.frame_crop_top_offset;
+    sps.display_right = sps.coded_width - crop_unit_x * sps.frame_crop_right_offset;
+    sps.display_bottom = sps.coded_height - crop_unit_y * sps.frame_crop_bottom_offset;
+
+    if (sps.display_right <= sps.display_left || sps.display_bottom <= sps.display_top) {
+      printf("Invalid cropping in SPS %d.\n", sps.sps_id);
+      return -5;
+    }
+
+    sps.is_valid = true;
+    result = sps;
+
+    return 0;
+  }
+
+  int h264_parse_pps(const uint8_t* nal, size_t nbytes, H264Pps& result) {
+
+    if (nullptr == nal || nbytes < 2) {
+      printf("Cannot parse the PPS, too small.\n");
+      return -1;
+    }
+
+    uint8_t rbsp[16];
+    size_t rbsp_size = h264_unescape(nal + 1, nbytes - 1, rbsp, sizeof(rbsp));
+    H264BitReader br(rbsp, rbsp_size);
+    H264Pps pps;
+
+    pps.pps_id = br.read_ue();
+    pps.sps_id = br.read_ue();
+    pps.entropy_coding_mode_flag = br.read_bit();
+    pps.bottom_field_pic_order_in_frame_present_flag = br.read_bit();
+
+    if (true == br.is_overrun()
+        || (unsigned int)pps.pps_id >= H264_MAX_PPS
+        || (unsigned int)pps.sps_id >= H264_MAX_SPS)
+      {
+        printf("Failed to parse the PPS.\n");
+        return -2;
+      }
+
+    pps.is_valid = true;
+    result = pps;
+
+    return 0;
+  }
+
+  /* See table A-1 of the spec for the MaxDpbMbs values. */
+  int h264_get_dpb_size(const H264Sps& sps) {
+
+    if (1 == sps.bitstream_restriction_flag && sps.max_dec_frame_buffering >= 0) {
+      return (sps.max_dec_frame_buffering > 0) ? sps.max_dec_frame_buffering : 1;
+    }
+
+    int max_dpb_mbs = 0;
+    switch (sps.level_idc) {
+      case 9:
+      case 10: { max_dpb_mbs = 396;    break; }
+      case 11: { max_dpb_mbs = (sps.constraint_flags & 0x10) ? 396 : 900; break; }
+      case 12:
+      case 13:
+      case 20: { max_dpb_mbs = 2376;   break; }
+      case 21: { max_dpb_mbs = 4752;   break; }
+      case 22:
+      case 30: { max_dpb_mbs = 8100;   break; }
+      case 31: { max_dpb_mbs = 18000;  break; }
+      case 32: { max_dpb_mbs = 20480;  break; }
+      case 40:
+      case 41: { max_dpb_mbs = 32768;  break; }
+      case 42: { max_dpb_mbs = 34816;  break; }
+      case 50: { max_dpb_mbs = 110400; break; }
+      case 51:
+      case 52: { max_dpb_mbs = 184320; break; }
+      default: { max_dpb_mbs = 696320; break; }
+    }
+
+    int frame_mbs = (sps.coded_width / 16) * (sps.coded_height / 16);
+    int dpb_size = (frame_mbs > 0) ? max_dpb_mbs / frame_mbs : 16;
+
+    if (dpb_size > 16) {
+      dpb_size = 16;
+    }
+
+    if (dpb_size < sps.max_num_ref_frames) {
+      dpb_size = sps.max_num_ref_frames;
+    }
+
+    return (dpb_size > 0) ? dpb_size : 1;
+  }
+
+  int h264_get_num_reorder_frames(const H264Sps& sps) {
+
+    if (1 == sps.bitstream_restriction_flag && sps.max_num_reorder_frames >= 0) {
+      return sps.max_num_reorder_frames;
+    }
+
+    /* Baseline and the intra profiles don't have B-frames. */
+    if (66 == sps.profile_idc
+        || 2 == sps.pic_order_cnt_type
+        || (0x10 & sps.constraint_flags && (44 == sps.profile_idc || 86 == sps.profile_idc || 100 == sps.profile_idc || 110 == sps.profile_idc || 122 == sps.profile_idc || 244 == sps.profile_idc)))
+      {
+        return 0;
+      }
+
+    return h264_get_dpb_size(sps);
+  }
+
+  bool h264_is_vcl(int nal_type) {
+    return (nal_type >= 1 && nal_type <= 5);
+  }
+
+  /* The slice type comes before anything that needs a parameter set. */
+  int h264_get_slice_type(const uint8_t* nal, size_t nbytes) {
+
+    if (nullptr == nal || nbytes < 2) {
+      return -1;
+    }
+
+    uint8_t rbsp[16];
+    size_t rbsp_size = h264_unescape(nal + 1, nbytes - 1, rbsp, sizeof(rbsp));
+    H264BitReader br(rbsp, rbsp_size);
+
+    br.read_ue();                 /* first_mb_in_slice */
+    int slice_type = (int)(br.read_ue() % 5);
+
+    if (true == br.is_overrun()) {
+      return -2;
+    }
+
+    return slice_type;
+  }
+
+  /* ------------------------------------------------ */
+
+  static void skip_scaling_list(H264BitReader& br, int size) {
+
+    int last_scale = 8;
+    int next_scale = 8;
+
+    for (int i = 0; i < size; ++i) {
+      if (0 != next_scale) {
+        int delta_scale = br.read_se();
+        next_scale = (last_scale + delta_scale + 256) % 256;
+      }
+      last_scale = (0 == next_scale) ? last_scale : next_scale;
+    }
+  }
+
+  static void skip_hrd_parameters(H264BitReader& br) {
+
+    uint32_t cpb_cnt_minus1 = br.read_ue();
+    br.read_bits(4); /* bit_rate_scale */
+    br.read_bits(4); /* cpb_size_scale */
+
+    for (uint32_t i = 0; i <= cpb_cnt_minus1 && i < 32; ++i) {
+      br.read_ue(); /* bit_rate_value_minus1 */
+      br.read_ue(); /* cpb_size_value_minus1 */
+      br.read_bit(); /* cbr_flag */
+    }
+
+    br.read_bits(5); /* initial_cpb_removal_delay_length_minus1 */
+    br.read_bits(5); /* cpb_removal_delay_length_minus1 */
+    br.read_bits(5); /* dpb_output_delay_length_minus1 */
+    br.read_bits(5); /* time_offset_length */
+  }
+
+  /* See E.1.1 of the spec. */
+  static int parse_vui(H264BitReader& br, H264Sps& sps) {
+
+    if (1 == br.read_bit()) { /* aspect_ratio_info_present_flag */
+      sps.aspect_ratio_idc = br.read_bits(8);
+      if (255 == sps.aspect_ratio_idc) { /* Extended_SAR */
+        sps.sar_width = br.read_bits(16);
+        sps.sar_height = br.read_bits(16);
+      }
+    }
+
+    if (1 == br.read_bit()) { /* overscan_info_present_flag */
+      br.read_bit(); /* overscan_appropriate_flag */
+    }
+
+    sps.video_format = 5;
+    sps.colour_primaries = 2;
+    sps.transfer_characteristics = 2;
+    sps.matrix_coefficients = 2;
+
+    if (1 == br.read_bit()) { /* video_signal_type_present_flag */
+      sps.video_format = br.read_bits(3);
+      sps.video_full_range_flag = br.read_bit();
+      if (1 == br.read_bit()) { /* colour_description_present_flag */
+        sps.colour_primaries = br.read_bits(8);
+        sps.transfer_characteristics = br.read_bits(8);
+        sps.matrix_coefficients = br.read_bits(8);
+      }
+    }
+
+    if (1 == br.read_bit()) { /* chroma_loc_info_present_flag */
+      br.read_ue();
+      br.read_ue();
+    }
+
+    sps.timing_info_present_flag = br.read_bit();
+    if (1 == sps.timing_info_present_flag) {
+      sps.num_units_in_tick = br.read_bits(32);
+      sps.time_scale = br.read_bits(32);
+      sps.fixed_frame_rate_flag = br.read_bit();
+    }
+
+    int nal_hrd_parameters_present_flag = br.read_bit();
+    if (1 == nal_hrd_parameters_present_flag) {
+      skip_hrd_parameters(br);
+    }
+
+    int vcl_hrd_parameters_present_flag = br.read_bit();
+    if (1 == vcl_hrd_parameters_present_flag) {
+      skip_hrd_parameters(br);
+    }
+
+    if (1 == nal_hrd_parameters_present_flag || 1 == vcl_hrd_parameters_present_flag) {
+      br.read_bit(); /* low_delay_hrd_flag */
+    }
+
+    br.read_bit(); /* pic_struct_present_flag */
+
+    sps.bitstream_restriction_flag = br.read_bit();
+    if (1 == sps.bitstream_restriction_flag) {
+      br.read_bit(); /* motion_vectors_over_pic_boundaries_flag */
+      br.read_ue(); /* max_bytes_per_pic_denom */
+      br.read_ue(); /* max_bits_per_mb_denom */
+      br.read_ue(); /* log2_max_mv_length_horizontal */
+      br.read_ue(); /* log2_max_mv_length_vertical */
+      sps.max_num_reorder_frames = br.read_ue();
+      sps.max_dec_frame_buffering = br.read_ue();
+    }
+
+    return (true == br.is_overrun()) ? -1 : 0;
+  }
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
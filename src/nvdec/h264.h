@@ -0,0 +1,209 @@
+/*
+  H264
+  ====
+
+  GENERAL INFO:
+
+    Minimal H264 bitstream parsing: SPS (including the VUI), PPS
+    and the first part of the slice header. This is not a
+    decoder; we only parse what we need to know about a stream
+    without the hardware parser, e.g. the dimensions, frame rate
+    and picture order. All parse functions expect a pointer to
+    the NAL header (the first byte after the start code) and
+    remove the emulation prevention bytes themselves.
+
+  REFERENCES:
+
+    [0]: https://www.itu.int/rec/T-REC-H.264 "H.264 spec"
+
+ */
+#ifndef NVDEC_H264_H
+#define NVDEC_H264_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#define H264_NAL_SLICE 1
+#define H264_NAL_IDR 5
+#define H264_NAL_SEI 6
+#define H264_NAL_SPS 7
+#define H264_NAL_PPS 8
+#define H264_NAL_AUD 9
+#define H264_NAL_END_OF_SEQUENCE 10
+#define H264_NAL_END_OF_STREAM 11
+
+#define H264_SLICE_TYPE_P 0
+#define H264_SLICE_TYPE_B 1
+#define H264_SLICE_TYPE_I 2
+#define H264_SLICE_TYPE_SP 3
+#define H264_SLICE_TYPE_SI 4
+
+#define H264_MAX_SPS 32
+#define H264_MAX_PPS 256
+#define H264_MAX_LOG2_MINUS4 12         /* log2_max_frame_num_minus4 and log2_max_pic_order_cnt_lsb_minus4 are 0..12. */
+#define H264_MAX_POC_CYCLE 255         /* num_ref_frames_in_pic_order_cnt_cycle is 0..255. */
+#define H264_MAX_SIZE_IN_MBS 1055       /* sqrt(8 * MaxFS) of the highest level, see A.3.1 f) and g). */
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  struct H264Sps {
+    H264Sps();
+
+    bool is_valid;
+    int profile_idc;
+    int constraint_flags;
+    int level_idc;
+    int sps_id;
+    int chroma_format_idc;
+    int separate_colour_plane_flag;
+    int bit_depth_luma_minus8;
+    int bit_depth_chroma_minus8;
+    int log2_max_frame_num_minus4;
+    int pic_order_cnt_type;
+    int log2_max_pic_order_cnt_lsb_minus4;
+    int delta_pic_order_always_zero_flag;
+    int offset_for_non_ref_pic;
+    int offset_for_top_to_bottom_field;
+    int num_ref_frames_in_pic_order_cnt_cycle;
+    int offset_for_ref_frame[H264_MAX_POC_CYCLE];
+    int max_num_ref_frames;
+    int pic_width_in_mbs_minus1;
+    int pic_height_in_map_units_minus1;
+    int frame_mbs_only_flag;
+    int frame_cropping_flag;
+    int frame_crop_left_offset;
+    int frame_crop_right_offset;
+    int frame_crop_top_offset;
+    int frame_crop_bottom_offset;
+
+    /* VUI */
+    int vui_parameters_present_flag;
+    int aspect_ratio_idc;
+    int sar_width;
+    int sar_height;
+    int video_format;
+    int video_full_range_flag;
+    int colour_primaries;
+    int transfer_characteristics;
+    int matrix_coefficients;
+    int timing_info_present_flag;
+    uint32_t num_units_in_tick;
+    uint32_t time_scale;
+    int fixed_frame_rate_flag;
+    int bitstream_restriction_flag;
+    int max_num_reorder_frames;
+    int max_dec_frame_buffering;
+
+    /* Derived */
+    int coded_width;                              /* Width in pixels, multiple of 16. */
+    int coded_height;                             /* Height in pixels, multiple of 16 (or 32 for field coding). */
+    int display_left;                             /* The display rectangle after applying the cropping. */
+    int display_top;
+    int display_right;
+    int display_bottom;
+    size_t nbytes;                                /* Size of the SPS NAL, without start code. */
+  };
+
+  /* ------------------------------------------------ */
+
+  struct H264Pps {
+    H264Pps();
+
+    bool is_valid;
+    int pps_id;
+    int sps_id;
+    int entropy_coding_mode_flag;
+    int bottom_field_pic_order_in_frame_present_flag;
+  };
+
+  /* ------------------------------------------------ */
+
+  struct H264SliceHeader {
+    H264SliceHeader();
+
+    int nal_type;
+    int nal_ref_idc;
+    int first_mb_in_slice;
+    int slice_type;                               /* One of the H264_SLICE_TYPE_* values (we already did the % 5). */
+    int pps_id;
+    int frame_num;
+    int field_pic_flag;
+    int bottom_field_flag;
+    int idr_pic_id;
+    int pic_order_cnt_lsb;
+    int delta_pic_order_cnt_bottom;
+    int delta_pic_order_cnt[2];                   /* POC type 1 only. */
+  };
+
+  /* ------------------------------------------------ */
+
+  class H264BitReader {
+  public:
+    H264BitReader(const uint8_t* data, size_t nbytes);
+    uint32_t read_bits(int n);
+    uint32_t read_bit();
+    uint32_t read_ue();
+    int32_t read_se();
+    void skip_bits(size_t n);
+    bool is_overrun();                            /* Returns true when we tried to read beyond the end. */
+
+  private:
+    const uint8_t* data;
+    size_t nbits;
+    size_t offset;                                /* Bit offset. */
+  };
+
+  /* ------------------------------------------------ */
+
+  /* Keeps the parameter sets we've seen so we can parse slice headers. */
+  class H264ParameterSets {
+  public:
+    H264ParameterSets();
+    void reset();
+    int parse(const uint8_t* nal, size_t nbytes);                                         /* Parses the NAL when it's a SPS or PPS; other NALs are ignored. Returns < 0 on error. */
+    int parse_slice_header(const uint8_t* nal, size_t nbytes, H264SliceHeader& result);  /* Returns < 0 when the slice refers to a parameter set we don't have. */
+    const H264Sps* get_sps(int id);
+    const H264Pps* get_pps(int id);
+    const H264Sps* get_sps_for_pps(int pps_id);
+
+  private:
+    std::vector<H264Sps> sps_list;
+    std::vector<H264Pps> pps_list;
+  };
+
+  /* ------------------------------------------------ */
+
+  /* The picture order count of the pictures, in decode order; see 8.2.1 of the spec. For POC type 2 we return 2 per frame in decode order, which is the display order. */
+  class H264PictureOrder {
+  public:
+    H264PictureOrder();
+    void reset();
+    int compute(const H264Sps& sps, const H264SliceHeader& sh);                          /* Call once per picture, with its first slice; an IDR starts at 0 again. */
+
+  private:
+    int compute_type1(const H264Sps& sps, const H264SliceHeader& sh);
+
+  private:
+    int prev_poc_msb;
+    int prev_poc_lsb;
+    int prev_frame_num;
+    int prev_frame_num_offset;
+    int num_pictures_since_idr;
+  };
+
+  /* ------------------------------------------------ */
+
+  size_t h264_unescape(const uint8_t* src, size_t nbytes, uint8_t* dst, size_t capacity);  /* Removes the emulation prevention bytes; returns the number of bytes written into `dst`. */
+  int h264_parse_sps(const uint8_t* nal, size_t nbytes, H264Sps& result);
+  int h264_parse_pps(const uint8_t* nal, size_t nbytes, H264Pps& result);
+  int h264_get_dpb_size(const H264Sps& sps);              /* The number of frames the decoder needs to hold for reference and reordering. */
+  int h264_get_num_reorder_frames(const H264Sps& sps);    /* The number of frames we need to wait before we know the display order. */
+  bool h264_is_vcl(int nal_type);
+  int h264_get_slice_type(const uint8_t* nal, size_t nbytes);  /* Returns one of the H264_SLICE_TYPE_* values of a slice NAL without needing its parameter sets, < 0 on error. */
+
+} /* namespace nvdec */
+
+#endif
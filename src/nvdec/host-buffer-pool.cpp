@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <string.h>
+#include <nvdec/host-buffer-pool.h>
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  HostBufferPool::HostBufferPool()
+    :backend(nullptr)
+    ,max_free(0)
+    ,headroom(0)
+  {
+    memset((char*)&stats, 0x00, sizeof(stats));
+  }
+
+  HostBufferPool::~HostBufferPool() {
+    shutdown();
+  }
+
+  int HostBufferPool::init(DecodeBackend* be, int max_free_count, size_t headroom_nbytes) {
+
+    if (nullptr == be) {
+      printf("Cannot initialize the host buffer pool, the given backend is nullptr.\n");
+      return -1;
+    }
+
+    if (nullptr != backend) {
+      printf("Cannot initialize the host buffer pool, already initialized. Call shutdown() first.\n");
+      return -2;
+    }
+
+    if (max_free_count < 0) {
+      printf("Cannot initialize the host buffer pool, invalid max_free %d.\n", max_free_count);
+      return -3;
+    }
+
+    backend = be;
+    max_free = max_free_count;
+    headroom = headroom_nbytes;
+    memset((char*)&stats, 0x00, sizeof(stats));
+
+    return 0;
+  }
+
+  int HostBufferPool::shutdown() {
+
+    if (nullptr == backend) {
+      return 0;
+    }
+
+    int result = 0;
+
+    if (stats.num_acquired > 0) {
+      printf("Warning: shutting down the host buffer pool while %llu buffers are still acquired; they are not freed by the pool.\n",
+             (unsigned long long)stats.num_acquired);
+      result = -1;
+    }
+
+    while (false == free_buffers.empty()) {
+      if (0 != free_buffer(free_buffers.front())) {
+        result = -2;
+      }
+      free_buffers.pop_front();
+    }
+
+    stats.num_free = 0;
+    backend = nullptr;
+
+    return result;
+  }
+
+  int HostBufferPool::acquire(const HostBufferKey& key, HostBuffer& buffer) {
+
+    if (nullptr == backend) {
+      printf("Cannot acquire a host buffer, not initialized.\n");
+      return -1;
+    }
+
+    if (0 == key.pitch || 0 == key.height) {
+      printf("Cannot acquire a host buffer, invalid pitch or height.\n");
+      return -2;
+    }
+
+    if (nullptr != buffer.data) {
+      printf("Cannot acquire a host buffer, the given buffer still holds one; release it first.\n");
+      return -3;
+    }
+
+    /* Most recently released first; it's the most likely to be warm. */
+    for (size_t i = free_buffers.size(); i > 0; --i) {
+      if (true == host_buffer_key_equals(free_buffers[i - 1].key, key)) {
+        buffer = free_buffers[i - 1];
+        free_buffers.erase(free_buffers.begin() + (i - 1));
+        stats.num_hits++;
+        stats.num_acquired++;
+        stats.num_free--;
+        return 0;
+      }
+    }
+
+    size_t nbytes = (size_t)key.pitch * (key.height + key.height / 2) + headroom;
+    uint8_t* data = nullptr;
+
+    CUresult r = backend->alloc_host((void**)&data, nbytes);
+    if (CUDA_SUCCESS != r) {
+      printf("Failed to allocate a host buffer of %zu bytes: %s.\n", nbytes, backend->get_error_string(r));
+      return -4;
+    }
+
+    buffer.key = key;
+    buffer.data = data;
+    buffer.nbytes = nbytes;
+
+    stats.num_misses++;
+    stats.num_acquired++;
+    stats.num_bytes += nbytes;
+    if (stats.num_bytes > stats.peak_bytes) {
+      stats.peak_bytes = stats.num_bytes;
+    }
+
+    return 0;
+  }
+
+  int HostBufferPool::release(HostBuffer& buffer) {
+
+    if (nullptr == backend) {
+      printf("Cannot release a host buffer, not initialized.\n");
+      return -1;
+    }
+
+    if (nullptr == buffer.data) {
+      return 0;
+    }
+
+    int result = 0;
+
+    free_buffers.push_back(buffer);
+    stats.num_acquired--;
+    stats.num_free++;
+
+    while ((int)free_buffers.size() > max_free) {
+      if (0 != free_buffer(free_buffers.front())) {
+        result = -2;
+      }
+      free_buffers.pop_front();
+      stats.num_free--;
+      stats.num_evictions++;
+    }
+
+    buffer.data = nullptr;
+    buffer.nbytes = 0;
+
+    return result;
+  }
+
+  HostBufferPoolStats HostBufferPool::get_stats() {
+    return stats;
+  }
+
+  /* ------------------------------------------------ */
+
+  int HostBufferPool::free_buffer(HostBuffer& buffer) {
+
+    if (nullptr == buffer.data) {
+      return 0;
+    }
+
+    CUresult r = backend->free_host(buffer.data);
+    if (CUDA_SUCCESS != r) {
+      printf("Failed to free a host buffer: %s.\n", backend->get_error_string(r));
+      return -1;
+    }
+
+    stats.num_bytes -= buffer.nbytes;
+    buffer.data = nullptr;
+    buffer.nbytes = 0;
+
+    return 0;
+  }
+
+  /* ------------------------------------------------ */
+
+  bool host_buffer_key_equals(const HostBufferKey& a, const HostBufferKey& b) {
+    return a.pitch == b.pitch
+      && a.height == b.height
+      && a.format == b.format;
+  }
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
@@ -0,0 +1,111 @@
+/*
+  HOST BUFFER POOL
+  ================
+
+  GENERAL INFO:
+
+    Keeps page-locked host buffers around so we don't have to
+    call alloc_host() / free_host() (cuMemAllocHost /
+    cuMemFreeHost, which are slow and synchronize the device)
+    every time the stream changes resolution. A buffer is
+    keyed by the pitch and height of the picture it holds and
+    by its surface format; when a buffer is released it goes on
+    a free list and the next acquire() with the same key gets it
+    back (a hit). A miss allocates a new buffer. This way a
+    stream that switches between a few resolutions, e.g. an
+    adaptive stream, stops allocating once it has seen each of
+    them.
+
+    The free list holds at most `max_free` buffers; when it's
+    full we free the buffer that was released the longest time
+    ago (an eviction). shutdown() frees everything on the free
+    list; release all acquired buffers before you call it (we
+    warn when you didn't) so nothing leaks on teardown.
+
+    The size of a buffer is `pitch * (height + height / 2)`, the
+    size of a 4:2:0 picture (NV12 or P016 with the pitch in
+    bytes), plus the `headroom` that you pass into init().
+
+  USAGE:
+
+    HostBufferPool pool;
+    pool.init(backend, 8, 0);
+
+    HostBufferKey key;
+    key.pitch = width;
+    key.height = height;
+    key.format = cudaVideoSurfaceFormat_NV12;
+
+    HostBuffer buffer;
+    pool.acquire(key, buffer);
+    ...
+    pool.release(buffer);
+
+    pool.shutdown();
+
+ */
+#ifndef NVDEC_HOST_BUFFER_POOL_H
+#define NVDEC_HOST_BUFFER_POOL_H
+
+#include <stdint.h>
+#include <deque>
+#include <nvdec/backend.h>
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  struct HostBufferKey {
+    unsigned int pitch;
+    unsigned int height;
+    int format;                     /* cudaVideoSurfaceFormat */
+  };
+
+  struct HostBuffer {
+    HostBufferKey key;
+    uint8_t* data;                  /* nullptr when this doesn't hold a buffer. */
+    size_t nbytes;
+  };
+
+  struct HostBufferPoolStats {
+    uint64_t num_hits;              /* acquire() calls that got a buffer from the free list. */
+    uint64_t num_misses;            /* acquire() calls that had to allocate. */
+    uint64_t num_evictions;         /* Buffers we freed because the free list was full. */
+    uint64_t num_acquired;          /* Buffers that are currently handed out. */
+    uint64_t num_free;              /* Buffers that are currently on the free list. */
+    uint64_t num_bytes;             /* Bytes of all buffers we currently hold, acquired or free. */
+    uint64_t peak_bytes;
+  };
+
+  /* ------------------------------------------------ */
+
+  class HostBufferPool {
+  public:
+    HostBufferPool();
+    ~HostBufferPool();
+    int init(DecodeBackend* backend, int max_free, size_t headroom);
+    int shutdown();                                                 /* Frees all buffers. */
+    int acquire(const HostBufferKey& key, HostBuffer& buffer);
+    int release(HostBuffer& buffer);                                /* Puts the buffer on the free list and resets `buffer`. */
+    HostBufferPoolStats get_stats();
+
+  private:
+    int free_buffer(HostBuffer& buffer);
+
+  private:
+    DecodeBackend* backend;
+    int max_free;
+    size_t headroom;
+    std::deque<HostBuffer> free_buffers;                            /* Oldest release first. */
+    HostBufferPoolStats stats;
+  };
+
+  /* ------------------------------------------------ */
+
+  bool host_buffer_key_equals(const HostBufferKey& a, const HostBufferKey& b);
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
+
+#endif
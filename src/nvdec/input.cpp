@@ -0,0 +1,614 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fstream>
+#include <chrono>
+#include <thread>
+#include <nvdec/input.h>
+
+#if defined(_WIN32)
+#  include <windows.h>
+#  include <io.h>
+#  include <fcntl.h>
+#else
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#endif
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  /* Without this the timestamps continue from the access unit before the seek. */
+  int InputSource::set_timeline(uint64_t frame, const uint8_t* parameter_sets, size_t nbytes) {
+
+    timestamper.seek(frame);
+
+    if (nullptr == parameter_sets || 0 == nbytes) {
+      return 0;
+    }
+
+    if (0 != timestamper.add_parameter_sets(parameter_sets, nbytes)) {
+      printf("Failed to parse the parameter sets for the timestamps.\n");
+      return -1;
+    }
+
+    return 0;
+  }
+
+  /* ------------------------------------------------ */
+
+  ReadInput::ReadInput()
+    :buffer(nullptr)
+    ,nbytes(0)
+    ,offset(0)
+  {
+  }
+
+  ReadInput::~ReadInput() {
+    close();
+  }
+
+  int ReadInput::open(const std::string& filepath) {
+
+    if (nullptr != buffer) {
+      printf("Cannot open %s, already opened. Call close() first.\n", filepath.c_str());
+      return -1;
+    }
+
+    std::ifstream ifs(filepath.c_str(), std::ios::in | std::ios::binary);
+    if (!ifs.is_open()) {
+      printf("Failed to open the file: %s.\n", filepath.c_str());
+      return -2;
+    }
+
+    ifs.seekg(0, std::ifstream::end);
+    size_t ifs_size = ifs.tellg();
+    ifs.seekg(0, std::ifstream::beg);
+
+    if (0 == ifs_size) {
+      printf("The file %s is empty.\n", filepath.c_str());
+      return -3;
+    }
+
+    buffer = (uint8_t*)malloc(ifs_size);
+    if (nullptr == buffer) {
+      printf("Failed to allocate %zu bytes for %s.\n", ifs_size, filepath.c_str());
+      return -4;
+    }
+
+    ifs.read((char*)buffer, ifs_size);
+
+    nbytes = ifs_size;
+    offset = 0;
+    splitter.reset();
+    timestamper.reset();
+
+    return 0;
+  }
+
+  int ReadInput::close() {
+
+    if (nullptr != buffer) {
+      free(buffer);
+      buffer = nullptr;
+    }
+
+    nbytes = 0;
+    offset = 0;
+    splitter.reset();
+    timestamper.reset();
+
+    return 0;
+  }
+
+  int ReadInput::next(AccessUnit& result) {
+
+    if (nullptr == buffer) {
+      printf("Cannot get the next access unit, not opened.\n");
+      return -1;
+    }
+
+    int r = splitter.next(buffer + offset, nbytes - offset, true, result);
+    if (ANNEXB_OK == r) {
+      offset += result.size;
+      timestamper.stamp(result);
+    }
+
+    return r;
+  }
+
+  int ReadInput::seek(uint64_t position) {
+
+    if (nullptr == buffer || position > nbytes) {
+      printf("Cannot seek to %llu, not opened or beyond the end.\n", (unsigned long long)position);
+      return -1;
+    }
+
+    offset = (size_t)position;
+    splitter.reset();
+
+    return 0;
+  }
+
+  /* ------------------------------------------------ */
+
+  MappedInput::MappedInput()
+#if defined(_WIN32)
+    :file_handle(INVALID_HANDLE_VALUE)
+    ,mapping_handle(nullptr)
+#else
+    :fd(-1)
+#endif
+    ,data(nullptr)
+    ,nbytes(0)
+    ,offset(0)
+    ,readahead_offset(0)
+    ,released_offset(0)
+  {
+  }
+
+  MappedInput::~MappedInput() {
+    close();
+  }
+
+  int MappedInput::open(const std::string& filepath) {
+
+    if (nullptr != data) {
+      printf("Cannot open %s, already opened. Call close() first.\n", filepath.c_str());
+      return -1;
+    }
+
+#if defined(_WIN32)
+
+    file_handle = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (INVALID_HANDLE_VALUE == file_handle) {
+      printf("Failed to open the file: %s.\n", filepath.c_str());
+      return -2;
+    }
+
+    LARGE_INTEGER file_size;
+    if (0 == GetFileSizeEx(file_handle, &file_size) || 0 == file_size.QuadPart) {
+      printf("The file %s is empty or we failed to get its size.\n", filepath.c_str());
+      close();
+      return -3;
+    }
+
+    mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (nullptr == mapping_handle) {
+      printf("Failed to create a file mapping for %s.\n", filepath.c_str());
+      close();
+      return -4;
+    }
+
+    data = (uint8_t*)MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+    if (nullptr == data) {
+      printf("Failed to map %s.\n", filepath.c_str());
+      close();
+      return -5;
+    }
+
+    nbytes = (size_t)file_size.QuadPart;
+
+#else
+
+    fd = ::open(filepath.c_str(), O_RDONLY);
+    if (-1 == fd) {
+      printf("Failed to open the file: %s.\n", filepath.c_str());
+      return -2;
+    }
+
+    struct stat st;
+    if (0 != fstat(fd, &st) || 0 == st.st_size) {
+      printf("The file %s is empty or we failed to get its size.\n", filepath.c_str());
+      close();
+      return -3;
+    }
+
+    void* ptr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == ptr) {
+      printf("Failed to map %s.\n", filepath.c_str());
+      close();
+      return -5;
+    }
+
+    data = (uint8_t*)ptr;
+    nbytes = (size_t)st.st_size;
+
+    if (0 != madvise(data, nbytes, MADV_SEQUENTIAL)) {
+      printf("Warning: madvise(MADV_SEQUENTIAL) failed for %s.\n", filepath.c_str());
+    }
+
+#endif
+
+    offset = 0;
+    readahead_offset = 0;
+    released_offset = 0;
+    splitter.reset();
+    timestamper.reset();
+
+    advise(0);
+
+    return 0;
+  }
+
+  int MappedInput::close() {
+
+#if defined(_WIN32)
+    if (nullptr != data) {
+      UnmapViewOfFile(data);
+    }
+    if (nullptr != mapping_handle) {
+      CloseHandle(mapping_handle);
+      mapping_handle = nullptr;
+    }
+    if (INVALID_HANDLE_VALUE != file_handle) {
+      CloseHandle(file_handle);
+      file_handle = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (nullptr != data) {
+      munmap(data, nbytes);
+    }
+    if (-1 != fd) {
+      ::close(fd);
+      fd = -1;
+    }
+#endif
+
+    data = nullptr;
+    nbytes = 0;
+    offset = 0;
+    readahead_offset = 0;
+    released_offset = 0;
+    splitter.reset();
+    timestamper.reset();
+
+    return 0;
+  }
+
+  int MappedInput::next(AccessUnit& result) {
+
+    if (nullptr == data) {
+      printf("Cannot get the next access unit, not opened.\n");
+      return -1;
+    }
+
+    int r = splitter.next(data + offset, nbytes - offset, true, result);
+    if (ANNEXB_OK == r) {
+      offset += result.size;
+      timestamper.stamp(result);
+      advise(offset);
+    }
+
+    return r;
+  }
+
+  /* The read ahead window starts over at the new position. */
+  int MappedInput::seek(uint64_t position) {
+
+    if (nullptr == data || position > nbytes) {
+      printf("Cannot seek to %llu, not opened or beyond the end.\n", (unsigned long long)position);
+      return -1;
+    }
+
+    offset = (size_t)position;
+    readahead_offset = offset;
+    splitter.reset();
+
+#if !defined(_WIN32)
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    if (offset < released_offset) {
+      released_offset = offset - (offset % page_size);
+    }
+#endif
+
+    advise(offset);
+
+    return 0;
+  }
+
+  /*
+    Keeps a window of pages in front of `position` in flight
+    and releases the pages that are more than a window behind
+    it. Giving back pages of a read-only file mapping is safe;
+    when they're touched again the kernel reads them back from
+    the page cache or disk.
+  */
+  void MappedInput::advise(size_t position) {
+
+#if !defined(_WIN32)
+
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+    if (readahead_offset < nbytes
+        && position + (INPUT_MMAP_WINDOW_SIZE / 2) >= readahead_offset)
+      {
+        size_t start = readahead_offset - (readahead_offset % page_size);
+        size_t end = readahead_offset + INPUT_MMAP_WINDOW_SIZE;
+        if (end > nbytes) {
+          end = nbytes;
+        }
+        madvise(data + start, end - start, MADV_WILLNEED);
+        readahead_offset = end;
+      }
+
+    if (position > released_offset + 2 * INPUT_MMAP_WINDOW_SIZE) {
+      size_t end = position - INPUT_MMAP_WINDOW_SIZE;
+      end = end - (end % page_size);
+      madvise(data + released_offset, end - released_offset, MADV_DONTNEED);
+      released_offset = end;
+    }
+
+#endif
+  }
+
+  /* ------------------------------------------------ */
+
+  StreamInput::StreamInput(bool follow)
+    :fd(-1)
+    ,owns_fd(false)
+    ,follow(follow)
+    ,is_eof(false)
+    ,buffer(nullptr)
+    ,capacity(0)
+    ,read_offset(0)
+    ,write_offset(0)
+  {
+  }
+
+  StreamInput::~StreamInput() {
+    close();
+  }
+
+  int StreamInput::open(const std::string& filepath) {
+
+    if (-1 != fd) {
+      printf("Cannot open %s, already opened. Call close() first.\n", filepath.c_str());
+      return -1;
+    }
+
+    if ("-" == filepath) {
+#if defined(_WIN32)
+      fd = _fileno(stdin);
+      _setmode(fd, _O_BINARY);
+#else
+      fd = STDIN_FILENO;
+#endif
+      owns_fd = false;
+    }
+    else {
+#if defined(_WIN32)
+      fd = _open(filepath.c_str(), _O_RDONLY | _O_BINARY);
+#else
+      fd = ::open(filepath.c_str(), O_RDONLY);
+#endif
+      owns_fd = true;
+    }
+
+    if (-1 == fd) {
+      printf("Failed to open the file: %s.\n", filepath.c_str());
+      return -2;
+    }
+
+    capacity = INPUT_STREAM_CHUNK_SIZE * INPUT_STREAM_NUM_CHUNKS;
+    buffer = (uint8_t*)malloc(capacity);
+    if (nullptr == buffer) {
+      printf("Failed to allocate the stream buffer of %zu bytes.\n", capacity);
+      close();
+      return -3;
+    }
+
+    is_eof = false;
+    read_offset = 0;
+    write_offset = 0;
+    splitter.reset();
+    timestamper.reset();
+
+    return 0;
+  }
+
+  int StreamInput::close() {
+
+    if (-1 != fd && true == owns_fd) {
+#if defined(_WIN32)
+      _close(fd);
+#else
+      ::close(fd);
+#endif
+    }
+
+    if (nullptr != buffer) {
+      free(buffer);
+      buffer = nullptr;
+    }
+
+    fd = -1;
+    owns_fd = false;
+    is_eof = false;
+    capacity = 0;
+    read_offset = 0;
+    write_offset = 0;
+    splitter.reset();
+    timestamper.reset();
+
+    return 0;
+  }
+
+  int StreamInput::next(AccessUnit& result) {
+
+    if (nullptr == buffer) {
+      printf("Cannot get the next access unit, not opened.\n");
+      return -1;
+    }
+
+    while (true) {
+
+      int r = splitter.next(buffer + read_offset, write_offset - read_offset, is_eof, result);
+      if (ANNEXB_OK == r) {
+        read_offset += result.size;
+        timestamper.stamp(result);
+        return ANNEXB_OK;
+      }
+
+      if (ANNEXB_END_OF_STREAM == r || true == is_eof) {
+        return ANNEXB_END_OF_STREAM;
+      }
+
+      /* Carry the incomplete access unit to the front when there is no room for another chunk. */
+      if ((capacity - write_offset) < INPUT_STREAM_CHUNK_SIZE) {
+        
+        if (0 == read_offset) {
+          printf("Access unit doesn't fit into the stream buffer of %zu bytes.\n", capacity);
+          return -2;
+        }
+
+        memmove(buffer, buffer + read_offset, write_offset - read_offset);
+        write_offset -= read_offset;
+        read_offset = 0;
+      }
+
+      int num_read = fill();
+      if (num_read < 0) {
+        return -3;
+      }
+
+      if (0 == num_read) {
+        is_eof = true;
+      }
+    }
+
+    return -4;
+  }
+
+  /* Only for files; the buffered bytes are dropped. */
+  int StreamInput::seek(uint64_t position) {
+
+    if (nullptr == buffer || false == owns_fd) {
+      printf("Cannot seek, the stream isn't opened or is stdin.\n");
+      return -1;
+    }
+
+#if defined(_WIN32)
+    int64_t r = _lseeki64(fd, (int64_t)position, SEEK_SET);
+#else
+    int64_t r = (int64_t)lseek(fd, (off_t)position, SEEK_SET);
+#endif
+
+    if (r < 0) {
+      printf("Failed to seek the stream to %llu: %s.\n", (unsigned long long)position, strerror(errno));
+      return -2;
+    }
+
+    is_eof = false;
+    read_offset = 0;
+    write_offset = 0;
+    splitter.reset();
+
+    return 0;
+  }
+
+  int StreamInput::fill() {
+
+    size_t num_free = capacity - write_offset;
+    if (num_free > INPUT_STREAM_CHUNK_SIZE) {
+      num_free = INPUT_STREAM_CHUNK_SIZE;
+    }
+
+    int waited_ms = 0;
+
+    while (true) {
+
+#if defined(_WIN32)
+      int r = _read(fd, buffer + write_offset, (unsigned int)num_free);
+#else
+      ssize_t r = ::read(fd, buffer + write_offset, num_free);
+#endif
+      
+      if (r > 0) {
+        write_offset += r;
+        return (int)r;
+      }
+
+      if (r < 0) {
+        if (EINTR == errno) {
+          continue;
+        }
+        printf("Failed to read from the stream: %s.\n", strerror(errno));
+        return -1;
+      }
+
+      /* End of file; when following a file we wait until the writer appended more. */
+      if (false == follow || waited_ms >= INPUT_FOLLOW_TIMEOUT_MS) {
+        return 0;
+      }
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(INPUT_FOLLOW_POLL_MS));
+      waited_ms += INPUT_FOLLOW_POLL_MS;
+    }
+
+    return -2;
+  }
+
+  /* ------------------------------------------------ */
+
+  InputSource* input_create(int type) {
+
+    switch (type) {
+      case INPUT_TYPE_READ: {
+        return new ReadInput();
+      }
+      case INPUT_TYPE_MMAP: {
+        return new MappedInput();
+      }
+      case INPUT_TYPE_STREAM: {
+        return new StreamInput(false);
+      }
+      case INPUT_TYPE_FOLLOW: {
+        return new StreamInput(true);
+      }
+      default: {
+        printf("Cannot create an input source for type %d.\n", type);
+        return nullptr;
+      }
+    }
+  }
+
+  int input_type_from_string(const std::string& name) {
+
+    if ("read" == name) {
+      return INPUT_TYPE_READ;
+    }
+
+    if ("mmap" == name) {
+      return INPUT_TYPE_MMAP;
+    }
+
+    if ("stream" == name) {
+      return INPUT_TYPE_STREAM;
+    }
+
+    if ("follow" == name) {
+      return INPUT_TYPE_FOLLOW;
+    }
+
+    return INPUT_TYPE_NONE;
+  }
+
+  const char* input_type_to_string(int type) {
+
+    switch (type) {
+      case INPUT_TYPE_READ: { return "read"; }
+      case INPUT_TYPE_MMAP: { return "mmap"; }
+      case INPUT_TYPE_STREAM: { return "stream"; }
+      case INPUT_TYPE_FOLLOW: { return "follow"; }
+      default:              { return "none"; }
+    }
+  }
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
@@ -0,0 +1,183 @@
+/*
+  INPUT
+  =====
+
+  GENERAL INFO:
+
+    An InputSource gives you the access units of an Annex-B
+    file, one at a time. The memory of an access unit is owned
+    by the source and stays valid until the next call to
+    `next()`, which is long enough as `cuvidParseVideoData()`
+    copies what it needs.
+
+    INPUT_TYPE_READ: reads the complete file into memory before
+                     we hand out the first access unit. This is
+                     what v0..v3 do and we keep it around to
+                     compare against.
+
+    INPUT_TYPE_MMAP: maps the file into memory and hands out
+                     pointers into the mapping. We tell the kernel
+                     we read sequentially and ask it to read ahead
+                     a window in front of the current position.
+                     Pages behind the current position are given
+                     back so the resident memory stays around two
+                     windows, no matter the size of the file.
+
+    INPUT_TYPE_STREAM: reads from a pipe, stdin (use "-" as
+                     filepath) or a file in chunks of
+                     INPUT_STREAM_CHUNK_SIZE into one fixed buffer
+                     of INPUT_STREAM_NUM_CHUNKS chunks. When we
+                     reach the end of the buffer, the bytes of the
+                     access unit that isn't complete yet are moved
+                     to the front and we continue reading behind
+                     them. The buffer is never resized so memory
+                     stays flat however long the stream runs; an
+                     access unit must fit in the buffer though.
+
+    INPUT_TYPE_FOLLOW: same as INPUT_TYPE_STREAM but when we hit
+                     the end of the file we wait for it to grow,
+                     e.g. when another process is still writing a
+                     capture. We stop when the file didn't grow for
+                     INPUT_FOLLOW_TIMEOUT_MS.
+
+  USAGE:
+
+    InputSource* input = input_create(INPUT_TYPE_MMAP);
+    input->open("moonlight.264");
+
+    AccessUnit au;
+    while (ANNEXB_OK == input->next(au)) {
+      ...
+    }
+
+    input->close();
+    delete input;
+
+    seek() continues at a byte offset, which must be the start
+    of an access unit, e.g. one from a StreamIndex (see
+    stream-index.h). We can't seek stdin or a pipe.
+
+    Every access unit that next() returns has a pts and dts from
+    an AnnexbTimestamper (see annexb.h). After a seek, call
+    set_timeline() with the frame number and parameter sets of
+    the StreamIndexEntry so the timestamps are those of that
+    position in the stream.
+
+ */
+#ifndef NVDEC_INPUT_H
+#define NVDEC_INPUT_H
+
+#include <string>
+#include <nvdec/annexb.h>
+
+#define INPUT_TYPE_NONE 0
+#define INPUT_TYPE_READ 1
+#define INPUT_TYPE_MMAP 2
+#define INPUT_TYPE_STREAM 3
+#define INPUT_TYPE_FOLLOW 4
+
+#define INPUT_MMAP_WINDOW_SIZE (8 * 1024 * 1024) /* The number of bytes we ask the kernel to read ahead. */
+#define INPUT_STREAM_CHUNK_SIZE (1024 * 1024)    /* The maximum number of bytes we read at once. */
+#define INPUT_STREAM_NUM_CHUNKS 8                /* The stream buffer holds this many chunks. */
+#define INPUT_FOLLOW_TIMEOUT_MS 2000             /* Stop following a file when it didn't grow for this long. */
+#define INPUT_FOLLOW_POLL_MS 10                  /* How long we sleep before we check if a followed file grew. */
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  class InputSource {
+  public:
+    virtual ~InputSource() {}
+    virtual int open(const std::string& filepath) = 0;
+    virtual int close() = 0;
+    virtual int next(AccessUnit& result) = 0;      /* Returns ANNEXB_OK when `result` is set, ANNEXB_END_OF_STREAM at the end or < 0 on error. */
+    virtual int seek(uint64_t offset) = 0;         /* The next access unit starts at `offset`. */
+    int set_timeline(uint64_t frame, const uint8_t* parameter_sets, size_t nbytes);  /* After seek(): the frame number of the next access unit and the SPS and PPS it uses. */
+
+  protected:
+    AnnexbTimestamper timestamper;                 /* Stamps the access units that next() returns. */
+  };
+
+  /* ------------------------------------------------ */
+
+  class ReadInput : public InputSource {
+  public:
+    ReadInput();
+    ~ReadInput();
+    int open(const std::string& filepath);
+    int close();
+    int next(AccessUnit& result);
+    int seek(uint64_t offset);
+
+  private:
+    AnnexbSplitter splitter;
+    uint8_t* buffer;
+    size_t nbytes;
+    size_t offset;                                 /* The number of bytes that we've handed out. */
+  };
+
+  /* ------------------------------------------------ */
+
+  class MappedInput : public InputSource {
+  public:
+    MappedInput();
+    ~MappedInput();
+    int open(const std::string& filepath);
+    int close();
+    int next(AccessUnit& result);
+    int seek(uint64_t offset);
+
+  private:
+    void advise(size_t position);
+
+  private:
+    AnnexbSplitter splitter;
+#if defined(_WIN32)
+    void* file_handle;
+    void* mapping_handle;
+#else
+    int fd;
+#endif
+    uint8_t* data;
+    size_t nbytes;
+    size_t offset;                                 /* The number of bytes that we've handed out. */
+    size_t readahead_offset;                       /* Up to where we asked the kernel to read ahead. */
+    size_t released_offset;                        /* Up to where we gave the pages back. */
+  };
+
+  /* ------------------------------------------------ */
+
+  class StreamInput : public InputSource {
+  public:
+    StreamInput(bool follow);
+    ~StreamInput();
+    int open(const std::string& filepath);        /* Use "-" to read from stdin. */
+    int close();
+    int next(AccessUnit& result);
+    int seek(uint64_t offset);
+
+  private:
+    int fill();                                    /* Reads the next chunk. Returns the number of bytes read, 0 at the end of the stream or < 0 on error. */
+
+  private:
+    AnnexbSplitter splitter;
+    int fd;
+    bool owns_fd;                                  /* False when we read from stdin. */
+    bool follow;
+    bool is_eof;
+    uint8_t* buffer;
+    size_t capacity;
+    size_t read_offset;                            /* Start of the bytes we didn't hand out yet. */
+    size_t write_offset;                           /* End of the bytes we've read. */
+  };
+
+  /* ------------------------------------------------ */
+
+  InputSource* input_create(int type);
+  int input_type_from_string(const std::string& name);  /* Returns INPUT_TYPE_NONE for unknown names. */
+  const char* input_type_to_string(int type);
+
+} /* namespace nvdec */
+
+#endif
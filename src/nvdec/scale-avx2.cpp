@@ -0,0 +1,76 @@
+/*
+  Only this file is compiled with AVX2 enabled; scale.cpp only
+  calls into it when the CPU supports AVX2. The math is the
+  same as scale_blend_row_scalar() and
+  scale_average_rows_scalar(), see scale.h.
+*/
+#include <nvdec/scale.h>
+
+#if defined(USE_AVX2)
+
+#include <immintrin.h>
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  /* 32 bytes per iteration, widened to two registers of 16 bit lanes; the weighted sum is at most 255 * 256 + 128. */
+  void scale_blend_row_avx2(const uint8_t* a, const uint8_t* b, int weight, uint8_t* dst, int x_start, int num_bytes) {
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i wa = _mm256_set1_epi16((short)((1 << SCALE_FRACTION_BITS) - weight));
+    const __m256i wb = _mm256_set1_epi16((short)weight);
+    const __m256i half = _mm256_set1_epi16(1 << (SCALE_FRACTION_BITS - 1));
+    int x = x_start;
+
+    for (; x + 32 <= num_bytes; x += 32) {
+
+      __m256i va = _mm256_loadu_si256((const __m256i*)(a + x));
+      __m256i vb = _mm256_loadu_si256((const __m256i*)(b + x));
+
+      __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(va, zero), wa), _mm256_mullo_epi16(_mm256_unpacklo_epi8(vb, zero), wb));
+      __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(va, zero), wa), _mm256_mullo_epi16(_mm256_unpackhi_epi8(vb, zero), wb));
+
+      lo = _mm256_srli_epi16(_mm256_add_epi16(lo, half), SCALE_FRACTION_BITS);
+      hi = _mm256_srli_epi16(_mm256_add_epi16(hi, half), SCALE_FRACTION_BITS);
+
+      /* The unpacks and the pack work per 128 bit lane, so the bytes end up where they came from. */
+      _mm256_storeu_si256((__m256i*)(dst + x), _mm256_packus_epi16(lo, hi));
+    }
+
+    scale_blend_row_scalar(a, b, weight, dst, x, num_bytes);
+  }
+
+  /* The sums of up to SCALE_MAX_BOX rows fit in 16 bit lanes; the multiply high does the `>> 16`. */
+  void scale_average_rows_avx2(const uint8_t* const* rows, int num_rows, int reciprocal, uint8_t* dst, int x_start, int num_bytes) {
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i half = _mm256_set1_epi16((short)(num_rows / 2));
+    const __m256i scale = _mm256_set1_epi16((short)reciprocal);
+    int x = x_start;
+
+    for (; x + 32 <= num_bytes; x += 32) {
+
+      __m256i lo = half;
+      __m256i hi = half;
+
+      for (int i = 0; i < num_rows; ++i) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(rows[i] + x));
+        lo = _mm256_add_epi16(lo, _mm256_unpacklo_epi8(v, zero));
+        hi = _mm256_add_epi16(hi, _mm256_unpackhi_epi8(v, zero));
+      }
+
+      lo = _mm256_mulhi_epu16(lo, scale);
+      hi = _mm256_mulhi_epu16(hi, scale);
+
+      _mm256_storeu_si256((__m256i*)(dst + x), _mm256_packus_epi16(lo, hi));
+    }
+
+    scale_average_rows_scalar(rows, num_rows, reciprocal, dst, x, num_bytes);
+  }
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
+
+#endif
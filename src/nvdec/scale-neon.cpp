@@ -0,0 +1,73 @@
+/*
+  The NEON kernels; compiled for 64 bit ARM where NEON is
+  always available. The math is the same as
+  scale_blend_row_scalar() and scale_average_rows_scalar(), see
+  scale.h.
+*/
+#include <nvdec/scale.h>
+
+#if defined(USE_NEON)
+
+#include <arm_neon.h>
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  /* 16 bytes per iteration in 16 bit lanes; the weighted sum is at most 255 * 256 + 128. */
+  void scale_blend_row_neon(const uint8_t* a, const uint8_t* b, int weight, uint8_t* dst, int x_start, int num_bytes) {
+
+    const uint16x8_t wa = vdupq_n_u16((uint16_t)((1 << SCALE_FRACTION_BITS) - weight));
+    const uint16x8_t wb = vdupq_n_u16((uint16_t)weight);
+    const uint16x8_t half = vdupq_n_u16(1 << (SCALE_FRACTION_BITS - 1));
+    int x = x_start;
+
+    for (; x + 16 <= num_bytes; x += 16) {
+
+      uint8x16_t va = vld1q_u8(a + x);
+      uint8x16_t vb = vld1q_u8(b + x);
+
+      uint16x8_t lo = vmlaq_u16(vmulq_u16(vmovl_u8(vget_low_u8(va)), wa), vmovl_u8(vget_low_u8(vb)), wb);
+      uint16x8_t hi = vmlaq_u16(vmulq_u16(vmovl_u8(vget_high_u8(va)), wa), vmovl_u8(vget_high_u8(vb)), wb);
+
+      lo = vaddq_u16(lo, half);
+      hi = vaddq_u16(hi, half);
+
+      vst1q_u8(dst + x, vcombine_u8(vshrn_n_u16(lo, SCALE_FRACTION_BITS), vshrn_n_u16(hi, SCALE_FRACTION_BITS)));
+    }
+
+    scale_blend_row_scalar(a, b, weight, dst, x, num_bytes);
+  }
+
+  /* NEON has no 16 bit multiply high, so we widen the product to 32 bit and narrow it with the `>> 16`. */
+  void scale_average_rows_neon(const uint8_t* const* rows, int num_rows, int reciprocal, uint8_t* dst, int x_start, int num_bytes) {
+
+    const uint16x8_t half = vdupq_n_u16((uint16_t)(num_rows / 2));
+    const uint16x4_t scale = vdup_n_u16((uint16_t)reciprocal);
+    int x = x_start;
+
+    for (; x + 16 <= num_bytes; x += 16) {
+
+      uint16x8_t lo = half;
+      uint16x8_t hi = half;
+
+      for (int i = 0; i < num_rows; ++i) {
+        uint8x16_t v = vld1q_u8(rows[i] + x);
+        lo = vaddw_u8(lo, vget_low_u8(v));
+        hi = vaddw_u8(hi, vget_high_u8(v));
+      }
+
+      uint16x8_t lo_avg = vcombine_u16(vshrn_n_u32(vmull_u16(vget_low_u16(lo), scale), 16), vshrn_n_u32(vmull_u16(vget_high_u16(lo), scale), 16));
+      uint16x8_t hi_avg = vcombine_u16(vshrn_n_u32(vmull_u16(vget_low_u16(hi), scale), 16), vshrn_n_u32(vmull_u16(vget_high_u16(hi), scale), 16));
+
+      vst1q_u8(dst + x, vcombine_u8(vmovn_u16(lo_avg), vmovn_u16(hi_avg)));
+    }
+
+    scale_average_rows_scalar(rows, num_rows, reciprocal, dst, x, num_bytes);
+  }
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
+
+#endif
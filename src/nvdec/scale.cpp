@@ -0,0 +1,392 @@
+#include <stdio.h>
+#include <string.h>
+#include <nvdec/scale.h>
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  ScaleSettings::ScaleSettings()
+    :width(0)
+    ,height(0)
+    ,filter(SCALE_FILTER_BOX)
+    ,isa(CONVERT_ISA_NONE)
+  {
+  }
+
+  /* ------------------------------------------------ */
+
+  Scaler::Scaler()
+    :src_width(0)
+    ,src_height(0)
+    ,width(0)
+    ,height(0)
+    ,is_init(false)
+  {
+    kernels.blend_row = nullptr;
+    kernels.average_rows = nullptr;
+  }
+
+  Scaler::~Scaler() {
+    shutdown();
+  }
+
+  int Scaler::init(const ScaleSettings& cfg) {
+
+    if (true == is_init) {
+      printf("Cannot initialize the scaler, already initialized. Call shutdown() first.\n");
+      return -1;
+    }
+
+    if (SCALE_FILTER_BOX != cfg.filter && SCALE_FILTER_BILINEAR != cfg.filter) {
+      printf("Cannot initialize the scaler, invalid filter %d.\n", cfg.filter);
+      return -2;
+    }
+
+    settings = cfg;
+    if (CONVERT_ISA_NONE == settings.isa) {
+      settings.isa = convert_get_best_isa();
+    }
+
+    if (0 != scale_get_kernels(settings.isa, kernels)) {
+      printf("Cannot initialize the scaler, %s is not supported by this build or CPU.\n", convert_isa_to_string(settings.isa));
+      return -3;
+    }
+
+    src_width = 0;
+    src_height = 0;
+    width = 0;
+    height = 0;
+    is_init = true;
+
+    return 0;
+  }
+
+  int Scaler::shutdown() {
+
+    if (false == is_init) {
+      return 0;
+    }
+
+    luma_x_taps.clear();
+    luma_y_taps.clear();
+    chroma_x_taps.clear();
+    chroma_y_taps.clear();
+    row.clear();
+    rows.clear();
+    kernels.blend_row = nullptr;
+    kernels.average_rows = nullptr;
+    is_init = false;
+
+    return 0;
+  }
+
+  int Scaler::scale(const ConvertSource& src, const ConvertTarget& dst, int dst_width, int dst_height) {
+
+    if (false == is_init) {
+      printf("Cannot scale, the scaler is not initialized.\n");
+      return -1;
+    }
+
+    if (nullptr == src.y || nullptr == src.uv || nullptr == dst.planes[0] || nullptr == dst.planes[1]) {
+      printf("Cannot scale, one of the planes is nullptr.\n");
+      return -2;
+    }
+
+    if (0 != update_taps(src.width, src.height, dst_width, dst_height)) {
+      return -3;
+    }
+
+    scale_plane(src.y, src.y_pitch, src.width, dst.planes[0], dst.pitches[0], 1, luma_x_taps, luma_y_taps);
+    scale_plane(src.uv, src.uv_pitch, src.width / 2, dst.planes[1], dst.pitches[1], 2, chroma_x_taps, chroma_y_taps);
+
+    return 0;
+  }
+
+  int Scaler::get_isa() {
+    return settings.isa;
+  }
+
+  int Scaler::update_taps(int sw, int sh, int dw, int dh) {
+
+    if (sw == src_width && sh == src_height && dw == width && dh == height) {
+      return 0;
+    }
+
+    if (sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0
+        || 0 != (sw & 1) || 0 != (sh & 1) || 0 != (dw & 1) || 0 != (dh & 1))
+      {
+        printf("Cannot scale %d x %d to %d x %d, the sizes must be even.\n", sw, sh, dw, dh);
+        return -1;
+      }
+
+    if (0 != scale_get_taps(settings.filter, sw, dw, luma_x_taps)
+        || 0 != scale_get_taps(settings.filter, sh, dh, luma_y_taps)
+        || 0 != scale_get_taps(settings.filter, sw / 2, dw / 2, chroma_x_taps)
+        || 0 != scale_get_taps(settings.filter, sh / 2, dh / 2, chroma_y_taps))
+      {
+        printf("Cannot scale %d x %d to %d x %d.\n", sw, sh, dw, dh);
+        src_width = 0;
+        return -2;
+      }
+
+    row.resize((size_t)sw);
+    rows.resize(SCALE_MAX_BOX);
+    src_width = sw;
+    src_height = sh;
+    width = dw;
+    height = dh;
+
+    return 0;
+  }
+
+  /*
+    `num_channels` is 2 for the interleaved chroma; the taps are
+    in samples, so a tap of sample x uses the bytes at x * 2 and
+    x * 2 + 1. The vertical pass doesn't care about channels.
+  */
+  void Scaler::scale_plane(const uint8_t* src,
+                           size_t src_pitch,
+                           int src_samples,
+                           uint8_t* dst,
+                           size_t dst_pitch,
+                           int num_channels,
+                           const std::vector<ScaleTap>& x_taps,
+                           const std::vector<ScaleTap>& y_taps)
+  {
+    int num_bytes = src_samples * num_channels;
+    uint8_t* filtered = row.data();
+
+    for (size_t j = 0; j < y_taps.size(); ++j) {
+
+      const ScaleTap& ty = y_taps[j];
+      const uint8_t* line = src + (size_t)ty.first * src_pitch;
+
+      /* Vertical pass; a single source row is used as is. */
+      if (SCALE_FILTER_BOX == settings.filter && ty.last > ty.first) {
+        int num_rows = ty.last - ty.first + 1;
+        for (int i = 0; i < num_rows; ++i) {
+          rows[i] = src + (size_t)(ty.first + i) * src_pitch;
+        }
+        kernels.average_rows(rows.data(), num_rows, ty.weight, filtered, 0, num_bytes);
+        line = filtered;
+      }
+      else if (SCALE_FILTER_BILINEAR == settings.filter && ty.weight > 0) {
+        kernels.blend_row(line, src + (size_t)ty.last * src_pitch, ty.weight, filtered, 0, num_bytes);
+        line = filtered;
+      }
+
+      /* Horizontal pass. */
+      uint8_t* out = dst + j * dst_pitch;
+
+      for (size_t i = 0; i < x_taps.size(); ++i) {
+
+        const ScaleTap& tx = x_taps[i];
+
+        for (int c = 0; c < num_channels; ++c) {
+
+          const uint8_t* first = line + (size_t)tx.first * num_channels + c;
+          uint8_t* result = out + i * num_channels + c;
+
+          if (SCALE_FILTER_BILINEAR == settings.filter) {
+            uint32_t a = first[0];
+            uint32_t b = line[(size_t)tx.last * num_channels + c];
+            *result = (uint8_t)((a * ((1 << SCALE_FRACTION_BITS) - tx.weight) + b * tx.weight + (1 << (SCALE_FRACTION_BITS - 1))) >> SCALE_FRACTION_BITS);
+            continue;
+          }
+
+          int num_samples = tx.last - tx.first + 1;
+          if (1 == num_samples) {
+            *result = first[0];
+            continue;
+          }
+
+          uint32_t sum = 0;
+          for (int k = 0; k < num_samples; ++k) {
+            sum += first[k * num_channels];
+          }
+
+          *result = (uint8_t)(((sum + num_samples / 2) * (uint32_t)tx.weight) >> 16);
+        }
+      }
+    }
+  }
+
+  /* ------------------------------------------------ */
+
+  int scale_get_size(int src_width, int src_height, int width, int height, int& result_width, int& result_height) {
+
+    if (src_width <= 0 || src_height <= 0) {
+      printf("Cannot get the scaled size, invalid source size %d x %d.\n", src_width, src_height);
+      return -1;
+    }
+
+    if (width <= 0 && height <= 0) {
+      printf("Cannot get the scaled size, no width or height given.\n");
+      return -2;
+    }
+
+    if (width <= 0) {
+      width = (int)(((int64_t)height * src_width + src_height / 2) / src_height);
+    }
+
+    if (height <= 0) {
+      height = (int)(((int64_t)width * src_height + src_width / 2) / src_width);
+    }
+
+    result_width = (width < 2) ? 2 : (width & ~1);
+    result_height = (height < 2) ? 2 : (height & ~1);
+
+    return 0;
+  }
+
+  /*
+    Box: target sample i covers the source samples [i * src /
+    size, (i + 1) * src / size); when we upscale that can be
+    empty and we take the first one. The average is `((sum +
+    n / 2) * (65536 / n)) >> 16` so the vector code can use a
+    16 bit multiply high; it can be a level below the rounded
+    average and it never goes above 255.
+
+    Bilinear: the centers of the samples line up, so target
+    sample i is at source position (i + 0.5) * src / size - 0.5.
+  */
+  int scale_get_taps(int filter, int src_size, int size, std::vector<ScaleTap>& result) {
+
+    if (src_size <= 0 || size <= 0) {
+      printf("Cannot get the scale taps, invalid size %d -> %d.\n", src_size, size);
+      return -1;
+    }
+
+    result.resize((size_t)size);
+
+    for (int i = 0; i < size; ++i) {
+
+      ScaleTap& tap = result[i];
+
+      if (SCALE_FILTER_BOX == filter) {
+        int first = (int)(((int64_t)i * src_size) / size);
+        int end = (int)(((int64_t)(i + 1) * src_size) / size);
+        if (end <= first) {
+          end = first + 1;
+        }
+        if (end - first > SCALE_MAX_BOX) {
+          printf("Cannot scale %d to %d with a box filter, a box can't cover more than %d samples.\n", src_size, size, SCALE_MAX_BOX);
+          return -2;
+        }
+        tap.first = first;
+        tap.last = end - 1;
+        tap.weight = (end - first > 1) ? (65536 / (end - first)) : 0;
+        continue;
+      }
+
+      if (SCALE_FILTER_BILINEAR == filter) {
+        int64_t one = 1 << SCALE_FRACTION_BITS;
+        int64_t pos = ((2 * (int64_t)i + 1) * src_size * one) / (2 * (int64_t)size) - one / 2;
+        if (pos < 0) {
+          pos = 0;
+        }
+        tap.first = (int)(pos >> SCALE_FRACTION_BITS);
+        tap.weight = (int)(pos & (one - 1));
+        tap.last = tap.first + 1;
+        if (tap.first >= src_size - 1) {
+          tap.first = src_size - 1;
+          tap.last = src_size - 1;
+          tap.weight = 0;
+        }
+        continue;
+      }
+
+      printf("Cannot get the scale taps, invalid filter %d.\n", filter);
+      return -3;
+    }
+
+    return 0;
+  }
+
+  int scale_get_kernels(int isa, ScaleKernels& result) {
+
+    result.blend_row = nullptr;
+    result.average_rows = nullptr;
+
+    if (false == convert_is_isa_supported(isa)) {
+      return -1;
+    }
+
+    switch (isa) {
+
+      case CONVERT_ISA_SCALAR: {
+        result.blend_row = scale_blend_row_scalar;
+        result.average_rows = scale_average_rows_scalar;
+        return 0;
+      }
+
+#if defined(USE_AVX2)
+      case CONVERT_ISA_AVX2: {
+        result.blend_row = scale_blend_row_avx2;
+        result.average_rows = scale_average_rows_avx2;
+        return 0;
+      }
+#endif
+
+#if defined(USE_NEON)
+      case CONVERT_ISA_NEON: {
+        result.blend_row = scale_blend_row_neon;
+        result.average_rows = scale_average_rows_neon;
+        return 0;
+      }
+#endif
+    }
+
+    return -2;
+  }
+
+  int scale_filter_from_string(const std::string& name) {
+
+    if ("box" == name)      { return SCALE_FILTER_BOX; }
+    if ("bilinear" == name) { return SCALE_FILTER_BILINEAR; }
+
+    return SCALE_FILTER_NONE;
+  }
+
+  const char* scale_filter_to_string(int filter) {
+
+    switch (filter) {
+      case SCALE_FILTER_BOX:      { return "box"; }
+      case SCALE_FILTER_BILINEAR: { return "bilinear"; }
+    }
+
+    return "unknown";
+  }
+
+  /* ------------------------------------------------ */
+
+  /* (a * (256 - w) + b * w + 128) >> 8; fits in 16 bits so the vector code can use 16 bit lanes. */
+  void scale_blend_row_scalar(const uint8_t* a, const uint8_t* b, int weight, uint8_t* dst, int x_start, int num_bytes) {
+
+    uint32_t wa = (uint32_t)((1 << SCALE_FRACTION_BITS) - weight);
+    uint32_t wb = (uint32_t)weight;
+    uint32_t half = 1 << (SCALE_FRACTION_BITS - 1);
+
+    for (int x = x_start; x < num_bytes; ++x) {
+      dst[x] = (uint8_t)((a[x] * wa + b[x] * wb + half) >> SCALE_FRACTION_BITS);
+    }
+  }
+
+  /* See scale_get_taps() for the reciprocal; `num_rows` is at least 2. */
+  void scale_average_rows_scalar(const uint8_t* const* rows, int num_rows, int reciprocal, uint8_t* dst, int x_start, int num_bytes) {
+
+    uint32_t half = (uint32_t)(num_rows / 2);
+
+    for (int x = x_start; x < num_bytes; ++x) {
+      uint32_t sum = half;
+      for (int i = 0; i < num_rows; ++i) {
+        sum += rows[i][x];
+      }
+      dst[x] = (uint8_t)((sum * (uint32_t)reciprocal) >> 16);
+    }
+  }
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
@@ -0,0 +1,164 @@
+/*
+  SCALE
+  =====
+
+  GENERAL INFO:
+
+    Scales NV12 pictures on the CPU, e.g. to make a small proxy
+    of every picture for analytics next to the full size output,
+    or to stand in for the scaler of the decoder in the fake
+    backend. The result is NV12 too.
+
+      SCALE_FILTER_BOX:      every target sample is the average
+                             of the source samples it covers.
+                             Use this to downscale by a large
+                             factor; it doesn't alias.
+      SCALE_FILTER_BILINEAR: every target sample is a blend of
+                             the two nearest source samples in
+                             both directions, with 8 bit weights.
+
+    The filters are separable. We first filter the source rows
+    that contribute to a target row into one row of the source
+    width (the vertical pass), then filter that row down to the
+    target width with tables we compute once per size (the
+    horizontal pass). The vertical pass touches every source
+    byte so that's the one that's vectorized: the kernels work
+    on 32 (AVX2) or 16 (NEON) bytes at a time in 16 bit lanes
+    and compute exactly the same bytes as the scalar ones. The
+    horizontal pass is scalar; it only produces the target
+    bytes. The chroma plane is filtered like the luma plane
+    with U and V kept apart. ISAs are picked like for the
+    Converter (see convert.h).
+
+    A box covers at most SCALE_MAX_BOX samples in each
+    direction, which limits the downscale factor. The source
+    and target sizes must be even.
+
+  USAGE:
+
+    ScaleSettings settings;
+    settings.width = 320;
+    settings.height = 0;                  // Keep the aspect ratio.
+    settings.filter = SCALE_FILTER_BOX;
+
+    Scaler scaler;
+    scaler.init(settings);
+
+    int width = 0;
+    int height = 0;
+    scale_get_size(src_width, src_height, settings.width, settings.height, width, height);
+
+    ConvertSource src;
+    convert_source_init(slot->data, slot->pitch, src_width, src_height, src);
+
+    std::vector<uint8_t> proxy(convert_get_nbytes(CONVERT_FORMAT_NV12, width, height));
+    ConvertTarget dst;
+    convert_target_init(CONVERT_FORMAT_NV12, width, height, proxy.data(), dst);
+
+    scaler.scale(src, dst, width, height);
+    scaler.shutdown();
+
+ */
+#ifndef NVDEC_SCALE_H
+#define NVDEC_SCALE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <nvdec/convert.h>
+
+#define SCALE_FILTER_NONE 0
+#define SCALE_FILTER_BOX 1
+#define SCALE_FILTER_BILINEAR 2
+
+#define SCALE_FRACTION_BITS 8      /* The bilinear weights are multiplied by 1 << SCALE_FRACTION_BITS. */
+#define SCALE_MAX_BOX 256          /* The sum of a box must fit in 16 bits. */
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  struct ScaleSettings {
+    ScaleSettings();
+    int width;                      /* The target size; 0 for one of them keeps the aspect ratio. 0 for both: don't scale. */
+    int height;
+    int filter;                     /* SCALE_FILTER_* */
+    int isa;                        /* CONVERT_ISA_*; CONVERT_ISA_NONE picks the best one. */
+  };
+
+  struct ScaleTap {                 /* How one target sample is made, in one direction. */
+    int first;                      /* The first source sample. */
+    int last;                       /* Box: the last source sample. Bilinear: the second sample, can be `first` at the edges. */
+    int weight;                     /* Box: the reciprocal of the number of samples, see scale_average_rows_scalar(). Bilinear: the weight of `last`. */
+  };
+
+  /* The vertical pass; see scale_blend_row_scalar() and scale_average_rows_scalar(). */
+  typedef void (*ScaleBlendRowFunc)(const uint8_t* a, const uint8_t* b, int weight, uint8_t* dst, int x_start, int num_bytes);
+  typedef void (*ScaleAverageRowsFunc)(const uint8_t* const* rows, int num_rows, int reciprocal, uint8_t* dst, int x_start, int num_bytes);
+
+  struct ScaleKernels {
+    ScaleBlendRowFunc blend_row;
+    ScaleAverageRowsFunc average_rows;
+  };
+
+  /* ------------------------------------------------ */
+
+  class Scaler {
+  public:
+    Scaler();
+    ~Scaler();
+    int init(const ScaleSettings& settings);
+    int shutdown();
+    int scale(const ConvertSource& src, const ConvertTarget& dst, int width, int height);  /* Scales `src` into the NV12 `dst` of `width` x `height`. */
+    int get_isa();
+
+  private:
+    int update_taps(int src_width, int src_height, int width, int height);               /* Recomputes the tables when the sizes changed. */
+    void scale_plane(const uint8_t* src, size_t src_pitch, int src_samples, uint8_t* dst, size_t dst_pitch, int num_channels, const std::vector<ScaleTap>& x_taps, const std::vector<ScaleTap>& y_taps);
+
+  private:
+    ScaleSettings settings;
+    ScaleKernels kernels;
+    std::vector<ScaleTap> luma_x_taps;
+    std::vector<ScaleTap> luma_y_taps;
+    std::vector<ScaleTap> chroma_x_taps;
+    std::vector<ScaleTap> chroma_y_taps;
+    std::vector<uint8_t> row;                          /* The result of the vertical pass. */
+    std::vector<const uint8_t*> rows;                  /* The source rows of a box. */
+    int src_width;                                     /* The sizes of the tables. */
+    int src_height;
+    int width;
+    int height;
+    bool is_init;
+  };
+
+  /* ------------------------------------------------ */
+
+  int scale_get_size(int src_width, int src_height, int width, int height, int& result_width, int& result_height);  /* Fills in a 0 width or height from the aspect ratio, rounded to even. */
+  int scale_get_taps(int filter, int src_size, int size, std::vector<ScaleTap>& result);
+  int scale_get_kernels(int isa, ScaleKernels& result);                                   /* Fails when the ISA isn't compiled in or not supported by this CPU. */
+  int scale_filter_from_string(const std::string& name);                                  /* Returns SCALE_FILTER_NONE for unknown names. */
+  const char* scale_filter_to_string(int filter);
+
+  /* ------------------------------------------------ */
+
+  /* Kernels; the vectorized ones use the scalar ones for the bytes at the end of a row. */
+  void scale_blend_row_scalar(const uint8_t* a, const uint8_t* b, int weight, uint8_t* dst, int x_start, int num_bytes);
+  void scale_average_rows_scalar(const uint8_t* const* rows, int num_rows, int reciprocal, uint8_t* dst, int x_start, int num_bytes);
+
+#if defined(USE_AVX2)
+  void scale_blend_row_avx2(const uint8_t* a, const uint8_t* b, int weight, uint8_t* dst, int x_start, int num_bytes);
+  void scale_average_rows_avx2(const uint8_t* const* rows, int num_rows, int reciprocal, uint8_t* dst, int x_start, int num_bytes);
+#endif
+
+#if defined(USE_NEON)
+  void scale_blend_row_neon(const uint8_t* a, const uint8_t* b, int weight, uint8_t* dst, int x_start, int num_bytes);
+  void scale_average_rows_neon(const uint8_t* const* rows, int num_rows, int reciprocal, uint8_t* dst, int x_start, int num_bytes);
+#endif
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
+
+#endif
@@ -0,0 +1,448 @@
+#include <stdio.h>
+#include <nvdec/session-scheduler.h>
+#include <nvdec/utils.h>
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  SessionSchedulerSettings::SessionSchedulerSettings()
+    :backend_type(backend_get_default_type())
+    ,num_devices(0)
+    ,max_sessions_per_device(0)
+    ,move_threshold(1.5)
+    ,move_cooldown_ns(1000ull * 1000ull * 1000ull)
+  {
+  }
+
+  SchedulerTicket::SchedulerTicket()
+    :device(-1)
+    ,vram_nbytes(0)
+    ,num_decoded(0)
+    ,decode_ns(0)
+    ,moved_ns(0)
+    ,pending_nbytes(0)
+    ,num_created(0)
+  {
+  }
+
+  SchedulerDeviceStats::SchedulerDeviceStats()
+    :num_sessions(0)
+    ,num_placed(0)
+    ,num_moved_in(0)
+    ,num_moved_out(0)
+    ,num_decoded(0)
+    ,engine_ns(0.0)
+    ,load(0.0)
+    ,free_nbytes(0)
+    ,total_nbytes(0)
+  {
+  }
+
+  /* ------------------------------------------------ */
+
+  SessionScheduler::SessionScheduler()
+    :reported_nbytes(0)
+    ,num_reported(0)
+    ,is_init(false)
+  {
+  }
+
+  SessionScheduler::~SessionScheduler() {
+    shutdown();
+  }
+
+  int SessionScheduler::init(const SessionSchedulerSettings& cfg) {
+
+    if (true == is_init) {
+      printf("Cannot initialize the session scheduler, already initialized. Call shutdown() first.\n");
+      return -1;
+    }
+
+    int num_devices = 0;
+
+    if (BACKEND_TYPE_FAKE == cfg.backend_type) {
+      num_devices = (cfg.fake_devices.empty()) ? 1 : (int)cfg.fake_devices.size();
+    }
+    else {
+      num_devices = backend_get_device_count(cfg.backend_type);
+      if (num_devices <= 0) {
+        printf("Cannot initialize the session scheduler, no %s devices.\n", backend_type_to_string(cfg.backend_type));
+        return -2;
+      }
+      if (cfg.num_devices > 0 && cfg.num_devices < num_devices) {
+        num_devices = cfg.num_devices;
+      }
+    }
+
+    settings = cfg;
+    reported_nbytes = 0;
+    num_reported = 0;
+
+    for (int i = 0; i < num_devices; ++i) {
+
+      DecodeBackend* backend = nullptr;
+
+      if (BACKEND_TYPE_FAKE == cfg.backend_type) {
+        FakeBackend* fake = new FakeBackend();
+        if (false == cfg.fake_devices.empty() && 0 != fake->configure(cfg.fake_devices[i])) {
+          printf("Cannot initialize the session scheduler, failed to configure fake device %d.\n", i);
+          delete fake;
+          destroy_devices();
+          return -3;
+        }
+        backend = fake;
+      }
+      else {
+        backend = backend_create(cfg.backend_type);
+        if (nullptr == backend) {
+          destroy_devices();
+          return -4;
+        }
+      }
+
+      if (0 != backend->init(i)) {
+        printf("Cannot initialize the session scheduler, failed to initialize device %d.\n", i);
+        delete backend;
+        destroy_devices();
+        return -5;
+      }
+
+      Device dev;
+      dev.backend = backend;
+      dev.pending_nbytes = 0;
+      dev.stats.name = backend->get_device_name();
+      devices.push_back(dev);
+    }
+
+    is_init = true;
+
+    return 0;
+  }
+
+  int SessionScheduler::shutdown() {
+
+    if (false == is_init) {
+      return 0;
+    }
+
+    int result = 0;
+
+    for (size_t i = 0; i < devices.size(); ++i) {
+
+      if (devices[i].stats.num_sessions > 0) {
+        printf("Warning: shutting down the session scheduler while device %zu still has %d sessions.\n", i, devices[i].stats.num_sessions);
+        result = -1;
+      }
+
+      if (0 != devices[i].backend->shutdown()) {
+        printf("Failed to cleanly shutdown device %zu of the session scheduler.\n", i);
+        result = -2;
+      }
+
+      delete devices[i].backend;
+    }
+
+    devices.clear();
+    is_init = false;
+
+    return result;
+  }
+
+  int SessionScheduler::place(SchedulerTicket& ticket) {
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    if (false == is_init) {
+      printf("Cannot place a session, the scheduler is not initialized.\n");
+      return -1;
+    }
+
+    if (-1 != ticket.device) {
+      printf("Cannot place a session, it's already placed on device %d.\n", ticket.device);
+      return -2;
+    }
+
+    int device = -1;
+    if (0 != find_device(-1, device)) {
+      printf("Cannot place a session, none of the %zu devices has room.\n", devices.size());
+      return -3;
+    }
+
+    add_session(ticket, device);
+    devices[device].stats.num_placed++;
+
+    return 0;
+  }
+
+  int SessionScheduler::release(SchedulerTicket& ticket) {
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    if (false == is_init) {
+      printf("Cannot release a session, the scheduler is not initialized.\n");
+      return -1;
+    }
+
+    if (ticket.device < 0 || ticket.device >= (int)devices.size()) {
+      return 0;
+    }
+
+    remove_session(ticket);
+
+    return 0;
+  }
+
+  int SessionScheduler::update(SchedulerTicket& ticket, const DecodeSessionStats& stats) {
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    if (ticket.device < 0 || ticket.device >= (int)devices.size()) {
+      printf("Cannot update the load, the session is not placed.\n");
+      return -1;
+    }
+
+    Device& dev = devices[ticket.device];
+
+    /* The session created its decoder on this device: replace our reservation by what it really takes. */
+    if (stats.num_decoders_created > ticket.num_created && stats.decoder_vram_nbytes > 0) {
+      dev.pending_nbytes -= ticket.pending_nbytes;
+      ticket.pending_nbytes = 0;
+      ticket.num_created = stats.num_decoders_created;
+      ticket.vram_nbytes = stats.decoder_vram_nbytes;
+      reported_nbytes += stats.decoder_vram_nbytes;
+      num_reported++;
+    }
+
+    if (stats.num_decoded <= ticket.num_decoded) {
+      return 0;
+    }
+
+    /* The sessions wait for each other, so divide by their number to get the time the engine needs. */
+    uint64_t num_decoded = stats.num_decoded - ticket.num_decoded;
+    double frame_ns = double(stats.decode_ns - ticket.decode_ns) / double(num_decoded);
+    double engine_ns = frame_ns / double((dev.stats.num_sessions > 0) ? dev.stats.num_sessions : 1);
+
+    if (0.0 == dev.stats.engine_ns) {
+      dev.stats.engine_ns = engine_ns;
+    }
+    else {
+      dev.stats.engine_ns += SCHEDULER_LOAD_WEIGHT * (engine_ns - dev.stats.engine_ns);
+    }
+
+    dev.stats.num_decoded += num_decoded;
+    ticket.num_decoded = stats.num_decoded;
+    ticket.decode_ns = stats.decode_ns;
+
+    return 0;
+  }
+
+  int SessionScheduler::rebalance(SchedulerTicket& ticket) {
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    if (ticket.device < 0 || ticket.device >= (int)devices.size()) {
+      printf("Cannot rebalance, the session is not placed.\n");
+      return -1;
+    }
+
+    if (settings.move_threshold <= 0.0 || devices.size() < 2) {
+      return -1;
+    }
+
+    if (get_time_ns() - ticket.moved_ns < settings.move_cooldown_ns) {
+      return -1;
+    }
+
+    /* We only move away from a device when we know how it's doing. */
+    Device& from = devices[ticket.device];
+    if (0.0 == from.stats.engine_ns) {
+      return -1;
+    }
+
+    int target = -1;
+    if (0 != find_device(ticket.device, target)) {
+      return -1;
+    }
+
+    if (get_load(from, 0) <= settings.move_threshold * get_load(devices[target], 1)) {
+      return -1;
+    }
+
+    from.stats.num_moved_out++;
+    remove_session(ticket);
+
+    add_session(ticket, target);
+    devices[target].stats.num_moved_in++;
+
+    return target;
+  }
+
+  int SessionScheduler::get_num_devices() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return (int)devices.size();
+  }
+
+  DecodeBackend* SessionScheduler::get_backend(int device) {
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    if (device < 0 || device >= (int)devices.size()) {
+      printf("Cannot get the backend of device %d, we have %zu devices.\n", device, devices.size());
+      return nullptr;
+    }
+
+    return devices[device].backend;
+  }
+
+  SchedulerDeviceStats SessionScheduler::get_device_stats(int device) {
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    SchedulerDeviceStats result;
+
+    if (device < 0 || device >= (int)devices.size()) {
+      printf("Cannot get the stats of device %d, we have %zu devices.\n", device, devices.size());
+      return result;
+    }
+
+    Device& dev = devices[device];
+    size_t free_nbytes = 0;
+    size_t total_nbytes = 0;
+
+    result = dev.stats;
+    result.load = get_load(dev, 0);
+
+    if (CUDA_SUCCESS == dev.backend->get_memory_info(&free_nbytes, &total_nbytes)) {
+      result.free_nbytes = (free_nbytes > dev.pending_nbytes) ? free_nbytes - dev.pending_nbytes : 0;
+      result.total_nbytes = total_nbytes;
+    }
+
+    return result;
+  }
+
+  /* ------------------------------------------------ */
+
+  void SessionScheduler::destroy_devices() {
+
+    for (size_t i = 0; i < devices.size(); ++i) {
+      devices[i].backend->shutdown();
+      delete devices[i].backend;
+    }
+
+    devices.clear();
+  }
+
+  int SessionScheduler::find_device(int exclude, int& result) {
+
+    double best_load = 0.0;
+    result = -1;
+
+    for (size_t i = 0; i < devices.size(); ++i) {
+
+      if ((int)i == exclude || false == has_room(devices[i])) {
+        continue;
+      }
+
+      double load = get_load(devices[i], 1);
+      if (-1 == result || load < best_load) {
+        best_load = load;
+        result = (int)i;
+      }
+    }
+
+    return (-1 == result) ? -1 : 0;
+  }
+
+  bool SessionScheduler::has_room(Device& dev) {
+
+    if (settings.max_sessions_per_device > 0 && dev.stats.num_sessions >= settings.max_sessions_per_device) {
+      return false;
+    }
+
+    size_t free_nbytes = 0;
+    size_t total_nbytes = 0;
+
+    CUresult r = dev.backend->get_memory_info(&free_nbytes, &total_nbytes);
+    if (CUDA_SUCCESS != r) {
+      printf("Failed to get the memory info of %s: %s.\n", dev.stats.name.c_str(), dev.backend->get_error_string(r));
+      return false;
+    }
+
+    if (free_nbytes < dev.pending_nbytes) {
+      return false;
+    }
+
+    return (free_nbytes - dev.pending_nbytes) >= get_expected_session_nbytes();
+  }
+
+  double SessionScheduler::get_load(Device& dev, int num_extra) {
+
+    double engine_ns = (dev.stats.engine_ns > 0.0) ? dev.stats.engine_ns : get_average_engine_ns();
+    if (0.0 == engine_ns) {
+      engine_ns = 1.0;
+    }
+
+    size_t free_nbytes = 0;
+    size_t total_nbytes = 0;
+    double used = 0.0;
+
+    if (CUDA_SUCCESS == dev.backend->get_memory_info(&free_nbytes, &total_nbytes) && total_nbytes > 0) {
+      uint64_t used_nbytes = (total_nbytes - free_nbytes) + dev.pending_nbytes;
+      used = (used_nbytes < total_nbytes) ? double(used_nbytes) / double(total_nbytes) : 1.0;
+    }
+
+    return double(dev.stats.num_sessions + num_extra) * engine_ns * (1.0 + used);
+  }
+
+  double SessionScheduler::get_average_engine_ns() {
+
+    double total = 0.0;
+    int count = 0;
+
+    for (size_t i = 0; i < devices.size(); ++i) {
+      if (devices[i].stats.engine_ns > 0.0) {
+        total += devices[i].stats.engine_ns;
+        count++;
+      }
+    }
+
+    return (count > 0) ? total / count : 0.0;
+  }
+
+  uint64_t SessionScheduler::get_expected_session_nbytes() {
+
+    if (0 == num_reported) {
+      return SCHEDULER_DEFAULT_SESSION_NBYTES;
+    }
+
+    return reported_nbytes / num_reported;
+  }
+
+  /* The session has no decoder on the device yet, so we reserve what we expect it to take. */
+  void SessionScheduler::add_session(SchedulerTicket& ticket, int device) {
+
+    Device& dev = devices[device];
+
+    ticket.device = device;
+    ticket.moved_ns = get_time_ns();
+    ticket.pending_nbytes = (ticket.vram_nbytes > 0) ? ticket.vram_nbytes : get_expected_session_nbytes();
+
+    dev.pending_nbytes += ticket.pending_nbytes;
+    dev.stats.num_sessions++;
+  }
+
+  void SessionScheduler::remove_session(SchedulerTicket& ticket) {
+
+    Device& dev = devices[ticket.device];
+
+    dev.pending_nbytes -= ticket.pending_nbytes;
+    dev.stats.num_sessions--;
+
+    ticket.pending_nbytes = 0;
+    ticket.device = -1;
+  }
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
@@ -0,0 +1,180 @@
+/*
+  SESSION SCHEDULER
+  =================
+
+  GENERAL INFO:
+
+    The SessionScheduler creates one backend (one context) per
+    device and decides on which device a decode session runs.
+    place() picks the device with the lowest load that still
+    has room for the session, release() gives the room back.
+
+    Room: a device has room when it has less than
+    `max_sessions_per_device` sessions and when its free memory,
+    minus what the sessions that didn't create their decoder yet
+    will take, fits another session. We expect a session to take
+    as much as the average of the sessions that reported their
+    decoder VRAM, or SCHEDULER_DEFAULT_SESSION_NBYTES when none
+    did.
+
+    Load: the sessions on one device share its decode engine,
+    so when they decode as fast as they can, each of them sees
+    a decode time per frame of about the number of sessions
+    times the time the engine needs for one frame. The sessions
+    report their decode time with update() and we keep a moving
+    average of the engine time per frame for every device
+    (SCHEDULER_LOAD_WEIGHT). The load of a device is the number
+    of sessions times that engine time, times one plus the
+    fraction of its memory that's in use, so with an equal
+    decode load we prefer the device with the most free memory.
+    Devices without samples use the average engine time of the
+    devices that have them; without any samples we place on the
+    number of sessions and memory only.
+
+    Moving: the load of a device changes while its sessions run,
+    e.g. a slow device saturates. rebalance() moves a session
+    when the load of its device is more than `move_threshold`
+    times the load of the best other device with the session
+    added. A session is not moved again within
+    `move_cooldown_ns`. When rebalance() returns a device, call
+    DecodeSession::move_to() with its backend; only do this
+    right before an IDR access unit with SPS and PPS.
+
+    BACKEND_TYPE_CUVID: one device per cuda device, or the
+                        first `num_devices`.
+
+    BACKEND_TYPE_FAKE:  one fake device per entry in
+                        `fake_devices`, each with its own memory
+                        and decode time (see backend-fake.h); use
+                        this to test the placement without GPUs.
+
+    All functions can be called from any thread.
+
+  USAGE:
+
+    SessionSchedulerSettings settings;
+    settings.backend_type = BACKEND_TYPE_CUVID;
+
+    SessionScheduler scheduler;
+    scheduler.init(settings);
+
+    SchedulerTicket ticket;
+    scheduler.place(ticket);
+    session.init(scheduler.get_backend(ticket.device), session_settings);
+
+    while (ANNEXB_OK == input->next(au)) {
+      if (ANNEXB_AU_FLAG_IDR & au.flags ...) {
+        scheduler.update(ticket, session.get_stats());
+        if (scheduler.rebalance(ticket) >= 0) {
+          session.move_to(scheduler.get_backend(ticket.device));
+        }
+      }
+      session.decode(au.data, au.size);
+    }
+
+    session.flush();
+    session.shutdown();
+    scheduler.release(ticket);
+    scheduler.shutdown();
+
+ */
+#ifndef NVDEC_SESSION_SCHEDULER_H
+#define NVDEC_SESSION_SCHEDULER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <nvdec/backend.h>
+#include <nvdec/backend-fake.h>
+#include <nvdec/decode-session.h>
+
+#define SCHEDULER_DEFAULT_SESSION_NBYTES (64ull * 1024ull * 1024ull)   /* What we expect a session to take before any session reported its decoder VRAM. */
+#define SCHEDULER_LOAD_WEIGHT 0.25                                     /* The weight of a new sample in the moving average of the engine time per frame. */
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  struct SessionSchedulerSettings {
+    SessionSchedulerSettings();
+    int backend_type;                           /* BACKEND_TYPE_* */
+    int num_devices;                            /* cuvid: use the first `num_devices` devices; 0 uses all of them. */
+    std::vector<FakeDeviceSettings> fake_devices; /* fake: one device per entry; empty gives one default device. */
+    int max_sessions_per_device;                /* 0: no limit. */
+    double move_threshold;                      /* Move when the load of the device is this many times the load of the target; <= 0 never moves. */
+    uint64_t move_cooldown_ns;                  /* Don't move a session again within this time. */
+  };
+
+  /* The scheduler's handle of one session; place() fills it. */
+  struct SchedulerTicket {
+    SchedulerTicket();
+    int device;                                 /* The device the session must run on; -1 when it's not placed. */
+    uint64_t vram_nbytes;                       /* The decoder VRAM of the session; 0 until it reported it. */
+    uint64_t num_decoded;                       /* The session stats of the last update(); we use the difference with the next one. */
+    uint64_t decode_ns;
+    uint64_t moved_ns;                          /* When we placed or moved the session. */
+    uint64_t pending_nbytes;                    /* What we reserved on the device until the session created its decoder there. */
+    int num_created;                            /* DecodeSessionStats::num_decoders_created as seen by update(); a higher count means the session created its decoder on `device`. */
+  };
+
+  struct SchedulerDeviceStats {
+    SchedulerDeviceStats();
+    std::string name;
+    int num_sessions;                           /* The sessions that are currently placed on the device. */
+    uint64_t num_placed;
+    uint64_t num_moved_in;
+    uint64_t num_moved_out;
+    uint64_t num_decoded;                       /* The pictures that the sessions reported. */
+    double engine_ns;                           /* Moving average of the engine time per frame; 0 without samples. */
+    double load;
+    uint64_t free_nbytes;                       /* Free device memory minus what the sessions without a decoder will take. */
+    uint64_t total_nbytes;
+  };
+
+  /* ------------------------------------------------ */
+
+  class SessionScheduler {
+  public:
+    SessionScheduler();
+    ~SessionScheduler();
+    int init(const SessionSchedulerSettings& settings);                     /* Creates and initializes a backend for every device. */
+    int shutdown();                                                         /* Call after all sessions are shut down. */
+    int place(SchedulerTicket& ticket);                                     /* Picks the device with the lowest load that has room; < 0 when none has room. */
+    int release(SchedulerTicket& ticket);
+    int update(SchedulerTicket& ticket, const DecodeSessionStats& stats);   /* Feeds the decode time and VRAM of the session into the load of its device. */
+    int rebalance(SchedulerTicket& ticket);                                 /* Returns the device the session must move to, or -1 when it stays. */
+    int get_num_devices();
+    DecodeBackend* get_backend(int device);
+    SchedulerDeviceStats get_device_stats(int device);
+
+  private:
+    struct Device {
+      DecodeBackend* backend;
+      SchedulerDeviceStats stats;
+      uint64_t pending_nbytes;                                              /* Expected VRAM of the sessions that didn't create their decoder yet. */
+    };
+
+    void destroy_devices();
+    int find_device(int exclude, int& result);                              /* The device with room and the lowest load with one more session. */
+    bool has_room(Device& dev);
+    double get_load(Device& dev, int num_extra);
+    double get_average_engine_ns();
+    uint64_t get_expected_session_nbytes();
+    void add_session(SchedulerTicket& ticket, int device);
+    void remove_session(SchedulerTicket& ticket);
+
+  private:
+    std::mutex mtx;
+    SessionSchedulerSettings settings;
+    std::vector<Device> devices;
+    uint64_t reported_nbytes;                                               /* The decoder VRAM of all sessions that reported it, to estimate the next one. */
+    uint64_t num_reported;
+    bool is_init;
+  };
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
+
+#endif
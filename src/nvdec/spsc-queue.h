@@ -0,0 +1,172 @@
+/*
+  SPSC QUEUE
+  ==========
+
+  GENERAL INFO:
+
+    A bounded single producer, single consumer ring buffer. One
+    thread calls push(), one other thread calls pop(); both
+    are wait-free: they never take a lock and return false
+    when the queue is full or empty so the caller can decide
+    how to wait. The read and write positions live on their
+    own cache line together with a cached copy of the other
+    side's position, so the threads only touch each others
+    cache line when the cached value says the queue looks
+    full or empty.
+
+    The storage is rounded up to a power of two so we can mask
+    the positions, but we never hold more than the capacity
+    that was passed into init().
+
+  USAGE:
+
+    SpscQueue<Frame> queue;
+    queue.init(8);
+
+    // Producer thread
+    while (false == queue.push(frame)) {
+      // Full, apply backpressure.
+    }
+
+    // Consumer thread
+    Frame frame;
+    if (true == queue.pop(frame)) {
+      ...
+    }
+
+ */
+#ifndef NVDEC_SPSC_QUEUE_H
+#define NVDEC_SPSC_QUEUE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+#define SPSC_CACHE_LINE_SIZE 64
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  template<class T>
+  class SpscQueue {
+  public:
+    SpscQueue();
+    int init(size_t capacity);                         /* Must be called before the threads use the queue. */
+    bool push(const T& item);                          /* Producer only. Returns false when the queue is full. */
+    bool pop(T& item);                                 /* Consumer only. Returns false when the queue is empty. */
+    size_t size();                                     /* The number of items in the queue; a snapshot when called from a third thread. */
+    size_t capacity();
+
+  private:
+    std::vector<T> items;
+    size_t mask;
+    size_t limit;
+
+    /* Producer side */
+    alignas(SPSC_CACHE_LINE_SIZE) std::atomic<size_t> write_pos;
+    size_t cached_read_pos;
+
+    /* Consumer side */
+    alignas(SPSC_CACHE_LINE_SIZE) std::atomic<size_t> read_pos;
+    size_t cached_write_pos;
+
+    char padding[SPSC_CACHE_LINE_SIZE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+  };
+
+  /* ------------------------------------------------ */
+
+  template<class T>
+  SpscQueue<T>::SpscQueue()
+    :mask(0)
+    ,limit(0)
+    ,write_pos(0)
+    ,cached_read_pos(0)
+    ,read_pos(0)
+    ,cached_write_pos(0)
+  {
+  }
+
+  template<class T>
+  int SpscQueue<T>::init(size_t cap) {
+
+    if (0 == cap) {
+      printf("Cannot initialize the spsc queue, capacity is 0.\n");
+      return -1;
+    }
+
+    if (0 != limit) {
+      printf("Cannot initialize the spsc queue, already initialized.\n");
+      return -2;
+    }
+
+    size_t storage = 1;
+    while (storage < cap) {
+      storage <<= 1;
+    }
+
+    items.resize(storage);
+    mask = storage - 1;
+    limit = cap;
+    write_pos.store(0, std::memory_order_relaxed);
+    read_pos.store(0, std::memory_order_relaxed);
+    cached_read_pos = 0;
+    cached_write_pos = 0;
+
+    return 0;
+  }
+
+  template<class T>
+  bool SpscQueue<T>::push(const T& item) {
+
+    size_t wp = write_pos.load(std::memory_order_relaxed);
+
+    if (wp - cached_read_pos >= limit) {
+      cached_read_pos = read_pos.load(std::memory_order_acquire);
+      if (wp - cached_read_pos >= limit) {
+        return false;
+      }
+    }
+
+    items[wp & mask] = item;
+    write_pos.store(wp + 1, std::memory_order_release);
+
+    return true;
+  }
+
+  template<class T>
+  bool SpscQueue<T>::pop(T& item) {
+
+    size_t rp = read_pos.load(std::memory_order_relaxed);
+
+    if (rp == cached_write_pos) {
+      cached_write_pos = write_pos.load(std::memory_order_acquire);
+      if (rp == cached_write_pos) {
+        return false;
+      }
+    }
+
+    item = items[rp & mask];
+    read_pos.store(rp + 1, std::memory_order_release);
+
+    return true;
+  }
+
+  template<class T>
+  size_t SpscQueue<T>::size() {
+    size_t rp = read_pos.load(std::memory_order_acquire);
+    size_t wp = write_pos.load(std::memory_order_acquire);
+    return (wp >= rp) ? (wp - rp) : 0;
+  }
+
+  template<class T>
+  size_t SpscQueue<T>::capacity() {
+    return limit;
+  }
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
+
+#endif
@@ -0,0 +1,545 @@
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <algorithm>
+#include <nvdec/annexb.h>
+#include <nvdec/h264.h>
+#include <nvdec/input.h>
+#include <nvdec/stream-index.h>
+
+#if !defined(_WIN32)
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#endif
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  struct StreamIndexNal {
+    const uint8_t* data;                              /* Without start code; points into the mapped stream. */
+    size_t nbytes;
+    int sps_id;                                       /* For a PPS: the SPS it uses. */
+  };
+
+  static int get_slice_pps_id(const uint8_t* nal, size_t nbytes);
+  static int get_recovery_frame_cnt(const uint8_t* nal, size_t nbytes, int& result);
+  static void append_nal(const StreamIndexNal& nal, std::vector<uint8_t>& result);
+
+  /* ------------------------------------------------ */
+
+  StreamIndex::StreamIndex()
+    :mapped(nullptr)
+    ,mapped_nbytes(0)
+    ,data(nullptr)
+    ,nbytes(0)
+    ,header(nullptr)
+    ,entries(nullptr)
+    ,parameter_sets(nullptr)
+  {
+  }
+
+  StreamIndex::~StreamIndex() {
+    close();
+  }
+
+  int StreamIndex::open(const std::string& stream_path) {
+
+    std::string index_path = stream_index_get_path(stream_path);
+
+    if (0 == load(index_path, stream_path)) {
+      return 0;
+    }
+
+    if (0 != build(stream_path)) {
+      return -1;
+    }
+
+    /* We still have the index when we can't write it, e.g. on a read-only disk. */
+    if (0 != save(index_path)) {
+      printf("Warning: failed to save the index of %s in %s.\n", stream_path.c_str(), index_path.c_str());
+    }
+
+    return 0;
+  }
+
+  int StreamIndex::build(const std::string& stream_path) {
+
+    close();
+
+    uint64_t stream_nbytes = 0;
+    uint64_t stream_hash = 0;
+    if (0 != stream_index_get_stream_id(stream_path, stream_nbytes, stream_hash)) {
+      return -1;
+    }
+
+    MappedInput input;
+    if (0 != input.open(stream_path)) {
+      return -2;
+    }
+
+    /* The last SPS and PPS we've seen for every id. */
+    std::vector<StreamIndexNal> sps_nals(H264_MAX_SPS);
+    std::vector<StreamIndexNal> pps_nals(H264_MAX_PPS);
+    memset((char*)sps_nals.data(), 0x00, sizeof(StreamIndexNal) * sps_nals.size());
+    memset((char*)pps_nals.data(), 0x00, sizeof(StreamIndexNal) * pps_nals.size());
+
+    std::vector<StreamIndexEntry> list;
+    std::vector<uint8_t> ps_data;
+    std::vector<uint8_t> ps;
+    std::vector<uint8_t> last_ps;
+    uint64_t last_ps_offset = 0;
+    uint64_t offset = 0;
+    uint64_t frame = 0;
+    uint32_t flags = ANNEXB_AU_FLAG_IDR | ANNEXB_AU_FLAG_SPS | ANNEXB_AU_FLAG_PPS | ANNEXB_AU_FLAG_SEI;
+    AccessUnit au;
+    int r = ANNEXB_OK;
+
+    while (ANNEXB_OK == (r = input.next(au))) {
+
+      /* Most access units only have slices of non-IDR pictures; we don't look inside those. */
+      if (0 == (au.flags & flags)) {
+        offset += au.size;
+        frame++;
+        continue;
+      }
+
+      const uint8_t* end = au.data + au.size;
+      const uint8_t* sc = annexb_find_start_code(au.data, end);
+      bool is_idr = false;
+      bool has_recovery = false;
+      int recovery_frame_cnt = 0;
+      int pps_id = -1;
+
+      while (sc < end) {
+
+        const uint8_t* nal = sc + 3;
+        const uint8_t* next = annexb_find_start_code(nal, end);
+        const uint8_t* nal_end = next;
+
+        while (nal_end > nal && 0x00 == nal_end[-1]) {
+          nal_end--;
+        }
+
+        size_t nal_nbytes = nal_end - nal;
+        int nal_type = (nal_nbytes > 0) ? (nal[0] & 0x1F) : 0;
+
+        if (H264_NAL_SPS == nal_type) {
+          H264Sps sps;
+          if (0 == h264_parse_sps(nal, nal_nbytes, sps) && sps.sps_id >= 0 && sps.sps_id < H264_MAX_SPS) {
+            sps_nals[sps.sps_id].data = nal;
+            sps_nals[sps.sps_id].nbytes = nal_nbytes;
+          }
+        }
+        else if (H264_NAL_PPS == nal_type) {
+          H264Pps pps;
+          if (0 == h264_parse_pps(nal, nal_nbytes, pps) && pps.pps_id >= 0 && pps.pps_id < H264_MAX_PPS) {
+            pps_nals[pps.pps_id].data = nal;
+            pps_nals[pps.pps_id].nbytes = nal_nbytes;
+            pps_nals[pps.pps_id].sps_id = pps.sps_id;
+          }
+        }
+        else if (H264_NAL_SEI == nal_type) {
+          if (0 == get_recovery_frame_cnt(nal, nal_nbytes, recovery_frame_cnt)) {
+            has_recovery = true;
+          }
+        }
+        else if (H264_NAL_IDR == nal_type || H264_NAL_SLICE == nal_type) {
+          is_idr = is_idr || (H264_NAL_IDR == nal_type);
+          if (pps_id < 0) {
+            pps_id = get_slice_pps_id(nal, nal_nbytes);
+          }
+        }
+
+        sc = next;
+      }
+
+      int type = STREAM_INDEX_ENTRY_NONE;
+      if (true == is_idr) {
+        type = STREAM_INDEX_ENTRY_IDR;
+        recovery_frame_cnt = 0;
+      }
+      else if (true == has_recovery) {
+        type = STREAM_INDEX_ENTRY_RECOVERY;
+      }
+
+      /* We can't start at a picture when we don't have its parameter sets, e.g. at the start of a capture. */
+      if (STREAM_INDEX_ENTRY_NONE != type
+          && pps_id >= 0 && pps_id < H264_MAX_PPS
+          && nullptr != pps_nals[pps_id].data
+          && pps_nals[pps_id].sps_id >= 0 && pps_nals[pps_id].sps_id < H264_MAX_SPS
+          && nullptr != sps_nals[pps_nals[pps_id].sps_id].data)
+        {
+          ps.clear();
+          append_nal(sps_nals[pps_nals[pps_id].sps_id], ps);
+          append_nal(pps_nals[pps_id], ps);
+
+          if (ps != last_ps) {
+            last_ps_offset = ps_data.size();
+            last_ps = ps;
+            ps_data.insert(ps_data.end(), ps.begin(), ps.end());
+          }
+
+          StreamIndexEntry entry;
+          memset((char*)&entry, 0x00, sizeof(entry));
+          entry.offset = offset;
+          entry.frame = frame;
+          entry.parameter_sets_offset = last_ps_offset;
+          entry.parameter_sets_nbytes = (uint32_t)ps.size();
+          entry.type = (uint32_t)type;
+          entry.recovery_frame_cnt = recovery_frame_cnt;
+          list.push_back(entry);
+        }
+
+      offset += au.size;
+      frame++;
+    }
+
+    input.close();
+
+    if (r < 0) {
+      printf("Failed to scan %s for the index.\n", stream_path.c_str());
+      return -3;
+    }
+
+    StreamIndexHeader hdr;
+    memset((char*)&hdr, 0x00, sizeof(hdr));
+    memcpy(hdr.magic, STREAM_INDEX_MAGIC, sizeof(hdr.magic));
+    hdr.version = STREAM_INDEX_VERSION;
+    hdr.num_entries = (uint32_t)list.size();
+    hdr.stream_nbytes = stream_nbytes;
+    hdr.stream_hash = stream_hash;
+    hdr.num_frames = frame;
+    hdr.parameter_sets_nbytes = ps_data.size();
+
+    const uint8_t* hdr_ptr = (const uint8_t*)&hdr;
+    const uint8_t* list_ptr = (const uint8_t*)list.data();
+    buffer.clear();
+    buffer.insert(buffer.end(), hdr_ptr, hdr_ptr + sizeof(hdr));
+    buffer.insert(buffer.end(), list_ptr, list_ptr + list.size() * sizeof(StreamIndexEntry));
+    buffer.insert(buffer.end(), ps_data.begin(), ps_data.end());
+
+    return set_data(buffer.data(), buffer.size());
+  }
+
+  int StreamIndex::save(const std::string& index_path) {
+
+    if (nullptr == data) {
+      printf("Cannot save the index, we don't have one.\n");
+      return -1;
+    }
+
+    std::ofstream ofs(index_path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (false == ofs.is_open()) {
+      printf("Failed to open %s to save the index.\n", index_path.c_str());
+      return -2;
+    }
+
+    ofs.write((const char*)data, nbytes);
+    if (false == ofs.good()) {
+      printf("Failed to write the index to %s.\n", index_path.c_str());
+      return -3;
+    }
+
+    return 0;
+  }
+
+  int StreamIndex::load(const std::string& index_path, const std::string& stream_path) {
+
+    close();
+
+#if defined(_WIN32)
+
+    /* We don't map on Windows; the index is small. */
+    std::ifstream ifs(index_path.c_str(), std::ios::in | std::ios::binary);
+    if (false == ifs.is_open()) {
+      return -1;
+    }
+
+    buffer.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    if (0 != set_data(buffer.data(), buffer.size())) {
+      close();
+      return -2;
+    }
+
+#else
+
+    int fd = ::open(index_path.c_str(), O_RDONLY);
+    if (-1 == fd) {
+      return -1;
+    }
+
+    struct stat st;
+    if (0 != fstat(fd, &st) || 0 == st.st_size) {
+      ::close(fd);
+      return -2;
+    }
+
+    void* ptr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (MAP_FAILED == ptr) {
+      printf("Failed to map the index %s.\n", index_path.c_str());
+      return -3;
+    }
+
+    mapped = (uint8_t*)ptr;
+    mapped_nbytes = (size_t)st.st_size;
+
+    if (0 != set_data(mapped, mapped_nbytes)) {
+      printf("The index %s is invalid, ignoring it.\n", index_path.c_str());
+      close();
+      return -4;
+    }
+
+#endif
+
+    uint64_t stream_nbytes = 0;
+    uint64_t stream_hash = 0;
+    if (0 != stream_index_get_stream_id(stream_path, stream_nbytes, stream_hash)
+        || stream_nbytes != header->stream_nbytes
+        || stream_hash != header->stream_hash)
+      {
+        printf("The index %s doesn't belong to %s (anymore), ignoring it.\n", index_path.c_str(), stream_path.c_str());
+        close();
+        return -5;
+      }
+
+    return 0;
+  }
+
+  int StreamIndex::close() {
+
+#if !defined(_WIN32)
+    if (nullptr != mapped) {
+      munmap(mapped, mapped_nbytes);
+    }
+#endif
+
+    mapped = nullptr;
+    mapped_nbytes = 0;
+    buffer.clear();
+    data = nullptr;
+    nbytes = 0;
+    header = nullptr;
+    entries = nullptr;
+    parameter_sets = nullptr;
+
+    return 0;
+  }
+
+  int StreamIndex::find(uint64_t frame, int mode, StreamIndexEntry& result) {
+
+    if (nullptr == header) {
+      printf("Cannot find an entry, the index isn't loaded.\n");
+      return -1;
+    }
+
+    if (STREAM_INDEX_FIND_IDR != mode && STREAM_INDEX_FIND_ANY != mode) {
+      printf("Cannot find an entry, invalid mode %d.\n", mode);
+      return -2;
+    }
+
+    /* The first entry after `frame`; we walk back from there. */
+    const StreamIndexEntry* end = entries + header->num_entries;
+    const StreamIndexEntry* it = std::upper_bound(entries, end, frame, [](uint64_t f, const StreamIndexEntry& e) { return f < e.frame; });
+
+    while (it != entries) {
+      --it;
+      if (STREAM_INDEX_FIND_ANY == mode || STREAM_INDEX_ENTRY_IDR == it->type) {
+        result = *it;
+        return 0;
+      }
+    }
+
+    return -3;
+  }
+
+  int StreamIndex::get_parameter_sets(const StreamIndexEntry& entry, const uint8_t** result, size_t* result_nbytes) {
+
+    if (nullptr == header || nullptr == result || nullptr == result_nbytes) {
+      return -1;
+    }
+
+    if (entry.parameter_sets_offset + entry.parameter_sets_nbytes > header->parameter_sets_nbytes) {
+      return -2;
+    }
+
+    *result = parameter_sets + entry.parameter_sets_offset;
+    *result_nbytes = entry.parameter_sets_nbytes;
+
+    return 0;
+  }
+
+  uint64_t StreamIndex::get_num_frames() {
+    return (nullptr != header) ? header->num_frames : 0;
+  }
+
+  uint32_t StreamIndex::get_num_entries() {
+    return (nullptr != header) ? header->num_entries : 0;
+  }
+
+  const StreamIndexEntry* StreamIndex::get_entries() {
+    return entries;
+  }
+
+  size_t StreamIndex::get_nbytes() {
+    return nbytes;
+  }
+
+  int StreamIndex::set_data(const uint8_t* ptr, size_t size) {
+
+    if (size < sizeof(StreamIndexHeader)) {
+      return -1;
+    }
+
+    const StreamIndexHeader* hdr = (const StreamIndexHeader*)ptr;
+    if (0 != memcmp(hdr->magic, STREAM_INDEX_MAGIC, sizeof(hdr->magic)) || STREAM_INDEX_VERSION != hdr->version) {
+      return -2;
+    }
+
+    uint64_t expected = sizeof(StreamIndexHeader) + (uint64_t)hdr->num_entries * sizeof(StreamIndexEntry) + hdr->parameter_sets_nbytes;
+    if (expected != size) {
+      return -3;
+    }
+
+    const StreamIndexEntry* list = (const StreamIndexEntry*)(ptr + sizeof(StreamIndexHeader));
+    for (uint32_t i = 0; i < hdr->num_entries; ++i) {
+      if (list[i].parameter_sets_offset + list[i].parameter_sets_nbytes > hdr->parameter_sets_nbytes
+          || (i > 0 && list[i].frame <= list[i - 1].frame))
+        {
+          return -4;
+        }
+    }
+
+    data = ptr;
+    nbytes = size;
+    header = hdr;
+    entries = list;
+    parameter_sets = ptr + sizeof(StreamIndexHeader) + (size_t)hdr->num_entries * sizeof(StreamIndexEntry);
+
+    return 0;
+  }
+
+  /* ------------------------------------------------ */
+
+  int stream_index_get_stream_id(const std::string& stream_path, uint64_t& nbytes, uint64_t& hash) {
+
+    std::ifstream ifs(stream_path.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+    if (false == ifs.is_open()) {
+      printf("Failed to open %s.\n", stream_path.c_str());
+      return -1;
+    }
+
+    nbytes = (uint64_t)ifs.tellg();
+    ifs.seekg(0, std::ifstream::beg);
+
+    std::vector<char> head((size_t)std::min<uint64_t>(nbytes, STREAM_INDEX_HASH_NBYTES));
+    if (false == ifs.read(head.data(), head.size()).good() && false == head.empty()) {
+      printf("Failed to read the start of %s.\n", stream_path.c_str());
+      return -2;
+    }
+
+    hash = 14695981039346656037ull;
+    for (size_t i = 0; i < head.size(); ++i) {
+      hash = (hash ^ (uint8_t)head[i]) * 1099511628211ull;
+    }
+
+    return 0;
+  }
+
+  std::string stream_index_get_path(const std::string& stream_path) {
+    return stream_path + STREAM_INDEX_EXTENSION;
+  }
+
+  const char* stream_index_entry_type_to_string(int type) {
+
+    switch (type) {
+      case STREAM_INDEX_ENTRY_IDR:      { return "idr";      }
+      case STREAM_INDEX_ENTRY_RECOVERY: { return "recovery"; }
+      default:                          { return "none";     }
+    }
+  }
+
+  /* ------------------------------------------------ */
+
+  static int get_slice_pps_id(const uint8_t* nal, size_t nbytes) {
+
+    if (nbytes < 2) {
+      return -1;
+    }
+
+    uint8_t rbsp[16];
+    size_t rbsp_size = h264_unescape(nal + 1, nbytes - 1, rbsp, sizeof(rbsp));
+    H264BitReader br(rbsp, rbsp_size);
+
+    br.read_ue();                 /* first_mb_in_slice */
+    br.read_ue();                 /* slice_type */
+    int pps_id = (int)br.read_ue();
+
+    return (true == br.is_overrun()) ? -2 : pps_id;
+  }
+
+  /* An SEI NAL holds one or more messages; see 7.3.2.3.1 and D.1.8 of the spec. */
+  static int get_recovery_frame_cnt(const uint8_t* nal, size_t nbytes, int& result) {
+
+    if (nbytes < 2) {
+      return -1;
+    }
+
+    std::vector<uint8_t> rbsp(nbytes);
+    size_t size = h264_unescape(nal + 1, nbytes - 1, rbsp.data(), rbsp.size());
+    size_t i = 0;
+
+    /* The rbsp_trailing_bits start with 0x80. */
+    while (i + 2 <= size && 0x80 != rbsp[i]) {
+
+      uint32_t payload_type = 0;
+      while (i < size && 0xFF == rbsp[i]) {
+        payload_type += 255;
+        i++;
+      }
+      if (i >= size) {
+        break;
+      }
+      payload_type += rbsp[i++];
+
+      uint32_t payload_size = 0;
+      while (i < size && 0xFF == rbsp[i]) {
+        payload_size += 255;
+        i++;
+      }
+      if (i >= size) {
+        break;
+      }
+      payload_size += rbsp[i++];
+
+      if (payload_size > size - i) {
+        break;
+      }
+
+      /* recovery_point */
+      if (6 == payload_type) {
+        H264BitReader br(rbsp.data() + i, payload_size);
+        result = (int)br.read_ue();
+        return (true == br.is_overrun()) ? -2 : 0;
+      }
+
+      i += payload_size;
+    }
+
+    return -3;
+  }
+
+  static void append_nal(const StreamIndexNal& nal, std::vector<uint8_t>& result) {
+
+    static const uint8_t start_code[] = { 0x00, 0x00, 0x00, 0x01 };
+    result.insert(result.end(), start_code, start_code + sizeof(start_code));
+    result.insert(result.end(), nal.data, nal.data + nal.nbytes);
+  }
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
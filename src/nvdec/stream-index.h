@@ -0,0 +1,155 @@
+/*
+  STREAM INDEX
+  ============
+
+  GENERAL INFO:
+
+    To decode frame N of an Annex-B file we have to start at a
+    picture that doesn't refer to anything before it, with the
+    SPS and PPS that it uses. Without an index the only way to
+    find those is to scan the file from byte 0. The StreamIndex
+    does that scan once and keeps, for every random access
+    point, the byte offset of its access unit, its frame number
+    and a copy of its active SPS and PPS, so a seek is a binary
+    search.
+
+      STREAM_INDEX_ENTRY_IDR:      an IDR picture; decoding
+                                   starts clean here.
+      STREAM_INDEX_ENTRY_RECOVERY: an access unit with a
+                                   recovery point SEI. The
+                                   pictures are correct after
+                                   `recovery_frame_cnt` frames;
+                                   streams without IDRs (e.g.
+                                   intra refresh) only have
+                                   these.
+
+    A frame is an access unit as the AnnexbSplitter returns
+    them, counted from 0, in decode order; the same units that
+    we feed to DecodeSession::decode().
+
+    build() scans the file with a MappedInput, so it's one pass
+    with the SIMD start code search; we only look at the NALs of
+    the access units that have an IDR, SPS, PPS or SEI. The
+    active parameter sets come from the `pps_id` of the first
+    slice and the `sps_id` of that PPS. Entries that use the
+    same parameter sets share one copy.
+
+    save() writes the index to a file, by default the stream
+    path plus STREAM_INDEX_EXTENSION, and load() memory maps it
+    so reusing an index doesn't read or parse anything. An
+    index remembers the size of the stream and a hash of its
+    first STREAM_INDEX_HASH_NBYTES bytes; load() rejects an
+    index that doesn't match. The file is:
+
+      StreamIndexHeader
+      StreamIndexEntry[num_entries]          sorted by frame
+      parameter sets                         Annex-B, with start codes
+
+    in the byte order of the machine that wrote it.
+
+  USAGE:
+
+    StreamIndex index;
+    index.open("moonlight.264");           // Loads moonlight.264.idx or builds and saves it.
+
+    StreamIndexEntry entry;
+    index.find(1000, STREAM_INDEX_FIND_IDR, entry);
+
+    const uint8_t* ps = nullptr;
+    size_t ps_nbytes = 0;
+    index.get_parameter_sets(entry, &ps, &ps_nbytes);
+
+    input->seek(entry.offset);
+    session.seek(ps, ps_nbytes);
+    while (ANNEXB_OK == input->next(au)) {
+      session.decode(au.data, au.size);
+    }
+
+ */
+#ifndef NVDEC_STREAM_INDEX_H
+#define NVDEC_STREAM_INDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#define STREAM_INDEX_MAGIC "NVDECIDX"                /* 8 bytes, without the terminating zero. */
+#define STREAM_INDEX_VERSION 1
+#define STREAM_INDEX_EXTENSION ".idx"
+#define STREAM_INDEX_HASH_NBYTES (64 * 1024)         /* The bytes at the start of the stream that we hash to recognize it. */
+
+#define STREAM_INDEX_ENTRY_NONE 0
+#define STREAM_INDEX_ENTRY_IDR 1
+#define STREAM_INDEX_ENTRY_RECOVERY 2
+
+#define STREAM_INDEX_FIND_IDR 1                      /* Only return IDR entries. */
+#define STREAM_INDEX_FIND_ANY 2                      /* Also return recovery points. */
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  struct StreamIndexHeader {
+    char magic[8];                                    /* STREAM_INDEX_MAGIC */
+    uint32_t version;
+    uint32_t num_entries;
+    uint64_t stream_nbytes;
+    uint64_t stream_hash;                             /* FNV-1a of the first STREAM_INDEX_HASH_NBYTES of the stream. */
+    uint64_t num_frames;                              /* Access units in the stream. */
+    uint64_t parameter_sets_nbytes;
+  };
+
+  struct StreamIndexEntry {
+    uint64_t offset;                                  /* Of the first byte of the access unit in the stream. */
+    uint64_t frame;                                   /* The number of access units before this one. */
+    uint64_t parameter_sets_offset;                   /* Where its SPS and PPS start in the parameter sets of the index. */
+    uint32_t parameter_sets_nbytes;
+    uint32_t type;                                    /* STREAM_INDEX_ENTRY_* */
+    int32_t recovery_frame_cnt;                       /* From the recovery point SEI; 0 for an IDR. */
+    uint32_t reserved;
+  };
+
+  /* ------------------------------------------------ */
+
+  class StreamIndex {
+  public:
+    StreamIndex();
+    ~StreamIndex();
+    int open(const std::string& stream_path);                                    /* Loads the index next to the stream; builds and saves it when there is none or it's stale. */
+    int build(const std::string& stream_path);
+    int save(const std::string& index_path);
+    int load(const std::string& index_path, const std::string& stream_path);     /* Maps the index; fails when it wasn't made for this stream. */
+    int close();
+    int find(uint64_t frame, int mode, StreamIndexEntry& result);               /* The last entry at or before `frame`; `mode` is STREAM_INDEX_FIND_*. */
+    int get_parameter_sets(const StreamIndexEntry& entry, const uint8_t** data, size_t* nbytes);
+    uint64_t get_num_frames();
+    uint32_t get_num_entries();
+    const StreamIndexEntry* get_entries();
+    size_t get_nbytes();                                                          /* The size of the index file. */
+
+  private:
+    int set_data(const uint8_t* ptr, size_t nbytes);                              /* Checks the layout and points `header`, `entries` and `parameter_sets` into it. */
+
+  private:
+    std::vector<uint8_t> buffer;                                                  /* The index after build(). */
+    uint8_t* mapped;                                                              /* The index after load(). */
+    size_t mapped_nbytes;
+    const uint8_t* data;                                                          /* Either of the two. */
+    size_t nbytes;
+    const StreamIndexHeader* header;
+    const StreamIndexEntry* entries;
+    const uint8_t* parameter_sets;
+  };
+
+  /* ------------------------------------------------ */
+
+  int stream_index_get_stream_id(const std::string& stream_path, uint64_t& nbytes, uint64_t& hash);  /* The size and hash that an index stores. */
+  std::string stream_index_get_path(const std::string& stream_path);
+  const char* stream_index_entry_type_to_string(int type);
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
+
+#endif
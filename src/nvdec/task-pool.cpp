@@ -0,0 +1,309 @@
+#include <stdio.h>
+#include <nvdec/task-pool.h>
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  /* The pool and worker that the current thread belongs to, so submit() knows whose queue to use. */
+  static thread_local TaskPool* tls_pool = nullptr;
+  static thread_local int tls_worker = -1;
+
+  /* ------------------------------------------------ */
+
+  TaskPool::TaskPool()
+    :num_queued(0)
+    ,num_submitted(0)
+    ,next_worker(0)
+    ,must_stop(false)
+    ,is_init(false)
+  {
+  }
+
+  TaskPool::~TaskPool() {
+    shutdown();
+  }
+
+  int TaskPool::init(int num_workers) {
+
+    if (true == is_init) {
+      printf("Cannot initialize the task pool, already initialized. Call shutdown() first.\n");
+      return -1;
+    }
+
+    if (num_workers < 0) {
+      printf("Cannot initialize the task pool, invalid number of workers %d.\n", num_workers);
+      return -2;
+    }
+
+    if (0 == num_workers) {
+      num_workers = (int)std::thread::hardware_concurrency();
+      num_workers = (num_workers > 0) ? num_workers : 1;
+    }
+
+    must_stop = false;
+    num_queued = 0;
+    num_submitted = 0;
+    next_worker = 0;
+
+    /* Create all queues before a worker can try to steal from them. */
+    for (int i = 0; i < num_workers; ++i) {
+      Worker* worker = new Worker();
+      worker->num_executed = 0;
+      worker->num_stolen = 0;
+      worker->num_sleeps = 0;
+      workers.push_back(worker);
+    }
+
+    for (int i = 0; i < num_workers; ++i) {
+      workers[i]->thread = std::thread(&TaskPool::run, this, i);
+    }
+
+    is_init = true;
+
+    return 0;
+  }
+
+  int TaskPool::shutdown() {
+
+    if (false == is_init) {
+      return 0;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(sleep_mtx);
+      must_stop = true;
+    }
+
+    sleep_cv.notify_all();
+
+    for (size_t i = 0; i < workers.size(); ++i) {
+      if (true == workers[i]->thread.joinable()) {
+        workers[i]->thread.join();
+      }
+    }
+
+    for (size_t i = 0; i < workers.size(); ++i) {
+      delete workers[i];
+    }
+
+    workers.clear();
+    is_init = false;
+
+    return 0;
+  }
+
+  int TaskPool::submit(const Task& task) {
+
+    if (false == is_init) {
+      printf("Cannot submit a task, the task pool is not initialized.\n");
+      return -1;
+    }
+
+    if (!task) {
+      printf("Cannot submit an empty task.\n");
+      return -2;
+    }
+
+    int index = (this == tls_pool) ? tls_worker : (int)(next_worker++ % workers.size());
+
+    {
+      std::lock_guard<std::mutex> lock(workers[index]->mtx);
+      workers[index]->tasks.push_back(task);
+    }
+
+    num_submitted++;
+
+    /* Take the lock so a worker that just found nothing can't miss this. */
+    {
+      std::lock_guard<std::mutex> lock(sleep_mtx);
+      num_queued++;
+    }
+
+    sleep_cv.notify_one();
+
+    return 0;
+  }
+
+  int TaskPool::get_num_workers() {
+    return (int)workers.size();
+  }
+
+  TaskPoolStats TaskPool::get_stats() {
+
+    TaskPoolStats stats;
+    stats.num_submitted = num_submitted;
+    stats.num_executed = 0;
+    stats.num_stolen = 0;
+    stats.num_sleeps = 0;
+
+    for (size_t i = 0; i < workers.size(); ++i) {
+      stats.num_executed += workers[i]->num_executed;
+      stats.num_stolen += workers[i]->num_stolen;
+      stats.num_sleeps += workers[i]->num_sleeps;
+    }
+
+    return stats;
+  }
+
+  /* ------------------------------------------------ */
+
+  void TaskPool::run(int index) {
+
+    tls_pool = this;
+    tls_worker = index;
+
+    Worker* worker = workers[index];
+    Task task;
+
+    while (true) {
+
+      if (true == pop(index, task)) {
+        task();
+        task = nullptr;
+        worker->num_executed++;
+        continue;
+      }
+
+      if (true == steal(index, task)) {
+        task();
+        task = nullptr;
+        worker->num_executed++;
+        worker->num_stolen++;
+        continue;
+      }
+
+      /* Nothing to do; we only stop when all tasks are done as running tasks may still submit new ones. */
+      std::unique_lock<std::mutex> lock(sleep_mtx);
+      if (0 == num_queued && true == must_stop) {
+        break;
+      }
+
+      if (0 == num_queued) {
+        worker->num_sleeps++;
+        sleep_cv.wait(lock, [this] { return num_queued > 0 || true == must_stop; });
+      }
+    }
+
+    tls_pool = nullptr;
+    tls_worker = -1;
+  }
+
+  bool TaskPool::pop(int index, Task& task) {
+
+    Worker* worker = workers[index];
+    std::lock_guard<std::mutex> lock(worker->mtx);
+
+    if (true == worker->tasks.empty()) {
+      return false;
+    }
+
+    task = worker->tasks.front();
+    worker->tasks.pop_front();
+    num_queued--;
+
+    return true;
+  }
+
+  bool TaskPool::steal(int index, Task& task) {
+
+    size_t num_workers = workers.size();
+
+    for (size_t i = 1; i < num_workers; ++i) {
+
+      Worker* victim = workers[(index + i) % num_workers];
+      std::lock_guard<std::mutex> lock(victim->mtx);
+
+      if (false == victim->tasks.empty()) {
+        task = victim->tasks.front();
+        victim->tasks.pop_front();
+        num_queued--;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  /* ------------------------------------------------ */
+
+  TaskStrand::TaskStrand()
+    :pool(nullptr)
+    ,is_running(false)
+  {
+  }
+
+  int TaskStrand::init(TaskPool* p) {
+
+    if (nullptr == p) {
+      printf("Cannot initialize the task strand, the given pool is nullptr.\n");
+      return -1;
+    }
+
+    if (nullptr != pool) {
+      printf("Cannot initialize the task strand, already initialized.\n");
+      return -2;
+    }
+
+    pool = p;
+
+    return 0;
+  }
+
+  int TaskStrand::post(const Task& task) {
+
+    if (nullptr == pool) {
+      printf("Cannot post a task, the task strand is not initialized.\n");
+      return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    tasks.push_back(task);
+
+    /* When a task is running, run_next() picks this one up. */
+    if (true == is_running) {
+      return 0;
+    }
+
+    is_running = true;
+
+    if (0 != pool->submit([this] { run_next(); })) {
+      is_running = false;
+      tasks.pop_back();
+      return -2;
+    }
+
+    return 0;
+  }
+
+  bool TaskStrand::is_idle() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return false == is_running;
+  }
+
+  /* Runs one task, then gives the worker back to the other strands. */
+  void TaskStrand::run_next() {
+
+    Task task;
+
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      task = tasks.front();
+      tasks.pop_front();
+    }
+
+    task();
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    if (true == tasks.empty()) {
+      is_running = false;
+      return;
+    }
+
+    pool->submit([this] { run_next(); });
+  }
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
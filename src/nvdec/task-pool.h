@@ -0,0 +1,130 @@
+/*
+  TASK POOL
+  =========
+
+  GENERAL INFO:
+
+    A fixed set of worker threads that run the host side work of
+    many decode sessions, instead of one thread per session.
+    Every worker has its own queue. A task that's submitted from
+    a worker goes on the queue of that worker, other submits are
+    spread round-robin over the workers. A worker runs the
+    oldest task of its own queue and when that's empty it steals
+    the oldest task of another worker, so no worker idles while
+    another one has a backlog. We take the oldest task, not the
+    newest as most work-stealing pools do, because we care about
+    the latency of every stream more than about the cache. Idle
+    workers sleep until a task is submitted.
+
+    A TaskStrand runs the tasks that are posted to it one at a
+    time, in the order they were posted, on whatever worker is
+    free. Give every pipeline stage of a session its own strand,
+    e.g. one for scanning the access units and one for the
+    parser: the parser calls of a session stay ordered and are
+    never made from two threads at once, while the stages of a
+    session and all sessions run in parallel. A strand runs one
+    task per turn and then submits itself again, so a busy
+    session can't starve the others.
+
+    shutdown() runs all tasks that are still queued, including
+    the ones they submit, before it joins the workers. A strand
+    must outlive the tasks that were posted to it.
+
+  USAGE:
+
+    TaskPool pool;
+    pool.init(0);                   // One worker per core.
+
+    TaskStrand strand;
+    strand.init(&pool);
+    strand.post([&session, au] { session.decode(au.data, au.size); });
+
+    pool.shutdown();
+
+ */
+#ifndef NVDEC_TASK_POOL_H
+#define NVDEC_TASK_POOL_H
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  typedef std::function<void()> Task;
+
+  struct TaskPoolStats {
+    uint64_t num_submitted;
+    uint64_t num_executed;
+    uint64_t num_stolen;                  /* Tasks a worker took from the queue of another worker. */
+    uint64_t num_sleeps;                  /* Times a worker found no task and went to sleep. */
+  };
+
+  /* ------------------------------------------------ */
+
+  class TaskPool {
+  public:
+    TaskPool();
+    ~TaskPool();
+    int init(int num_workers);            /* 0 uses one worker per hardware thread. */
+    int shutdown();                       /* Runs the queued tasks and joins the workers. */
+    int submit(const Task& task);
+    int get_num_workers();
+    TaskPoolStats get_stats();
+
+  private:
+    struct Worker {
+      std::mutex mtx;
+      std::deque<Task> tasks;
+      std::thread thread;
+      std::atomic<uint64_t> num_executed;
+      std::atomic<uint64_t> num_stolen;
+      std::atomic<uint64_t> num_sleeps;
+    };
+
+    void run(int index);
+    bool pop(int index, Task& task);      /* The oldest task of worker `index`. */
+    bool steal(int index, Task& task);    /* The oldest task of any other worker. */
+
+  private:
+    std::vector<Worker*> workers;
+    std::mutex sleep_mtx;
+    std::condition_variable sleep_cv;
+    std::atomic<int64_t> num_queued;
+    std::atomic<uint64_t> num_submitted;
+    std::atomic<uint32_t> next_worker;    /* Round-robin for submits from other threads. */
+    bool must_stop;
+    bool is_init;
+  };
+
+  /* ------------------------------------------------ */
+
+  class TaskStrand {
+  public:
+    TaskStrand();
+    int init(TaskPool* pool);
+    int post(const Task& task);           /* Runs after the tasks that were posted before it. */
+    bool is_idle();                       /* True when nothing is queued or running. */
+
+  private:
+    void run_next();
+
+  private:
+    TaskPool* pool;
+    std::mutex mtx;
+    std::deque<Task> tasks;
+    bool is_running;
+  };
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
+
+#endif
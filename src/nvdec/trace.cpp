@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <nvdec/trace.h>
+
+#if defined(USE_TRACE)
+#  include <atomic>
+#  include <mutex>
+#  include <vector>
+#  include <nvdec/utils.h>
+#endif
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+#if defined(USE_TRACE)
+
+  struct TraceEvent {
+    const char* name;
+    uint64_t start_ticks;
+    uint64_t end_ticks;
+    int64_t arg;
+  };
+
+  /* Only the owning thread writes `events`; it publishes them by storing `num_events`. */
+  struct TraceBuffer {
+    TraceBuffer();
+    std::vector<TraceEvent> events;
+    std::atomic<size_t> num_events;
+    std::atomic<uint64_t> num_dropped;
+    std::mutex name_mutex;
+    std::string name;
+    int tid;
+  };
+
+  /* The moment we start counting from; trace_write_json() measures the ticks per ns between this and the dump. */
+  struct TraceOrigin {
+    TraceOrigin();
+    uint64_t ticks;
+    uint64_t ns;
+  };
+
+  static TraceBuffer* get_thread_buffer();
+  static void write_json_string(FILE* fp, const std::string& str);
+
+  static std::mutex buffers_mutex;
+  static std::vector<TraceBuffer*> buffers;                   /* Never freed; a thread may exit before we dump its spans. */
+  static thread_local TraceBuffer* thread_buffer = nullptr;
+  static TraceOrigin origin;
+
+  /* ------------------------------------------------ */
+
+  TraceBuffer::TraceBuffer()
+    :events(TRACE_NUM_EVENTS_PER_THREAD)
+    ,num_events(0)
+    ,num_dropped(0)
+    ,tid(0)
+  {
+  }
+
+  TraceOrigin::TraceOrigin()
+    :ticks(trace_get_ticks())
+    ,ns(get_time_ns())
+  {
+  }
+
+  /* ------------------------------------------------ */
+
+  bool trace_is_enabled() {
+    return true;
+  }
+
+  void trace_set_thread_name(const char* name) {
+
+    if (nullptr == name) {
+      printf("Cannot set the trace name of the thread, given name is nullptr.\n");
+      return;
+    }
+
+    TraceBuffer* buf = get_thread_buffer();
+    std::lock_guard<std::mutex> lock(buf->name_mutex);
+    buf->name = name;
+  }
+
+  void trace_record(const char* name, uint64_t start_ticks, uint64_t end_ticks, int64_t arg) {
+
+    TraceBuffer* buf = get_thread_buffer();
+    size_t dx = buf->num_events.load(std::memory_order_relaxed);
+
+    if (dx >= buf->events.size()) {
+      buf->num_dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    TraceEvent& ev = buf->events[dx];
+    ev.name = name;
+    ev.start_ticks = start_ticks;
+    ev.end_ticks = end_ticks;
+    ev.arg = arg;
+
+    buf->num_events.store(dx + 1, std::memory_order_release);
+  }
+
+  uint64_t trace_get_ticks_fallback() {
+    return get_time_ns();
+  }
+
+  int trace_write_json(const std::string& filepath) {
+
+    uint64_t end_ticks = trace_get_ticks();
+    uint64_t end_ns = get_time_ns();
+    double us_per_tick = 0.001;
+
+    if (end_ticks > origin.ticks && end_ns > origin.ns) {
+      us_per_tick = ((double)(end_ns - origin.ns) / 1000.0) / (double)(end_ticks - origin.ticks);
+    }
+
+    FILE* fp = fopen(filepath.c_str(), "wb");
+    if (nullptr == fp) {
+      printf("Cannot write the trace, failed to open %s: %s.\n", filepath.c_str(), strerror(errno));
+      return -1;
+    }
+
+    uint64_t num_events = 0;
+    uint64_t num_dropped = 0;
+    bool is_first = true;
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+
+    for (size_t i = 0; i < buffers.size(); ++i) {
+
+      TraceBuffer* buf = buffers[i];
+      size_t count = buf->num_events.load(std::memory_order_acquire);
+      std::string name;
+
+      {
+        std::lock_guard<std::mutex> name_lock(buf->name_mutex);
+        name = buf->name;
+      }
+
+      if (true == name.empty()) {
+        name = "thread " + std::to_string(buf->tid);
+      }
+
+      fprintf(fp, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", (true == is_first) ? "" : ",", buf->tid);
+      write_json_string(fp, name);
+      fprintf(fp, "}}");
+      is_first = false;
+
+      for (size_t j = 0; j < count; ++j) {
+
+        const TraceEvent& ev = buf->events[j];
+        double ts = (double)(int64_t)(ev.start_ticks - origin.ticks) * us_per_tick;
+        double dur = (double)(ev.end_ticks - ev.start_ticks) * us_per_tick;
+
+        fprintf(fp, ",\n{\"name\":\"%s\",\"cat\":\"nvdec\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f", ev.name, buf->tid, ts, dur);
+
+        if (TRACE_NO_ARG != ev.arg) {
+          fprintf(fp, ",\"args\":{\"arg\":%lld}", (long long)ev.arg);
+        }
+
+        fprintf(fp, "}");
+      }
+
+      num_events += count;
+      num_dropped += buf->num_dropped.load(std::memory_order_relaxed);
+    }
+
+    fprintf(fp, "\n],\"otherData\":{\"num_dropped\":%llu,\"us_per_tick\":%.9f}}\n", (unsigned long long)num_dropped, us_per_tick);
+
+    if (0 != fclose(fp)) {
+      printf("Failed to close the trace %s: %s.\n", filepath.c_str(), strerror(errno));
+      return -2;
+    }
+
+    printf("Wrote %llu spans of %zu threads to %s", (unsigned long long)num_events, buffers.size(), filepath.c_str());
+    if (num_dropped > 0) {
+      printf(", dropped %llu because the buffers were full", (unsigned long long)num_dropped);
+    }
+    printf(".\n");
+
+    return 0;
+  }
+
+  /* ------------------------------------------------ */
+
+  /* Creates the buffer of the calling thread the first time; the only place (beside the dump) that takes a lock. */
+  static TraceBuffer* get_thread_buffer() {
+
+    if (nullptr != thread_buffer) {
+      return thread_buffer;
+    }
+
+    TraceBuffer* buf = new TraceBuffer();
+
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    buf->tid = (int)buffers.size() + 1;
+    buffers.push_back(buf);
+    thread_buffer = buf;
+
+    return buf;
+  }
+
+  static void write_json_string(FILE* fp, const std::string& str) {
+
+    fputc('"', fp);
+
+    for (size_t i = 0; i < str.size(); ++i) {
+      unsigned char c = (unsigned char)str[i];
+      if ('"' == c || '\\' == c) {
+        fputc('\\', fp);
+        fputc(c, fp);
+      }
+      else if (c < 0x20) {
+        fprintf(fp, "\\u%04x", c);
+      }
+      else {
+        fputc(c, fp);
+      }
+    }
+
+    fputc('"', fp);
+  }
+
+#else
+
+  /* ------------------------------------------------ */
+
+  bool trace_is_enabled() {
+    return false;
+  }
+
+  void trace_set_thread_name(const char*) {
+  }
+
+  int trace_write_json(const std::string& filepath) {
+    printf("Cannot write the trace to %s, we were built without USE_TRACE.\n", filepath.c_str());
+    return -1;
+  }
+
+#endif
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
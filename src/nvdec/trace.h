@@ -0,0 +1,135 @@
+/*
+  TRACE
+  =====
+
+  GENERAL INFO:
+
+    Spans that show where the time of a frame goes: the parser
+    (`parse`) and its sequence, decode and display callbacks,
+    the map of a picture, the start of the device to host copy
+    (`copy`) and the time we block on it (`copy_wait`), the
+    unmap and the writes of the sink. trace_write_json() dumps
+    them as a Chrome trace which you can open in
+    chrome://tracing or https://ui.perfetto.dev.
+
+    The spans are compiled in only when we build with
+    `-DUSE_TRACE=ON`; otherwise TRACE_SPAN() expands to nothing
+    and there is no cost at all. When enabled a span reads the
+    time stamp counter (rdtsc on x86, cntvct_el0 on ARMv8) when
+    it starts and ends and stores 32 bytes in a buffer of the
+    thread that created it, so there is no lock and no shared
+    cache line in the hot path. A span costs about 100 ns in a
+    build without optimizations and a frame has about eight of
+    them, which stays well below 1% of the time of a frame.
+
+    Every thread gets a buffer of TRACE_NUM_EVENTS_PER_THREAD
+    spans the first time it records one. When it's full we drop
+    new spans and count them; the json tells how many. The
+    buffers stay alive when their thread exits so we can still
+    dump them, and trace_write_json() can run while the other
+    threads record: the writer publishes its count after it
+    stored the span. The counter is converted to microseconds
+    with the ratio between it and the steady clock, measured
+    from startup until the dump; this assumes an invariant TSC,
+    which every x86 CPU of the last decade has.
+
+    The functions below exist in both builds; without USE_TRACE
+    they do nothing and trace_write_json() returns an error.
+
+  USAGE:
+
+    trace_set_thread_name("decode");
+
+    {
+      TRACE_SPAN("map");                 // Ends with the scope.
+      ...
+    }
+
+    TRACE_SPAN_ARG("decode", pic_idx);   // With an int64 argument shown in the viewer.
+
+    trace_write_json("trace.json");
+
+ */
+#ifndef NVDEC_TRACE_H
+#define NVDEC_TRACE_H
+
+#include <stdint.h>
+#include <string>
+
+#define TRACE_NUM_EVENTS_PER_THREAD (64 * 1024)
+#define TRACE_NO_ARG INT64_MIN
+
+#if defined(USE_TRACE)
+#  if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#    include <intrin.h>
+#  elif defined(__x86_64__) || defined(__i386__)
+#    include <x86intrin.h>
+#  endif
+#  define TRACE_CONCAT_IMPL(a, b) a##b
+#  define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#  define TRACE_SPAN(name) nvdec::TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name, TRACE_NO_ARG)
+#  define TRACE_SPAN_ARG(name, arg) nvdec::TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name, (int64_t)(arg))
+#else
+#  define TRACE_SPAN(name)
+#  define TRACE_SPAN_ARG(name, arg)
+#endif
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  bool trace_is_enabled();                                    /* Whether we were built with USE_TRACE. */
+  void trace_set_thread_name(const char* name);              /* Shown by the viewer for the calling thread. */
+  int trace_write_json(const std::string& filepath);          /* Writes the spans of all threads; returns < 0 on error or without USE_TRACE. */
+
+  /* ------------------------------------------------ */
+
+#if defined(USE_TRACE)
+
+  void trace_record(const char* name, uint64_t start_ticks, uint64_t end_ticks, int64_t arg); /* `name` must be a string literal, we keep the pointer. */
+  uint64_t trace_get_ticks_fallback();
+
+  static inline uint64_t trace_get_ticks() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return trace_get_ticks_fallback();
+#endif
+  }
+
+  class TraceSpan {
+  public:
+    TraceSpan(const char* name, int64_t arg)
+      :name(name)
+      ,arg(arg)
+      ,start_ticks(trace_get_ticks())
+    {
+    }
+
+    ~TraceSpan() {
+      trace_record(name, start_ticks, trace_get_ticks(), arg);
+    }
+
+  private:
+    TraceSpan(const TraceSpan&);
+    TraceSpan& operator=(const TraceSpan&);
+
+  private:
+    const char* name;
+    int64_t arg;
+    uint64_t start_ticks;
+  };
+
+#endif
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
+
+#endif
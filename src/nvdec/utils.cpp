@@ -0,0 +1,215 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <nvdec/utils.h>
+
+#if defined(_WIN32)
+#  include <windows.h>
+#  include <psapi.h>
+#  include <malloc.h>
+#else
+#  include <unistd.h>
+#  include <time.h>
+#  include <sys/resource.h>
+#endif
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  uint64_t get_time_ns() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+#if defined(_WIN32)
+  static uint64_t filetime_to_ns(const FILETIME& ft) {
+    ULARGE_INTEGER v;
+    v.LowPart = ft.dwLowDateTime;
+    v.HighPart = ft.dwHighDateTime;
+    return (uint64_t)v.QuadPart * 100; /* 100 ns units. */
+  }
+#endif
+
+  uint64_t get_thread_cpu_time_ns() {
+
+#if defined(_WIN32)
+    FILETIME creation, exit, kernel, user;
+    if (0 == GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+      return 0;
+    }
+    return filetime_to_ns(kernel) + filetime_to_ns(user);
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+    if (0 != clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts)) {
+      return 0;
+    }
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#else
+    return 0;
+#endif
+  }
+
+  uint64_t get_process_cpu_time_ns() {
+
+#if defined(_WIN32)
+    FILETIME creation, exit, kernel, user;
+    if (0 == GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+      return 0;
+    }
+    return filetime_to_ns(kernel) + filetime_to_ns(user);
+#else
+    struct rusage usage;
+    if (0 != getrusage(RUSAGE_SELF, &usage)) {
+      return 0;
+    }
+    return ((uint64_t)usage.ru_utime.tv_sec + (uint64_t)usage.ru_stime.tv_sec) * 1000000000ull
+      + ((uint64_t)usage.ru_utime.tv_usec + (uint64_t)usage.ru_stime.tv_usec) * 1000ull;
+#endif
+  }
+
+  size_t get_rss_bytes() {
+
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (0 == GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+      return 0;
+    }
+    return pmc.WorkingSetSize;
+#elif defined(__linux__)
+    /* The second value in statm is the number of resident pages. */
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (nullptr == fp) {
+      return 0;
+    }
+    unsigned long total_pages = 0;
+    unsigned long resident_pages = 0;
+    int num_read = fscanf(fp, "%lu %lu", &total_pages, &resident_pages);
+    fclose(fp);
+    if (2 != num_read) {
+      return 0;
+    }
+    return (size_t)resident_pages * (size_t)sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+  }
+
+  size_t get_peak_rss_bytes() {
+
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (0 == GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+      return 0;
+    }
+    return pmc.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (0 != getrusage(RUSAGE_SELF, &usage)) {
+      return 0;
+    }
+#  if defined(__APPLE__)
+    return (size_t)usage.ru_maxrss;        /* Bytes on macOS. */
+#  else
+    return (size_t)usage.ru_maxrss * 1024; /* Kilobytes on Linux. */
+#  endif
+#endif
+  }
+
+  void* alloc_aligned(size_t nbytes, size_t alignment) {
+
+#if defined(_WIN32)
+    return _aligned_malloc(nbytes, alignment);
+#else
+    void* ptr = nullptr;
+    if (0 != posix_memalign(&ptr, alignment, nbytes)) {
+      return nullptr;
+    }
+    return ptr;
+#endif
+  }
+
+  void free_aligned(void* ptr) {
+
+    if (nullptr == ptr) {
+      return;
+    }
+
+#if defined(_WIN32)
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+  }
+
+  /* ------------------------------------------------ */
+
+  void latency_histogram_reset(LatencyHistogram& hist) {
+    memset((char*)&hist, 0x00, sizeof(hist));
+  }
+
+  /* The octave is the highest bit of the microseconds, the quarter the two bits below it. */
+  void latency_histogram_add(LatencyHistogram& hist, uint64_t ns) {
+
+    uint64_t us = ns / 1000;
+    int dx = 0;
+
+    if (us > 0) {
+      int octave = 63;
+      while (0 == (us & (1ull << octave))) {
+        octave--;
+      }
+      int quarter = (octave >= 2) ? (int)((us >> (octave - 2)) & 3) : (int)((us << (2 - octave)) & 3);
+      dx = 1 + octave * 4 + quarter;
+    }
+
+    if (dx >= LATENCY_HISTOGRAM_NUM_BUCKETS) {
+      dx = LATENCY_HISTOGRAM_NUM_BUCKETS - 1;
+    }
+
+    hist.counts[dx]++;
+    hist.num_samples++;
+    hist.total_ns += ns;
+
+    if (ns > hist.max_ns) {
+      hist.max_ns = ns;
+    }
+  }
+
+  uint64_t latency_histogram_get_percentile(const LatencyHistogram& hist, double percentile) {
+
+    if (0 == hist.num_samples) {
+      return 0;
+    }
+
+    uint64_t rank = (uint64_t)((percentile / 100.0) * double(hist.num_samples) + 0.5);
+    if (rank < 1) {
+      rank = 1;
+    }
+
+    uint64_t num_seen = 0;
+
+    for (int i = 0; i < LATENCY_HISTOGRAM_NUM_BUCKETS - 1; ++i) {
+
+      num_seen += hist.counts[i];
+      if (num_seen < rank) {
+        continue;
+      }
+
+      /* Bucket 0 is everything below 1 us. */
+      uint64_t upper_ns = 1000;
+      if (i > 0) {
+        int octave = (i - 1) / 4;
+        int quarter = (i - 1) % 4;
+        upper_ns = ((uint64_t)(5 + quarter) << octave) * 1000 / 4;
+      }
+
+      return (upper_ns < hist.max_ns) ? upper_ns : hist.max_ns;
+    }
+
+    return hist.max_ns;
+  }
+
+  /* ------------------------------------------------ */
+
+} /* namespace nvdec */
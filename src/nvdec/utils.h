@@ -0,0 +1,53 @@
+/*
+  UTILS
+  =====
+
+  GENERAL INFO:
+
+    Small helpers that are shared between the experiments and
+    the benchmarks: a monotonic clock, the CPU time of the
+    calling thread and of the process, the resident memory of
+    the current process and aligned allocations.
+
+    A LatencyHistogram counts latencies in buckets of a quarter
+    octave, from 1 us up to about 16 s, so it has a fixed size
+    however long a session runs. A percentile is the upper bound
+    of the bucket that holds it: at most 19% too high, never
+    higher than the max.
+
+ */
+#ifndef NVDEC_UTILS_H
+#define NVDEC_UTILS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LATENCY_HISTOGRAM_NUM_BUCKETS 98       /* 1 for < 1 us, 4 per octave up to 2^24 us, 1 for the rest. */
+
+namespace nvdec {
+
+  /* ------------------------------------------------ */
+
+  struct LatencyHistogram {
+    uint64_t counts[LATENCY_HISTOGRAM_NUM_BUCKETS];
+    uint64_t num_samples;
+    uint64_t total_ns;
+    uint64_t max_ns;
+  };
+
+  /* ------------------------------------------------ */
+
+  uint64_t get_time_ns();                /* Monotonic time in nanoseconds. */
+  uint64_t get_thread_cpu_time_ns();     /* User + system time of the calling thread; returns 0 when not supported. */
+  uint64_t get_process_cpu_time_ns();    /* User + system time of all threads of the process; returns 0 when not supported. */
+  size_t get_rss_bytes();                /* Current resident set size; returns 0 when not supported. */
+  size_t get_peak_rss_bytes();           /* Peak resident set size; returns 0 when not supported. */
+  void* alloc_aligned(size_t nbytes, size_t alignment);  /* `alignment` must be a power of two; free with free_aligned(). */
+  void free_aligned(void* ptr);
+  void latency_histogram_reset(LatencyHistogram& hist);
+  void latency_histogram_add(LatencyHistogram& hist, uint64_t ns);
+  uint64_t latency_histogram_get_percentile(const LatencyHistogram& hist, double percentile);  /* `percentile` in [0, 100]; returns ns, 0 without samples. */
+
+} /* namespace nvdec */
+
+#endif
@@ -0,0 +1,1963 @@
+/*
+  NVIDIA DECODE EXPERIMENTS
+  =========================
+
+  GENERAL INFO:
+
+    Micro benchmarks for the host side parts of the decode
+    experiments. Each benchmark has a name which you pass as
+    first argument, run without arguments to get a list of all
+    benchmarks.
+
+        ./test-nvidia-decode-bench scanner [file.264]
+
+  BENCHMARKS:
+
+    scanner: Measures the throughput of the Annex-B start code
+             search for every ISA that the CPU supports and
+             compares it with the scalar version. When no file
+             is given we generate a buffer with random NAL
+             sized chunks. Also measures the access unit
+             splitter which is what the decoder tests use.
+
+    input:   Compares the input sources (read, mmap, stream) on the given
+             file. Every input runs in its own process so we can
+             report the peak resident memory. We ask the kernel
+             to drop the file from the page cache before each run
+             so the time to the first access unit includes the
+             disk reads.
+
+                 ./test-nvidia-decode-bench input file.264 [read|mmap|stream]
+
+    sessions: Decodes the same file in N sessions at the same
+             time, one thread per session, all sharing one
+             backend (one context). The frames are downloaded
+             but not written so the disk doesn't limit us. For
+             every session count we print the aggregate fps,
+             the slowest and average fps per session and the
+             device memory the decoders take. The default counts
+             are 1, 2, 4, 8 and 16.
+
+                 ./test-nvidia-decode-bench sessions file.264 [cuvid|fake] [1,2,4,8,16]
+
+    scheduler: Runs N sessions on a SessionScheduler with fake
+             devices, each given as `memory_mb:decode_us`, the
+             device memory and the time the decode engine needs
+             for one picture. The sessions are placed before
+             they start, then at every IDR with SPS and PPS they
+             report their decode time and may move to another
+             device. We print per device how many sessions were
+             placed and moved in and out, the pictures decoded
+             and the engine time we measured. The defaults are
+             a slow and a fast device and 8 sessions.
+
+                 ./test-nvidia-decode-bench scheduler file.264 [4096:2000,4096:500] [8]
+
+    pool:    Runs N sessions as a pipeline of two stages: one
+             scans the next POOL_BATCH_SIZE access units, the
+             other feeds them into the session (parse, decode,
+             map and copy). We run this with one thread per
+             session and with a TaskPool, a fixed set of workers
+             where every stage of a session has its own strand.
+             For both we print the aggregate fps and the latency
+             of a batch: the time from the moment it's scanned
+             until it's decoded (p50, p99 and max). Frames are
+             downloaded but not written. Every session keeps its
+             own copy buffers and decoder so use a small stream
+             for the larger counts. By default we use one worker
+             per core.
+
+                 ./test-nvidia-decode-bench pool file.264 [cuvid|fake] [1,8,64,256] [workers]
+
+    convert: Converts a pitched NV12 picture with random
+             samples to NV12 (a copy), I420, RGB24 and BGRA with
+             every ISA the CPU supports. For RGB we do every
+             matrix and range. Every ISA, and the banded
+             conversion, must give the same bytes as the scalar
+             code. We print the Mpix/s on one thread and with
+             the picture split over N threads (by default one
+             per core). The default size is 1920x1080.
+
+                 ./test-nvidia-decode-bench convert [WxH] [threads]
+
+    scale:   First scales a pitched 1920x1080 NV12 picture with
+             random samples to 640x360 with the box and bilinear
+             filters and every ISA the CPU supports; every ISA
+             must give the same bytes as the scalar code. Then
+             decodes the file once per target width (0 is the
+             full size), with the decoder scaling and with the
+             CPU scaling a proxy next to the full copy. For every
+             run we print the bytes and the time per copy, which
+             is what the bus carries, the time per scaled
+             picture and the fps. Frames aren't written.
+
+                 ./test-nvidia-decode-bench scale file.264 [cuvid|fake] [0,1280,640,320]
+
+    frames:  Decodes the file with every `frames` mode of the
+             DecodeSession: all pictures, only the reference
+             pictures and only the intra pictures. We print the
+             pictures decoded, the fps and the speedup over
+             decoding all, and the device memory of the decoder.
+             Use a stream with long GOPs to see the difference.
+             The fake backend takes the time the decode engine
+             needs per picture, 0 by default. Frames aren't
+             written.
+
+                 ./test-nvidia-decode-bench frames file.264 [cuvid|fake] [decode_us]
+
+    seek:    Builds the StreamIndex of the file (and saves it
+             next to it), then loads it again, and prints how
+             long both take and how big it is. Then seeks to N
+             random frames, with and without the index. Without
+             it we decode from byte 0 up to the frame, with it
+             from the last IDR before it. A seek is done when
+             the frame has been decoded and downloaded; we print
+             the average and max latency and the access units we
+             decoded per seek.
+
+                 ./test-nvidia-decode-bench seek file.264 [cuvid|fake] [num_seeks]
+
+    latency: Feeds the file in real time, every access unit at
+             its decode time, to a DecodeSession with `latency`
+             set to throughput (the v3 pipeline: display delay
+             and a delayed map) and to low (no display delay,
+             end of picture per access unit and a map in the
+             display callback). For both we print the p50, p99
+             and max of the time from decode() until the picture
+             is in host memory and the average time until the
+             display callback. The fake backend takes the time
+             the decode engine needs per picture, 0 by default.
+             Frames aren't written.
+
+                 ./test-nvidia-decode-bench latency file.264 [cuvid|fake] [decode_us]
+
+    sinks:   First measures the CRC32C of the hash sink on a 64
+             MB buffer with every ISA the CPU supports; every
+             ISA must give the same CRC as the scalar code. Then
+             decodes the file with every sink: fd (writes
+             sinks.nv12 through the page cache), null (drops the
+             frames after the copy), hash (writes
+             sinks.nv12.crc32c) and map (no copy). We print the
+             fps and the time per frame of every run, so the
+             difference between two of them is what that stage
+             costs. The files are removed afterwards.
+
+                 ./test-nvidia-decode-bench sinks file.264 [cuvid|fake]
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fstream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <condition_variable>
+#include <nvdec/annexb.h>
+#include <nvdec/backend.h>
+#include <nvdec/backend-fake.h>
+#include <nvdec/convert.h>
+#include <nvdec/decode-session.h>
+#include <nvdec/frame-sink-hash.h>
+#include <nvdec/scale.h>
+#include <nvdec/session-scheduler.h>
+#include <nvdec/stream-index.h>
+#include <nvdec/task-pool.h>
+#include <nvdec/input.h>
+#include <nvdec/utils.h>
+
+#if !defined(_WIN32)
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/wait.h>
+#endif
+
+#define POOL_BATCH_SIZE 8      /* Access units per pipeline task. */
+#define POOL_DEPTH 2           /* Batches of one session that can be in the pipeline at the same time. */
+#define CONVERT_BENCH_NS 300000000ull  /* We convert for at least this long per measurement. */
+
+/* ------------------------------------------------ */
+
+struct Benchmark {
+  const char* name;
+  const char* info;
+  int (*func)(int argc, char** argv);
+};
+
+/* The AUs that the scan stage hands to the decode stage. */
+struct PipelineBatch {
+  std::vector<nvdec::AccessUnit> aus;
+  uint64_t ready_ns;
+  bool is_last;
+};
+
+/* One session of the `pool` benchmark; only its own stages touch it. */
+/* Holds a DecodeSession by value, so it needs the same aligned new. */
+struct PipelineSession {
+  static void* operator new(size_t nbytes) { return nvdec::DecodeSession::operator new(nbytes); }
+  static void operator delete(void* ptr) { nvdec::DecodeSession::operator delete(ptr); }
+  nvdec::DecodeSession session;
+  nvdec::AnnexbSplitter splitter;
+  const uint8_t* data;                  /* The part we didn't scan yet. */
+  size_t nbytes;
+  bool is_scanned;
+  bool has_failed;
+  nvdec::TaskStrand scan_strand;
+  nvdec::TaskStrand decode_strand;
+  nvdec::Task scan;                     /* The scan stage; it posts the decode stage which posts this again. */
+  std::vector<uint64_t> latencies_ns;
+};
+
+/* Counts the sessions that are done so the main thread can wait for them. */
+struct PipelineDone {
+  std::mutex mtx;
+  std::condition_variable cv;
+  int num_done;
+};
+
+/* ------------------------------------------------ */
+
+static int bench_scanner(int argc, char** argv);
+static int bench_input(int argc, char** argv);
+static int run_input(const char* filepath, int type);
+static int bench_sessions(int argc, char** argv);
+static int bench_scheduler(int argc, char** argv);
+static int run_sessions(nvdec::DecodeBackend* backend, const std::vector<nvdec::AccessUnit>& aus, int num_sessions);
+static int bench_pool(int argc, char** argv);
+static int run_pool(nvdec::DecodeBackend* backend, const std::vector<uint8_t>& buf, int num_sessions, int num_workers);
+static void scan_batch(PipelineSession* ps, PipelineBatch& batch);
+static void decode_batch(PipelineSession* ps, PipelineBatch& batch);
+static int bench_convert(int argc, char** argv);
+static double run_convert(const nvdec::ConvertSettings& settings, const nvdec::ConvertSource& src, const nvdec::ConvertTarget& dst);
+static int bench_scale(int argc, char** argv);
+static double run_scale(const nvdec::ScaleSettings& settings, const nvdec::ConvertSource& src, const nvdec::ConvertTarget& dst, int width, int height);
+static int run_scaled_session(nvdec::DecodeBackend* backend, const std::vector<nvdec::AccessUnit>& aus, int scale_mode, int width);
+static int bench_frames(int argc, char** argv);
+static int bench_seek(int argc, char** argv);
+static int bench_latency(int argc, char** argv);
+static int bench_sinks(int argc, char** argv);
+static void drop_page_cache(const char* filepath);
+static int load_file(const char* filepath, std::vector<uint8_t>& result);
+static int load_access_units(const char* filepath, bool must_stamp, std::vector<uint8_t>& buf, std::vector<nvdec::AccessUnit>& result);
+static nvdec::DecodeBackend* create_backend(int backend_type, const char* fake_decode_us);
+static void generate_annexb(size_t nbytes, std::vector<uint8_t>& result);
+
+/* ------------------------------------------------ */
+
+static Benchmark benchmarks[] = {
+  { "scanner", "Annex-B start code scanner throughput (GB/s) per ISA.", bench_scanner },
+  { "input", "Time to first access unit and peak RSS per input source.", bench_input },
+  { "sessions", "Aggregate decode fps against the number of concurrent sessions.", bench_sessions },
+  { "scheduler", "Placement and moves of sessions over fake devices with different capacities.", bench_scheduler },
+  { "pool", "Throughput and batch latency of sessions on a thread per session and on a task pool.", bench_pool },
+  { "convert", "NV12 to I420, RGB24 and BGRA conversion (Mpix/s) per ISA and thread count.", bench_convert },
+  { "scale", "NV12 downscaling (Mpix/s) per ISA, and copy bytes and time per frame per output size.", bench_scale },
+  { "frames", "Speedup and decoder memory when only decoding the reference or intra pictures.", bench_frames },
+  { "seek", "Index build and load time, and seek latency with and without the index.", bench_seek },
+  { "latency", "Decode to host memory latency of a real time stream, throughput against low latency mode.", bench_latency },
+  { "sinks", "CRC32C throughput per ISA, and decode fps with the fd, null, hash and map-only sinks.", bench_sinks },
+};
+
+/* ------------------------------------------------ */
+
+int main(int argc, char** argv) {
+
+  printf("\n\nnvidia decode benchmarks.\n\n");
+
+  size_t num_benchmarks = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+  if (argc < 2) {
+    printf("Usage: %s <benchmark> [options]\n\n", argv[0]);
+    for (size_t i = 0; i < num_benchmarks; ++i) {
+      printf("  %-12s %s\n", benchmarks[i].name, benchmarks[i].info);
+    }
+    printf("\n");
+    exit(EXIT_FAILURE);
+  }
+
+  for (size_t i = 0; i < num_benchmarks; ++i) {
+    if (0 == strcmp(argv[1], benchmarks[i].name)) {
+      return benchmarks[i].func(argc - 2, argv + 2);
+    }
+  }
+
+  printf("Unknown benchmark: %s. (exiting).\n", argv[1]);
+  exit(EXIT_FAILURE);
+}
+
+/* ------------------------------------------------ */
+
+static int bench_scanner(int argc, char** argv) {
+
+  std::vector<uint8_t> buf;
+
+  if (argc > 0) {
+    if (0 != load_file(argv[0], buf)) {
+      exit(EXIT_FAILURE);
+    }
+  }
+  else {
+    generate_annexb(64 * 1024 * 1024, buf);
+  }
+
+  /* Make sure we scan at least 2GB per ISA so the timings are stable. */
+  const uint8_t* begin = buf.data();
+  const uint8_t* end = begin + buf.size();
+  size_t num_iterations = (2ull * 1024 * 1024 * 1024) / buf.size() + 1;
+  double scalar_gbps = 0.0;
+  size_t scalar_count = 0;
+
+  printf("Scanning %zu bytes, %zu times.\n", buf.size(), num_iterations);
+
+  for (int isa = 0; isa < ANNEXB_ISA_COUNT; ++isa) {
+
+    if (false == nvdec::annexb_is_isa_supported(isa)) {
+      printf("%-8s not supported on this CPU.\n", nvdec::annexb_isa_to_string(isa));
+      continue;
+    }
+
+    size_t count = 0;
+    uint64_t t0 = nvdec::get_time_ns();
+
+    for (size_t i = 0; i < num_iterations; ++i) {
+      const uint8_t* p = begin;
+      count = 0;
+      while (true) {
+        p = nvdec::annexb_find_start_code_with_isa(isa, p, end);
+        if (p == end) {
+          break;
+        }
+        count++;
+        p += 3;
+      }
+    }
+
+    uint64_t t1 = nvdec::get_time_ns();
+    double gbps = (double(buf.size()) * num_iterations) / double(t1 - t0);
+
+    if (ANNEXB_ISA_SCALAR == isa) {
+      scalar_gbps = gbps;
+      scalar_count = count;
+    }
+
+    if (count != scalar_count) {
+      printf("Error: the %s scanner found %zu start codes, the scalar version %zu. (exiting).\n", nvdec::annexb_isa_to_string(isa), count, scalar_count);
+      exit(EXIT_FAILURE);
+    }
+
+    printf("%-8s %8.2f GB/s, %6.2fx scalar, %zu start codes.\n", nvdec::annexb_isa_to_string(isa), gbps, gbps / scalar_gbps, count);
+  }
+
+  /* The splitter uses the fastest scanner and also looks at the NAL headers. */
+  size_t num_aus = 0;
+  uint64_t t0 = nvdec::get_time_ns();
+
+  for (size_t i = 0; i < num_iterations; ++i) {
+    nvdec::AnnexbSplitter splitter;
+    nvdec::AccessUnit au;
+    const uint8_t* p = begin;
+    size_t nbytes = buf.size();
+    num_aus = 0;
+    while (ANNEXB_OK == splitter.next(p, nbytes, true, au)) {
+      p += au.size;
+      nbytes -= au.size;
+      num_aus++;
+    }
+  }
+
+  uint64_t t1 = nvdec::get_time_ns();
+  double gbps = (double(buf.size()) * num_iterations) / double(t1 - t0);
+  double aups = (double(num_aus) * num_iterations) / (double(t1 - t0) * 1e-9);
+
+  printf("%-8s %8.2f GB/s, %6.2fx scalar, %zu access units (%.0f AU/s).\n", "splitter", gbps, gbps / scalar_gbps, num_aus, aups);
+
+  return 0;
+}
+
+static int bench_input(int argc, char** argv) {
+
+  if (argc < 1) {
+    printf("Usage: input <file.264> [read|mmap|stream]. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  const char* filepath = argv[0];
+  int types[] = { INPUT_TYPE_READ, INPUT_TYPE_MMAP, INPUT_TYPE_STREAM };
+  int num_types = sizeof(types) / sizeof(types[0]);
+
+  if (argc > 1) {
+    types[0] = nvdec::input_type_from_string(argv[1]);
+    num_types = 1;
+    if (INPUT_TYPE_NONE == types[0]) {
+      printf("Unknown input type: %s. (exiting).\n", argv[1]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  for (int i = 0; i < num_types; ++i) {
+
+    drop_page_cache(filepath);
+
+#if defined(_WIN32)
+    run_input(filepath, types[i]);
+#else
+    /* Run every input in a child so the peak RSS isn't polluted by the previous run. */
+    fflush(stdout);
+    pid_t pid = fork();
+    if (0 == pid) {
+      exit((0 == run_input(filepath, types[i])) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    if (pid < 0) {
+      printf("Failed to fork. (exiting).\n");
+      exit(EXIT_FAILURE);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+#endif
+  }
+
+  return 0;
+}
+
+/* Reads all access units and touches every byte like the parser would. */
+static int run_input(const char* filepath, int type) {
+
+  uint64_t t0 = nvdec::get_time_ns();
+  uint64_t t_first = 0;
+  size_t rss_start = nvdec::get_rss_bytes();
+  size_t num_aus = 0;
+  size_t num_bytes = 0;
+  uint32_t sum = 0;
+
+  nvdec::InputSource* input = nvdec::input_create(type);
+  if (nullptr == input) {
+    return -1;
+  }
+
+  if (0 != input->open(filepath)) {
+    delete input;
+    return -2;
+  }
+
+  nvdec::AccessUnit au;
+  while (ANNEXB_OK == input->next(au)) {
+    if (0 == t_first) {
+      t_first = nvdec::get_time_ns();
+    }
+    for (size_t i = 0; i < au.size; i += 64) {
+      sum += au.data[i];
+    }
+    num_bytes += au.size;
+    num_aus++;
+  }
+
+  uint64_t t1 = nvdec::get_time_ns();
+  
+  input->close();
+  delete input;
+
+  printf("%-6s first AU after %9.3f ms, total %9.3f ms (%8.2f MB/s), %zu AUs, peak RSS %8.2f MB (%8.2f MB over baseline), checksum %08x.\n",
+         nvdec::input_type_to_string(type),
+         double(t_first - t0) * 1e-6,
+         double(t1 - t0) * 1e-6,
+         (double(num_bytes) / (1024.0 * 1024.0)) / (double(t1 - t0) * 1e-9),
+         num_aus,
+         double(nvdec::get_peak_rss_bytes()) / (1024.0 * 1024.0),
+         double(nvdec::get_peak_rss_bytes() - rss_start) / (1024.0 * 1024.0),
+         sum);
+
+  return 0;
+}
+
+static int bench_sessions(int argc, char** argv) {
+
+  if (argc < 1) {
+    printf("Usage: sessions <file.264> [cuvid|fake] [1,2,4,8,16]. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  int backend_type = nvdec::backend_get_default_type();
+  if (argc > 1) {
+    backend_type = nvdec::backend_type_from_string(argv[1]);
+    if (BACKEND_TYPE_NONE == backend_type) {
+      printf("Unknown backend: %s. (exiting).\n", argv[1]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  std::vector<int> counts;
+  const char* list = (argc > 2) ? argv[2] : "1,2,4,8,16";
+  while (nullptr != list && '\0' != *list) {
+    int count = atoi(list);
+    if (count <= 0) {
+      printf("Invalid session count in: %s. (exiting).\n", argv[2]);
+      exit(EXIT_FAILURE);
+    }
+    counts.push_back(count);
+    list = strchr(list, ',');
+    list = (nullptr != list) ? list + 1 : nullptr;
+  }
+
+  /* Every session decodes the same access units from memory so only the decode path is measured. */
+  std::vector<uint8_t> buf;
+  std::vector<nvdec::AccessUnit> aus;
+  if (0 != load_access_units(argv[0], false, buf, aus)) {
+    exit(EXIT_FAILURE);
+  }
+
+  nvdec::DecodeBackend* backend = create_backend(backend_type, nullptr);
+  if (nullptr == backend) {
+    exit(EXIT_FAILURE);
+  }
+
+  printf("Decoding %zu access units per session on %s, %u hardware threads.\n",
+         aus.size(),
+         backend->get_device_name().c_str(),
+         std::thread::hardware_concurrency());
+
+  for (size_t i = 0; i < counts.size(); ++i) {
+    if (0 != run_sessions(backend, aus, counts[i])) {
+      printf("Failed to run %d sessions. (exiting).\n", counts[i]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  backend->shutdown();
+  delete backend;
+
+  return 0;
+}
+
+/* Decodes `aus` in `num_sessions` sessions, each on its own thread; the clock starts when all sessions are created. */
+static int run_sessions(nvdec::DecodeBackend* backend, const std::vector<nvdec::AccessUnit>& aus, int num_sessions) {
+
+  std::vector<nvdec::DecodeSession*> sessions;
+  std::vector<std::thread> threads;
+  std::atomic<int> num_failed(0);
+  int result = 0;
+
+  for (int i = 0; i < num_sessions; ++i) {
+
+    nvdec::DecodeSessionSettings settings;
+    settings.id = i;
+
+    nvdec::DecodeSession* session = new nvdec::DecodeSession();
+    if (0 != session->init(backend, settings)) {
+      delete session;
+      result = -1;
+      break;
+    }
+
+    sessions.push_back(session);
+  }
+
+  uint64_t cpu_start_ns = nvdec::get_process_cpu_time_ns();
+  uint64_t t0 = nvdec::get_time_ns();
+
+  for (size_t i = 0; i < sessions.size() && 0 == result; ++i) {
+    nvdec::DecodeSession* session = sessions[i];
+    threads.push_back(std::thread([session, &aus, &num_failed] {
+      for (size_t j = 0; j < aus.size(); ++j) {
+        if (0 != session->decode(aus[j].data, aus[j].size)) {
+          num_failed++;
+          return;
+        }
+      }
+      if (0 != session->flush()) {
+        num_failed++;
+      }
+    }));
+  }
+
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+
+  uint64_t t1 = nvdec::get_time_ns();
+  uint64_t cpu_end_ns = nvdec::get_process_cpu_time_ns();
+
+  uint64_t num_frames = 0;
+  uint64_t vram_nbytes = 0;
+  double min_fps = 0.0;
+  double total_fps = 0.0;
+
+  for (size_t i = 0; i < sessions.size(); ++i) {
+
+    /* shutdown() destroys the decoder; the stats keep its peak VRAM. */
+    if (0 != sessions[i]->shutdown()) {
+      result = -2;
+    }
+
+    nvdec::DecodeSessionStats stats = sessions[i]->get_stats();
+    double duration = double(stats.time_decoded_ns - t0) * 1e-9;
+    double fps = (stats.time_decoded_ns > t0) ? double(stats.num_frames) / duration : 0.0;
+
+    num_frames += stats.num_frames;
+    vram_nbytes += stats.peak_decoder_vram_nbytes;
+    total_fps += fps;
+    min_fps = (0 == i || fps < min_fps) ? fps : min_fps;
+
+    delete sessions[i];
+  }
+
+  if (num_failed > 0) {
+    printf("%d of %d sessions failed.\n", (int)num_failed, num_sessions);
+    result = -3;
+  }
+
+  double duration = double(t1 - t0) * 1e-9;
+
+  printf("sessions: %4d, frames: %8llu, time: %8.3f s, aggregate: %9.2f fps, per session: min %8.2f fps, avg %8.2f fps, CPU: %9.3f ms, VRAM: %9.2f MB.\n",
+         num_sessions,
+         (unsigned long long)num_frames,
+         duration,
+         (duration > 0.0) ? double(num_frames) / duration : 0.0,
+         min_fps,
+         (false == sessions.empty()) ? total_fps / sessions.size() : 0.0,
+         double(cpu_end_ns - cpu_start_ns) * 1e-6,
+         double(vram_nbytes) / (1024.0 * 1024.0));
+
+  return result;
+}
+
+static int bench_scheduler(int argc, char** argv) {
+
+  if (argc < 1) {
+    printf("Usage: scheduler <file.264> [4096:2000,4096:500] [8]. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  nvdec::SessionSchedulerSettings settings;
+  settings.backend_type = BACKEND_TYPE_FAKE;
+  settings.move_cooldown_ns = 100ull * 1000ull * 1000ull;
+
+  const char* list = (argc > 1) ? argv[1] : "4096:2000,4096:500";
+  while (nullptr != list && '\0' != *list) {
+    unsigned long long memory_mb = 0;
+    unsigned long long decode_us = 0;
+    if (2 != sscanf(list, "%llu:%llu", &memory_mb, &decode_us) || 0 == memory_mb) {
+      printf("Invalid device in: %s, use memory_mb:decode_us. (exiting).\n", argv[1]);
+      exit(EXIT_FAILURE);
+    }
+    nvdec::FakeDeviceSettings device;
+    device.memory_nbytes = memory_mb * 1024ull * 1024ull;
+    device.decode_ns = decode_us * 1000ull;
+    settings.fake_devices.push_back(device);
+    list = strchr(list, ',');
+    list = (nullptr != list) ? list + 1 : nullptr;
+  }
+
+  int num_sessions = (argc > 2) ? atoi(argv[2]) : 8;
+  if (num_sessions <= 0) {
+    printf("Invalid number of sessions: %s. (exiting).\n", argv[2]);
+    exit(EXIT_FAILURE);
+  }
+
+  std::vector<uint8_t> buf;
+  std::vector<nvdec::AccessUnit> aus;
+  if (0 != load_access_units(argv[0], false, buf, aus)) {
+    exit(EXIT_FAILURE);
+  }
+
+  uint32_t move_flags = ANNEXB_AU_FLAG_IDR | ANNEXB_AU_FLAG_SPS | ANNEXB_AU_FLAG_PPS;
+  int num_move_points = 0;
+
+  for (size_t i = 0; i < aus.size(); ++i) {
+    num_move_points += (move_flags == (aus[i].flags & move_flags)) ? 1 : 0;
+  }
+
+  nvdec::SessionScheduler scheduler;
+  if (0 != scheduler.init(settings)) {
+    exit(EXIT_FAILURE);
+  }
+
+  printf("Decoding %zu access units (%d points where a session can move) in %d sessions on %d fake devices.\n",
+         aus.size(),
+         num_move_points,
+         num_sessions,
+         scheduler.get_num_devices());
+
+  std::vector<nvdec::DecodeSession*> sessions;
+  std::vector<nvdec::SchedulerTicket> tickets(num_sessions);
+  std::vector<std::thread> threads;
+  std::atomic<int> num_failed(0);
+
+  for (int i = 0; i < num_sessions; ++i) {
+
+    if (0 != scheduler.place(tickets[i])) {
+      printf("Failed to place session %d. (exiting).\n", i);
+      exit(EXIT_FAILURE);
+    }
+
+    nvdec::DecodeSessionSettings session_settings;
+    session_settings.id = i;
+
+    nvdec::DecodeSession* session = new nvdec::DecodeSession();
+    if (0 != session->init(scheduler.get_backend(tickets[i].device), session_settings)) {
+      printf("Failed to initialize session %d. (exiting).\n", i);
+      exit(EXIT_FAILURE);
+    }
+
+    sessions.push_back(session);
+  }
+
+  uint64_t t0 = nvdec::get_time_ns();
+
+  for (int i = 0; i < num_sessions; ++i) {
+    nvdec::DecodeSession* session = sessions[i];
+    nvdec::SchedulerTicket* ticket = &tickets[i];
+    threads.push_back(std::thread([session, ticket, move_flags, &scheduler, &aus, &num_failed] {
+      for (size_t j = 0; j < aus.size(); ++j) {
+        if (j > 0 && move_flags == (aus[j].flags & move_flags)) {
+          scheduler.update(*ticket, session->get_stats());
+          if (scheduler.rebalance(*ticket) >= 0
+              && 0 != session->move_to(scheduler.get_backend(ticket->device)))
+            {
+              num_failed++;
+              return;
+            }
+        }
+        if (0 != session->decode(aus[j].data, aus[j].size)) {
+          num_failed++;
+          return;
+        }
+      }
+      if (0 != session->flush()) {
+        num_failed++;
+        return;
+      }
+      scheduler.update(*ticket, session->get_stats());
+    }));
+  }
+
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+
+  uint64_t t1 = nvdec::get_time_ns();
+  uint64_t num_frames = 0;
+
+  /* Before we release the sessions so the stats still show where they ended. */
+  for (int i = 0; i < scheduler.get_num_devices(); ++i) {
+    nvdec::SchedulerDeviceStats stats = scheduler.get_device_stats(i);
+    printf("device: %d, %s, engine: %6.1f us (configured: %6.1f us), sessions: %3d, placed: %3llu, moved in: %3llu, out: %3llu, decoded: %8llu, free: %8.2f MB.\n",
+           i,
+           stats.name.c_str(),
+           stats.engine_ns * 1e-3,
+           double(settings.fake_devices[i].decode_ns) * 1e-3,
+           stats.num_sessions,
+           (unsigned long long)stats.num_placed,
+           (unsigned long long)stats.num_moved_in,
+           (unsigned long long)stats.num_moved_out,
+           (unsigned long long)stats.num_decoded,
+           double(stats.free_nbytes) / (1024.0 * 1024.0));
+  }
+
+  for (int i = 0; i < num_sessions; ++i) {
+    sessions[i]->shutdown();
+    scheduler.release(tickets[i]);
+    nvdec::DecodeSessionStats stats = sessions[i]->get_stats();
+    num_frames += stats.num_frames;
+    delete sessions[i];
+  }
+
+  scheduler.shutdown();
+
+  if (num_failed > 0) {
+    printf("%d of %d sessions failed. (exiting).\n", (int)num_failed, num_sessions);
+    exit(EXIT_FAILURE);
+  }
+
+  double duration = double(t1 - t0) * 1e-9;
+
+  printf("sessions: %d, frames: %llu, time: %.3f s, aggregate: %.2f fps.\n",
+         num_sessions,
+         (unsigned long long)num_frames,
+         duration,
+         (duration > 0.0) ? double(num_frames) / duration : 0.0);
+
+  return 0;
+}
+
+static int bench_pool(int argc, char** argv) {
+
+  if (argc < 1) {
+    printf("Usage: pool <file.264> [cuvid|fake] [1,8,64,256] [workers]. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  int backend_type = nvdec::backend_get_default_type();
+  if (argc > 1) {
+    backend_type = nvdec::backend_type_from_string(argv[1]);
+    if (BACKEND_TYPE_NONE == backend_type) {
+      printf("Unknown backend: %s. (exiting).\n", argv[1]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  std::vector<int> counts;
+  const char* list = (argc > 2) ? argv[2] : "1,8,64,256";
+  while (nullptr != list && '\0' != *list) {
+    int count = atoi(list);
+    if (count <= 0) {
+      printf("Invalid session count in: %s. (exiting).\n", argv[2]);
+      exit(EXIT_FAILURE);
+    }
+    counts.push_back(count);
+    list = strchr(list, ',');
+    list = (nullptr != list) ? list + 1 : nullptr;
+  }
+
+  int num_workers = (argc > 3) ? atoi(argv[3]) : 0;
+  if (num_workers < 0) {
+    printf("Invalid number of workers: %s. (exiting).\n", argv[3]);
+    exit(EXIT_FAILURE);
+  }
+
+  std::vector<uint8_t> buf;
+  if (0 != load_file(argv[0], buf)) {
+    exit(EXIT_FAILURE);
+  }
+
+  nvdec::DecodeBackend* backend = create_backend(backend_type, nullptr);
+  if (nullptr == backend) {
+    exit(EXIT_FAILURE);
+  }
+
+  printf("Decoding %s on %s, %u hardware threads, batches of %d access units.\n",
+         argv[0],
+         backend->get_device_name().c_str(),
+         std::thread::hardware_concurrency(),
+         POOL_BATCH_SIZE);
+
+  /* A worker count of -1 means a thread per session. */
+  for (size_t i = 0; i < counts.size(); ++i) {
+    if (0 != run_pool(backend, buf, counts[i], -1)
+        || 0 != run_pool(backend, buf, counts[i], num_workers))
+      {
+        printf("Failed to run %d sessions. (exiting).\n", counts[i]);
+        exit(EXIT_FAILURE);
+      }
+  }
+
+  backend->shutdown();
+  delete backend;
+
+  return 0;
+}
+
+static int run_pool(nvdec::DecodeBackend* backend, const std::vector<uint8_t>& buf, int num_sessions, int num_workers) {
+
+  std::vector<PipelineSession*> sessions;
+  nvdec::TaskPool pool;
+  PipelineDone done;
+  int result = 0;
+
+  done.num_done = 0;
+
+  if (num_workers >= 0 && 0 != pool.init(num_workers)) {
+    return -1;
+  }
+
+  for (int i = 0; i < num_sessions; ++i) {
+
+    nvdec::DecodeSessionSettings settings;
+    settings.id = i;
+
+    PipelineSession* ps = new PipelineSession();
+    ps->data = buf.data();
+    ps->nbytes = buf.size();
+    ps->is_scanned = false;
+    ps->has_failed = false;
+
+    if (0 != ps->session.init(backend, settings)) {
+      delete ps;
+      result = -2;
+      break;
+    }
+
+    if (num_workers >= 0) {
+      ps->scan_strand.init(&pool);
+      ps->decode_strand.init(&pool);
+    }
+
+    sessions.push_back(ps);
+  }
+
+  uint64_t cpu_start_ns = nvdec::get_process_cpu_time_ns();
+  uint64_t t0 = nvdec::get_time_ns();
+  std::vector<std::thread> threads;
+
+  for (size_t i = 0; i < sessions.size() && 0 == result; ++i) {
+
+    PipelineSession* ps = sessions[i];
+
+    if (num_workers < 0) {
+      threads.push_back(std::thread([ps] {
+        PipelineBatch batch;
+        batch.is_last = false;
+        while (false == batch.is_last && false == ps->has_failed) {
+          scan_batch(ps, batch);
+          decode_batch(ps, batch);
+        }
+      }));
+      continue;
+    }
+
+    /*
+      The scan stage hands every batch to the decode stage of the
+      session; when a batch is decoded we scan the next one, so a
+      session has at most POOL_DEPTH batches in the pipeline.
+    */
+    ps->scan = [ps, &done] {
+      if (true == ps->is_scanned) {
+        return;
+      }
+      PipelineBatch batch;
+      scan_batch(ps, batch);
+      ps->decode_strand.post([ps, batch, &done]() mutable {
+        decode_batch(ps, batch);
+        if (false == batch.is_last && false == ps->has_failed) {
+          ps->scan_strand.post(ps->scan);
+          return;
+        }
+        std::lock_guard<std::mutex> lock(done.mtx);
+        done.num_done++;
+        done.cv.notify_one();
+      });
+    };
+
+    for (int j = 0; j < POOL_DEPTH; ++j) {
+      ps->scan_strand.post(ps->scan);
+    }
+  }
+
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+
+  if (num_workers >= 0) {
+    std::unique_lock<std::mutex> lock(done.mtx);
+    done.cv.wait(lock, [&done, &sessions] { return done.num_done == (int)sessions.size(); });
+  }
+
+  uint64_t t1 = nvdec::get_time_ns();
+  uint64_t cpu_end_ns = nvdec::get_process_cpu_time_ns();
+
+  nvdec::TaskPoolStats pool_stats;
+  memset((char*)&pool_stats, 0x00, sizeof(pool_stats));
+
+  if (num_workers >= 0) {
+    pool_stats = pool.get_stats();
+    num_workers = pool.get_num_workers();
+    pool.shutdown();
+  }
+
+  std::vector<uint64_t> latencies;
+  uint64_t num_frames = 0;
+
+  for (size_t i = 0; i < sessions.size(); ++i) {
+    if (true == sessions[i]->has_failed || 0 != sessions[i]->session.shutdown()) {
+      result = -3;
+    }
+    num_frames += sessions[i]->session.get_stats().num_frames;
+    latencies.insert(latencies.end(), sessions[i]->latencies_ns.begin(), sessions[i]->latencies_ns.end());
+    delete sessions[i];
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+
+  double duration = double(t1 - t0) * 1e-9;
+  double p50 = (latencies.empty()) ? 0.0 : double(latencies[latencies.size() / 2]) * 1e-6;
+  double p99 = (latencies.empty()) ? 0.0 : double(latencies[(latencies.size() * 99) / 100]) * 1e-6;
+  double max = (latencies.empty()) ? 0.0 : double(latencies.back()) * 1e-6;
+  char mode[32] = { 0 };
+
+  if (num_workers < 0) {
+    snprintf(mode, sizeof(mode), "threads");
+  }
+  else {
+    snprintf(mode, sizeof(mode), "pool(%d)", num_workers);
+  }
+
+  printf("%-9s sessions: %4d, frames: %8llu, time: %8.3f s, aggregate: %9.2f fps, latency p50: %8.3f ms, p99: %8.3f ms, max: %8.3f ms, CPU: %9.3f ms, stolen: %llu.\n",
+         mode,
+         num_sessions,
+         (unsigned long long)num_frames,
+         duration,
+         (duration > 0.0) ? double(num_frames) / duration : 0.0,
+         p50,
+         p99,
+         max,
+         double(cpu_end_ns - cpu_start_ns) * 1e-6,
+         (unsigned long long)pool_stats.num_stolen);
+
+  return result;
+}
+
+/* Splits the next POOL_BATCH_SIZE access units off the data of the session. */
+static void scan_batch(PipelineSession* ps, PipelineBatch& batch) {
+
+  nvdec::AccessUnit au;
+
+  batch.aus.clear();
+  batch.is_last = false;
+
+  while ((int)batch.aus.size() < POOL_BATCH_SIZE) {
+    if (ANNEXB_OK != ps->splitter.next(ps->data, ps->nbytes, true, au)) {
+      batch.is_last = true;
+      ps->is_scanned = true;
+      break;
+    }
+    batch.aus.push_back(au);
+    ps->data += au.size;
+    ps->nbytes -= au.size;
+  }
+
+  batch.ready_ns = nvdec::get_time_ns();
+}
+
+static void decode_batch(PipelineSession* ps, PipelineBatch& batch) {
+
+  for (size_t i = 0; i < batch.aus.size() && false == ps->has_failed; ++i) {
+    if (0 != ps->session.decode(batch.aus[i].data, batch.aus[i].size)) {
+      ps->has_failed = true;
+    }
+  }
+
+  if (true == batch.is_last && false == ps->has_failed && 0 != ps->session.flush()) {
+    ps->has_failed = true;
+  }
+
+  ps->latencies_ns.push_back(nvdec::get_time_ns() - batch.ready_ns);
+}
+
+static int bench_convert(int argc, char** argv) {
+
+  int width = 1920;
+  int height = 1080;
+  int num_threads = (int)std::thread::hardware_concurrency();
+
+  if (argc > 0 && (2 != sscanf(argv[0], "%dx%d", &width, &height) || width <= 0 || height <= 0)) {
+    printf("Invalid size, use WxH, e.g. 1920x1080. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (argc > 1) {
+    num_threads = atoi(argv[1]);
+  }
+
+  num_threads = (num_threads > 0) ? num_threads : 1;
+
+  /* A pitch like the decode surfaces have, so the kernels read rows that don't follow each other. */
+  size_t pitch = ((size_t)width + 255) & ~(size_t)255;
+  std::vector<uint8_t> nv12(pitch * (height + (height + 1) / 2));
+  uint32_t seed = 0x12345678;
+
+  for (size_t i = 0; i < nv12.size(); ++i) {
+    seed = seed * 1664525u + 1013904223u;
+    nv12[i] = (uint8_t)(seed >> 24);
+  }
+
+  nvdec::ConvertSource src;
+  if (0 != nvdec::convert_source_init(nv12.data(), pitch, width, height, src)) {
+    exit(EXIT_FAILURE);
+  }
+
+  struct { int format; int matrix; int range; } cases[] = {
+    { CONVERT_FORMAT_NV12,  CONVERT_MATRIX_BT601, CONVERT_RANGE_LIMITED },
+    { CONVERT_FORMAT_I420,  CONVERT_MATRIX_BT601, CONVERT_RANGE_LIMITED },
+    { CONVERT_FORMAT_RGB24, CONVERT_MATRIX_BT601, CONVERT_RANGE_LIMITED },
+    { CONVERT_FORMAT_RGB24, CONVERT_MATRIX_BT709, CONVERT_RANGE_LIMITED },
+    { CONVERT_FORMAT_RGB24, CONVERT_MATRIX_BT601, CONVERT_RANGE_FULL },
+    { CONVERT_FORMAT_RGB24, CONVERT_MATRIX_BT709, CONVERT_RANGE_FULL },
+    { CONVERT_FORMAT_BGRA,  CONVERT_MATRIX_BT601, CONVERT_RANGE_LIMITED },
+    { CONVERT_FORMAT_BGRA,  CONVERT_MATRIX_BT709, CONVERT_RANGE_LIMITED },
+    { CONVERT_FORMAT_BGRA,  CONVERT_MATRIX_BT601, CONVERT_RANGE_FULL },
+    { CONVERT_FORMAT_BGRA,  CONVERT_MATRIX_BT709, CONVERT_RANGE_FULL },
+  };
+
+  int isas[] = { CONVERT_ISA_SCALAR, CONVERT_ISA_AVX2, CONVERT_ISA_NEON };
+
+  printf("Converting a %d x %d NV12 picture with a pitch of %zu, banded over %d threads.\n\n", width, height, pitch, num_threads);
+
+  for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+
+    size_t nbytes = nvdec::convert_get_nbytes(cases[c].format, width, height);
+    std::vector<uint8_t> expected(nbytes);
+    std::vector<uint8_t> result(nbytes);
+    nvdec::ConvertTarget expected_dst;
+    nvdec::ConvertTarget dst;
+    nvdec::ConvertCoefficients k;
+
+    nvdec::convert_target_init(cases[c].format, width, height, expected.data(), expected_dst);
+    nvdec::convert_target_init(cases[c].format, width, height, result.data(), dst);
+    nvdec::convert_get_coefficients(cases[c].matrix, cases[c].range, k);
+    nvdec::convert_rows_scalar(src, expected_dst, k, cases[c].format, 0, height);
+
+    double scalar_mpps = 0.0;
+
+    for (size_t i = 0; i < sizeof(isas) / sizeof(isas[0]); ++i) {
+
+      char label[64];
+      snprintf(label, sizeof(label), "%s %s %s",
+               nvdec::convert_format_to_string(cases[c].format),
+               nvdec::convert_matrix_to_string(cases[c].matrix),
+               nvdec::convert_range_to_string(cases[c].range));
+
+      if (false == nvdec::convert_is_isa_supported(isas[i])) {
+        printf("%-24s %-8s not supported on this CPU or build.\n", label, nvdec::convert_isa_to_string(isas[i]));
+        continue;
+      }
+
+      nvdec::ConvertSettings settings;
+      settings.format = cases[c].format;
+      settings.matrix = cases[c].matrix;
+      settings.range = cases[c].range;
+      settings.isa = isas[i];
+      settings.num_threads = 1;
+
+      double mpps = run_convert(settings, src, dst);
+      if (0 != memcmp(result.data(), expected.data(), nbytes)) {
+        printf("Error: the %s conversion of %s differs from the scalar one. (exiting).\n", nvdec::convert_isa_to_string(isas[i]), label);
+        exit(EXIT_FAILURE);
+      }
+
+      settings.num_threads = num_threads;
+      memset(result.data(), 0x00, nbytes);
+
+      double banded_mpps = run_convert(settings, src, dst);
+      if (0 != memcmp(result.data(), expected.data(), nbytes)) {
+        printf("Error: the banded %s conversion of %s differs from the scalar one. (exiting).\n", nvdec::convert_isa_to_string(isas[i]), label);
+        exit(EXIT_FAILURE);
+      }
+
+      if (CONVERT_ISA_SCALAR == isas[i]) {
+        scalar_mpps = mpps;
+      }
+
+      printf("%-24s %-8s %9.1f Mpix/s, %6.2fx scalar, %9.1f Mpix/s on %d threads (%.2fx).\n",
+             label,
+             nvdec::convert_isa_to_string(isas[i]),
+             mpps,
+             (scalar_mpps > 0.0) ? mpps / scalar_mpps : 0.0,
+             banded_mpps,
+             num_threads,
+             (mpps > 0.0) ? banded_mpps / mpps : 0.0);
+    }
+  }
+
+  return 0;
+}
+
+/* Returns the Mpix/s; converts for at least CONVERT_BENCH_NS after one warm up. */
+static double run_convert(const nvdec::ConvertSettings& settings, const nvdec::ConvertSource& src, const nvdec::ConvertTarget& dst) {
+
+  nvdec::Converter converter;
+  if (0 != converter.init(settings)) {
+    exit(EXIT_FAILURE);
+  }
+
+  converter.convert(src, dst);
+
+  uint64_t num_pictures = 0;
+  uint64_t t0 = nvdec::get_time_ns();
+  uint64_t t1 = t0;
+
+  while (t1 - t0 < CONVERT_BENCH_NS) {
+    converter.convert(src, dst);
+    num_pictures++;
+    t1 = nvdec::get_time_ns();
+  }
+
+  converter.shutdown();
+
+  return (double(src.width) * src.height * num_pictures) / (double(t1 - t0) * 1e-3);
+}
+
+static int bench_scale(int argc, char** argv) {
+
+  if (argc < 1) {
+    printf("Usage: scale <file.264> [cuvid|fake] [0,1280,640,320]. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  int backend_type = nvdec::backend_get_default_type();
+  if (argc > 1) {
+    backend_type = nvdec::backend_type_from_string(argv[1]);
+    if (BACKEND_TYPE_NONE == backend_type) {
+      printf("Unknown backend: %s. (exiting).\n", argv[1]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  std::vector<int> widths;
+  const char* list = (argc > 2) ? argv[2] : "0,1280,640,320";
+  while (nullptr != list && '\0' != *list) {
+    int width = atoi(list);
+    if (width < 0 || 0 != (width & 1)) {
+      printf("Invalid width in: %s, use even widths. (exiting).\n", argv[2]);
+      exit(EXIT_FAILURE);
+    }
+    widths.push_back(width);
+    list = strchr(list, ',');
+    list = (nullptr != list) ? list + 1 : nullptr;
+  }
+
+  /* The kernels, on a picture with a pitch like the decode surfaces have. */
+  int src_width = 1920;
+  int src_height = 1080;
+  int width = 640;
+  int height = 360;
+  size_t pitch = 2048;
+  std::vector<uint8_t> nv12(pitch * (src_height + src_height / 2));
+  uint32_t seed = 0x12345678;
+
+  for (size_t i = 0; i < nv12.size(); ++i) {
+    seed = seed * 1664525u + 1013904223u;
+    nv12[i] = (uint8_t)(seed >> 24);
+  }
+
+  nvdec::ConvertSource src;
+  if (0 != nvdec::convert_source_init(nv12.data(), pitch, src_width, src_height, src)) {
+    exit(EXIT_FAILURE);
+  }
+
+  size_t nbytes = nvdec::convert_get_nbytes(CONVERT_FORMAT_NV12, width, height);
+  std::vector<uint8_t> expected(nbytes);
+  std::vector<uint8_t> result(nbytes);
+  nvdec::ConvertTarget expected_dst;
+  nvdec::ConvertTarget dst;
+  nvdec::convert_target_init(CONVERT_FORMAT_NV12, width, height, expected.data(), expected_dst);
+  nvdec::convert_target_init(CONVERT_FORMAT_NV12, width, height, result.data(), dst);
+
+  int filters[] = { SCALE_FILTER_BOX, SCALE_FILTER_BILINEAR };
+  int isas[] = { CONVERT_ISA_SCALAR, CONVERT_ISA_AVX2, CONVERT_ISA_NEON };
+
+  printf("Scaling a %d x %d NV12 picture with a pitch of %zu to %d x %d.\n\n", src_width, src_height, pitch, width, height);
+
+  for (size_t f = 0; f < sizeof(filters) / sizeof(filters[0]); ++f) {
+
+    double scalar_mpps = 0.0;
+
+    for (size_t i = 0; i < sizeof(isas) / sizeof(isas[0]); ++i) {
+
+      if (false == nvdec::convert_is_isa_supported(isas[i])) {
+        printf("%-10s %-8s not supported on this CPU or build.\n", nvdec::scale_filter_to_string(filters[f]), nvdec::convert_isa_to_string(isas[i]));
+        continue;
+      }
+
+      nvdec::ScaleSettings settings;
+      settings.width = width;
+      settings.height = height;
+      settings.filter = filters[f];
+      settings.isa = isas[i];
+
+      memset(result.data(), 0x00, nbytes);
+
+      double mpps = run_scale(settings, src, (CONVERT_ISA_SCALAR == isas[i]) ? expected_dst : dst, width, height);
+      if (CONVERT_ISA_SCALAR == isas[i]) {
+        scalar_mpps = mpps;
+      }
+      else if (0 != memcmp(result.data(), expected.data(), nbytes)) {
+        printf("Error: the %s %s scaler differs from the scalar one. (exiting).\n", nvdec::convert_isa_to_string(isas[i]), nvdec::scale_filter_to_string(filters[f]));
+        exit(EXIT_FAILURE);
+      }
+
+      printf("%-10s %-8s %9.1f Mpix/s (source), %6.2fx scalar.\n",
+             nvdec::scale_filter_to_string(filters[f]),
+             nvdec::convert_isa_to_string(isas[i]),
+             mpps,
+             (scalar_mpps > 0.0) ? mpps / scalar_mpps : 0.0);
+    }
+  }
+
+  /* The sessions. */
+  std::vector<uint8_t> buf;
+  std::vector<nvdec::AccessUnit> aus;
+  if (0 != load_access_units(argv[0], false, buf, aus)) {
+    exit(EXIT_FAILURE);
+  }
+
+  nvdec::DecodeBackend* backend = create_backend(backend_type, nullptr);
+  if (nullptr == backend) {
+    exit(EXIT_FAILURE);
+  }
+
+  printf("\nDecoding %zu access units on %s.\n\n", aus.size(), backend->get_device_name().c_str());
+
+  for (size_t i = 0; i < widths.size(); ++i) {
+    if (0 != run_scaled_session(backend, aus, DECODE_SESSION_SCALE_DECODER, widths[i])) {
+      printf("Failed to decode at a width of %d. (exiting).\n", widths[i]);
+      exit(EXIT_FAILURE);
+    }
+    if (0 != widths[i] && 0 != run_scaled_session(backend, aus, DECODE_SESSION_SCALE_CPU, widths[i])) {
+      printf("Failed to decode with a proxy width of %d. (exiting).\n", widths[i]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  backend->shutdown();
+  delete backend;
+
+  return 0;
+}
+
+/* Returns the source Mpix/s; scales for at least CONVERT_BENCH_NS after one warm up. */
+static double run_scale(const nvdec::ScaleSettings& settings, const nvdec::ConvertSource& src, const nvdec::ConvertTarget& dst, int width, int height) {
+
+  nvdec::Scaler scaler;
+  if (0 != scaler.init(settings)) {
+    exit(EXIT_FAILURE);
+  }
+
+  scaler.scale(src, dst, width, height);
+
+  uint64_t num_pictures = 0;
+  uint64_t t0 = nvdec::get_time_ns();
+  uint64_t t1 = t0;
+
+  while (t1 - t0 < CONVERT_BENCH_NS) {
+    scaler.scale(src, dst, width, height);
+    num_pictures++;
+    t1 = nvdec::get_time_ns();
+  }
+
+  scaler.shutdown();
+
+  return (double(src.width) * src.height * num_pictures) / (double(t1 - t0) * 1e-3);
+}
+
+/* Decodes `aus` without writing; a width of 0 doesn't scale. */
+static int run_scaled_session(nvdec::DecodeBackend* backend, const std::vector<nvdec::AccessUnit>& aus, int scale_mode, int width) {
+
+  nvdec::DecodeSessionSettings settings;
+  settings.scale_mode = scale_mode;
+  settings.scale.width = width;
+  settings.scale.height = 0;
+
+  nvdec::DecodeSession session;
+  if (0 != session.init(backend, settings)) {
+    return -1;
+  }
+
+  uint64_t t0 = nvdec::get_time_ns();
+
+  for (size_t i = 0; i < aus.size(); ++i) {
+    if (0 != session.decode(aus[i].data, aus[i].size)) {
+      session.shutdown();
+      return -2;
+    }
+  }
+
+  if (0 != session.flush() || 0 != session.shutdown()) {
+    return -3;
+  }
+
+  uint64_t t1 = nvdec::get_time_ns();
+
+  nvdec::DecodeSessionStats stats = session.get_stats();
+  const nvdec::CopyPoolStats& copy_stats = stats.copy;
+  double duration = double(t1 - t0) * 1e-9;
+  char label[32];
+
+  if (0 == width) {
+    snprintf(label, sizeof(label), "full");
+  }
+  else {
+    snprintf(label, sizeof(label), "%s %d", nvdec::decode_session_scale_to_string(scale_mode), width);
+  }
+
+  printf("%-12s copy: %5d x %-5d %10.0f bytes/frame, %7.3f ms/frame, scale: %5d x %-5d %7.3f ms/frame, %9.2f fps.\n",
+         label,
+         stats.width,
+         stats.height,
+         (copy_stats.num_copies > 0) ? double(copy_stats.num_bytes) / copy_stats.num_copies : 0.0,
+         (copy_stats.num_copies > 0) ? double(copy_stats.copy_ns) * 1e-6 / copy_stats.num_copies : 0.0,
+         stats.proxy_width,
+         stats.proxy_height,
+         (stats.num_scaled > 0) ? double(stats.scale_ns) * 1e-6 / stats.num_scaled : 0.0,
+         (duration > 0.0) ? double(stats.num_frames) / duration : 0.0);
+
+  return 0;
+}
+
+static int bench_frames(int argc, char** argv) {
+
+  if (argc < 1) {
+    printf("Usage: frames <file.264> [cuvid|fake] [decode_us]. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  int backend_type = nvdec::backend_get_default_type();
+  if (argc > 1) {
+    backend_type = nvdec::backend_type_from_string(argv[1]);
+    if (BACKEND_TYPE_NONE == backend_type) {
+      printf("Unknown backend: %s. (exiting).\n", argv[1]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  std::vector<uint8_t> buf;
+  std::vector<nvdec::AccessUnit> aus;
+  if (0 != load_access_units(argv[0], false, buf, aus)) {
+    exit(EXIT_FAILURE);
+  }
+
+  int num_idr = 0;
+  for (size_t i = 0; i < aus.size(); ++i) {
+    num_idr += (0 != (aus[i].flags & ANNEXB_AU_FLAG_IDR)) ? 1 : 0;
+  }
+
+  nvdec::DecodeBackend* backend = create_backend(backend_type, (argc > 2) ? argv[2] : nullptr);
+  if (nullptr == backend) {
+    exit(EXIT_FAILURE);
+  }
+
+  printf("Decoding %zu access units (%d IDR, average GOP: %.1f) on %s.\n\n",
+         aus.size(),
+         num_idr,
+         (num_idr > 0) ? double(aus.size()) / num_idr : 0.0,
+         backend->get_device_name().c_str());
+
+  int modes[] = { DECODE_SESSION_FRAMES_ALL, DECODE_SESSION_FRAMES_REFERENCE, DECODE_SESSION_FRAMES_INTRA };
+  double all_duration = 0.0;
+  uint64_t all_vram_nbytes = 0;
+
+  for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i) {
+
+    nvdec::DecodeSessionSettings settings;
+    settings.frames = modes[i];
+
+    nvdec::DecodeSession session;
+    if (0 != session.init(backend, settings)) {
+      exit(EXIT_FAILURE);
+    }
+
+    uint64_t t0 = nvdec::get_time_ns();
+
+    for (size_t j = 0; j < aus.size(); ++j) {
+      if (0 != session.decode(aus[j].data, aus[j].size)) {
+        printf("Failed to decode with --frames %s. (exiting).\n", nvdec::decode_session_frames_to_string(modes[i]));
+        exit(EXIT_FAILURE);
+      }
+    }
+
+    if (0 != session.flush() || 0 != session.shutdown()) {
+      exit(EXIT_FAILURE);
+    }
+
+    uint64_t t1 = nvdec::get_time_ns();
+
+    nvdec::DecodeSessionStats stats = session.get_stats();
+    double duration = double(t1 - t0) * 1e-9;
+
+    if (DECODE_SESSION_FRAMES_ALL == modes[i]) {
+      all_duration = duration;
+      all_vram_nbytes = stats.peak_decoder_vram_nbytes;
+    }
+
+    printf("%-10s decoded: %6llu, skipped: %6llu, time: %8.3f s, %9.2f access units/s, %6.2fx, decoder VRAM: %8.2f MB (%.2f MB saved).\n",
+           nvdec::decode_session_frames_to_string(modes[i]),
+           (unsigned long long)stats.num_decoded,
+           (unsigned long long)stats.num_skipped,
+           duration,
+           (duration > 0.0) ? double(aus.size()) / duration : 0.0,
+           (duration > 0.0) ? all_duration / duration : 0.0,
+           double(stats.peak_decoder_vram_nbytes) / (1024.0 * 1024.0),
+           (all_vram_nbytes > stats.peak_decoder_vram_nbytes) ? double(all_vram_nbytes - stats.peak_decoder_vram_nbytes) / (1024.0 * 1024.0) : 0.0);
+  }
+
+  backend->shutdown();
+  delete backend;
+
+  return 0;
+}
+
+static int bench_seek(int argc, char** argv) {
+
+  if (argc < 1) {
+    printf("Usage: seek <file.264> [cuvid|fake] [num_seeks]. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  int backend_type = nvdec::backend_get_default_type();
+  if (argc > 1) {
+    backend_type = nvdec::backend_type_from_string(argv[1]);
+    if (BACKEND_TYPE_NONE == backend_type) {
+      printf("Unknown backend: %s. (exiting).\n", argv[1]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  int num_seeks = (argc > 2) ? atoi(argv[2]) : 20;
+  if (num_seeks <= 0) {
+    printf("Invalid number of seeks: %s. (exiting).\n", argv[2]);
+    exit(EXIT_FAILURE);
+  }
+
+  std::string stream_path = argv[0];
+  std::string index_path = nvdec::stream_index_get_path(stream_path);
+  nvdec::StreamIndex index;
+
+  uint64_t t0 = nvdec::get_time_ns();
+  if (0 != index.build(stream_path) || 0 != index.save(index_path)) {
+    exit(EXIT_FAILURE);
+  }
+
+  uint64_t t1 = nvdec::get_time_ns();
+  if (0 != index.load(index_path, stream_path)) {
+    exit(EXIT_FAILURE);
+  }
+
+  uint64_t t2 = nvdec::get_time_ns();
+  uint64_t num_frames = index.get_num_frames();
+  uint64_t first_idr_frame = 0;
+  uint32_t num_idr = 0;
+
+  for (uint32_t i = 0; i < index.get_num_entries(); ++i) {
+    const nvdec::StreamIndexEntry& entry = index.get_entries()[i];
+    if (STREAM_INDEX_ENTRY_IDR == entry.type) {
+      first_idr_frame = (0 == num_idr) ? entry.frame : first_idr_frame;
+      num_idr++;
+    }
+  }
+
+  printf("Index of %s: %llu frames, %u entries (%u IDR), %zu bytes, built in %.3f ms, loaded in %.3f ms.\n\n",
+         stream_path.c_str(),
+         (unsigned long long)num_frames,
+         index.get_num_entries(),
+         num_idr,
+         index.get_nbytes(),
+         double(t1 - t0) * 1e-6,
+         double(t2 - t1) * 1e-6);
+
+  if (0 == num_idr) {
+    printf("The stream has no IDR to seek to. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  nvdec::DecodeBackend* backend = create_backend(backend_type, nullptr);
+  if (nullptr == backend) {
+    exit(EXIT_FAILURE);
+  }
+
+  /* The same targets for both; only the frames after the first IDR can be reached with the index. */
+  std::vector<uint64_t> targets;
+  uint32_t seed = 0x12345678;
+  for (int i = 0; i < num_seeks; ++i) {
+    seed = seed * 1664525u + 1013904223u;
+    targets.push_back(first_idr_frame + (uint64_t)(seed >> 8) % (num_frames - first_idr_frame));
+  }
+
+  for (int use_index = 0; use_index < 2; ++use_index) {
+
+    nvdec::MappedInput input;
+    nvdec::DecodeSessionSettings settings;
+    nvdec::DecodeSession session;
+
+    if (0 != input.open(stream_path) || 0 != session.init(backend, settings)) {
+      exit(EXIT_FAILURE);
+    }
+
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+    uint64_t num_decoded = 0;
+
+    for (size_t i = 0; i < targets.size(); ++i) {
+
+      uint64_t start_ns = nvdec::get_time_ns();
+      nvdec::StreamIndexEntry entry;
+      const uint8_t* parameter_sets = nullptr;
+      size_t parameter_sets_nbytes = 0;
+
+      memset((char*)&entry, 0x00, sizeof(entry));
+
+      if (1 == use_index
+          && (0 != index.find(targets[i], STREAM_INDEX_FIND_IDR, entry)
+              || 0 != index.get_parameter_sets(entry, &parameter_sets, &parameter_sets_nbytes)))
+        {
+          exit(EXIT_FAILURE);
+        }
+
+      if (0 != input.seek(entry.offset) || 0 != session.seek(parameter_sets, parameter_sets_nbytes)) {
+        exit(EXIT_FAILURE);
+      }
+
+      nvdec::AccessUnit au;
+      for (uint64_t frame = entry.frame; frame <= targets[i]; ++frame) {
+        if (ANNEXB_OK != input.next(au) || 0 != session.decode(au.data, au.size)) {
+          printf("Failed to decode frame %llu. (exiting).\n", (unsigned long long)frame);
+          exit(EXIT_FAILURE);
+        }
+        num_decoded++;
+      }
+
+      /* Outputs the target. */
+      if (0 != session.seek(nullptr, 0)) {
+        exit(EXIT_FAILURE);
+      }
+
+      uint64_t ns = nvdec::get_time_ns() - start_ns;
+      total_ns += ns;
+      max_ns = std::max(max_ns, ns);
+    }
+
+    session.shutdown();
+    input.close();
+
+    printf("%-14s seeks: %4zu, latency: avg %9.3f ms, max %9.3f ms, access units decoded per seek: %9.1f.\n",
+           (1 == use_index) ? "with index" : "without index",
+           targets.size(),
+           double(total_ns) * 1e-6 / targets.size(),
+           double(max_ns) * 1e-6,
+           double(num_decoded) / targets.size());
+  }
+
+  backend->shutdown();
+  delete backend;
+
+  return 0;
+}
+
+static int bench_latency(int argc, char** argv) {
+
+  if (argc < 1) {
+    printf("Usage: latency <file.264> [cuvid|fake] [decode_us]. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  int backend_type = nvdec::backend_get_default_type();
+  if (argc > 1) {
+    backend_type = nvdec::backend_type_from_string(argv[1]);
+    if (BACKEND_TYPE_NONE == backend_type) {
+      printf("Unknown backend: %s. (exiting).\n", argv[1]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  std::vector<uint8_t> buf;
+  std::vector<nvdec::AccessUnit> aus;
+  if (0 != load_access_units(argv[0], true, buf, aus)) {
+    exit(EXIT_FAILURE);
+  }
+
+  if (true == aus.empty() || ANNEXB_NO_TIMESTAMP == aus[0].dts) {
+    printf("Failed to get the timestamps of %s. (exiting).\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  nvdec::DecodeBackend* backend = create_backend(backend_type, (argc > 2) ? argv[2] : nullptr);
+  if (nullptr == backend) {
+    exit(EXIT_FAILURE);
+  }
+
+  printf("Feeding %zu access units in real time (%.3f s) on %s.\n\n",
+         aus.size(),
+         double(aus.back().dts - aus[0].dts) / ANNEXB_CLOCK_RATE,
+         backend->get_device_name().c_str());
+
+  int modes[] = { DECODE_SESSION_LATENCY_THROUGHPUT, DECODE_SESSION_LATENCY_LOW };
+
+  for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i) {
+
+    nvdec::DecodeSessionSettings settings;
+    settings.latency = modes[i];
+
+    nvdec::DecodeSession session;
+    if (0 != session.init(backend, settings)) {
+      exit(EXIT_FAILURE);
+    }
+
+    uint64_t t0 = nvdec::get_time_ns();
+
+    for (size_t j = 0; j < aus.size(); ++j) {
+
+      /* A live source hands us the access unit at its decode time, not before. */
+      uint64_t due_ns = t0 + uint64_t(aus[j].dts - aus[0].dts) * 1000000000ull / ANNEXB_CLOCK_RATE;
+      uint64_t now_ns = nvdec::get_time_ns();
+      if (due_ns > now_ns) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(due_ns - now_ns));
+      }
+
+      if (0 != session.decode(aus[j])) {
+        printf("Failed to decode with --latency %s. (exiting).\n", nvdec::decode_session_latency_to_string(modes[i]));
+        exit(EXIT_FAILURE);
+      }
+    }
+
+    if (0 != session.flush() || 0 != session.shutdown()) {
+      exit(EXIT_FAILURE);
+    }
+
+    nvdec::DecodeSessionStats stats = session.get_stats();
+
+    printf("%-10s to host memory p50: %8.3f ms, p99: %8.3f ms, max: %8.3f ms, to display avg: %8.3f ms, over %llu pictures.\n",
+           nvdec::decode_session_latency_to_string(modes[i]),
+           double(nvdec::latency_histogram_get_percentile(stats.ready_latency, 50.0)) * 1e-6,
+           double(nvdec::latency_histogram_get_percentile(stats.ready_latency, 99.0)) * 1e-6,
+           double(stats.ready_latency.max_ns) * 1e-6,
+           (stats.num_latencies > 0) ? double(stats.latency_ns) * 1e-6 / stats.num_latencies : 0.0,
+           (unsigned long long)stats.ready_latency.num_samples);
+  }
+
+  backend->shutdown();
+  delete backend;
+
+  return 0;
+}
+
+static int bench_sinks(int argc, char** argv) {
+
+  if (argc < 1) {
+    printf("Usage: sinks <file.264> [cuvid|fake]. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  int backend_type = nvdec::backend_get_default_type();
+  if (argc > 1) {
+    backend_type = nvdec::backend_type_from_string(argv[1]);
+    if (BACKEND_TYPE_NONE == backend_type) {
+      printf("Unknown backend: %s. (exiting).\n", argv[1]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  /* The CRC on its own. */
+  std::vector<uint8_t> data(64 * 1024 * 1024);
+  uint32_t seed = 0x12345678;
+  for (size_t i = 0; i < data.size(); ++i) {
+    seed = seed * 1664525u + 1013904223u;
+    data[i] = (uint8_t)(seed >> 24);
+  }
+
+  uint32_t scalar_crc = nvdec::hash_sink_crc32c_with_isa(HASH_SINK_ISA_SCALAR, 0, data.data(), data.size());
+  int isas[] = { HASH_SINK_ISA_SCALAR, HASH_SINK_ISA_SSE42, HASH_SINK_ISA_ARM };
+
+  for (size_t i = 0; i < sizeof(isas) / sizeof(isas[0]); ++i) {
+
+    if (false == nvdec::hash_sink_is_isa_supported(isas[i])) {
+      continue;
+    }
+
+    uint64_t t0 = nvdec::get_time_ns();
+    uint32_t crc = nvdec::hash_sink_crc32c_with_isa(isas[i], 0, data.data(), data.size());
+    uint64_t t1 = nvdec::get_time_ns();
+
+    if (crc != scalar_crc) {
+      printf("The CRC32C of %s (%08x) is not the one of the scalar code (%08x). (exiting).\n", nvdec::hash_sink_isa_to_string(isas[i]), crc, scalar_crc);
+      exit(EXIT_FAILURE);
+    }
+
+    printf("crc32c %-8s %8.2f GB/s\n", nvdec::hash_sink_isa_to_string(isas[i]), double(data.size()) / (double(t1 - t0) * 1e-9) * 1e-9);
+  }
+
+  printf("\n");
+
+  std::vector<uint8_t> buf;
+  std::vector<nvdec::AccessUnit> aus;
+  if (0 != load_access_units(argv[0], false, buf, aus)) {
+    exit(EXIT_FAILURE);
+  }
+
+  nvdec::DecodeBackend* backend = create_backend(backend_type, nullptr);
+  if (nullptr == backend) {
+    exit(EXIT_FAILURE);
+  }
+
+  printf("Decoding %zu access units on %s.\n\n", aus.size(), backend->get_device_name().c_str());
+
+  const char* names[] = { "fd", "null", "hash", "map" };
+
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+
+    nvdec::DecodeSessionSettings settings;
+    std::string path;
+
+    if (0 == strcmp(names[i], "map")) {
+      settings.download = DECODE_SESSION_DOWNLOAD_SKIP;
+    }
+    else {
+      settings.sink_type = nvdec::frame_sink_type_from_string(names[i]);
+      path = (FRAME_SINK_TYPE_HASH == settings.sink_type) ? "sinks.nv12.crc32c" : "sinks.nv12";
+      settings.output_path = (FRAME_SINK_TYPE_NULL == settings.sink_type) ? "null" : path;
+    }
+
+    nvdec::DecodeSession session;
+    if (0 != session.init(backend, settings)) {
+      exit(EXIT_FAILURE);
+    }
+
+    uint64_t t0 = nvdec::get_time_ns();
+
+    for (size_t j = 0; j < aus.size(); ++j) {
+      if (0 != session.decode(aus[j].data, aus[j].size)) {
+        printf("Failed to decode with the %s sink. (exiting).\n", names[i]);
+        exit(EXIT_FAILURE);
+      }
+    }
+
+    if (0 != session.flush() || 0 != session.shutdown()) {
+      exit(EXIT_FAILURE);
+    }
+
+    uint64_t t1 = nvdec::get_time_ns();
+
+    nvdec::DecodeSessionStats stats = session.get_stats();
+    double duration = double(t1 - t0) * 1e-9;
+
+    printf("%-6s frames: %6llu, time: %8.3f s, %9.2f fps, %8.3f ms per frame, to the sink: %9.2f MB.\n",
+           names[i],
+           (unsigned long long)stats.num_frames,
+           duration,
+           (duration > 0.0) ? double(stats.num_frames) / duration : 0.0,
+           (stats.num_frames > 0) ? duration * 1e3 / stats.num_frames : 0.0,
+           double(stats.writer.sink.num_bytes) / (1024.0 * 1024.0));
+
+    if (false == path.empty()) {
+      remove(path.c_str());
+    }
+  }
+
+  backend->shutdown();
+  delete backend;
+
+  return 0;
+}
+
+/* Best effort; only clean pages are dropped. */
+static void drop_page_cache(const char* filepath) {
+
+#if defined(__linux__)
+  int fd = open(filepath, O_RDONLY);
+  if (-1 == fd) {
+    return;
+  }
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  close(fd);
+#endif
+}
+
+/* ------------------------------------------------ */
+
+static int load_file(const char* filepath, std::vector<uint8_t>& result) {
+
+  std::ifstream ifs(filepath, std::ios::in | std::ios::binary);
+  if (!ifs.is_open()) {
+    printf("Failed to open the file: %s.\n", filepath);
+    return -1;
+  }
+
+  ifs.seekg(0, std::ifstream::end);
+  size_t ifs_size = ifs.tellg();
+  ifs.seekg(0, std::ifstream::beg);
+
+  if (0 == ifs_size) {
+    printf("The file %s is empty.\n", filepath);
+    return -2;
+  }
+
+  result.resize(ifs_size);
+  ifs.read((char*)result.data(), ifs_size);
+
+  return 0;
+}
+
+/* Loads the file into `buf` and splits it; the access units point into `buf`. With `must_stamp` they get a dts and pts like the InputSource gives them. */
+static int load_access_units(const char* filepath, bool must_stamp, std::vector<uint8_t>& buf, std::vector<nvdec::AccessUnit>& result) {
+
+  if (0 != load_file(filepath, buf)) {
+    return -1;
+  }
+
+  nvdec::AnnexbSplitter splitter;
+  nvdec::AnnexbTimestamper timestamper;
+  nvdec::AccessUnit au;
+  const uint8_t* p = buf.data();
+  size_t nbytes = buf.size();
+
+  result.clear();
+
+  while (ANNEXB_OK == splitter.next(p, nbytes, true, au)) {
+    if (true == must_stamp) {
+      timestamper.stamp(au);
+    }
+    result.push_back(au);
+    p += au.size;
+    nbytes -= au.size;
+  }
+
+  return 0;
+}
+
+/* Creates and initializes a backend for device 0. `fake_decode_us` sets the decode time of the fake device; pass nullptr for its default. */
+static nvdec::DecodeBackend* create_backend(int backend_type, const char* fake_decode_us) {
+
+  nvdec::DecodeBackend* backend = nvdec::backend_create(backend_type);
+  if (nullptr == backend) {
+    printf("Failed to create the %s backend. (exiting).\n", nvdec::backend_type_to_string(backend_type));
+    return nullptr;
+  }
+
+  if (BACKEND_TYPE_FAKE == backend_type && nullptr != fake_decode_us) {
+    nvdec::FakeDeviceSettings device;
+    device.decode_ns = strtoull(fake_decode_us, nullptr, 10) * 1000ull;
+    static_cast<nvdec::FakeBackend*>(backend)->configure(device);
+  }
+
+  if (0 != backend->init(0)) {
+    printf("Failed to initialize the %s backend. (exiting).\n", nvdec::backend_type_to_string(backend_type));
+    delete backend;
+    return nullptr;
+  }
+
+  return backend;
+}
+
+/*
+   Creates something that looks like an Annex-B stream: an AUD
+   followed by a slice with random payload. The payload sizes
+   vary between 64 bytes and 64KB which is what you typically
+   see for P and I frames.
+*/
+static void generate_annexb(size_t nbytes, std::vector<uint8_t>& result) {
+
+  result.clear();
+  result.reserve(nbytes);
+
+  uint32_t seed = 0x12345678;
+
+  while (result.size() < nbytes) {
+
+    static const uint8_t aud[] = { 0x00, 0x00, 0x00, 0x01, 0x09, 0xF0 };
+    static const uint8_t slice[] = { 0x00, 0x00, 0x00, 0x01, 0x41, 0x9A };
+
+    result.insert(result.end(), aud, aud + sizeof(aud));
+    result.insert(result.end(), slice, slice + sizeof(slice));
+
+    seed = seed * 1664525u + 1013904223u;
+    size_t payload_size = 64 + (seed >> 16);
+    int num_zeros = 0;
+
+    for (size_t i = 0; i < payload_size && result.size() < nbytes; ++i) {
+      
+      seed = seed * 1664525u + 1013904223u;
+      uint8_t b = (uint8_t)(seed >> 24);
+
+      /* Insert an emulation prevention byte like an encoder does. */
+      if (num_zeros >= 2 && b <= 0x03) {
+        result.push_back(0x03);
+        num_zeros = 0;
+      }
+      
+      result.push_back(b);
+      num_zeros = (0x00 == b) ? num_zeros + 1 : 0;
+    }
+  }
+}
+
+/* ------------------------------------------------ */
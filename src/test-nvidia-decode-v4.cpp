@@ -0,0 +1,719 @@
+/*
+  NVIDIA DECODE EXPERIMENTS
+  =========================
+  
+  GENERAL INFO:
+
+    This repository contains a collection of experiments using
+    the NVDECODE SDK to decode H264 using hardware
+    acceleration. These tests are meant to be minimal and should
+    not be used in production environments. The code was written 
+    while diving into the APIs so things might be incorrect.
+
+    This particular test does the same thing as v3, but instead
+    of handing the complete file to the parser in one call, we
+    split the Annex-B stream into access units and feed the
+    parser one CUVIDSOURCEDATAPACKET per access unit. When all
+    access units have been parsed we send a packet with the
+    CUVID_PKT_ENDOFSTREAM flag so the parser flushes the frames
+    it's holding on to and then we map whatever is still in our
+    queue. See nvdec/annexb.h for the splitter.
+
+    By default the file is memory mapped (see nvdec/input.h) so
+    the parser can start as soon as the first pages are in and
+    we don't keep a copy of the whole file around. Use `--input
+    read` to read the whole file up front like v0..v3 do. Use
+    `--input stream` to read from a pipe (pass "-" to read from
+    stdin, which selects the stream input automatically) and
+    `--input follow` for a capture that's still being written.
+    At the end we print the time to the first written frame,
+    the frame rate and the peak resident memory so you can
+    compare them.
+
+    The decoded pictures are downloaded with async copies into a
+    pool of page-locked buffers (see nvdec/copy-pool.h); while
+    picture k is being copied we map picture k+1 and write
+    picture k-1. Use `--copy-depth N` to set the number of
+    copies that can be in flight; 1 gives the same behaviour as
+    the blocking copy in v3.
+
+    Writing happens on a separate thread (see
+    nvdec/frame-writer.h) that gets the downloaded frames
+    through a lock-free queue, so disk stalls don't stall the
+    parser. When the queue is full we block; `--write-queue N`
+    sets its size. We print how full the queue was and how long
+    the decode thread waited for the writer. `--sink fd|uring|pwritev`
+    selects how the writer writes (see nvdec/frame-sink.h): `fd`
+    goes through the page cache, `uring` and `pwritev` use
+    O_DIRECT straight from the page-locked copy buffers. We
+    print the sustained MB/s and the CPU time of the writer
+    thread so you can compare them.
+
+    To measure without the disk: `--sink null` runs the writer
+    but drops the frames, `--sink hash` writes a CRC32C per
+    frame to out.<format>.crc32c instead of the frame (diff two
+    of them to check that the output didn't change) and `--sink
+    map` doesn't even copy the pictures to host memory, it maps
+    and unmaps them and writes nothing.
+
+    The copies strip the pitch so we only move the visible
+    bytes and the writer can write each frame with a single
+    syscall; we print the bytes per frame with and without the
+    padding and the number of write syscalls per frame.
+
+    We only copy and write the display area of the pictures,
+    e.g. 1920x1080 of a 1920x1088 stream. `--crop decoder` (the
+    default) lets the decoder crop, `--crop copy` copies the
+    display area out of the full coded picture and `--crop
+    coded` writes the full coded size. We print the bytes per
+    frame that cropping saved.
+
+    `--scale WxH` makes the output smaller; use 0 for W or H to
+    keep the aspect ratio, e.g. `--scale 640x0`. With
+    `--scale-mode decoder` (the default) the decoder scales, so
+    we copy fewer bytes over PCIe. With `--scale-mode cpu` we
+    copy and write the full pictures and also write a proxy of
+    every picture in proxy.nv12, scaled on the CPU with the
+    `--scale-filter box|bilinear` filter (see nvdec/scale.h).
+    We print the bytes and the time per copy and the time per
+    scaled picture so you can compare both.
+
+    `--frames reference` drops the pictures that no other
+    picture refers to before they reach the parser and `--frames
+    intra` only decodes the intra pictures, for thumbnails and
+    scrubbing; we print how many access units we skipped.
+
+    `--seek N` starts decoding at the last IDR at or before
+    frame N (an access unit, counted from 0) instead of at the
+    start of the file. We find it in the index next to the
+    file, file.264.idx, which we create on the first seek (see
+    nvdec/stream-index.h); the SPS and PPS come from the index
+    too. Use `--seek-recovery N` to also start at recovery
+    point SEIs. This needs a file input.
+
+    The input gives every access unit a pts and dts, made from
+    the timing info in the SPS (see nvdec/annexb.h), which we
+    give to the parser. After a seek they continue from the
+    frame we start at. We print the pts of the last picture and
+    the average and max time from handing an access unit to the
+    parser until it displays the picture; that includes the
+    pictures it waits for to get the display order right.
+
+    `--latency low` is for live streams: no display delay in the
+    parser, no delay queue, every access unit is marked as a
+    complete picture and we wait for each copy as soon as we
+    start it (see nvdec/decode-session.h). `--latency
+    throughput` (the default) is the v3 pipeline. We print the
+    p50, p99 and max time from handing an access unit to the
+    parser until its picture is in host memory. The input is
+    read as fast as we can, so use the `latency` benchmark to
+    see the difference at the frame rate of a live stream.
+
+    The delay queue between the display callback and the map
+    adapts its depth to how long mapping blocks, for the
+    copies, the writer and the map itself. We print its depth
+    at the end, the range it moved in and how long it spent at
+    each depth, and log it every time we look at it.
+
+    `--trace trace.json` writes where the time of every frame
+    went as a Chrome trace: the parser and its callbacks, the
+    maps, copies and unmaps and the writes of the sink, per
+    thread. Open it in chrome://tracing or ui.perfetto.dev. The
+    spans are only compiled in when you configure with
+    `-DUSE_TRACE=ON` (see nvdec/trace.h).
+
+    When the resolution changes mid-stream we write out the
+    pictures of the old sequence and reconfigure the decoder
+    for the new size with cuvidReconfigureDecoder(). That only
+    works when the new size fits in the max size the decoder
+    was created with; `--max-size WxH` sets it (by default it's
+    the size of the first sequence). When the codec, the chroma
+    format or the bit depth change, or the new size doesn't fit,
+    we destroy the decoder and create a new one. We print how
+    long a create, destroy and reconfigure take on average. The
+    download buffers are pooled per resolution (see
+    nvdec/host-buffer-pool.h) so switching back to a resolution
+    we've seen doesn't allocate; we print the pool hits and
+    misses.
+
+    The number of decode surfaces comes from the stream: the
+    `min_num_decode_surfaces` the parser needs for the DPB, plus
+    the display delay of the parser and the size of our delay
+    queue, because the pictures in there must not be
+    overwritten before we map them. We return that number from
+    the sequence callback so the parser uses the same count. We
+    print the device memory each decoder takes (measured with
+    cuMemGetInfo() around the create) so you can work out how
+    many sessions fit on a card.
+
+    Everything that belongs to one stream (the parser, decoder,
+    delay queue, copy pool and writer) lives in a
+    nvdec::DecodeSession (see nvdec/decode-session.h), which
+    gets its state through the `pUserData` of the parser; this
+    test runs one session, the `sessions` benchmark of
+    test-nvidia-decode-bench runs many. The session runs on the
+    device that the SessionScheduler picks, which is the one
+    with the most free memory when there are several.
+
+    `--format i420|rgb24|bgra` converts the downloaded NV12 on
+    the CPU before we write it (see nvdec/convert.h), into
+    out.i420, out.rgb24 or out.bgra. For RGB, `--matrix
+    bt601|bt709` and `--range limited|full` describe the YUV of
+    the stream and `--convert-threads N` splits every picture
+    over N threads. We use AVX2 or NEON when we can and print
+    which one and the time spent converting.
+
+    `--container y4m` writes I420 in out.y4m, with the size,
+    frame rate and aspect ratio of the stream in its header, so
+    you can play it without telling ffplay the format. When the
+    stream changes size we continue in out.1.y4m, out.2.y4m etc.
+
+    All cuvid and cu calls go through a nvdec::DecodeBackend (see
+    nvdec/backend.h). Use `--backend fake` to run the complete
+    host side of this test without an NVIDIA GPU; the frames it
+    writes are a test pattern.
+
+        ./test-nvidia-decode-v4 [--input read|mmap|stream|follow] [--backend cuvid|fake] [--copy-depth N] [--write-queue N] [--sink fd|uring|pwritev|null|hash|map] [--max-size WxH] [--format nv12|i420|rgb24|bgra] [--matrix bt601|bt709] [--range limited|full] [--convert-threads N] [--container raw|y4m] [--crop decoder|copy|coded] [--scale WxH] [--scale-mode decoder|cpu] [--scale-filter box|bilinear] [--frames all|reference|intra] [--latency throughput|low] [--seek N] [--seek-recovery N] [--trace file.json] [file.264|-]
+        cat moonlight.264 | ./test-nvidia-decode-v4 -
+
+  QUESTIONS:
+  
+    Q1: Should I use the CUVIDDECODECREATEINFO.vidLock .. and when? 
+    A1: When more than one thread uses the context, e.g. one
+        decode session per thread; we use one lock per context,
+        see DecodeBackend::get_context_lock().
+
+    Q2: What are the video parser callbacks supposed to return?
+    A2: ....
+
+    Q3: When calling a cuvidCreateVideoParser(), do I need to provide `pExtVideoInfo` ? 
+    A3: I tested this by setting the pExtVideoInfo member to nullptr in the cudaDecodeGL example
+        and things were working fine w/o.
+
+  REFERENCES:
+
+    [0]: http://docs.nvidia.com/cuda/pdf/CUDA_C_Programming_Guide.pdf "Cuda C Programming Guide"
+    [1]: https://github.com/gpac/gpac/blob/9bf9d23283553bf8214d13b286ce759ddd216be0/modules/nvdec/nvdec.c "GPAC implementation of NVDECODE"
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <NvDecoder/nvcuvid.h>
+#include <NvDecoder/cuviddec.h>
+#include <nvdec/annexb.h>
+#include <nvdec/backend.h>
+#include <nvdec/decode-session.h>
+#include <nvdec/input.h>
+#include <nvdec/session-scheduler.h>
+#include <nvdec/stream-index.h>
+#include <nvdec/trace.h>
+#include <nvdec/utils.h>
+
+#define COPY_DEPTH 3
+#define WRITE_QUEUE_SIZE 8
+
+/* ------------------------------------------------ */
+
+int main(int argc, char** argv) {
+ 
+  printf("\n\nnvidia decode test v4.\n\n");
+
+  std::string filename = "./moonlight.264";
+  int input_type = INPUT_TYPE_MMAP;
+  int backend_type = nvdec::backend_get_default_type();
+  long long seek_frame = -1;
+  int seek_mode = STREAM_INDEX_FIND_IDR;
+  std::string trace_path;
+
+  nvdec::DecodeSessionSettings settings;
+  settings.copy_depth = COPY_DEPTH;
+  settings.write_queue_size = WRITE_QUEUE_SIZE;
+  settings.sink_type = FRAME_SINK_TYPE_FD;
+  settings.is_verbose = true;
+
+  for (int i = 1; i < argc; ++i) {
+    if (0 == strcmp(argv[i], "--input") && i + 1 < argc) {
+      input_type = nvdec::input_type_from_string(argv[++i]);
+    }
+    else if (0 == strcmp(argv[i], "--backend") && i + 1 < argc) {
+      backend_type = nvdec::backend_type_from_string(argv[++i]);
+    }
+    else if (0 == strcmp(argv[i], "--copy-depth") && i + 1 < argc) {
+      settings.copy_depth = atoi(argv[++i]);
+    }
+    else if (0 == strcmp(argv[i], "--write-queue") && i + 1 < argc) {
+      settings.write_queue_size = atoi(argv[++i]);
+    }
+    else if (0 == strcmp(argv[i], "--sink") && i + 1 < argc) {
+      ++i;
+      settings.download = (0 == strcmp(argv[i], "map")) ? DECODE_SESSION_DOWNLOAD_SKIP : DECODE_SESSION_DOWNLOAD_COPY;
+      settings.sink_type = (DECODE_SESSION_DOWNLOAD_SKIP == settings.download) ? FRAME_SINK_TYPE_NULL : nvdec::frame_sink_type_from_string(argv[i]);
+    }
+    else if (0 == strcmp(argv[i], "--max-size") && i + 1 < argc) {
+      if (2 != sscanf(argv[++i], "%dx%d", &settings.max_width, &settings.max_height) || settings.max_width <= 0 || settings.max_height <= 0) {
+        printf("Invalid --max-size, use WxH, e.g. 1920x1080. (exiting).\n");
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if (0 == strcmp(argv[i], "--format") && i + 1 < argc) {
+      settings.convert.format = nvdec::convert_format_from_string(argv[++i]);
+    }
+    else if (0 == strcmp(argv[i], "--matrix") && i + 1 < argc) {
+      settings.convert.matrix = nvdec::convert_matrix_from_string(argv[++i]);
+    }
+    else if (0 == strcmp(argv[i], "--range") && i + 1 < argc) {
+      settings.convert.range = nvdec::convert_range_from_string(argv[++i]);
+    }
+    else if (0 == strcmp(argv[i], "--convert-threads") && i + 1 < argc) {
+      settings.convert.num_threads = atoi(argv[++i]);
+    }
+    else if (0 == strcmp(argv[i], "--container") && i + 1 < argc) {
+      settings.container = nvdec::container_type_from_string(argv[++i]);
+    }
+    else if (0 == strcmp(argv[i], "--crop") && i + 1 < argc) {
+      settings.crop = nvdec::decode_session_crop_from_string(argv[++i]);
+    }
+    else if (0 == strcmp(argv[i], "--scale") && i + 1 < argc) {
+      settings.scale.height = 0;
+      int num_read = sscanf(argv[++i], "%dx%d", &settings.scale.width, &settings.scale.height);
+      if (num_read < 1 || settings.scale.width < 0 || settings.scale.height < 0 || (0 == settings.scale.width && 0 == settings.scale.height)) {
+        printf("Invalid --scale, use WxH, e.g. 640x360 or 640x0 to keep the aspect ratio. (exiting).\n");
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if (0 == strcmp(argv[i], "--scale-mode") && i + 1 < argc) {
+      settings.scale_mode = nvdec::decode_session_scale_from_string(argv[++i]);
+    }
+    else if (0 == strcmp(argv[i], "--scale-filter") && i + 1 < argc) {
+      settings.scale.filter = nvdec::scale_filter_from_string(argv[++i]);
+    }
+    else if (0 == strcmp(argv[i], "--frames") && i + 1 < argc) {
+      settings.frames = nvdec::decode_session_frames_from_string(argv[++i]);
+    }
+    else if (0 == strcmp(argv[i], "--latency") && i + 1 < argc) {
+      settings.latency = nvdec::decode_session_latency_from_string(argv[++i]);
+    }
+    else if ((0 == strcmp(argv[i], "--seek") || 0 == strcmp(argv[i], "--seek-recovery")) && i + 1 < argc) {
+      seek_mode = (0 == strcmp(argv[i], "--seek")) ? STREAM_INDEX_FIND_IDR : STREAM_INDEX_FIND_ANY;
+      seek_frame = atoll(argv[++i]);
+      if (seek_frame < 0) {
+        printf("Invalid %s, use a frame number of 0 or more. (exiting).\n", argv[i - 1]);
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if (0 == strcmp(argv[i], "--trace") && i + 1 < argc) {
+      trace_path = argv[++i];
+    }
+    else {
+      filename = argv[i];
+    }
+  }
+
+  if (INPUT_TYPE_NONE == input_type) {
+    printf("Invalid --input, use read, mmap, stream or follow. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (BACKEND_TYPE_NONE == backend_type) {
+    printf("Invalid --backend, use cuvid or fake. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (FRAME_SINK_TYPE_NONE == settings.sink_type) {
+    printf("Invalid --sink, use fd, uring, pwritev, null, hash or map. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (CONVERT_FORMAT_NONE == settings.convert.format) {
+    printf("Invalid --format, use nv12, i420, rgb24 or bgra. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (CONVERT_MATRIX_NONE == settings.convert.matrix) {
+    printf("Invalid --matrix, use bt601 or bt709. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (CONVERT_RANGE_NONE == settings.convert.range) {
+    printf("Invalid --range, use limited or full. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (settings.convert.num_threads <= 0) {
+    printf("Invalid --convert-threads, use 1 or more. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (DECODE_SESSION_CROP_NONE == settings.crop) {
+    printf("Invalid --crop, use decoder, copy or coded. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (DECODE_SESSION_FRAMES_NONE == settings.frames) {
+    printf("Invalid --frames, use all, reference or intra. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (DECODE_SESSION_LATENCY_NONE == settings.latency) {
+    printf("Invalid --latency, use throughput or low. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (DECODE_SESSION_SCALE_NONE == settings.scale_mode) {
+    printf("Invalid --scale-mode, use decoder or cpu. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (SCALE_FILTER_NONE == settings.scale.filter) {
+    printf("Invalid --scale-filter, use box or bilinear. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (DECODE_SESSION_SCALE_CPU == settings.scale_mode) {
+    settings.proxy_path = "proxy.nv12";
+  }
+
+  if (CONTAINER_TYPE_NONE == settings.container) {
+    printf("Invalid --container, use raw or y4m. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (CONTAINER_TYPE_Y4M == settings.container) {
+    if (CONVERT_FORMAT_NV12 != settings.convert.format && CONVERT_FORMAT_I420 != settings.convert.format) {
+      printf("Invalid --format, y4m only holds i420. (exiting).\n");
+      exit(EXIT_FAILURE);
+    }
+    settings.convert.format = CONVERT_FORMAT_I420;
+    settings.output_path = "out.y4m";
+  }
+  else {
+    settings.output_path = std::string("out.") + nvdec::convert_format_to_string(settings.convert.format);
+  }
+
+  if (FRAME_SINK_TYPE_HASH == settings.sink_type) {
+    settings.output_path += ".crc32c";
+    settings.proxy_path += (true == settings.proxy_path.empty()) ? "" : ".crc32c";
+  }
+
+  if (DECODE_SESSION_DOWNLOAD_SKIP == settings.download) {
+    settings.output_path.clear();
+    settings.proxy_path.clear();
+  }
+
+  if (false == trace_path.empty() && false == nvdec::trace_is_enabled()) {
+    printf("Invalid --trace, configure with -DUSE_TRACE=ON to record the spans. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  nvdec::trace_set_thread_name("decode");
+
+  /* We can't map or seek stdin. */
+  if ("-" == filename && INPUT_TYPE_FOLLOW != input_type) {
+    input_type = INPUT_TYPE_STREAM;
+  }
+
+  /* Create a backend per device, for cuvid this initializes cuda and creates the contexts. */
+  nvdec::SessionSchedulerSettings scheduler_settings;
+  scheduler_settings.backend_type = backend_type;
+
+  nvdec::SessionScheduler scheduler;
+  if (0 != scheduler.init(scheduler_settings)) {
+    printf("Failed to initialize the %s backend. (exiting).\n", nvdec::backend_type_to_string(backend_type));
+    exit(EXIT_FAILURE);
+  }
+
+  /* With one session this is the device with the most free memory. */
+  nvdec::SchedulerTicket ticket;
+  if (0 != scheduler.place(ticket)) {
+    printf("Failed to find a device for the decode session. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  nvdec::DecodeBackend* backend = scheduler.get_backend(ticket.device);
+  printf("Device: %s (%d of %d, %s backend).\n",
+         backend->get_device_name().c_str(),
+         ticket.device,
+         scheduler.get_num_devices(),
+         nvdec::backend_type_to_string(backend_type));
+
+  /* Creates the parser and opens the output file. */
+  nvdec::DecodeSession session;
+  if (0 != session.init(backend, settings)) {
+    printf("Failed to initialize the decode session. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* Open the input; this gives us one access unit at a time. */
+  nvdec::InputSource* input = nvdec::input_create(input_type);
+  if (nullptr == input) {
+    printf("Failed to create the input source. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (0 != input->open(filename)) {
+    printf("Failed to open the input: %s. (exiting).\n", filename.c_str());
+    exit(EXIT_FAILURE);
+  }
+
+  printf("Opened %s using the %s input.\n", filename.c_str(), nvdec::input_type_to_string(input_type));
+
+  /* Jump to the random access point before the frame and give the parser its parameter sets. */
+  if (seek_frame >= 0) {
+
+    if ("-" == filename) {
+      printf("Cannot seek in stdin. (exiting).\n");
+      exit(EXIT_FAILURE);
+    }
+
+    uint64_t index_start_ns = nvdec::get_time_ns();
+
+    nvdec::StreamIndex index;
+    if (0 != index.open(filename)) {
+      printf("Failed to open the index of %s. (exiting).\n", filename.c_str());
+      exit(EXIT_FAILURE);
+    }
+
+    nvdec::StreamIndexEntry entry;
+    const uint8_t* parameter_sets = nullptr;
+    size_t parameter_sets_nbytes = 0;
+
+    if (0 != index.find((uint64_t)seek_frame, seek_mode, entry)
+        || 0 != index.get_parameter_sets(entry, &parameter_sets, &parameter_sets_nbytes))
+      {
+        printf("There is no random access point at or before frame %lld. (exiting).\n", seek_frame);
+        exit(EXIT_FAILURE);
+      }
+
+    if (0 != input->seek(entry.offset)
+        || 0 != input->set_timeline(entry.frame, parameter_sets, parameter_sets_nbytes)
+        || 0 != session.seek(parameter_sets, parameter_sets_nbytes))
+      {
+      printf("Failed to seek to byte %llu. (exiting).\n", (unsigned long long)entry.offset);
+      exit(EXIT_FAILURE);
+    }
+
+    printf("Seeking to frame %lld: starting at frame %llu (%s, byte %llu), index: %u entries, %llu frames, %zu bytes, %.3f ms.\n",
+           seek_frame,
+           (unsigned long long)entry.frame,
+           nvdec::stream_index_entry_type_to_string(entry.type),
+           (unsigned long long)entry.offset,
+           index.get_num_entries(),
+           (unsigned long long)index.get_num_frames(),
+           index.get_nbytes(),
+           double(nvdec::get_time_ns() - index_start_ns) * 1e-6);
+  }
+
+  /* Feed the parser one access unit at a time. */
+  nvdec::AccessUnit au;
+  int input_result = ANNEXB_OK;
+  
+  while (ANNEXB_OK == (input_result = input->next(au))) {
+    if (0 != session.decode(au)) {
+      printf("Failed to decode an access unit. (exiting).\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (input_result < 0) {
+    printf("Failed to read from the input. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* Output the frames the parser and our delay queue still hold. */
+  if (0 != session.flush()) {
+    printf("Failed to flush the decode session. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* Cleanup */
+  /* ------------------------------------------------------ */
+
+  printf("Cleaning up.\n");
+
+  /* Lets the writer finish the queued frames, then destroys the parser and decoder. */
+  if (0 != session.shutdown()) {
+    printf("Failed to cleanly shutdown the decode session. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  input->close();
+  delete input;
+  input = nullptr;
+
+  nvdec::DecodeSessionStats stats = session.get_stats();
+  printf("Fed %llu access units into the parser, skipped %llu (%.2f MB) with --frames %s.\n",
+         (unsigned long long)stats.num_packets,
+         (unsigned long long)stats.num_skipped,
+         double(stats.num_skipped_bytes) / (1024.0 * 1024.0),
+         nvdec::decode_session_frames_to_string(settings.frames));
+
+  if (false == trace_path.empty() && 0 != nvdec::trace_write_json(trace_path)) {
+    printf("Failed to write the trace. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  printf("Shutting down the backend.\n");
+  scheduler.release(ticket);
+  backend = nullptr;
+
+  if (0 != scheduler.shutdown()) {
+    printf("Failed to cleanly shutdown the backend. (exiting).\n");
+    exit(EXIT_FAILURE);
+  }
+
+  const nvdec::CopyPoolStats& copy_stats = stats.copy;
+  const nvdec::HostBufferPoolStats& buffer_stats = stats.buffers;
+  const nvdec::FrameWriterStats& writer_stats = stats.writer;
+  int num_frames = (int)stats.num_frames;
+  
+  printf("Time to first frame: %.3f ms, peak RSS: %.2f MB.\n",
+         (stats.time_first_frame_ns > 0) ? double(stats.time_first_frame_ns - stats.time_start_ns) * 1e-6 : 0.0,
+         double(nvdec::get_peak_rss_bytes()) / (1024.0 * 1024.0));
+
+  double duration = double(stats.time_end_ns - stats.time_start_ns) * 1e-9;
+  double decode_duration = double(stats.time_decoded_ns - stats.time_start_ns) * 1e-9;
+  printf("Decoded %d frames in %.3f s, %.2f fps.\n", num_frames, decode_duration, (decode_duration > 0.0) ? num_frames / decode_duration : 0.0);
+  printf("Wrote %d frames in %.3f s, %.2f fps.\n", num_frames, duration, (duration > 0.0) ? num_frames / duration : 0.0);
+  printf("Latency from decode to display: %.3f ms avg, %.3f ms max, over %llu pictures, last pts: %.3f s.\n",
+         (stats.num_latencies > 0) ? double(stats.latency_ns) * 1e-6 / stats.num_latencies : 0.0,
+         double(stats.max_latency_ns) * 1e-6,
+         (unsigned long long)stats.num_latencies,
+         (ANNEXB_NO_TIMESTAMP != stats.last_pts) ? double(stats.last_pts) / ANNEXB_CLOCK_RATE : 0.0);
+  printf("Latency from decode to host memory (--latency %s): p50: %.3f ms, p99: %.3f ms, max: %.3f ms, over %llu pictures.\n",
+         nvdec::decode_session_latency_to_string(settings.latency),
+         double(nvdec::latency_histogram_get_percentile(stats.ready_latency, 50.0)) * 1e-6,
+         double(nvdec::latency_histogram_get_percentile(stats.ready_latency, 99.0)) * 1e-6,
+         double(stats.ready_latency.max_ns) * 1e-6,
+         (unsigned long long)stats.ready_latency.num_samples);
+  std::string depth_times;
+  uint64_t depth_total_ns = 0;
+  for (int i = 0; i <= DECODE_SESSION_MAX_QUEUE_SIZE; ++i) {
+    depth_total_ns += stats.queue_depth_ns[i];
+  }
+  for (int i = 0; i <= DECODE_SESSION_MAX_QUEUE_SIZE && depth_total_ns > 0; ++i) {
+    if (stats.queue_depth_ns[i] > 0) {
+      char buf[64];
+      snprintf(buf, sizeof(buf), " %d: %.1f%%", i, 100.0 * double(stats.queue_depth_ns[i]) / depth_total_ns);
+      depth_times += buf;
+    }
+  }
+  printf("Delay queue depth: %d (%d - %d), changes: %d, map stalls: %.3f ms, time per depth:%s.\n",
+         stats.queue_depth,
+         stats.min_queue_depth,
+         stats.max_queue_depth,
+         stats.num_queue_changes,
+         double(stats.map_stall_ns) * 1e-6,
+         depth_times.c_str());
+  printf("Copy depth: %d, copies: %llu (%.2f MB), stalls: %llu (%.3f ms).\n",
+         settings.copy_depth,
+         (unsigned long long)copy_stats.num_copies,
+         double(copy_stats.num_bytes) / (1024.0 * 1024.0),
+         (unsigned long long)copy_stats.num_stalls,
+         double(copy_stats.stall_ns) * 1e-6);
+  printf("Write queue: %d, average occupancy: %.2f, max occupancy: %llu, decoder stalls: %llu (%.3f ms), write time: %.3f ms.\n",
+         settings.write_queue_size,
+         (writer_stats.num_pushes > 0) ? double(writer_stats.total_occupancy) / writer_stats.num_pushes : 0.0,
+         (unsigned long long)writer_stats.max_occupancy,
+         (unsigned long long)writer_stats.num_producer_stalls,
+         double(writer_stats.producer_stall_ns) * 1e-6,
+         double(writer_stats.write_ns) * 1e-6);
+  printf("Bytes copied per frame: %.0f (%.0f with pitch), copy time per frame: %.3f ms, write syscalls per frame: %.2f.\n",
+         (copy_stats.num_copies > 0) ? double(copy_stats.num_bytes) / copy_stats.num_copies : 0.0,
+         (copy_stats.num_copies > 0) ? double(copy_stats.num_pitched_bytes) / copy_stats.num_copies : 0.0,
+         (copy_stats.num_copies > 0) ? double(copy_stats.copy_ns) * 1e-6 / copy_stats.num_copies : 0.0,
+         (writer_stats.num_frames > 0) ? double(writer_stats.sink.num_syscalls) / writer_stats.num_frames : 0.0);
+  printf("Crop: %s, %d x %d of %d x %d coded, saved %.0f bytes per frame.\n",
+         nvdec::decode_session_crop_to_string(settings.crop),
+         stats.width,
+         stats.height,
+         stats.coded_width,
+         stats.coded_height,
+         (copy_stats.num_copies > 0) ? double(stats.num_crop_saved_bytes) / copy_stats.num_copies : 0.0);
+  printf("Host buffers: hits: %llu, misses: %llu, evictions: %llu, peak: %.2f MB.\n",
+         (unsigned long long)buffer_stats.num_hits,
+         (unsigned long long)buffer_stats.num_misses,
+         (unsigned long long)buffer_stats.num_evictions,
+         double(buffer_stats.peak_bytes) / (1024.0 * 1024.0));
+  printf("Decoders created: %d (%.3f ms avg), destroyed: %d (%.3f ms avg), reconfigured: %d (%.3f ms avg).\n",
+         stats.num_decoders_created,
+         (stats.num_decoders_created > 0) ? double(stats.create_decoder_ns) * 1e-6 / stats.num_decoders_created : 0.0,
+         stats.num_decoders_destroyed,
+         (stats.num_decoders_destroyed > 0) ? double(stats.destroy_decoder_ns) * 1e-6 / stats.num_decoders_destroyed : 0.0,
+         stats.num_decoders_reconfigured,
+         (stats.num_decoders_reconfigured > 0) ? double(stats.reconfigure_decoder_ns) * 1e-6 / stats.num_decoders_reconfigured : 0.0);
+  printf("Decoder VRAM: %.2f MB (peak: %.2f MB), decode surfaces: %d, device memory: %.2f MB, sessions that fit: %llu.\n",
+         double(stats.decoder_vram_nbytes) / (1024.0 * 1024.0),
+         double(stats.peak_decoder_vram_nbytes) / (1024.0 * 1024.0),
+         stats.num_decode_surfaces,
+         double(stats.device_total_nbytes) / (1024.0 * 1024.0),
+         (stats.peak_decoder_vram_nbytes > 0) ? (unsigned long long)(stats.device_total_nbytes / stats.peak_decoder_vram_nbytes) : 0ull);
+  printf("Sink: %s%s, writes: %llu, max in flight: %llu, sustained: %.2f MB/s, writer CPU: %.3f ms (%.1f%%), process CPU: %.3f ms.\n",
+         (DECODE_SESSION_DOWNLOAD_SKIP == settings.download) ? "map" : nvdec::frame_sink_type_to_string(settings.sink_type),
+         (true == stats.is_direct) ? " (O_DIRECT)" : "",
+         (unsigned long long)writer_stats.sink.num_writes,
+         (unsigned long long)writer_stats.sink.max_in_flight,
+         (writer_stats.active_ns > 0) ? (double(writer_stats.num_bytes) / (1024.0 * 1024.0)) / (double(writer_stats.active_ns) * 1e-9) : 0.0,
+         double(writer_stats.cpu_ns) * 1e-6,
+         (writer_stats.active_ns > 0) ? 100.0 * double(writer_stats.cpu_ns) / double(writer_stats.active_ns) : 0.0,
+         double(nvdec::get_process_cpu_time_ns()) * 1e-6);
+
+  if (settings.scale.width > 0 || settings.scale.height > 0) {
+    printf("Scale: %s, %d x %d requested.\n",
+           nvdec::decode_session_scale_to_string(settings.scale_mode),
+           settings.scale.width,
+           settings.scale.height);
+  }
+
+  if (stats.num_scaled > 0) {
+    printf("Scaled %llu frames to %d x %d (%s) with %s, %.3f ms per frame, proxy playback with: ffplay -f rawvideo -pix_fmt nv12 -s %dx%d -i %s\n",
+           (unsigned long long)stats.num_scaled,
+           stats.proxy_width,
+           stats.proxy_height,
+           nvdec::scale_filter_to_string(settings.scale.filter),
+           nvdec::convert_isa_to_string(stats.scale_isa),
+           double(stats.scale_ns) * 1e-6 / stats.num_scaled,
+           stats.proxy_width,
+           stats.proxy_height,
+           settings.proxy_path.c_str());
+  }
+
+  if (stats.num_converted > 0) {
+    printf("Converted %llu frames to %s (%s, %s range) with %s on %d thread(s), %.3f ms per frame.\n",
+           (unsigned long long)stats.num_converted,
+           nvdec::convert_format_to_string(settings.convert.format),
+           nvdec::convert_matrix_to_string(settings.convert.matrix),
+           nvdec::convert_range_to_string(settings.convert.range),
+           nvdec::convert_isa_to_string(stats.convert_isa),
+           settings.convert.num_threads,
+           double(stats.convert_ns) * 1e-6 / stats.num_converted);
+  }
+  
+  const char* pix_fmt = "nv12";
+  switch (settings.convert.format) {
+    case CONVERT_FORMAT_I420:  { pix_fmt = "yuv420p"; break; }
+    case CONVERT_FORMAT_RGB24: { pix_fmt = "rgb24";   break; }
+    case CONVERT_FORMAT_BGRA:  { pix_fmt = "bgra";    break; }
+  }
+
+  if (FRAME_SINK_TYPE_HASH == settings.sink_type) {
+    printf("Wrote the CRC32C of every frame to %s.\n", settings.output_path.c_str());
+    return 0;
+  }
+
+  if (FRAME_SINK_TYPE_NULL == settings.sink_type) {
+    return 0;
+  }
+
+  if (CONTAINER_TYPE_Y4M == settings.container) {
+    printf("Wrote %d segment(s), playback with: ffplay %s\n", stats.num_segments, settings.output_path.c_str());
+    return 0;
+  }
+
+  printf("Playback with: ");
+  printf("ffplay -f rawvideo -pix_fmt %s -s %dx%d -i %s\n", pix_fmt, stats.width, stats.height, settings.output_path.c_str());
+
+  return 0;
+}
+
+/* ------------------------------------------------ */